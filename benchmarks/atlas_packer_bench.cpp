@@ -0,0 +1,77 @@
+// Times pack_atlas and plan_texture_pack on generated rectangle sets, from
+// UI-icon sized sets to large mixed ones, and reports page count and
+// occupancy alongside. Occupancy is image texels over page texels, so
+// padding and alignment count as waste.
+//
+// atlas_packer_bench [max size]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "atlas_packer.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double get_median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Sizes skewed toward small, like a real mix of icons, decals and a few large textures.
+static std::vector<ImageExtent> make_extents(uint32_t count, uint32_t max_extent, uint32_t seed) {
+    std::vector<ImageExtent> extents(count);
+    for (ImageExtent& extent : extents) {
+        seed = seed * 1664525u + 1013904223u;
+        float u = (seed >> 8) / 16777215.0f;
+        seed = seed * 1664525u + 1013904223u;
+        float v = (seed >> 8) / 16777215.0f;
+        extent.width = 4 + static_cast<uint32_t>(u * u * (max_extent - 4));
+        extent.height = 4 + static_cast<uint32_t>(v * v * (max_extent - 4));
+    }
+    return extents;
+}
+
+int main(int argc, char** argv) {
+    uint32_t max_size = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 256)) : 4096;
+    printf("atlas_packer_bench: %ux%u pages\n\n", max_size, max_size);
+    printf("    rects   largest   padding   pages   occupancy        ms\n");
+
+    const uint32_t sets[][3] = {
+        // count, largest extent, padding
+        { 64, 64, 2 }, { 256, 128, 4 }, { 1024, 128, 4 }, { 4096, 64, 2 }, { 1024, 512, 4 }, { 16384, 32, 1 },
+    };
+    for (const auto& set : sets) {
+        std::vector<ImageExtent> extents = make_extents(set[0], set[1], set[0] + set[1]);
+        AtlasLayout layout;
+        std::vector<double> samples;
+        for (int repeat = 0; repeat < 5; ++repeat) {
+            Clock::time_point start = Clock::now();
+            layout = pack_atlas(extents, max_size, set[2], 4);
+            samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        uint64_t area = 0;
+        for (const ImageExtent& extent : extents) {
+            area += static_cast<uint64_t>(extent.width) * extent.height;
+        }
+        double occupancy = static_cast<double>(area) / (static_cast<double>(layout.width) * layout.height * layout.page_count);
+        printf("    %5u   %7u   %7u   %5u   %8.1f%%  %8.3f\n", set[0], set[1], set[2], layout.page_count, occupancy * 100.0,
+               get_median(samples));
+    }
+
+    // A pack plan where most images share a few sizes and become arrays.
+    std::vector<ImageExtent> extents = make_extents(2000, 256, 7);
+    for (size_t i = 0; i < extents.size(); i += 2) {
+        extents[i] = { 256u >> (i % 3), 256u >> (i % 3) };
+    }
+    std::vector<double> samples;
+    TexturePackPlan plan;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        Clock::time_point start = Clock::now();
+        plan = plan_texture_pack(extents);
+        samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    printf("\n    plan_texture_pack: %zu images into %zu groups in %.3f ms\n", extents.size(), plan.groups.size(), get_median(samples));
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Encodes a generated corpus to BC1, BC3, BC4, BC5 and BC7 at both
+// qualities and reports PSNR and encode throughput for each, through
+// measure_block_compression.
+//
+// block_compress_bench [size] [workers]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "block_compress.hpp"
+#include "job_pool.hpp"
+
+struct CorpusImage {
+    const char* name;
+    std::vector<uint8_t> rgba;
+};
+
+static uint8_t to_unorm(float value) {
+    return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Each image stresses something different: smooth ramps show banding,
+// noise has no structure to exploit, the pattern has hard edges between
+// unrelated colors, and the normal map is what BC5 is for.
+static std::vector<CorpusImage> make_corpus(uint32_t size) {
+    std::vector<CorpusImage> corpus = { { "gradient", {} }, { "noise", {} }, { "pattern", {} }, { "normal map", {} } };
+    for (CorpusImage& image : corpus) {
+        image.rgba.resize(static_cast<size_t>(size) * size * 4);
+    }
+    uint32_t state = 42;
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            float u = static_cast<float>(x) / size;
+            float v = static_cast<float>(y) / size;
+            size_t i = (static_cast<size_t>(y) * size + x) * 4;
+            state = state * 1664525u + 1013904223u;
+            float noise = (state >> 8) / 16777215.0f;
+
+            uint8_t* gradient = &corpus[0].rgba[i];
+            gradient[0] = to_unorm(u);
+            gradient[1] = to_unorm(v);
+            gradient[2] = to_unorm(0.5f + 0.5f * std::sin(6.2831853f * (u + v)));
+            gradient[3] = to_unorm(1.0f - u * v);
+
+            uint8_t* random = &corpus[1].rgba[i];
+            random[0] = static_cast<uint8_t>(state >> 24);
+            random[1] = static_cast<uint8_t>(state >> 16);
+            random[2] = static_cast<uint8_t>(state >> 8);
+            random[3] = to_unorm(noise);
+
+            uint8_t* pattern = &corpus[2].rgba[i];
+            bool checker = ((x / 8) ^ (y / 8)) & 1;
+            bool stripe = (x + y) / 5 % 3 == 0;
+            pattern[0] = checker ? 230 : 20;
+            pattern[1] = stripe ? 200 : 60;
+            pattern[2] = to_unorm(0.5f + 0.4f * std::cos(40.0f * u) + 0.1f * noise);
+            pattern[3] = checker ? 255 : 0;
+
+            // Bumps as a tangent-space normal map, xy in red and green.
+            float dx = std::cos(25.0f * u) * std::sin(17.0f * v) * 0.6f;
+            float dy = std::sin(25.0f * u) * std::cos(17.0f * v) * 0.6f;
+            float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+            uint8_t* normal = &corpus[3].rgba[i];
+            normal[0] = to_unorm(dx / length * 0.5f + 0.5f);
+            normal[1] = to_unorm(dy / length * 0.5f + 0.5f);
+            normal[2] = to_unorm(1.0f / length * 0.5f + 0.5f);
+            normal[3] = 255;
+        }
+    }
+    return corpus;
+}
+
+static const char* get_format_name(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::bc1: return "BC1";
+        case PixelFormat::bc3: return "BC3";
+        case PixelFormat::bc4: return "BC4";
+        case PixelFormat::bc5: return "BC5";
+        case PixelFormat::bc7: return "BC7";
+        default: return "?";
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t size = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 4)) & ~3u : 256;
+    uint32_t hardware = std::max(std::thread::hardware_concurrency(), 2u);
+    uint32_t workers = argc > 2 ? static_cast<uint32_t>(std::max(atoi(argv[2]), 1)) : hardware - 1;
+    JobPool pool(workers);
+    std::vector<CorpusImage> corpus = make_corpus(size);
+
+    printf("block_compress_bench: %ux%u images, %u workers + main thread\n\n", size, size, pool.get_worker_count());
+    printf("    format  quality   image          PSNR dB      MP/s\n");
+    const PixelFormat formats[] = { PixelFormat::bc1, PixelFormat::bc3, PixelFormat::bc4, PixelFormat::bc5, PixelFormat::bc7 };
+    for (PixelFormat format : formats) {
+        for (BlockQuality quality : { BlockQuality::fast, BlockQuality::high }) {
+            double total_seconds = 0.0;
+            for (const CorpusImage& image : corpus) {
+                BlockCompressionReport report = measure_block_compression(format, image.rgba.data(), size, size, quality, &pool);
+                total_seconds += report.seconds;
+                char psnr[16];
+                snprintf(psnr, sizeof(psnr), std::isinf(report.psnr) ? "lossless" : "%.2f", report.psnr);
+                printf("    %-6s  %-7s   %-12s %9s %9.2f\n", get_format_name(format), quality == BlockQuality::fast ? "fast" : "high",
+                       image.name, psnr, report.megapixels_per_second);
+            }
+            printf("    %-6s  %-7s   %-12s %9s %9.2f\n\n", get_format_name(format), quality == BlockQuality::fast ? "fast" : "high", "all", "",
+                   static_cast<double>(size) * size * corpus.size() / total_seconds / 1e6);
+        }
+    }
+    return 0;
+}
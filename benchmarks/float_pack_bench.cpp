@@ -0,0 +1,90 @@
+// Packs generated HDR images to rgba16f, r11g11b10f and rgb9e5 through
+// measure_float_packing, serially and on the job pool, and reports
+// throughput with the relative error of each format.
+//
+// float_pack_bench [size] [workers]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "float_pack.hpp"
+#include "job_pool.hpp"
+
+struct HdrImage {
+    const char* name;
+    std::vector<float> rgba;
+};
+
+// A sky-like gradient with a sun far brighter than the rest, and noise over
+// six orders of magnitude, so every exponent range gets used.
+static std::vector<HdrImage> make_images(uint32_t size) {
+    std::vector<HdrImage> images = { { "sky", {} }, { "noise", {} } };
+    for (HdrImage& image : images) {
+        image.rgba.resize(static_cast<size_t>(size) * size * 4);
+    }
+    uint32_t state = 3;
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            float u = static_cast<float>(x) / size;
+            float v = static_cast<float>(y) / size;
+            size_t i = (static_cast<size_t>(y) * size + x) * 4;
+
+            float distance = std::hypot(u - 0.7f, v - 0.2f);
+            float sun = 20000.0f * std::exp(-distance * distance * 4000.0f);
+            float* sky = &images[0].rgba[i];
+            sky[0] = 0.3f + 0.5f * v + sun;
+            sky[1] = 0.5f + 0.4f * v + sun * 0.9f;
+            sky[2] = 1.2f - 0.6f * v + sun * 0.7f;
+            sky[3] = 1.0f;
+
+            float* noise = &images[1].rgba[i];
+            for (int c = 0; c < 4; ++c) {
+                state = state * 1664525u + 1013904223u;
+                noise[c] = std::pow(10.0f, -3.0f + 6.0f * ((state >> 8) / 16777216.0f));
+            }
+        }
+    }
+    return images;
+}
+
+static const char* get_format_name(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::rgba16f: return "rgba16f";
+        case PixelFormat::r11g11b10f: return "r11g11b10f";
+        case PixelFormat::rgb9e5: return "rgb9e5";
+        default: return "?";
+    }
+}
+
+// Median of five runs, so a scheduling hiccup does not decide the result.
+static FloatPackReport measure(PixelFormat format, const std::vector<float>& rgba, uint32_t size, JobPool* job_pool) {
+    std::vector<FloatPackReport> reports;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        reports.push_back(measure_float_packing(format, rgba.data(), size, size, job_pool));
+    }
+    std::sort(reports.begin(), reports.end(), [](const FloatPackReport& a, const FloatPackReport& b) { return a.seconds < b.seconds; });
+    return reports[reports.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    uint32_t size = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 4)) : 2048;
+    uint32_t hardware = std::max(std::thread::hardware_concurrency(), 2u);
+    uint32_t workers = argc > 2 ? static_cast<uint32_t>(std::max(atoi(argv[2]), 1)) : hardware - 1;
+    JobPool pool(workers);
+    std::vector<HdrImage> images = make_images(size);
+
+    printf("float_pack_bench: %ux%u images, %u workers + main thread\n\n", size, size, pool.get_worker_count());
+    printf("    format       image   serial MP/s   pool MP/s   max error  mean error\n");
+    for (PixelFormat format : { PixelFormat::rgba16f, PixelFormat::r11g11b10f, PixelFormat::rgb9e5 }) {
+        for (const HdrImage& image : images) {
+            FloatPackReport serial = measure(format, image.rgba, size, nullptr);
+            FloatPackReport parallel = measure(format, image.rgba, size, &pool);
+            printf("    %-10s   %-5s %13.1f %11.1f   %9.2e  %9.2e\n", get_format_name(format), image.name, serial.megapixels_per_second,
+                   parallel.megapixels_per_second, serial.max_relative_error, serial.mean_relative_error);
+        }
+    }
+    return 0;
+}
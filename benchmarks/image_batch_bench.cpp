@@ -0,0 +1,190 @@
+// Writes a corpus of PNG, TGA, PPM and PGM files to a temporary directory
+// and decodes it with ImageBatchLoader, reporting wall-clock throughput and
+// the loader's own per-stage totals.
+//
+// image_batch_bench [image count] [size] [workers] [io threads]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "image_batch_loader.hpp"
+#include "job_pool.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static void put_u32_be(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint32_t get_crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc >> 1 ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void put_chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    put_u32_be(out, static_cast<uint32_t>(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32_be(out, get_crc32(out.data() + start, out.size() - start));
+}
+
+// RGBA PNG with Sub-filtered rows in stored deflate blocks, so the decoder
+// still unfilters every row but the file needs no compressor to write.
+static std::vector<uint8_t> encode_png(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> raw;
+    raw.reserve((static_cast<size_t>(width) * 4 + 1) * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* row = &rgba[static_cast<size_t>(y) * width * 4];
+        raw.push_back(1);
+        for (uint32_t i = 0; i < width * 4; ++i) {
+            raw.push_back(static_cast<uint8_t>(row[i] - (i >= 4 ? row[i - 4] : 0)));
+        }
+    }
+
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+        uint16_t length = static_cast<uint16_t>(std::min<size_t>(raw.size() - offset, 65535));
+        zlib.push_back(offset + length == raw.size() ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(length));
+        zlib.push_back(static_cast<uint8_t>(length >> 8));
+        zlib.push_back(static_cast<uint8_t>(~length));
+        zlib.push_back(static_cast<uint8_t>(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+    }
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (uint8_t value : raw) {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32_be(zlib, b << 16 | a);
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> header;
+    put_u32_be(header, width);
+    put_u32_be(header, height);
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+    put_chunk(png, "IHDR", header);
+    put_chunk(png, "IDAT", zlib);
+    put_chunk(png, "IEND", {});
+    return png;
+}
+
+// Uncompressed 32-bit TGA, which goes through stb_image.
+static std::vector<uint8_t> encode_tga(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> tga(18, 0);
+    tga[2] = 2;
+    tga[12] = static_cast<uint8_t>(width);
+    tga[13] = static_cast<uint8_t>(width >> 8);
+    tga[14] = static_cast<uint8_t>(height);
+    tga[15] = static_cast<uint8_t>(height >> 8);
+    tga[16] = 32;
+    tga[17] = 0x28;
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        tga.insert(tga.end(), { rgba[i + 2], rgba[i + 1], rgba[i], rgba[i + 3] });
+    }
+    return tga;
+}
+
+static std::vector<uint8_t> encode_pnm(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, bool grey) {
+    std::string header = (grey ? "P5\n" : "P6\n") + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::vector<uint8_t> pnm(header.begin(), header.end());
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        if (grey) {
+            pnm.push_back(rgba[i + 1]);
+        } else {
+            pnm.insert(pnm.end(), { rgba[i], rgba[i + 1], rgba[i + 2] });
+        }
+    }
+    return pnm;
+}
+
+static std::vector<uint8_t> make_image(uint32_t size, uint32_t seed) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(size) * size * 4);
+    uint32_t state = seed;
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            state = state * 1664525u + 1013904223u;
+            uint8_t* p = &rgba[(static_cast<size_t>(y) * size + x) * 4];
+            p[0] = static_cast<uint8_t>((x + seed) * 255 / size);
+            p[1] = static_cast<uint8_t>(y * 255 / size + (state >> 30));
+            p[2] = static_cast<uint8_t>(((x / 16) ^ (y / 16)) & 1 ? 200 : state >> 24);
+            p[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+static bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+int main(int argc, char** argv) {
+    uint32_t count = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 1)) : 64;
+    uint32_t size = argc > 2 ? static_cast<uint32_t>(std::clamp(atoi(argv[2]), 1, 8192)) : 512;
+    uint32_t hardware = std::max(std::thread::hardware_concurrency(), 2u);
+    uint32_t workers = argc > 3 ? static_cast<uint32_t>(std::max(atoi(argv[3]), 1)) : hardware - 1;
+    uint32_t io_threads = argc > 4 ? static_cast<uint32_t>(std::max(atoi(argv[4]), 1)) : 2;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "image_batch_bench";
+    std::filesystem::create_directories(directory);
+    const char* formats[] = { "png", "tga", "ppm", "pgm" };
+    std::vector<std::vector<std::string>> paths(4);
+    for (uint32_t i = 0; i < count; ++i) {
+        std::vector<uint8_t> rgba = make_image(size, i);
+        for (uint32_t format = 0; format < 4; ++format) {
+            std::vector<uint8_t> data = format == 0 ? encode_png(rgba, size, size)
+                                      : format == 1 ? encode_tga(rgba, size, size)
+                                                    : encode_pnm(rgba, size, size, format == 3);
+            std::string path = (directory / ("image" + std::to_string(i) + "." + formats[format])).string();
+            if (!write_file(path, data)) {
+                fprintf(stderr, "Failed to write %s\n", path.c_str());
+                return 1;
+            }
+            paths[format].push_back(path);
+        }
+    }
+
+    JobPool pool(workers);
+    printf("image_batch_bench: %u %ux%u images per format, %u workers + main thread, %u io threads\n\n", count, size, size,
+           pool.get_worker_count(), io_threads);
+    printf("    format   images/s      MP/s   file MB/s\n");
+    int result = 0;
+    for (uint32_t format = 0; format < 4; ++format) {
+        ImageBatchLoader loader(pool, io_threads);
+        Clock::time_point start = Clock::now();
+        loader.load_batch(paths[format]);
+        loader.wait_all();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        ImageBatchStats stats = loader.get_stats();
+        if (stats.images_failed) {
+            result = 1;
+        }
+        printf("    %-6s %10.1f %9.1f %11.1f\n", formats[format], count / seconds, static_cast<double>(size) * size * count / seconds / 1e6,
+               stats.bytes_read / seconds / 1e6);
+        printf("             %s\n", format_image_batch_stats(stats).c_str());
+    }
+    std::filesystem::remove_all(directory);
+    return result;
+}
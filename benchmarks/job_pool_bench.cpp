@@ -0,0 +1,179 @@
+// Benchmarks for the core job system: spawn overhead, fork/join latency,
+// parallel_for scaling and task graph throughput. Portable; meant to be run
+// on a quiet Linux box so numbers are comparable between changes.
+//
+// job_pool_bench [max_workers]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "job_pool.hpp"
+#include "task_graph.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double get_elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+static double get_median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Enough arithmetic that a chunk is not dominated by scheduling.
+static float burn(uint32_t seed, uint32_t iterations) {
+    float value = static_cast<float>(seed);
+    for (uint32_t i = 0; i < iterations; ++i) {
+        value = std::sqrt(value * 1.0001f + 1.0f);
+    }
+    return value;
+}
+
+static void bench_spawn(JobPool& pool) {
+    const uint32_t job_count = 200000;
+    std::atomic<uint32_t> done(0);
+
+    // From outside the pool, every job goes through the shared queue.
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < job_count; ++i) {
+        pool.submit([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+    }
+    while (done.load() < job_count) {
+        std::this_thread::yield();
+    }
+    double outside_ns = get_elapsed_ns(start) / job_count;
+
+    // From a worker, jobs go on its own deque and the others steal.
+    done = 0;
+    start = Clock::now();
+    pool.submit([&pool, &done] {
+        for (uint32_t i = 0; i < job_count; ++i) {
+            pool.submit([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+    });
+    while (done.load() < job_count) {
+        std::this_thread::yield();
+    }
+    double worker_ns = get_elapsed_ns(start) / job_count;
+
+    printf("spawn overhead        outside %7.1f ns/job   from worker %7.1f ns/job\n", outside_ns, worker_ns);
+}
+
+static void bench_fork_join(JobPool& pool) {
+    const uint32_t rounds = 2000;
+    std::vector<double> samples;
+    samples.reserve(rounds);
+    std::atomic<uint32_t> sink(0);
+    uint32_t fan_out = (pool.get_worker_count() + 1) * 4;
+    for (uint32_t round = 0; round < rounds; ++round) {
+        Clock::time_point start = Clock::now();
+        pool.parallel_for(fan_out, 1, [&sink](uint32_t begin, uint32_t end) {
+            sink.fetch_add(end - begin, std::memory_order_relaxed);
+        });
+        samples.push_back(get_elapsed_ns(start));
+    }
+    std::sort(samples.begin(), samples.end());
+    printf("fork/join latency     %u empty chunks   median %7.2f us   p99 %7.2f us\n", fan_out, samples[rounds / 2] / 1000.0,
+           samples[rounds * 99 / 100] / 1000.0);
+}
+
+static double time_parallel_for(JobPool* pool, const std::vector<uint32_t>& costs, std::vector<float>& out) {
+    std::vector<double> samples;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        Clock::time_point start = Clock::now();
+        auto body = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                out[i] = burn(i, costs[i]);
+            }
+        };
+        if (pool) {
+            pool->parallel_for(static_cast<uint32_t>(costs.size()), 0, body);
+        } else {
+            body(0, static_cast<uint32_t>(costs.size()));
+        }
+        samples.push_back(get_elapsed_ns(start));
+    }
+    return get_median(samples);
+}
+
+static void bench_scaling(uint32_t max_workers) {
+    // Uneven items, like culling a scene where some objects cost far more.
+    const uint32_t item_count = 1 << 16;
+    std::vector<uint32_t> costs(item_count);
+    uint32_t state = 12345;
+    for (uint32_t& cost : costs) {
+        state = state * 1664525u + 1013904223u;
+        cost = 16 + (state >> 24) % 240;
+    }
+    std::vector<float> out(item_count);
+
+    double serial_ns = time_parallel_for(nullptr, costs, out);
+    printf("parallel_for scaling  %u items, serial %.2f ms\n", item_count, serial_ns / 1e6);
+    printf("    threads       ms   speedup   efficiency   splits   stolen\n");
+    std::vector<uint32_t> worker_counts;
+    for (uint32_t workers = 1; workers < max_workers; workers = workers < 4 ? workers + 1 : workers * 2) {
+        worker_counts.push_back(workers);
+    }
+    worker_counts.push_back(max_workers);
+    for (uint32_t workers : worker_counts) {
+        JobPool pool(workers);
+        double ns = time_parallel_for(&pool, costs, out);
+        JobPoolStats stats = pool.get_stats();
+        uint32_t threads = workers + 1;
+        double speedup = serial_ns / ns;
+        printf("    %7u %8.2f %9.2f %11.0f%% %8llu %8llu\n", threads, ns / 1e6, speedup, 100.0 * speedup / threads,
+               static_cast<unsigned long long>(stats.parallel_for_splits), static_cast<unsigned long long>(stats.jobs_stolen));
+    }
+}
+
+static void bench_task_graph(JobPool& pool) {
+    // Layers of independent tasks, each depending on two of the layer before.
+    const uint32_t width = 64;
+    const uint32_t depth = 16;
+    TaskGraph graph;
+    std::vector<float> out(width * depth);
+    std::vector<TaskGraph::TaskId> previous;
+    for (uint32_t layer = 0; layer < depth; ++layer) {
+        std::vector<TaskGraph::TaskId> current;
+        for (uint32_t i = 0; i < width; ++i) {
+            uint32_t slot = layer * width + i;
+            TaskGraph::TaskId id = graph.add([&out, slot] { out[slot] = burn(slot, 2000); });
+            if (!previous.empty()) {
+                graph.add_dependency(id, previous[i]);
+                graph.add_dependency(id, previous[(i + 1) % width]);
+            }
+            current.push_back(id);
+        }
+        previous = std::move(current);
+    }
+
+    std::vector<double> samples;
+    for (int repeat = 0; repeat < 20; ++repeat) {
+        Clock::time_point start = Clock::now();
+        pool.run(graph);
+        samples.push_back(get_elapsed_ns(start));
+    }
+    double ns = get_median(samples);
+    printf("task graph            %u tasks in %u layers   %7.3f ms   %6.2f us/task\n", graph.size(), depth, ns / 1e6,
+           ns / 1000.0 / graph.size());
+}
+
+int main(int argc, char** argv) {
+    uint32_t hardware = std::max(std::thread::hardware_concurrency(), 2u);
+    uint32_t max_workers = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 1)) : hardware - 1;
+
+    JobPool pool(max_workers);
+    printf("job_pool_bench: %u workers + main thread\n\n", pool.get_worker_count());
+    bench_spawn(pool);
+    bench_fork_join(pool);
+    bench_task_graph(pool);
+    printf("\n");
+    bench_scaling(max_workers);
+    return 0;
+}
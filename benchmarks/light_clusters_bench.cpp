@@ -0,0 +1,71 @@
+// Benchmarks CPU light binning into the default 16x9x24 cluster grid for
+// growing light counts, serially and on the job pool.
+//
+// light_clusters_bench [workers]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "job_pool.hpp"
+#include "light_clusters.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double get_median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Lights scattered through the view frustum, the way a scene full of small
+// point lights lands in it.
+static std::vector<ClusterLight> make_lights(uint32_t count) {
+    std::vector<ClusterLight> lights(count);
+    uint32_t state = 12345;
+    auto next = [&state](float low, float high) {
+        state = state * 1664525u + 1013904223u;
+        return low + (high - low) * (state >> 8) / 16777215.0f;
+    };
+    for (ClusterLight& light : lights) {
+        float z = next(1.0f, 90.0f);
+        light.position[0] = next(-0.8f, 0.8f) * z;
+        light.position[1] = next(-0.45f, 0.45f) * z;
+        light.position[2] = z;
+        light.range = next(0.5f, 3.0f);
+        light.spot_cos_outer = -1.0f;
+    }
+    return lights;
+}
+
+static double time_bin(LightClusterer& clusterer, const std::vector<ClusterLight>& lights, JobPool* job_pool) {
+    const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    std::vector<double> samples;
+    for (int repeat = 0; repeat < 30; ++repeat) {
+        Clock::time_point start = Clock::now();
+        clusterer.bin(identity, lights.data(), static_cast<uint32_t>(lights.size()), job_pool);
+        samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return get_median(samples);
+}
+
+int main(int argc, char** argv) {
+    uint32_t hardware = std::max(std::thread::hardware_concurrency(), 2u);
+    uint32_t workers = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 1)) : hardware - 1;
+    JobPool pool(workers);
+
+    LightClusterer clusterer;
+    clusterer.set_projection(1.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    printf("light_clusters_bench: %u clusters, %u workers + main thread\n\n", clusterer.get_cluster_count(), pool.get_worker_count());
+    printf("     lights   serial ms   pool ms   speedup   indices   truncated\n");
+    for (uint32_t count : { 256u, 1024u, 4096u, 16384u }) {
+        std::vector<ClusterLight> lights = make_lights(count);
+        double serial_ms = time_bin(clusterer, lights, nullptr);
+        double pool_ms = time_bin(clusterer, lights, &pool);
+        printf("    %7u %11.3f %9.3f %9.2f %9zu   %s\n", count, serial_ms, pool_ms, serial_ms / pool_ms, clusterer.get_light_indices().size(),
+               clusterer.was_truncated() ? "yes" : "no");
+    }
+    return 0;
+}
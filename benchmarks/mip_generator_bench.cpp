@@ -0,0 +1,72 @@
+// Benchmarks full mip chain generation from RGBA8 sources with the box and
+// Kaiser filters, in linear light and sRGB, serially and on the job pool.
+// Throughput is level-0 bytes per second.
+//
+// mip_generator_bench [workers]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "job_pool.hpp"
+#include "mip_generator.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double get_median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Smooth gradients with noise on top, so neither the filter nor the sRGB
+// tables see only a handful of values.
+static std::vector<uint8_t> make_image(uint32_t width, uint32_t height) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    uint32_t state = 1;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            uint8_t* p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+            p[0] = static_cast<uint8_t>(x * 255 / width + (state >> 29));
+            p[1] = static_cast<uint8_t>(y * 255 / height + (state >> 28 & 3));
+            p[2] = static_cast<uint8_t>(state >> 24);
+            p[3] = 255;
+        }
+    }
+    return rgba;
+}
+
+static double time_chain(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, MipFilter filter, bool srgb, JobPool* job_pool) {
+    MipChain chain;
+    std::vector<double> samples;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        Clock::time_point start = Clock::now();
+        generate_mip_chain(rgba.data(), width, height, filter, srgb, job_pool, chain);
+        samples.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    return rgba.size() / get_median(samples) / 1e6;
+}
+
+int main(int argc, char** argv) {
+    uint32_t hardware = std::max(std::thread::hardware_concurrency(), 2u);
+    uint32_t workers = argc > 1 ? static_cast<uint32_t>(std::max(atoi(argv[1]), 1)) : hardware - 1;
+    JobPool pool(workers);
+    printf("mip_generator_bench: %u workers + main thread, MB/s of level 0\n\n", pool.get_worker_count());
+    printf("          size   filter   space    serial      pool\n");
+
+    const uint32_t sizes[][2] = { { 1024, 1024 }, { 2048, 2048 }, { 1000, 600 } };
+    for (const auto& size : sizes) {
+        std::vector<uint8_t> rgba = make_image(size[0], size[1]);
+        for (MipFilter filter : { MipFilter::box, MipFilter::kaiser }) {
+            for (bool srgb : { false, true }) {
+                double serial = time_chain(rgba, size[0], size[1], filter, srgb, nullptr);
+                double parallel = time_chain(rgba, size[0], size[1], filter, srgb, &pool);
+                printf("    %4ux%-4u   %-6s   %-6s %8.1f  %8.1f\n", size[0], size[1], filter == MipFilter::box ? "box" : "kaiser",
+                       srgb ? "srgb" : "linear", serial, parallel);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Chase-Lev work-stealing deque, with the memory orderings of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (2013).
+// The owning thread pushes and pops at the bottom (LIFO, cache-warm); any
+// other thread steals from the top (FIFO, oldest and usually largest work
+// first). T must be trivially copyable, typically a pointer.
+//
+// The ring grows when full. Outgrown rings stay alive until the deque is
+// destroyed, since a thief may still be reading one; growth doubles, so
+// they add up to less than the live ring.
+template <typename T>
+class ChaseLevDeque {
+public:
+    explicit ChaseLevDeque(uint32_t log_capacity = 8) : top(0), bottom(0) {
+        rings.push_back(std::make_unique<Ring>(int64_t(1) << log_capacity));
+        ring.store(rings.back().get(), std::memory_order_relaxed);
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    // Owner only.
+    void push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Ring* r = ring.load(std::memory_order_relaxed);
+        if (b - t > r->capacity - 1) {
+            r = grow(r, t, b);
+        }
+        r->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only. False when empty or a thief took the last item.
+    bool pop(T& item) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring* r = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = r->get(b);
+        if (t == b) {
+            // Last item: race the thieves for it.
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread. False when empty or another thread got there first.
+    bool steal(T& item) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        Ring* r = ring.load(std::memory_order_acquire);
+        item = r->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // A snapshot; may be stale by the time it returns.
+    bool empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring {
+        explicit Ring(int64_t capacity) : capacity(capacity), items(new std::atomic<T>[capacity]) {}
+
+        T get(int64_t index) const { return items[index & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t index, T item) { items[index & (capacity - 1)].store(item, std::memory_order_relaxed); }
+
+        int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> items;
+    };
+
+    Ring* grow(Ring* old_ring, int64_t t, int64_t b) {
+        rings.push_back(std::make_unique<Ring>(old_ring->capacity * 2));
+        Ring* new_ring = rings.back().get();
+        for (int64_t i = t; i < b; ++i) {
+            new_ring->put(i, old_ring->get(i));
+        }
+        ring.store(new_ring, std::memory_order_release);
+        return new_ring;
+    }
+
+    // Top and bottom on separate cache lines: thieves hammer one, the owner the other.
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    alignas(64) std::atomic<Ring*> ring;
+    // Owner only; the current ring and every one it outgrew.
+    std::vector<std::unique_ptr<Ring>> rings;
+};
@@ -0,0 +1,36 @@
+#include "fixed_timestep.hpp"
+#include <cmath>
+#include <stdexcept>
+
+FixedTimestep::FixedTimestep(double step_seconds, uint32_t max_catch_up_steps) :
+    step_ns(std::llround(step_seconds * 1e9)), max_catch_up_steps(max_catch_up_steps), accumulator_ns(0), step_count(0), dropped_steps(0) {
+    if (step_ns <= 0 || max_catch_up_steps == 0) {
+        throw std::runtime_error("Fixed timestep needs a positive step and at least one catch-up step.");
+    }
+}
+
+void FixedTimestep::add_time(double seconds) {
+    if (seconds > 0.0) {
+        accumulator_ns += std::llround(seconds * 1e9);
+    }
+    // Keep the fraction, so alpha does not jump.
+    int64_t steps = accumulator_ns / step_ns;
+    if (steps > max_catch_up_steps) {
+        int64_t dropped = steps - max_catch_up_steps;
+        dropped_steps += static_cast<uint64_t>(dropped);
+        accumulator_ns -= dropped * step_ns;
+    }
+}
+
+bool FixedTimestep::step() {
+    if (accumulator_ns < step_ns) {
+        return false;
+    }
+    accumulator_ns -= step_ns;
+    step_count++;
+    return true;
+}
+
+float FixedTimestep::get_alpha() const {
+    return static_cast<float>(static_cast<double>(accumulator_ns) / step_ns);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// Accumulator for a fixed-step simulation loop. Real time goes in with
+// add_time, whole steps come out of step, and the remainder is the blend
+// factor for drawing between the last two simulated states:
+//
+//     timestep.add_time(elapsed);
+//     while (timestep.step()) { simulate(timestep.get_step_seconds()); }
+//     draw(timestep.get_alpha());
+//
+// Drawing blends toward the newest state, so what is shown trails the
+// simulation by under one step.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double step_seconds = 1.0 / 60.0, uint32_t max_catch_up_steps = 8);
+
+    // A backlog beyond max_catch_up_steps is dropped, so after a stall (a
+    // breakpoint, a window drag) the simulation slows down instead of
+    // spending ever longer catching up.
+    void add_time(double seconds);
+    // Takes one step from the accumulator; false once less than a step is left.
+    bool step();
+
+    // Fraction of a step accumulated past the last one, in [0, 1).
+    float get_alpha() const;
+    double get_step_seconds() const { return step_ns * 1e-9; }
+    uint64_t get_step_count() const { return step_count; }
+    uint64_t get_dropped_steps() const { return dropped_steps; }
+
+private:
+    // Whole nanoseconds, so steps come out exactly and nothing drifts.
+    int64_t step_ns;
+    uint32_t max_catch_up_steps;
+    int64_t accumulator_ns;
+    uint64_t step_count;
+    uint64_t dropped_steps;
+};
@@ -0,0 +1,341 @@
+#include "job_pool.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+static const uint32_t no_worker = UINT32_MAX;
+// Rounds of yielding before a worker sleeps, or a waiter starts napping.
+static const uint32_t idle_spin_rounds = 64;
+
+static thread_local const JobPool* current_pool = nullptr;
+static thread_local uint32_t current_worker_index = no_worker;
+// Jobs this thread is inside of, counting those run while waiting.
+static thread_local uint32_t running_job_depth = 0;
+
+static uint32_t next_random(uint32_t& state) {
+    // xorshift32; only picks where to start looking for a victim.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+struct JobPool::ForState {
+    const std::function<void(uint32_t begin, uint32_t end)>* fn;
+    uint32_t grain;
+    std::atomic<uint32_t> done{0};
+};
+
+JobPool::JobPool(uint32_t worker_count) :
+    main_thread_id(std::this_thread::get_id()), injected_count(0), unfinished_jobs(0), work_epoch(0), sleeping_workers(0), idle_workers(0), stopping(false),
+    main_thread_job_count(0), helper_jobs_run(0), helper_jobs_stolen(0), jobs_injected(0), parallel_for_splits(0), worker_sleeps(0)
+{
+    if (worker_count == 0) {
+        uint32_t hw = std::thread::hardware_concurrency();
+        worker_count = hw > 1 ? hw - 1 : 1;
+    }
+    // Every deque exists before any thread can try to steal from it.
+    workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->index = i;
+        workers.back()->random_state = (i + 1) * 2654435761u;
+    }
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        workers[i]->thread = std::thread(&JobPool::worker_main, this, i);
+    }
+}
+
+JobPool::~JobPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    for (std::unique_ptr<Worker>& worker : workers) {
+        worker->thread.join();
+    }
+    for (Job* job : injected) {
+        delete job;
+    }
+}
+
+JobPool::Worker* JobPool::get_current_worker() const {
+    return current_pool == this ? workers[current_worker_index].get() : nullptr;
+}
+
+void JobPool::submit(std::function<void()> job) {
+    push(new Job{std::move(job)});
+}
+
+void JobPool::push(Job* job) {
+    unfinished_jobs.fetch_add(1, std::memory_order_relaxed);
+    Worker* worker = get_current_worker();
+    if (worker) {
+        worker->deque.push(job);
+    } else {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        injected.push_back(job);
+        injected_count.fetch_add(1, std::memory_order_relaxed);
+        jobs_injected.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Pairs with the sleeper registering itself before it rechecks the
+    // epoch: either it sees the new epoch or this sees it sleeping.
+    work_epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping_workers.load(std::memory_order_seq_cst) > 0) {
+        { std::lock_guard<std::mutex> lock(sleep_mutex); }
+        sleep_cv.notify_one();
+    }
+}
+
+JobPool::Job* JobPool::find_job(uint32_t self, uint32_t& random_state, bool& stolen) {
+    Job* job = nullptr;
+    stolen = false;
+    if (self != no_worker && workers[self]->deque.pop(job)) {
+        return job;
+    }
+    if (injected_count.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        if (!injected.empty()) {
+            job = injected.front();
+            injected.pop_front();
+            injected_count.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    uint32_t count = static_cast<uint32_t>(workers.size());
+    uint32_t start = next_random(random_state) % count;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t victim = (start + i) % count;
+        if (victim != self && workers[victim]->deque.steal(job)) {
+            stolen = true;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobPool::run_job(Job* job, Worker* worker, bool stolen) {
+    {
+        PROFILE_SCOPE("job");
+        running_job_depth++;
+        job->fn();
+        running_job_depth--;
+    }
+    delete job;
+    // After the job, so wait_all also covers whatever it pushed.
+    unfinished_jobs.fetch_sub(1, std::memory_order_acq_rel);
+    if (worker) {
+        worker->jobs_run.fetch_add(1, std::memory_order_relaxed);
+        if (stolen) {
+            worker->jobs_stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else {
+        helper_jobs_run.fetch_add(1, std::memory_order_relaxed);
+        if (stolen) {
+            helper_jobs_stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void JobPool::worker_main(uint32_t index) {
+    current_pool = this;
+    current_worker_index = index;
+    Profiler::set_thread_name("job worker " + std::to_string(index));
+    Worker& self = *workers[index];
+    for (;;) {
+        bool stolen;
+        Job* job = find_job(index, self.random_state, stolen);
+        if (job) {
+            run_job(job, &self, stolen);
+            continue;
+        }
+
+        // Idle workers make parallel_for split its ranges.
+        idle_workers.fetch_add(1, std::memory_order_relaxed);
+        for (uint32_t round = 0; round < idle_spin_rounds && !job; ++round) {
+            std::this_thread::yield();
+            job = find_job(index, self.random_state, stolen);
+        }
+        while (!job) {
+            uint64_t epoch = work_epoch.load(std::memory_order_seq_cst);
+            job = find_job(index, self.random_state, stolen);
+            if (job) {
+                break;
+            }
+            if (stopping.load()) {
+                idle_workers.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+            worker_sleeps.fetch_add(1, std::memory_order_relaxed);
+            sleep_cv.wait(lock, [&] { return work_epoch.load(std::memory_order_seq_cst) != epoch || stopping.load(); });
+            sleeping_workers.fetch_sub(1, std::memory_order_seq_cst);
+        }
+        idle_workers.fetch_sub(1, std::memory_order_relaxed);
+        run_job(job, &self, stolen);
+    }
+}
+
+bool JobPool::try_run_one() {
+    static thread_local uint32_t helper_random_state = 0x9e3779b9u;
+    Worker* worker = get_current_worker();
+    uint32_t& random_state = worker ? worker->random_state : helper_random_state;
+    bool stolen;
+    Job* job = find_job(worker ? worker->index : no_worker, random_state, stolen);
+    if (!job) {
+        return false;
+    }
+    run_job(job, worker, stolen);
+    return true;
+}
+
+void JobPool::wait_until(const std::function<bool()>& done) {
+    uint32_t idle_rounds = 0;
+    while (!done()) {
+        if (is_main_thread() && main_thread_job_count.load(std::memory_order_relaxed) > 0) {
+            run_main_thread_jobs();
+            idle_rounds = 0;
+        } else if (try_run_one()) {
+            idle_rounds = 0;
+        } else if (++idle_rounds < idle_spin_rounds) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+    }
+}
+
+void JobPool::wait_all() {
+    if (running_job_depth > 0) {
+        throw std::runtime_error("wait_all cannot be called from inside a job.");
+    }
+    wait_until([&] { return unfinished_jobs.load(std::memory_order_acquire) == 0; });
+}
+
+void JobPool::parallel_for(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (grain == 0) {
+        // Enough chunks for every thread to steal several times over.
+        uint32_t target_chunks = (get_worker_count() + 1) * 8;
+        grain = std::max((count + target_chunks - 1) / target_chunks, 1u);
+    }
+    if (count <= grain || workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    ForState state;
+    state.fn = &fn;
+    state.grain = grain;
+    run_range(state, 0, count);
+    wait_until([&] { return state.done.load(std::memory_order_acquire) == count; });
+}
+
+void JobPool::run_range(ForState& state, uint32_t begin, uint32_t end) {
+    // Lazy binary splitting: hand off half of what is left only when a
+    // worker is idle and nothing this thread queued is still waiting.
+    Worker* worker = get_current_worker();
+    while (end - begin > state.grain) {
+        bool queue_empty = worker ? worker->deque.empty() : injected_count.load(std::memory_order_relaxed) == 0;
+        if (has_idle_workers() && queue_empty) {
+            uint32_t half_chunks = std::max((end - begin) / state.grain / 2, 1u);
+            uint32_t mid = begin + half_chunks * state.grain;
+            ForState* shared = &state;
+            push(new Job{[this, shared, mid, end] { run_range(*shared, mid, end); }});
+            parallel_for_splits.fetch_add(1, std::memory_order_relaxed);
+            end = mid;
+            continue;
+        }
+        (*state.fn)(begin, begin + state.grain);
+        state.done.fetch_add(state.grain, std::memory_order_acq_rel);
+        begin += state.grain;
+    }
+    (*state.fn)(begin, end);
+    // The last touch of state; the waiter may return right after.
+    state.done.fetch_add(end - begin, std::memory_order_acq_rel);
+}
+
+void JobPool::run(TaskGraph& graph) {
+    uint32_t count = graph.size();
+    if (count == 0) {
+        return;
+    }
+    for (TaskGraph::Node& node : graph.nodes) {
+        node.pending.store(node.dependency_count, std::memory_order_relaxed);
+    }
+    graph.remaining.store(count, std::memory_order_release);
+    for (TaskGraph::TaskId id = 0; id < count; ++id) {
+        if (graph.nodes[id].dependency_count == 0) {
+            push(new Job{[this, &graph, id] { run_graph_node(graph, id); }});
+        }
+    }
+    wait_until([&] { return graph.remaining.load(std::memory_order_acquire) == 0; });
+}
+
+void JobPool::run_graph_node(TaskGraph& graph, TaskGraph::TaskId id) {
+    for (;;) {
+        TaskGraph::Node& node = graph.nodes[id];
+        node.fn();
+
+        // The first successor this releases runs next on this thread, the
+        // rest are queued for others to steal.
+        TaskGraph::TaskId next = UINT32_MAX;
+        for (TaskGraph::TaskId successor : node.successors) {
+            if (graph.nodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                continue;
+            }
+            if (next == UINT32_MAX) {
+                next = successor;
+            } else {
+                push(new Job{[this, &graph, successor] { run_graph_node(graph, successor); }});
+            }
+        }
+        // With no successor held back, this may be the graph's last touch.
+        graph.remaining.fetch_sub(1, std::memory_order_acq_rel);
+        if (next == UINT32_MAX) {
+            return;
+        }
+        id = next;
+    }
+}
+
+void JobPool::run_on_main_thread(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(main_thread_mutex);
+    main_thread_jobs.push_back(std::move(job));
+    main_thread_job_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t JobPool::run_main_thread_jobs() {
+    if (!is_main_thread()) {
+        throw std::runtime_error("Main thread jobs can only run on the thread that created the pool.");
+    }
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(main_thread_mutex);
+        jobs.swap(main_thread_jobs);
+        main_thread_job_count.store(0, std::memory_order_relaxed);
+    }
+    for (std::function<void()>& job : jobs) {
+        job();
+    }
+    return static_cast<uint32_t>(jobs.size());
+}
+
+JobPoolStats JobPool::get_stats() const {
+    JobPoolStats stats = {};
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        stats.jobs_run += worker->jobs_run.load(std::memory_order_relaxed);
+        stats.jobs_stolen += worker->jobs_stolen.load(std::memory_order_relaxed);
+    }
+    stats.jobs_run += helper_jobs_run.load(std::memory_order_relaxed);
+    stats.jobs_stolen += helper_jobs_stolen.load(std::memory_order_relaxed);
+    stats.jobs_injected = jobs_injected.load(std::memory_order_relaxed);
+    stats.parallel_for_splits = parallel_for_splits.load(std::memory_order_relaxed);
+    stats.worker_sleeps = worker_sleeps.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "chase_lev_deque.hpp"
+#include "task_graph.hpp"
+
+struct JobPoolStats {
+    uint64_t jobs_run;
+    // Taken from another worker's deque rather than the thread's own.
+    uint64_t jobs_stolen;
+    // Submitted from outside the pool, through the shared queue.
+    uint64_t jobs_injected;
+    uint64_t parallel_for_splits;
+    uint64_t worker_sleeps;
+};
+
+// Work-stealing pool. Each worker owns a Chase-Lev deque: jobs a worker
+// submits go on its own deque and run newest first, idle workers steal the
+// oldest from the others. Threads outside the pool submit through a shared
+// queue. Workers with nothing to steal sleep until more is submitted.
+//
+// Threads waiting on parallel_for or a task graph run jobs meanwhile, so
+// the calling thread always takes part and nested waits cannot deadlock.
+//
+// The thread that creates the pool is its main thread. Work that has to
+// happen there (window and swap chain calls, for instance) is queued with
+// run_on_main_thread and runs when that thread calls run_main_thread_jobs,
+// or while it waits inside the pool.
+class JobPool {
+public:
+    // Zero picks one worker per hardware thread, less the main thread.
+    explicit JobPool(uint32_t worker_count = 0);
+    ~JobPool();
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    void submit(std::function<void()> job);
+    // Runs jobs until every job submitted so far has finished, along with
+    // any those jobs submitted. Not from inside a job, which would wait on
+    // itself; throws std::runtime_error there.
+    void wait_all();
+
+    // Calls fn over [0, count) in chunks of grain iterations, starting at
+    // multiples of grain. The range is split in half only while some worker
+    // is idle, so busy pools run few, large pieces. A grain of 0 picks one
+    // from count and the worker count.
+    void parallel_for(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& fn);
+
+    // Runs every task of the graph once its dependencies are done; returns
+    // when all have run.
+    void run(TaskGraph& graph);
+
+    void run_on_main_thread(std::function<void()> job);
+    // Main thread only; returns how many jobs ran.
+    uint32_t run_main_thread_jobs();
+    bool is_main_thread() const { return std::this_thread::get_id() == main_thread_id; }
+
+    uint32_t get_worker_count() const { return static_cast<uint32_t>(workers.size()); }
+    JobPoolStats get_stats() const;
+
+private:
+    struct Job {
+        std::function<void()> fn;
+    };
+
+    struct alignas(64) Worker {
+        ChaseLevDeque<Job*> deque;
+        std::thread thread;
+        uint32_t index;
+        uint32_t random_state;
+        std::atomic<uint64_t> jobs_run{0};
+        std::atomic<uint64_t> jobs_stolen{0};
+    };
+
+    struct ForState;
+
+    void worker_main(uint32_t index);
+    void push(Job* job);
+    Job* find_job(uint32_t self, uint32_t& random_state, bool& stolen);
+    bool try_run_one();
+    void run_job(Job* job, Worker* worker, bool stolen);
+    // Runs jobs, then yields, then naps until done returns true.
+    void wait_until(const std::function<bool()>& done);
+    void run_range(ForState& state, uint32_t begin, uint32_t end);
+    void run_graph_node(TaskGraph& graph, TaskGraph::TaskId id);
+    bool has_idle_workers() const { return idle_workers.load(std::memory_order_relaxed) > 0; }
+    // The calling thread's worker in this pool, or null.
+    Worker* get_current_worker() const;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::thread::id main_thread_id;
+
+    std::deque<Job*> injected;
+    std::mutex injected_mutex;
+    std::atomic<uint32_t> injected_count;
+    // Pushed and not yet finished, for wait_all.
+    std::atomic<uint64_t> unfinished_jobs;
+
+    // Sleepers wait for work_epoch to move; every push moves it.
+    std::atomic<uint64_t> work_epoch;
+    std::atomic<uint32_t> sleeping_workers;
+    std::atomic<uint32_t> idle_workers;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::atomic<bool> stopping;
+
+    std::vector<std::function<void()>> main_thread_jobs;
+    std::mutex main_thread_mutex;
+    std::atomic<uint32_t> main_thread_job_count;
+
+    // Jobs run by threads outside the pool while they wait.
+    std::atomic<uint64_t> helper_jobs_run;
+    std::atomic<uint64_t> helper_jobs_stolen;
+    std::atomic<uint64_t> jobs_injected;
+    std::atomic<uint64_t> parallel_for_splits;
+    std::atomic<uint64_t> worker_sleeps;
+};
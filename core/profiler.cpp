@@ -0,0 +1,155 @@
+#include "profiler.hpp"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> Profiler::enabled(false);
+
+namespace {
+
+// Written only by the owning thread; read when a trace is written, which
+// stops the capture first.
+struct ThreadBuffer {
+    struct Event {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> begin;
+        std::atomic<uint64_t> end;
+    };
+
+    std::unique_ptr<Event[]> events;
+    std::atomic<uint64_t> write_count{0};
+    // write_count when the current capture started; earlier events are stale.
+    std::atomic<uint64_t> capture_start_count{0};
+    uint32_t thread_id;
+    std::string name;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    uint64_t capture_start_tick = 0;
+    std::chrono::steady_clock::time_point capture_start_time;
+};
+
+Registry& get_registry() {
+    static Registry registry;
+    return registry;
+}
+
+thread_local ThreadBuffer* current_buffer = nullptr;
+thread_local std::string current_thread_name;
+
+ThreadBuffer* register_thread() {
+    Registry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+    buffer->events.reset(new ThreadBuffer::Event[Profiler::events_per_thread]);
+    buffer->thread_id = static_cast<uint32_t>(registry.buffers.size()) + 1;
+    buffer->name = current_thread_name.empty() ? "thread " + std::to_string(buffer->thread_id) : current_thread_name;
+    registry.buffers.push_back(std::move(buffer));
+    return registry.buffers.back().get();
+}
+
+std::string escape_json(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+void Profiler::start() {
+    Registry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (std::unique_ptr<ThreadBuffer>& buffer : registry.buffers) {
+        buffer->capture_start_count.store(buffer->write_count.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+    registry.capture_start_time = std::chrono::steady_clock::now();
+    registry.capture_start_tick = now();
+    enabled.store(true, std::memory_order_release);
+}
+
+void Profiler::stop() {
+    enabled.store(false, std::memory_order_release);
+}
+
+void Profiler::set_thread_name(const std::string& name) {
+    current_thread_name = name;
+    if (current_buffer) {
+        std::lock_guard<std::mutex> lock(get_registry().mutex);
+        current_buffer->name = name;
+    }
+}
+
+void Profiler::record(const char* name, uint64_t begin, uint64_t end) {
+    ThreadBuffer* buffer = current_buffer;
+    if (!buffer) {
+        buffer = current_buffer = register_thread();
+    }
+    uint64_t index = buffer->write_count.load(std::memory_order_relaxed);
+    ThreadBuffer::Event& event = buffer->events[index % events_per_thread];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer->write_count.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::write_chrome_trace(const std::string& path) {
+    stop();
+    Registry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Ticks per microsecond, measured over the capture.
+    uint64_t end_tick = now();
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - registry.capture_start_time).count();
+    double ticks_per_us = elapsed_us > 0.0 ? (end_tick - registry.capture_start_tick) / elapsed_us : 1000.0;
+    if (!(ticks_per_us > 0.0)) {
+        ticks_per_us = 1000.0;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to create trace " + path + ".");
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"benjamin\"}}");
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.buffers) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", buffer->thread_id,
+                escape_json(buffer->name).c_str());
+
+        uint64_t written = buffer->write_count.load(std::memory_order_acquire);
+        uint64_t first = buffer->capture_start_count.load(std::memory_order_relaxed);
+        if (written - first > events_per_thread) {
+            first = written - events_per_thread;
+        }
+        for (uint64_t i = first; i < written; ++i) {
+            const ThreadBuffer::Event& event = buffer->events[i % events_per_thread];
+            uint64_t begin = event.begin.load(std::memory_order_relaxed);
+            uint64_t end = event.end.load(std::memory_order_relaxed);
+            if (begin < registry.capture_start_tick || end < begin) {
+                continue;
+            }
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    escape_json(event.name.load(std::memory_order_relaxed)).c_str(), buffer->thread_id,
+                    (begin - registry.capture_start_tick) / ticks_per_us, (end - begin) / ticks_per_us);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        throw std::runtime_error("Failed to write trace " + path + ".");
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+// CPU scope profiler. Scopes are marked with PROFILE_SCOPE("name"); while a
+// capture runs, each one that closes appends its begin and end tick to a
+// ring owned by the calling thread, so recording takes no locks. Outside a
+// capture a scope costs one relaxed load and a branch; building with
+// DISABLE_PROFILER removes the scopes altogether.
+//
+// Names must be string literals; the pointer is the scope's id and is only
+// read when the trace is written. A thread keeps the newest
+// Profiler::events_per_thread scopes of a capture.
+class Profiler {
+public:
+    static const uint32_t events_per_thread = 1 << 15;
+
+    // Clears what earlier captures recorded.
+    static void start();
+    static void stop();
+    static bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Shown in the trace for the calling thread; set it before recording.
+    static void set_thread_name(const std::string& name);
+
+    // Chrome trace event JSON, which chrome://tracing and Perfetto open.
+    // Stops the capture first. Throws std::runtime_error if the file cannot
+    // be written.
+    static void write_chrome_trace(const std::string& path);
+
+    // rdtsc on x86-64, assuming an invariant TSC; a monotonic nanosecond
+    // clock elsewhere. Converted to time when the trace is written.
+    static uint64_t now() {
+#if defined(_M_X64) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static void record(const char* name, uint64_t begin, uint64_t end);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(Profiler::is_enabled() ? name : nullptr), begin(this->name ? Profiler::now() : 0) {}
+    ~ProfileScope() {
+        if (name) {
+            Profiler::record(name, begin, Profiler::now());
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t begin;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#if defined(DISABLE_PROFILER)
+#define PROFILE_SCOPE(name)
+#else
+// The "" concatenation only compiles for a string literal.
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)("" name)
+#endif
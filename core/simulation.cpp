@@ -0,0 +1,40 @@
+#include "simulation.hpp"
+#include <cmath>
+
+static const float pi = 3.14159265f;
+
+// Into [-pi, pi), so angles keep their precision however long the run.
+static float wrap_angle(float angle) {
+    return angle - 2.0f * pi * std::floor((angle + pi) / (2.0f * pi));
+}
+
+Simulation::Simulation() : tick(0) {}
+
+uint32_t Simulation::add_object(const SimulationObject& object) {
+    previous.push_back(object);
+    current.push_back(object);
+    return static_cast<uint32_t>(current.size() - 1);
+}
+
+void Simulation::step(double step_seconds) {
+    float dt = static_cast<float>(step_seconds);
+    previous = current;
+    for (SimulationObject& object : current) {
+        object.yaw = wrap_angle(object.yaw + object.angular_velocity * dt);
+    }
+    tick++;
+}
+
+void Simulation::interpolate(float alpha, std::vector<ObjectTransform>& transforms) const {
+    transforms.resize(current.size());
+    for (size_t i = 0; i < current.size(); ++i) {
+        const SimulationObject& from = previous[i];
+        const SimulationObject& to = current[i];
+        ObjectTransform& transform = transforms[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            transform.position[axis] = from.position[axis] + (to.position[axis] - from.position[axis]) * alpha;
+        }
+        // The short way round, across the wrap.
+        transform.yaw = wrap_angle(from.yaw + wrap_angle(to.yaw - from.yaw) * alpha);
+    }
+}
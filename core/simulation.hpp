@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct SimulationObject {
+    float position[3];
+    float yaw;
+    // Radians per second around y.
+    float angular_velocity;
+};
+
+struct ObjectTransform {
+    float position[3];
+    float yaw;
+};
+
+// Scene state advanced in fixed steps, independent of the renderer and the
+// window, so it can also run headless as fast as the CPU allows. The state
+// before the last step is kept for interpolate.
+class Simulation {
+public:
+    Simulation();
+
+    uint32_t add_object(const SimulationObject& object);
+    void step(double step_seconds);
+
+    // Blends the previous and current step, alpha in [0, 1]; one transform
+    // per object, in add_object order.
+    void interpolate(float alpha, std::vector<ObjectTransform>& transforms) const;
+
+    uint32_t get_object_count() const { return static_cast<uint32_t>(current.size()); }
+    uint64_t get_tick() const { return tick; }
+
+private:
+    std::vector<SimulationObject> previous;
+    std::vector<SimulationObject> current;
+    uint64_t tick;
+};
@@ -0,0 +1,20 @@
+#include "task_graph.hpp"
+#include <stdexcept>
+
+TaskGraph::TaskId TaskGraph::add(std::function<void()> fn, std::initializer_list<TaskId> dependencies) {
+    TaskId id = static_cast<TaskId>(nodes.size());
+    nodes.emplace_back();
+    nodes.back().fn = std::move(fn);
+    for (TaskId dependency : dependencies) {
+        add_dependency(id, dependency);
+    }
+    return id;
+}
+
+void TaskGraph::add_dependency(TaskId task, TaskId dependency) {
+    if (task >= nodes.size() || dependency >= task) {
+        throw std::runtime_error("Task dependencies must be added before the tasks that depend on them.");
+    }
+    nodes[dependency].successors.push_back(task);
+    nodes[task].dependency_count++;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+// Tasks with dependencies, run by JobPool::run. Each task carries a counter
+// of dependencies still running; the one that finishes last releases it. A
+// graph can be run again once the previous run returns.
+class TaskGraph {
+public:
+    using TaskId = uint32_t;
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Dependencies have to be added before their dependents, which keeps the
+    // graph acyclic; throws std::runtime_error otherwise.
+    TaskId add(std::function<void()> fn, std::initializer_list<TaskId> dependencies = {});
+    void add_dependency(TaskId task, TaskId dependency);
+
+    uint32_t size() const { return static_cast<uint32_t>(nodes.size()); }
+    void clear() { nodes.clear(); }
+
+private:
+    friend class JobPool;
+
+    struct Node {
+        std::function<void()> fn;
+        std::vector<TaskId> successors;
+        uint32_t dependency_count = 0;
+        std::atomic<uint32_t> pending{0};
+    };
+
+    // A deque, so nodes never move while tasks point at them.
+    std::deque<Node> nodes;
+    std::atomic<uint32_t> remaining{0};
+};
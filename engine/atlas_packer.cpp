@@ -0,0 +1,264 @@
+#include "atlas_packer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height) : width(width), height(height), used_area(0) {
+    skyline.push_back({0, 0, width});
+}
+
+bool SkylinePacker::fit(size_t index, uint32_t rect_width, uint32_t rect_height, uint32_t& y) const {
+    uint32_t x = skyline[index].x;
+    if (x + rect_width > width) {
+        return false;
+    }
+    y = skyline[index].y;
+    uint32_t width_left = rect_width;
+    for (size_t i = index; ; ++i) {
+        if (i == skyline.size()) {
+            return false;
+        }
+        y = std::max(y, skyline[i].y);
+        if (y + rect_height > height) {
+            return false;
+        }
+        if (skyline[i].width >= width_left) {
+            return true;
+        }
+        width_left -= skyline[i].width;
+    }
+}
+
+bool SkylinePacker::insert(uint32_t rect_width, uint32_t rect_height, AtlasRect& rect) {
+    size_t best_index = skyline.size();
+    uint32_t best_top = UINT32_MAX;
+    uint32_t best_width = UINT32_MAX;
+    uint32_t best_y = 0;
+    for (size_t i = 0; i < skyline.size(); ++i) {
+        uint32_t y;
+        if (!fit(i, rect_width, rect_height, y)) {
+            continue;
+        }
+        // Lowest top edge wins; ties go to the narrowest ledge, which leaves
+        // wide ledges for wide rectangles.
+        uint32_t top = y + rect_height;
+        if (top < best_top || (top == best_top && skyline[i].width < best_width)) {
+            best_index = i;
+            best_top = top;
+            best_width = skyline[i].width;
+            best_y = y;
+        }
+    }
+    if (best_index == skyline.size()) {
+        return false;
+    }
+
+    rect = {skyline[best_index].x, best_y, rect_width, rect_height};
+    skyline.insert(skyline.begin() + best_index, {rect.x, best_top, rect_width});
+
+    // Trim the ledges now hidden under the new one.
+    for (size_t i = best_index + 1; i < skyline.size(); ) {
+        uint32_t previous_end = skyline[i - 1].x + skyline[i - 1].width;
+        if (skyline[i].x >= previous_end) {
+            break;
+        }
+        uint32_t shrink = previous_end - skyline[i].x;
+        if (skyline[i].width <= shrink) {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+        skyline[i].x += shrink;
+        skyline[i].width -= shrink;
+        break;
+    }
+    for (size_t i = 0; i + 1 < skyline.size(); ) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    used_area += static_cast<uint64_t>(rect_width) * rect_height;
+    return true;
+}
+
+float SkylinePacker::get_occupancy() const {
+    return static_cast<float>(static_cast<double>(used_area) / (static_cast<double>(width) * height));
+}
+
+static uint32_t align_up(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t next_power_of_two(uint32_t value) {
+    uint32_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Packs order onto one page. With partial set, whatever does not fit is
+// left in order for the next page; otherwise the first miss fails the page.
+static bool pack_page(const std::vector<ImageExtent>& padded, std::vector<uint32_t>& order, uint32_t width, uint32_t height,
+                      bool partial, uint32_t page, std::vector<AtlasPlacement>& placements) {
+    SkylinePacker packer(width, height);
+    std::vector<uint32_t> rest;
+    for (uint32_t index : order) {
+        AtlasRect rect;
+        if (packer.insert(padded[index].width, padded[index].height, rect)) {
+            placements[index].page = page;
+            placements[index].rect = rect;
+        } else if (partial) {
+            rest.push_back(index);
+        } else {
+            return false;
+        }
+    }
+    order.swap(rest);
+    return true;
+}
+
+AtlasLayout pack_atlas(const std::vector<ImageExtent>& extents, uint32_t max_size, uint32_t padding, uint32_t alignment) {
+    alignment = std::max(alignment, 1u);
+    padding = align_up(padding, alignment);
+
+    AtlasLayout layout = {};
+    layout.padding = padding;
+    layout.placements.resize(extents.size());
+    if (extents.empty()) {
+        return layout;
+    }
+
+    std::vector<ImageExtent> padded(extents.size());
+    uint64_t total_area = 0;
+    for (size_t i = 0; i < extents.size(); ++i) {
+        padded[i].width = align_up(extents[i].width + 2 * padding, alignment);
+        padded[i].height = align_up(extents[i].height + 2 * padding, alignment);
+        if (padded[i].width > max_size || padded[i].height > max_size) {
+            throw std::runtime_error("Texture is too large for the atlas.");
+        }
+        total_area += static_cast<uint64_t>(padded[i].width) * padded[i].height;
+    }
+
+    std::vector<uint32_t> order(extents.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&padded](uint32_t a, uint32_t b) {
+        if (padded[a].height != padded[b].height) {
+            return padded[a].height > padded[b].height;
+        }
+        return padded[a].width > padded[b].width;
+    });
+
+    // Grow a single page from the smallest power-of-two size whose area could
+    // hold everything; only fall back to several max_size pages when even
+    // that fails.
+    uint32_t width = std::min(next_power_of_two(static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(total_area))))), max_size);
+    uint32_t height = width;
+    if (static_cast<uint64_t>(width) * (height / 2) >= total_area) {
+        height /= 2;
+    }
+    for (;;) {
+        std::vector<uint32_t> attempt = order;
+        if (pack_page(padded, attempt, width, height, false, 0, layout.placements)) {
+            layout.width = width;
+            layout.height = height;
+            layout.page_count = 1;
+            break;
+        }
+        if (width == max_size && height == max_size) {
+            layout.width = max_size;
+            layout.height = max_size;
+            layout.page_count = 0;
+            while (!order.empty()) {
+                pack_page(padded, order, max_size, max_size, true, layout.page_count++, layout.placements);
+            }
+            break;
+        }
+        if (width <= height && width < max_size) {
+            width *= 2;
+        } else {
+            height = std::min(height * 2, max_size);
+        }
+    }
+
+    for (AtlasPlacement& placement : layout.placements) {
+        placement.rect.x += padding;
+        placement.rect.y += padding;
+    }
+    for (size_t i = 0; i < extents.size(); ++i) {
+        layout.placements[i].rect.width = extents[i].width;
+        layout.placements[i].rect.height = extents[i].height;
+    }
+    return layout;
+}
+
+UvRemap compute_uv_remap(const AtlasLayout& layout, uint32_t index) {
+    const AtlasRect& rect = layout.placements[index].rect;
+    float inverse_width = 1.0f / layout.width;
+    float inverse_height = 1.0f / layout.height;
+    return {rect.width * inverse_width, rect.height * inverse_height, rect.x * inverse_width, rect.y * inverse_height};
+}
+
+TexturePackPlan plan_texture_pack(const std::vector<ImageExtent>& extents, const TexturePackOptions& options) {
+    TexturePackPlan plan;
+    plan.locations.resize(extents.size());
+
+    // std::map keeps group order independent of input hashing.
+    std::map<std::pair<uint32_t, uint32_t>, std::vector<uint32_t>> by_size;
+    for (uint32_t i = 0; i < extents.size(); ++i) {
+        by_size[{extents[i].width, extents[i].height}].push_back(i);
+    }
+
+    std::vector<uint32_t> atlas_members;
+    for (const auto& [size, members] : by_size) {
+        if (members.size() < options.min_array_size) {
+            atlas_members.insert(atlas_members.end(), members.begin(), members.end());
+            continue;
+        }
+        for (size_t first = 0; first < members.size(); first += options.max_array_layers) {
+            size_t count = std::min<size_t>(options.max_array_layers, members.size() - first);
+            PackGroup group = {};
+            group.kind = PackGroupKind::array;
+            group.width = size.first;
+            group.height = size.second;
+            group.slice_count = static_cast<uint32_t>(count);
+            group.members.assign(members.begin() + first, members.begin() + first + count);
+            uint32_t group_index = static_cast<uint32_t>(plan.groups.size());
+            for (uint32_t slice = 0; slice < count; ++slice) {
+                plan.locations[group.members[slice]] = {group_index, slice, {0, 0, size.first, size.second}, {1.0f, 1.0f, 0.0f, 0.0f}};
+            }
+            plan.groups.push_back(std::move(group));
+        }
+    }
+
+    if (!atlas_members.empty()) {
+        std::sort(atlas_members.begin(), atlas_members.end());
+        std::vector<ImageExtent> atlas_extents;
+        for (uint32_t member : atlas_members) {
+            atlas_extents.push_back(extents[member]);
+        }
+        AtlasLayout layout = pack_atlas(atlas_extents, options.max_atlas_size, options.padding, options.alignment);
+
+        PackGroup group = {};
+        group.kind = PackGroupKind::atlas;
+        group.width = layout.width;
+        group.height = layout.height;
+        group.slice_count = layout.page_count;
+        group.padding = layout.padding;
+        group.members = atlas_members;
+        uint32_t group_index = static_cast<uint32_t>(plan.groups.size());
+        for (uint32_t i = 0; i < atlas_members.size(); ++i) {
+            const AtlasPlacement& placement = layout.placements[i];
+            plan.locations[atlas_members[i]] = {group_index, placement.page, placement.rect, compute_uv_remap(layout, i)};
+        }
+        plan.groups.push_back(std::move(group));
+    }
+    return plan;
+}
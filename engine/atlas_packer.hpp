@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ImageExtent {
+    uint32_t width;
+    uint32_t height;
+};
+
+struct AtlasRect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+// uv' = uv * scale + offset maps a texture's own [0,1] UVs onto its slot.
+// Repeating UVs must be wrapped with frac() before the remap.
+struct UvRemap {
+    float scale_u;
+    float scale_v;
+    float offset_u;
+    float offset_v;
+};
+
+// Bottom-left skyline packer: the packed area is described by the top edge
+// of everything placed so far, and each rectangle goes where its top edge
+// ends lowest. Fast and close to MaxRects for similarly sized rectangles.
+class SkylinePacker {
+public:
+    SkylinePacker(uint32_t width, uint32_t height);
+
+    bool insert(uint32_t width, uint32_t height, AtlasRect& rect);
+    float get_occupancy() const;
+
+private:
+    struct Node {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    bool fit(size_t index, uint32_t width, uint32_t height, uint32_t& y) const;
+
+    std::vector<Node> skyline;
+    uint32_t width;
+    uint32_t height;
+    uint64_t used_area;
+};
+
+struct AtlasPlacement {
+    uint32_t page;
+    // Excludes padding.
+    AtlasRect rect;
+};
+
+// Every page has the same size so pages can be slices of one array texture.
+struct AtlasLayout {
+    uint32_t width;
+    uint32_t height;
+    uint32_t page_count;
+    // Texels left free on each side of every placement: the requested
+    // padding rounded up to the alignment.
+    uint32_t padding;
+    std::vector<AtlasPlacement> placements;
+};
+
+// Packs rectangles, largest first, into the smallest power-of-two page that
+// holds them all, spilling onto further max_size pages when one is not
+// enough. Each rectangle gets padding texels on every side for mip and
+// filter bleed. Positions and padded sizes are rounded up to alignment;
+// pass 4 for block-compressed atlases so no block straddles two images.
+AtlasLayout pack_atlas(const std::vector<ImageExtent>& extents, uint32_t max_size, uint32_t padding, uint32_t alignment);
+
+UvRemap compute_uv_remap(const AtlasLayout& layout, uint32_t index);
+
+struct TexturePackOptions {
+    // Same-size textures this common become an array; the rest are atlased.
+    uint32_t min_array_size = 2;
+    uint32_t max_array_layers = 2048;
+    uint32_t max_atlas_size = 4096;
+    uint32_t padding = 4;
+    uint32_t alignment = 4;
+};
+
+enum class PackGroupKind : uint32_t {
+    array,
+    atlas
+};
+
+// One Texture2DArray. Atlas pages are its slices.
+struct PackGroup {
+    PackGroupKind kind;
+    uint32_t width;
+    uint32_t height;
+    uint32_t slice_count;
+    // Gap around each atlas member to fill with its edge texels; 0 for arrays.
+    uint32_t padding;
+    std::vector<uint32_t> members;
+};
+
+struct PackedTextureLocation {
+    uint32_t group;
+    uint32_t slice;
+    // Where the texels go inside the slice; the whole slice for arrays.
+    AtlasRect rect;
+    UvRemap uv;
+};
+
+struct TexturePackPlan {
+    std::vector<PackGroup> groups;
+    // Indexed like the input extents.
+    std::vector<PackedTextureLocation> locations;
+};
+
+// Deterministic, so it can run offline at build time or on load with the
+// same result.
+TexturePackPlan plan_texture_pack(const std::vector<ImageExtent>& extents, const TexturePackOptions& options = {});
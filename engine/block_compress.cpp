@@ -0,0 +1,856 @@
+#include "block_compress.hpp"
+#include "job_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <emmintrin.h>
+
+namespace {
+
+const uint32_t bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Nearest BC7 4-bit index for a projected position in 0..64.
+struct Bc7ProjectionTable {
+    uint8_t index[65];
+
+    Bc7ProjectionTable() {
+        for (uint32_t t = 0; t <= 64; ++t) {
+            uint32_t best = 0;
+            for (uint32_t i = 1; i < 16; ++i) {
+                if (std::abs(static_cast<int>(bc7_weights[i]) - static_cast<int>(t)) < std::abs(static_cast<int>(bc7_weights[best]) - static_cast<int>(t))) {
+                    best = i;
+                }
+            }
+            index[t] = static_cast<uint8_t>(best);
+        }
+    }
+};
+
+const Bc7ProjectionTable& get_bc7_projection_table() {
+    static const Bc7ProjectionTable table;
+    return table;
+}
+
+// Copies a 4x4 block, replicating edge texels for partial blocks.
+void load_block(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t block[64]) {
+    for (uint32_t y = 0; y < 4; ++y) {
+        uint32_t sy = std::min(by * 4 + y, height - 1);
+        const uint8_t* row = rgba + static_cast<size_t>(sy) * width * 4;
+        if (bx * 4 + 4 <= width) {
+            memcpy(block + y * 16, row + bx * 16, 16);
+        } else {
+            for (uint32_t x = 0; x < 4; ++x) {
+                uint32_t sx = std::min(bx * 4 + x, width - 1);
+                memcpy(block + y * 16 + x * 4, row + sx * 4, 4);
+            }
+        }
+    }
+}
+
+void block_min_max(const uint8_t block[64], uint8_t min_color[4], uint8_t max_color[4]) {
+    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+    __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 32));
+    __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 48));
+    __m128i mn = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+    __m128i mx = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+    mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(1, 0, 3, 2)));
+    mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(1, 0, 3, 2)));
+    mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(2, 3, 0, 1)));
+    mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(2, 3, 0, 1)));
+    int32_t packed_min = _mm_cvtsi128_si32(mn);
+    int32_t packed_max = _mm_cvtsi128_si32(mx);
+    memcpy(min_color, &packed_min, 4);
+    memcpy(max_color, &packed_max, 4);
+}
+
+// Squared distances of all 16 texels to one color. Alpha is ignored unless
+// use_alpha is set.
+void block_distances(const uint8_t block[64], const int32_t color[4], bool use_alpha, int32_t out[16]) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = use_alpha ? _mm_set1_epi16(-1) : _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+    const __m128i c = _mm_and_si128(
+        _mm_setr_epi16(
+            static_cast<int16_t>(color[0]), static_cast<int16_t>(color[1]), static_cast<int16_t>(color[2]), static_cast<int16_t>(color[3]),
+            static_cast<int16_t>(color[0]), static_cast<int16_t>(color[1]), static_cast<int16_t>(color[2]), static_cast<int16_t>(color[3])),
+        mask);
+
+    for (uint32_t group = 0; group < 4; ++group) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + group * 16));
+        __m128i lo = _mm_sub_epi16(_mm_and_si128(_mm_unpacklo_epi8(v, zero), mask), c);
+        __m128i hi = _mm_sub_epi16(_mm_and_si128(_mm_unpackhi_epi8(v, zero), mask), c);
+        __m128 sq_lo = _mm_castsi128_ps(_mm_madd_epi16(lo, lo));
+        __m128 sq_hi = _mm_castsi128_ps(_mm_madd_epi16(hi, hi));
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(sq_lo, sq_hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(sq_lo, sq_hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + group * 4), _mm_add_epi32(even, odd));
+    }
+}
+
+// Endpoints along the principal axis of the block's color distribution.
+void principal_endpoints(const uint8_t block[64], uint32_t channels, uint32_t iterations, float e0[4], float e1[4]) {
+    float mean[4] = {};
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) {
+            mean[c] += block[i * 4 + c];
+        }
+    }
+    for (uint32_t c = 0; c < channels; ++c) {
+        mean[c] /= 16.0f;
+    }
+
+    float cov[4][4] = {};
+    for (uint32_t i = 0; i < 16; ++i) {
+        float d[4];
+        for (uint32_t c = 0; c < channels; ++c) {
+            d[c] = block[i * 4 + c] - mean[c];
+        }
+        for (uint32_t a = 0; a < channels; ++a) {
+            for (uint32_t b = 0; b < channels; ++b) {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    uint8_t mn[4], mx[4];
+    block_min_max(block, mn, mx);
+    float axis[4] = {};
+    for (uint32_t c = 0; c < channels; ++c) {
+        axis[c] = static_cast<float>(mx[c] - mn[c]) + 1e-3f;
+    }
+    for (uint32_t it = 0; it < iterations; ++it) {
+        float next[4] = {};
+        for (uint32_t a = 0; a < channels; ++a) {
+            for (uint32_t b = 0; b < channels; ++b) {
+                next[a] += cov[a][b] * axis[b];
+            }
+        }
+        float len = 0.0f;
+        for (uint32_t c = 0; c < channels; ++c) {
+            len += next[c] * next[c];
+        }
+        if (len < 1e-12f) {
+            break;
+        }
+        len = 1.0f / std::sqrt(len);
+        for (uint32_t c = 0; c < channels; ++c) {
+            axis[c] = next[c] * len;
+        }
+    }
+
+    float t_min = 1e30f;
+    float t_max = -1e30f;
+    for (uint32_t i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (uint32_t c = 0; c < channels; ++c) {
+            t += (block[i * 4 + c] - mean[c]) * axis[c];
+        }
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+    float len_sq = 0.0f;
+    for (uint32_t c = 0; c < channels; ++c) {
+        len_sq += axis[c] * axis[c];
+    }
+    len_sq = std::max(len_sq, 1e-12f);
+    for (uint32_t c = 0; c < 4; ++c) {
+        e0[c] = c < channels ? std::clamp(mean[c] + axis[c] * t_min / len_sq, 0.0f, 255.0f) : 255.0f;
+        e1[c] = c < channels ? std::clamp(mean[c] + axis[c] * t_max / len_sq, 0.0f, 255.0f) : 255.0f;
+    }
+}
+
+// Least-squares endpoints for fixed per-texel interpolation weights, where
+// weight 0 selects e0 and weight 1 selects e1. Returns false if degenerate.
+bool refine_endpoints(const uint8_t block[64], const float weights[16], uint32_t channels, float e0[4], float e1[4]) {
+    float a = 0.0f, b = 0.0f, c = 0.0f;
+    float x[4] = {}, y[4] = {};
+    for (uint32_t i = 0; i < 16; ++i) {
+        float w = weights[i];
+        float iw = 1.0f - w;
+        a += iw * iw;
+        b += iw * w;
+        c += w * w;
+        for (uint32_t ch = 0; ch < channels; ++ch) {
+            x[ch] += iw * block[i * 4 + ch];
+            y[ch] += w * block[i * 4 + ch];
+        }
+    }
+    float det = a * c - b * b;
+    if (std::fabs(det) < 1e-6f) {
+        return false;
+    }
+    float inv = 1.0f / det;
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+        e0[ch] = std::clamp((c * x[ch] - b * y[ch]) * inv, 0.0f, 255.0f);
+        e1[ch] = std::clamp((a * y[ch] - b * x[ch]) * inv, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(uint8_t* out) : out(out), position(0) {
+        memset(out, 0, 16);
+    }
+
+    void write(uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i, ++position) {
+            if (value & (1u << i)) {
+                out[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+            }
+        }
+    }
+
+private:
+    uint8_t* out;
+    uint32_t position;
+};
+
+class BitReader {
+public:
+    explicit BitReader(const uint8_t* in) : in(in), position(0) {}
+
+    uint32_t read(uint32_t count) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < count; ++i, ++position) {
+            value |= ((in[position >> 3] >> (position & 7)) & 1u) << i;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* in;
+    uint32_t position;
+};
+
+// ---------------------------------------------------------------------------
+// BC1 color (always four-color mode, alpha ignored)
+
+uint16_t pack_565(const float color[4]) {
+    uint32_t r = static_cast<uint32_t>(std::clamp(color[0] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+    uint32_t g = static_cast<uint32_t>(std::clamp(color[1] * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f));
+    uint32_t b = static_cast<uint32_t>(std::clamp(color[2] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpack_565(uint16_t packed, int32_t color[4]) {
+    int32_t r = (packed >> 11) & 31;
+    int32_t g = (packed >> 5) & 63;
+    int32_t b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+    color[3] = 255;
+}
+
+void bc1_palette(uint16_t c0, uint16_t c1, int32_t palette[4][4]) {
+    unpack_565(c0, palette[0]);
+    unpack_565(c1, palette[1]);
+    for (uint32_t ch = 0; ch < 4; ++ch) {
+        if (c0 > c1) {
+            palette[2][ch] = (2 * palette[0][ch] + palette[1][ch] + 1) / 3;
+            palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch] + 1) / 3;
+        } else {
+            palette[2][ch] = (palette[0][ch] + palette[1][ch]) / 2;
+            palette[3][ch] = 0;
+        }
+    }
+}
+
+// Picks indices for a four-color block and returns the total squared error.
+uint32_t bc1_select_indices(const uint8_t block[64], uint16_t c0, uint16_t c1, uint32_t& indices) {
+    int32_t palette[4][4];
+    bc1_palette(c0, c1, palette);
+    int32_t dist[4][16];
+    for (uint32_t p = 0; p < 4; ++p) {
+        block_distances(block, palette[p], false, dist[p]);
+    }
+    uint32_t error = 0;
+    indices = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0;
+        for (uint32_t p = 1; p < 4; ++p) {
+            if (dist[p][i] < dist[best][i]) {
+                best = p;
+            }
+        }
+        error += dist[best][i];
+        indices |= best << (i * 2);
+    }
+    return error;
+}
+
+uint32_t bc1_encode_endpoints(const uint8_t block[64], const float e0[4], const float e1[4], uint16_t& c0, uint16_t& c1, uint32_t& indices) {
+    c0 = pack_565(e1);
+    c1 = pack_565(e0);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    if (c0 == c1) {
+        // Any index reproduces the single color; keep the block in four-color mode if possible.
+        if (c0 > 0) {
+            --c1;
+        } else {
+            ++c0;
+        }
+    }
+    return bc1_select_indices(block, c0, c1, indices);
+}
+
+void encode_bc1_block(const uint8_t block[64], BlockQuality quality, uint8_t* out) {
+    float e0[4], e1[4];
+    uint8_t mn[4], mx[4];
+    block_min_max(block, mn, mx);
+    // Inset the bounding box so the interpolated colors land inside it.
+    for (uint32_t c = 0; c < 3; ++c) {
+        float inset = (mx[c] - mn[c]) / 16.0f;
+        e0[c] = mn[c] + inset;
+        e1[c] = mx[c] - inset;
+    }
+    e0[3] = e1[3] = 255.0f;
+
+    uint16_t c0, c1;
+    uint32_t indices;
+    uint32_t error = bc1_encode_endpoints(block, e0, e1, c0, c1, indices);
+
+    if (quality == BlockQuality::high) {
+        // The box diagonal misses anti-correlated channels; try the principal axis too.
+        principal_endpoints(block, 3, 8, e0, e1);
+        uint16_t p0, p1;
+        uint32_t p_indices;
+        uint32_t p_error = bc1_encode_endpoints(block, e0, e1, p0, p1, p_indices);
+        if (p_error < error) {
+            c0 = p0;
+            c1 = p1;
+            indices = p_indices;
+            error = p_error;
+        }
+
+        static const float index_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        for (uint32_t iteration = 0; iteration < 3 && error > 0; ++iteration) {
+            // Weights are relative to c0, which is the brighter endpoint e1.
+            float weights[16];
+            for (uint32_t i = 0; i < 16; ++i) {
+                weights[i] = index_weights[(indices >> (i * 2)) & 3];
+            }
+            float r0[4] = { 0, 0, 0, 255 }, r1[4] = { 0, 0, 0, 255 };
+            if (!refine_endpoints(block, weights, 3, r0, r1)) {
+                break;
+            }
+            uint16_t n0, n1;
+            uint32_t n_indices;
+            uint32_t n_error = bc1_encode_endpoints(block, r1, r0, n0, n1, n_indices);
+            if (n_error >= error) {
+                break;
+            }
+            c0 = n0;
+            c1 = n1;
+            indices = n_indices;
+            error = n_error;
+        }
+    }
+
+    out[0] = static_cast<uint8_t>(c0);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    memcpy(out + 4, &indices, 4);
+}
+
+// ---------------------------------------------------------------------------
+// BC4 single channel
+
+void bc4_palette(uint32_t a0, uint32_t a1, uint32_t palette[8]) {
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (uint32_t i = 1; i < 7; ++i) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+        }
+    } else {
+        for (uint32_t i = 1; i < 5; ++i) {
+            palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+uint32_t bc4_select_indices(const uint8_t values[16], uint32_t a0, uint32_t a1, uint64_t& indices) {
+    uint32_t palette[8];
+    bc4_palette(a0, a1, palette);
+    uint32_t error = 0;
+    indices = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t best = 0;
+        int32_t best_error = 1 << 30;
+        for (uint32_t p = 0; p < 8; ++p) {
+            int32_t d = static_cast<int32_t>(values[i]) - static_cast<int32_t>(palette[p]);
+            if (d * d < best_error) {
+                best_error = d * d;
+                best = p;
+            }
+        }
+        error += best_error;
+        indices |= static_cast<uint64_t>(best) << (i * 3);
+    }
+    return error;
+}
+
+void encode_bc4_block(const uint8_t values[16], BlockQuality quality, uint8_t* out) {
+    uint32_t mn = 255, mx = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+        mn = std::min<uint32_t>(mn, values[i]);
+        mx = std::max<uint32_t>(mx, values[i]);
+    }
+
+    uint32_t a0 = mx, a1 = mn;
+    uint64_t indices = 0;
+    uint32_t error = 0;
+    if (mx == mn) {
+        a0 = a1 = mx;
+    } else if (quality == BlockQuality::fast) {
+        // Project straight onto the eight-value ramp.
+        for (uint32_t i = 0; i < 16; ++i) {
+            uint32_t t = ((mx - values[i]) * 7 + (mx - mn) / 2) / (mx - mn);
+            uint32_t index = t == 0 ? 0 : (t == 7 ? 1 : t + 1);
+            indices |= static_cast<uint64_t>(index) << (i * 3);
+        }
+    } else {
+        error = bc4_select_indices(values, a0, a1, indices);
+        // Nudge the endpoints around the extremes of the eight-value ramp.
+        for (int32_t d0 = -3; d0 <= 0; ++d0) {
+            for (int32_t d1 = 0; d1 <= 3; ++d1) {
+                int32_t t0 = static_cast<int32_t>(mx) + d0;
+                int32_t t1 = static_cast<int32_t>(mn) + d1;
+                if (t0 <= t1) {
+                    continue;
+                }
+                uint64_t t_indices;
+                uint32_t t_error = bc4_select_indices(values, t0, t1, t_indices);
+                if (t_error < error) {
+                    error = t_error;
+                    indices = t_indices;
+                    a0 = t0;
+                    a1 = t1;
+                }
+            }
+        }
+        // The six-value ramp wins when 0 and 255 are outliers.
+        uint32_t inner_min = 255, inner_max = 0;
+        for (uint32_t i = 0; i < 16; ++i) {
+            if (values[i] != 0 && values[i] != 255) {
+                inner_min = std::min<uint32_t>(inner_min, values[i]);
+                inner_max = std::max<uint32_t>(inner_max, values[i]);
+            }
+        }
+        if (inner_min <= inner_max) {
+            uint64_t t_indices;
+            uint32_t t_error = bc4_select_indices(values, inner_min, inner_max, t_indices);
+            if (t_error < error) {
+                error = t_error;
+                indices = t_indices;
+                a0 = inner_min;
+                a1 = inner_max;
+            }
+        }
+    }
+
+    out[0] = static_cast<uint8_t>(a0);
+    out[1] = static_cast<uint8_t>(a1);
+    for (uint32_t i = 0; i < 6; ++i) {
+        out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+}
+
+void encode_bc4_channel(const uint8_t block[64], uint32_t channel, BlockQuality quality, uint8_t* out) {
+    uint8_t values[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        values[i] = block[i * 4 + channel];
+    }
+    encode_bc4_block(values, quality, out);
+}
+
+// ---------------------------------------------------------------------------
+// BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4-bit indices
+
+void quantize_bc7_endpoint(const float e[4], uint32_t p, int32_t q[4], int32_t expanded[4]) {
+    for (uint32_t c = 0; c < 4; ++c) {
+        int32_t v = static_cast<int32_t>(std::floor((e[c] - p) * 0.5f + 0.5f));
+        q[c] = std::clamp(v, 0, 127);
+        expanded[c] = (q[c] << 1) | static_cast<int32_t>(p);
+    }
+}
+
+uint32_t best_bc7_pbit(const float e[4]) {
+    float error[2] = {};
+    for (uint32_t p = 0; p < 2; ++p) {
+        int32_t q[4], x[4];
+        quantize_bc7_endpoint(e, p, q, x);
+        for (uint32_t c = 0; c < 4; ++c) {
+            error[p] += (x[c] - e[c]) * (x[c] - e[c]);
+        }
+    }
+    return error[1] < error[0] ? 1 : 0;
+}
+
+struct Bc7Mode6 {
+    int32_t q0[4];
+    int32_t q1[4];
+    uint32_t p0;
+    uint32_t p1;
+    uint8_t indices[16];
+    uint32_t error;
+};
+
+void bc7_interpolate(const int32_t x0[4], const int32_t x1[4], uint32_t index, int32_t out[4]) {
+    uint32_t w = bc7_weights[index];
+    for (uint32_t c = 0; c < 4; ++c) {
+        out[c] = static_cast<int32_t>(((64 - w) * x0[c] + w * x1[c] + 32) >> 6);
+    }
+}
+
+void bc7_evaluate(const uint8_t block[64], const float e0[4], const float e1[4], uint32_t p0, uint32_t p1, bool exhaustive, Bc7Mode6& result) {
+    int32_t x0[4], x1[4];
+    quantize_bc7_endpoint(e0, p0, result.q0, x0);
+    quantize_bc7_endpoint(e1, p1, result.q1, x1);
+    result.p0 = p0;
+    result.p1 = p1;
+    result.error = 0;
+
+    if (exhaustive) {
+        int32_t best_dist[16];
+        std::fill(best_dist, best_dist + 16, 1 << 30);
+        for (uint32_t index = 0; index < 16; ++index) {
+            int32_t color[4], dist[16];
+            bc7_interpolate(x0, x1, index, color);
+            block_distances(block, color, true, dist);
+            for (uint32_t i = 0; i < 16; ++i) {
+                if (dist[i] < best_dist[i]) {
+                    best_dist[i] = dist[i];
+                    result.indices[i] = static_cast<uint8_t>(index);
+                }
+            }
+        }
+        for (uint32_t i = 0; i < 16; ++i) {
+            result.error += best_dist[i];
+        }
+        return;
+    }
+
+    const Bc7ProjectionTable& table = get_bc7_projection_table();
+    int32_t axis[4];
+    int32_t axis_len_sq = 0;
+    for (uint32_t c = 0; c < 4; ++c) {
+        axis[c] = x1[c] - x0[c];
+        axis_len_sq += axis[c] * axis[c];
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t index = 0;
+        if (axis_len_sq > 0) {
+            int32_t dot = 0;
+            for (uint32_t c = 0; c < 4; ++c) {
+                dot += (block[i * 4 + c] - x0[c]) * axis[c];
+            }
+            int32_t t = std::clamp((dot * 64 + axis_len_sq / 2) / axis_len_sq, 0, 64);
+            index = table.index[t];
+        }
+        result.indices[i] = static_cast<uint8_t>(index);
+        int32_t color[4];
+        bc7_interpolate(x0, x1, index, color);
+        for (uint32_t c = 0; c < 4; ++c) {
+            int32_t d = block[i * 4 + c] - color[c];
+            result.error += d * d;
+        }
+    }
+}
+
+void encode_bc7_block(const uint8_t block[64], BlockQuality quality, uint8_t* out) {
+    float e0[4], e1[4];
+    Bc7Mode6 best;
+
+    if (quality == BlockQuality::fast) {
+        principal_endpoints(block, 4, 3, e0, e1);
+        bc7_evaluate(block, e0, e1, best_bc7_pbit(e0), best_bc7_pbit(e1), false, best);
+    } else {
+        principal_endpoints(block, 4, 8, e0, e1);
+        best.error = UINT32_MAX;
+        for (uint32_t iteration = 0; iteration < 3; ++iteration) {
+            Bc7Mode6 candidate;
+            bool improved = false;
+            for (uint32_t p = 0; p < 4; ++p) {
+                bc7_evaluate(block, e0, e1, p & 1, p >> 1, true, candidate);
+                if (candidate.error < best.error) {
+                    best = candidate;
+                    improved = true;
+                }
+            }
+            if (!improved || best.error == 0) {
+                break;
+            }
+            float weights[16];
+            for (uint32_t i = 0; i < 16; ++i) {
+                weights[i] = bc7_weights[best.indices[i]] / 64.0f;
+            }
+            if (!refine_endpoints(block, weights, 4, e0, e1)) {
+                break;
+            }
+        }
+    }
+
+    // The anchor texel's index MSB is implicit zero.
+    if (best.indices[0] & 8) {
+        std::swap(best.q0, best.q1);
+        std::swap(best.p0, best.p1);
+        for (uint32_t i = 0; i < 16; ++i) {
+            best.indices[i] = static_cast<uint8_t>(15 - best.indices[i]);
+        }
+    }
+
+    BitWriter writer(out);
+    writer.write(1u << 6, 7);
+    for (uint32_t c = 0; c < 4; ++c) {
+        writer.write(static_cast<uint32_t>(best.q0[c]), 7);
+        writer.write(static_cast<uint32_t>(best.q1[c]), 7);
+    }
+    writer.write(best.p0, 1);
+    writer.write(best.p1, 1);
+    writer.write(best.indices[0], 3);
+    for (uint32_t i = 1; i < 16; ++i) {
+        writer.write(best.indices[i], 4);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Decoders
+
+void decode_bc1_block(const uint8_t* in, uint8_t block[64]) {
+    uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+    uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+    int32_t palette[4][4];
+    bc1_palette(c0, c1, palette);
+    if (c0 <= c1) {
+        palette[3][3] = 0;
+    }
+    uint32_t indices;
+    memcpy(&indices, in + 4, 4);
+    for (uint32_t i = 0; i < 16; ++i) {
+        const int32_t* color = palette[(indices >> (i * 2)) & 3];
+        for (uint32_t c = 0; c < 4; ++c) {
+            block[i * 4 + c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+}
+
+void decode_bc4_block(const uint8_t* in, uint8_t block[64], uint32_t channel) {
+    uint32_t palette[8];
+    bc4_palette(in[0], in[1], palette);
+    uint64_t indices = 0;
+    for (uint32_t i = 0; i < 6; ++i) {
+        indices |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        block[i * 4 + channel] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+    }
+}
+
+void decode_bc7_block(const uint8_t* in, uint8_t block[64]) {
+    BitReader reader(in);
+    if (reader.read(7) != (1u << 6)) {
+        for (uint32_t i = 0; i < 16; ++i) {
+            block[i * 4 + 0] = 255;
+            block[i * 4 + 1] = 0;
+            block[i * 4 + 2] = 255;
+            block[i * 4 + 3] = 255;
+        }
+        return;
+    }
+    int32_t x0[4], x1[4];
+    for (uint32_t c = 0; c < 4; ++c) {
+        x0[c] = static_cast<int32_t>(reader.read(7)) << 1;
+        x1[c] = static_cast<int32_t>(reader.read(7)) << 1;
+    }
+    uint32_t p0 = reader.read(1);
+    uint32_t p1 = reader.read(1);
+    for (uint32_t c = 0; c < 4; ++c) {
+        x0[c] |= static_cast<int32_t>(p0);
+        x1[c] |= static_cast<int32_t>(p1);
+    }
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t index = reader.read(i == 0 ? 3 : 4);
+        int32_t color[4];
+        bc7_interpolate(x0, x1, index, color);
+        for (uint32_t c = 0; c < 4; ++c) {
+            block[i * 4 + c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+}
+
+void encode_block(PixelFormat format, const uint8_t block[64], BlockQuality quality, uint8_t* out) {
+    switch (format) {
+        case PixelFormat::bc1:
+            encode_bc1_block(block, quality, out);
+            break;
+        case PixelFormat::bc3:
+            encode_bc4_channel(block, 3, quality, out);
+            encode_bc1_block(block, quality, out + 8);
+            break;
+        case PixelFormat::bc4:
+            encode_bc4_channel(block, 0, quality, out);
+            break;
+        case PixelFormat::bc5:
+            encode_bc4_channel(block, 0, quality, out);
+            encode_bc4_channel(block, 1, quality, out + 8);
+            break;
+        case PixelFormat::bc7:
+            encode_bc7_block(block, quality, out);
+            break;
+        default:
+            break;
+    }
+}
+
+void decode_block(PixelFormat format, const uint8_t* in, uint8_t block[64]) {
+    switch (format) {
+        case PixelFormat::bc1:
+            decode_bc1_block(in, block);
+            break;
+        case PixelFormat::bc3:
+            decode_bc1_block(in + 8, block);
+            decode_bc4_block(in, block, 3);
+            break;
+        case PixelFormat::bc4:
+            memset(block, 0, 64);
+            decode_bc4_block(in, block, 0);
+            for (uint32_t i = 0; i < 16; ++i) {
+                block[i * 4 + 3] = 255;
+            }
+            break;
+        case PixelFormat::bc5:
+            memset(block, 0, 64);
+            decode_bc4_block(in, block, 0);
+            decode_bc4_block(in + 8, block, 1);
+            for (uint32_t i = 0; i < 16; ++i) {
+                block[i * 4 + 3] = 255;
+            }
+            break;
+        case PixelFormat::bc7:
+            decode_bc7_block(in, block);
+            break;
+        default:
+            break;
+    }
+}
+
+}
+
+void compress_surface(
+    PixelFormat format,
+    const uint8_t* rgba,
+    uint32_t width,
+    uint32_t height,
+    BlockQuality quality,
+    JobPool* job_pool,
+    uint8_t* dst,
+    size_t dst_row_pitch
+) {
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+    uint32_t block_size = get_element_size(format);
+
+    auto encode_rows = [&](uint32_t begin, uint32_t end) {
+        uint8_t block[64];
+        uint8_t encoded[16];
+        for (uint32_t by = begin; by < end; ++by) {
+            uint8_t* out = dst + by * dst_row_pitch;
+            for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+                // Encoders read back what they write; stage locally since dst
+                // is usually write-combined upload memory.
+                load_block(rgba, width, height, bx, by, block);
+                encode_block(format, block, quality, encoded);
+                memcpy(out + bx * block_size, encoded, block_size);
+            }
+        }
+    };
+
+    uint32_t grain = std::max(1u, 256u / std::max(blocks_x, 1u));
+    if (job_pool) {
+        job_pool->parallel_for(blocks_y, grain, encode_rows);
+    } else {
+        encode_rows(0, blocks_y);
+    }
+}
+
+void decompress_surface(PixelFormat format, const uint8_t* src, size_t src_row_pitch, uint32_t width, uint32_t height, uint8_t* rgba) {
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+    uint32_t block_size = get_element_size(format);
+    uint8_t block[64];
+
+    for (uint32_t by = 0; by < blocks_y; ++by) {
+        for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+            decode_block(format, src + by * src_row_pitch + bx * block_size, block);
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x) {
+                    memcpy(rgba + (static_cast<size_t>(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+}
+
+double compute_psnr(PixelFormat format, const uint8_t* reference, const uint8_t* decoded, uint32_t width, uint32_t height) {
+    uint32_t channel_mask = 0xF;
+    switch (format) {
+        case PixelFormat::bc1:
+            channel_mask = 0x7;
+            break;
+        case PixelFormat::bc4:
+            channel_mask = 0x1;
+            break;
+        case PixelFormat::bc5:
+            channel_mask = 0x3;
+            break;
+        default:
+            break;
+    }
+
+    double sum = 0.0;
+    uint64_t samples = 0;
+    size_t texels = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < texels; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            if (channel_mask & (1u << c)) {
+                double d = static_cast<double>(reference[i * 4 + c]) - decoded[i * 4 + c];
+                sum += d * d;
+                ++samples;
+            }
+        }
+    }
+    if (samples == 0 || sum == 0.0) {
+        return INFINITY;
+    }
+    double mse = sum / samples;
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+BlockCompressionReport measure_block_compression(PixelFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, BlockQuality quality, JobPool* job_pool) {
+    BlockCompressionReport report = {};
+    size_t row_pitch = get_row_size(format, width);
+    std::vector<uint8_t> compressed(get_surface_size(format, width, height));
+
+    auto start = std::chrono::steady_clock::now();
+    compress_surface(format, rgba, width, height, quality, job_pool, compressed.data(), row_pitch);
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<uint8_t> decoded(static_cast<size_t>(width) * height * 4);
+    decompress_surface(format, compressed.data(), row_pitch, width, height, decoded.data());
+
+    report.psnr = compute_psnr(format, rgba, decoded.data(), width, height);
+    report.seconds = std::chrono::duration<double>(end - start).count();
+    report.megapixels_per_second = report.seconds > 0.0 ? static_cast<double>(width) * height / report.seconds / 1e6 : 0.0;
+    report.compressed_bytes = compressed.size();
+    return report;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "pixel_format.hpp"
+
+class JobPool;
+
+// fast: bounding/principal axis endpoints and projected indices, for runtime.
+// high: endpoint refinement, exhaustive index search and p-bit search, for
+// offline baking.
+enum class BlockQuality {
+    fast,
+    high
+};
+
+struct BlockCompressionReport {
+    double psnr;
+    double seconds;
+    double megapixels_per_second;
+    size_t compressed_bytes;
+};
+
+// Encodes an RGBA8 surface into BCn blocks. dst_row_pitch is the distance
+// between rows of blocks, so the output can go straight into an upload heap
+// footprint. BC4 reads red, BC5 reads red and green. BC7 emits mode 6 blocks.
+void compress_surface(
+    PixelFormat format,
+    const uint8_t* rgba,
+    uint32_t width,
+    uint32_t height,
+    BlockQuality quality,
+    JobPool* job_pool,
+    uint8_t* dst,
+    size_t dst_row_pitch
+);
+
+// Reference decoder used for quality measurement. BC7 blocks in modes other
+// than 6 decode to magenta.
+void decompress_surface(PixelFormat format, const uint8_t* src, size_t src_row_pitch, uint32_t width, uint32_t height, uint8_t* rgba);
+
+// PSNR over the channels the format stores.
+double compute_psnr(PixelFormat format, const uint8_t* reference, const uint8_t* decoded, uint32_t width, uint32_t height);
+
+// Encodes, decodes and times one surface.
+BlockCompressionReport measure_block_compression(PixelFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, BlockQuality quality, JobPool* job_pool);
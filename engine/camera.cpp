@@ -3,14 +3,15 @@
 using namespace DirectX;
 
 Camera::Camera(float fov, float aspect_ratio, float near_plane, float far_plane, float initial_z)
-    : position(0.0f, 0.0f, initial_z), yaw(XM_PI), pitch(0.0f), mouse_sensitivity(0.002f), first_mouse(true),
-      fov(fov), near_plane(near_plane), far_plane(far_plane) {
+    : position(0.0f, 0.0f, initial_z), yaw(XM_PI), pitch(0.0f), previous_position(0.0f, 0.0f, initial_z),
+      move_speed(6.0f), mouse_sensitivity(0.002f),
+      fov(fov), aspect_ratio(aspect_ratio), near_plane(near_plane), far_plane(far_plane) {
     projection_matrix = XMMatrixPerspectiveFovLH(fov, aspect_ratio, near_plane, far_plane);
-    GetCursorPos(&last_mouse_pos);
     update_view_matrix();
 }
 
 void Camera::set_aspect_ratio(float aspect_ratio) {
+    this->aspect_ratio = aspect_ratio;
     projection_matrix = XMMatrixPerspectiveFovLH(fov, aspect_ratio, near_plane, far_plane);
 }
 
@@ -31,34 +32,26 @@ XMVECTOR Camera::get_right() const {
     return XMVector3Normalize(XMVector3Cross(up, forward));
 }
 
-void Camera::update() {
-    float speed = 0.1f;
+void Camera::update(float dt, const InputState& input) {
+    previous_position = position;
+    float speed = move_speed * dt;
 
     XMVECTOR pos = XMLoadFloat3(&position);
     XMVECTOR forward = get_forward();
     XMVECTOR right = get_right();
 
-    if (GetAsyncKeyState('W') & 0x8000) pos = XMVectorAdd(pos, XMVectorScale(forward, speed));
-    if (GetAsyncKeyState('S') & 0x8000) pos = XMVectorSubtract(pos, XMVectorScale(forward, speed));
-    if (GetAsyncKeyState('A') & 0x8000) pos = XMVectorSubtract(pos, XMVectorScale(right, speed));
-    if (GetAsyncKeyState('D') & 0x8000) pos = XMVectorAdd(pos, XMVectorScale(right, speed));
-    if (GetAsyncKeyState('Q') & 0x8000) pos = XMVectorAdd(pos, XMVectorSet(0.0f, speed, 0.0f, 0.0f));
-    if (GetAsyncKeyState('E') & 0x8000) pos = XMVectorSubtract(pos, XMVectorSet(0.0f, speed, 0.0f, 0.0f));
+    if (input.is_key_down('W')) pos = XMVectorAdd(pos, XMVectorScale(forward, speed));
+    if (input.is_key_down('S')) pos = XMVectorSubtract(pos, XMVectorScale(forward, speed));
+    if (input.is_key_down('A')) pos = XMVectorSubtract(pos, XMVectorScale(right, speed));
+    if (input.is_key_down('D')) pos = XMVectorAdd(pos, XMVectorScale(right, speed));
+    if (input.is_key_down('Q')) pos = XMVectorAdd(pos, XMVectorSet(0.0f, speed, 0.0f, 0.0f));
+    if (input.is_key_down('E')) pos = XMVectorSubtract(pos, XMVectorSet(0.0f, speed, 0.0f, 0.0f));
 
     XMStoreFloat3(&position, pos);
+    update_view_matrix();
+}
 
-    POINT current_mouse;
-    GetCursorPos(&current_mouse);
-
-    if (first_mouse) {
-        last_mouse_pos = current_mouse;
-        first_mouse = false;
-    }
-
-    float dx = static_cast<float>(current_mouse.x - last_mouse_pos.x);
-    float dy = static_cast<float>(current_mouse.y - last_mouse_pos.y);
-    last_mouse_pos = current_mouse;
-
+void Camera::look(int32_t dx, int32_t dy) {
     yaw += dx * mouse_sensitivity;
     pitch -= dy * mouse_sensitivity;
 
@@ -69,6 +62,20 @@ void Camera::update() {
     update_view_matrix();
 }
 
+XMFLOAT3 Camera::get_interpolated_position(float alpha) const {
+    XMFLOAT3 result;
+    XMStoreFloat3(&result, XMVectorLerp(XMLoadFloat3(&previous_position), XMLoadFloat3(&position), alpha));
+    return result;
+}
+
+XMMATRIX Camera::get_interpolated_view_matrix(float alpha) const {
+    XMFLOAT3 eye_position = get_interpolated_position(alpha);
+    XMVECTOR eye = XMLoadFloat3(&eye_position);
+    XMVECTOR forward = get_forward();
+    XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+    return XMMatrixLookAtLH(eye, XMVectorAdd(eye, forward), up);
+}
+
 void Camera::update_view_matrix() {
     XMVECTOR eye = XMLoadFloat3(&position);
     XMVECTOR forward = get_forward();
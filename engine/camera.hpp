@@ -2,17 +2,32 @@
 
 #include <DirectXMath.h>
 #include <windows.h>
+#include "input.hpp"
 
 class Camera {
 public:
     Camera(float fov, float aspect_ratio, float near_plane, float far_plane, float initial_z = 5.0f);
     ~Camera();
 
-    void update();
+    // One simulation step of dt seconds from the keys held; movement is in
+    // units per second.
+    void update(float dt, const InputState& input);
+    // Turns by raw mouse counts right away rather than on the next step,
+    // so the view follows the latest look input.
+    void look(int32_t dx, int32_t dy);
     void set_aspect_ratio(float aspect_ratio);
 
     DirectX::XMMATRIX get_view_matrix() const { return view_matrix; }
+    // Position between the state before the last update (alpha 0) and after
+    // it (1); orientation is always the latest.
+    DirectX::XMMATRIX get_interpolated_view_matrix(float alpha) const;
+    DirectX::XMFLOAT3 get_interpolated_position(float alpha) const;
     DirectX::XMMATRIX get_projection_matrix() const { return projection_matrix; }
+    DirectX::XMFLOAT3 get_position() const { return position; }
+    float get_fov() const { return fov; }
+    float get_aspect_ratio() const { return aspect_ratio; }
+    float get_near_plane() const { return near_plane; }
+    float get_far_plane() const { return far_plane; }
 
 private:
     void update_view_matrix();
@@ -25,11 +40,12 @@ private:
     DirectX::XMFLOAT3 position;
     float yaw;
     float pitch;
+    DirectX::XMFLOAT3 previous_position;
+    float move_speed;
     float mouse_sensitivity;
-    POINT last_mouse_pos;
-    bool first_mouse;
 
     float fov;
+    float aspect_ratio;
     float near_plane;
     float far_plane;
 };
@@ -0,0 +1,7 @@
+#include "content_hash.hpp"
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+uint64_t hash_content(const void* data, size_t size) {
+    return XXH3_64bits(data, size);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// XXH3-64 of the bytes. Stable across runs and platforms, so it can key
+// on-disk data as well as in-memory caches.
+uint64_t hash_content(const void* data, size_t size);
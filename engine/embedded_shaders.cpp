@@ -0,0 +1,30 @@
+#include "embedded_shaders.hpp"
+#include <iterator>
+
+// Generated into the build directory by shader_compiler.
+#include "embedded_shaders.inl"
+
+const EmbeddedShader* find_embedded_shader(PipelineShaderStage stage, const ShaderPermutation& permutation) {
+    uint32_t key = mask_permutation(permutation, stage).get_key();
+    for (const EmbeddedShader& shader : embedded_shaders) {
+        if (shader.stage == stage && shader.permutation_key == key) {
+            return &shader;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<ShaderPermutation> get_embedded_manifest() {
+    return std::vector<ShaderPermutation>(std::begin(embedded_manifest), std::end(embedded_manifest));
+}
+
+std::vector<ShaderBinding> get_embedded_bindings() {
+    std::vector<ShaderBinding> bindings;
+    for (const EmbeddedShader& shader : embedded_shaders) {
+        for (size_t i = 0; i < shader.binding_count; ++i) {
+            const EmbeddedShaderBinding& binding = shader.bindings[i];
+            bindings.push_back({ binding.name, binding.type, binding.register_index, binding.space, binding.size, shader.stage });
+        }
+    }
+    return bindings;
+}
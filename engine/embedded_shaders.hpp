@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "shader_permutations.hpp"
+#include "shader_bindings.hpp"
+
+// A ShaderBinding as recorded by shader_compiler's reflection pass.
+struct EmbeddedShaderBinding {
+    const char* name;
+    ShaderBindingType type;
+    uint32_t register_index;
+    uint32_t space;
+    uint32_t size;
+};
+
+// Stage bytecode the shader_compiler tool builds from shaders.hlsl when the
+// engine target is built, one entry per compile the permutation manifest
+// needs. Release builds are optimized; other builds keep debug info.
+struct EmbeddedShader {
+    PipelineShaderStage stage;
+    // get_key() of the permutation masked for the stage.
+    uint32_t permutation_key;
+    const uint8_t* bytecode;
+    size_t size;
+    const EmbeddedShaderBinding* bindings;
+    size_t binding_count;
+};
+
+// Null when the build did not compile that stage and permutation.
+const EmbeddedShader* find_embedded_shader(PipelineShaderStage stage, const ShaderPermutation& permutation);
+
+// The manifest the embedded shaders were built from.
+std::vector<ShaderPermutation> get_embedded_manifest();
+
+// Every binding of every embedded stage, for deriving the shared layout
+// without reflecting at startup.
+std::vector<ShaderBinding> get_embedded_bindings();
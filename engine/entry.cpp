@@ -1,9 +1,18 @@
 #include "window.hpp"
+#include <cstring>
 #include <stdexcept>
 
-int main() {
+int main(int argc, char** argv) {
     try {
         Window window(800, 600, L"DirectX 12 Hello Triangle");
+        // engine [--record file | --replay file | --profile file]
+        if (argc > 2 && strcmp(argv[1], "--record") == 0) {
+            window.record_input(argv[2]);
+        } else if (argc > 2 && strcmp(argv[1], "--replay") == 0) {
+            window.replay_input(argv[2]);
+        } else if (argc > 2 && strcmp(argv[1], "--profile") == 0) {
+            window.capture_profile(argv[2]);
+        }
         window.run();
     } catch (const std::exception& e) {
         MessageBoxA(nullptr, e.what(), "Error", MB_OK | MB_ICONERROR);
@@ -14,6 +23,3 @@ int main() {
     }
     return 0;
 }
-
-
-
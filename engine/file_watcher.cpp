@@ -0,0 +1,144 @@
+#include "file_watcher.hpp"
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// How often the watch thread checks for shutdown while no events arrive.
+static const int stop_poll_milliseconds = 100;
+
+std::vector<std::string> FileWatcher::take_changes() {
+    std::vector<std::string> settled;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(changes_mutex);
+    for (auto it = changes.begin(); it != changes.end();) {
+        if (now - it->second >= settle_time) {
+            settled.push_back(it->first);
+            it = changes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return settled;
+}
+
+void FileWatcher::record_change(const std::string& name) {
+    std::lock_guard<std::mutex> lock(changes_mutex);
+    changes[name] = std::chrono::steady_clock::now();
+}
+
+#if defined(_WIN32)
+
+FileWatcher::FileWatcher(const std::string& directory, std::chrono::milliseconds settle_time) :
+    directory(directory), settle_time(settle_time), stopping(false), directory_handle(INVALID_HANDLE_VALUE)
+{
+    directory_handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                   OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (directory_handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open directory for watching: " + directory);
+    }
+    watch_thread = std::thread(&FileWatcher::watch_main, this);
+}
+
+FileWatcher::~FileWatcher() {
+    stopping = true;
+    watch_thread.join();
+    CloseHandle(directory_handle);
+}
+
+void FileWatcher::watch_main() {
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    // DWORD-aligned, as ReadDirectoryChangesW requires.
+    DWORD buffer[16 * 1024];
+    const DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+
+    bool pending = false;
+    while (!stopping) {
+        if (!pending) {
+            ResetEvent(overlapped.hEvent);
+            if (!ReadDirectoryChangesW(directory_handle, buffer, sizeof(buffer), FALSE, filter, nullptr, &overlapped, nullptr)) {
+                break;
+            }
+            pending = true;
+        }
+        if (WaitForSingleObject(overlapped.hEvent, stop_poll_milliseconds) != WAIT_OBJECT_0) {
+            continue;
+        }
+        pending = false;
+        DWORD size = 0;
+        if (!GetOverlappedResult(directory_handle, &overlapped, &size, FALSE) || size == 0) {
+            // Overflowed or failed; nothing to attribute, so keep watching.
+            continue;
+        }
+
+        const BYTE* entry = reinterpret_cast<const BYTE*>(buffer);
+        for (;;) {
+            const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry);
+            if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
+                int name_length = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+                int utf8_length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, name_length, nullptr, 0, nullptr, nullptr);
+                std::string name(static_cast<size_t>(utf8_length), '\0');
+                WideCharToMultiByte(CP_UTF8, 0, info->FileName, name_length, name.data(), utf8_length, nullptr, nullptr);
+                record_change(name);
+            }
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            entry += info->NextEntryOffset;
+        }
+    }
+    if (pending) {
+        CancelIoEx(directory_handle, &overlapped);
+        DWORD size = 0;
+        GetOverlappedResult(directory_handle, &overlapped, &size, TRUE);
+    }
+    CloseHandle(overlapped.hEvent);
+}
+
+#else
+
+FileWatcher::FileWatcher(const std::string& directory, std::chrono::milliseconds settle_time) :
+    directory(directory), settle_time(settle_time), stopping(false), inotify_descriptor(-1)
+{
+    inotify_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_descriptor < 0) {
+        throw std::runtime_error("Failed to initialize inotify.");
+    }
+    if (inotify_add_watch(inotify_descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(inotify_descriptor);
+        throw std::runtime_error("Failed to open directory for watching: " + directory);
+    }
+    watch_thread = std::thread(&FileWatcher::watch_main, this);
+}
+
+FileWatcher::~FileWatcher() {
+    stopping = true;
+    watch_thread.join();
+    close(inotify_descriptor);
+}
+
+void FileWatcher::watch_main() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (!stopping) {
+        pollfd descriptor = { inotify_descriptor, POLLIN, 0 };
+        if (poll(&descriptor, 1, stop_poll_milliseconds) <= 0) {
+            continue;
+        }
+        ssize_t size = read(inotify_descriptor, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < size;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+                record_change(event->name);
+            }
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Watches one directory (not its subdirectories) for files being written,
+// created or renamed into it: inotify on Linux, ReadDirectoryChangesW on
+// Windows. Events are collected on a background thread; take_changes hands
+// out names once they have been quiet for settle_time, so an editor's
+// burst of writes for one save reports the file once.
+class FileWatcher {
+public:
+    explicit FileWatcher(const std::string& directory, std::chrono::milliseconds settle_time = std::chrono::milliseconds(100));
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // File names relative to the directory. Never blocks.
+    std::vector<std::string> take_changes();
+
+    const std::string& get_directory() const { return directory; }
+
+private:
+    void watch_main();
+    void record_change(const std::string& name);
+
+    std::string directory;
+    std::chrono::milliseconds settle_time;
+    std::mutex changes_mutex;
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> changes;
+    std::atomic<bool> stopping;
+#if defined(_WIN32)
+    void* directory_handle;
+#else
+    int inotify_descriptor;
+#endif
+    std::thread watch_thread;
+};
@@ -0,0 +1,256 @@
+#include "float_pack.hpp"
+#include "job_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <emmintrin.h>
+
+namespace {
+
+// Largest finite values: 5-bit exponent with bias 15 and a 6-, 5- or 10-bit
+// mantissa, and 9-bit mantissas over a shared 5-bit exponent.
+const float max_float11 = 65024.0f;
+const float max_float10 = 64512.0f;
+const float max_half = 65504.0f;
+const float max_rgb9e5 = 65408.0f;
+
+__m128i select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Non-negative, finite, in-range floats to a float with a 5-bit exponent
+// (bias 15) and the given mantissa width, rounded to nearest even. Normal
+// values rebias the exponent and round off the low mantissa bits; values
+// below the smallest normal are rounded by adding a magic number whose ulp
+// is one step of the target's subnormals.
+template <int mantissa_bits>
+__m128i encode_unsigned_float(__m128 value) {
+    const int shift = 23 - mantissa_bits;
+    __m128i bits = _mm_castps_si128(value);
+    __m128i is_subnormal = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), bits);
+
+    __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((127 + 23 - 14 - mantissa_bits) << 23));
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(value, magic)), _mm_castps_si128(magic));
+
+    __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, shift), _mm_set1_epi32(1));
+    __m128i biased = _mm_add_epi32(bits, _mm_set1_epi32((1 << (shift - 1)) - 1 - ((127 - 15) << 23)));
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(biased, odd), shift);
+
+    return select(is_subnormal, subnormal, normal);
+}
+
+// Clamps to [0, max]; max_ps returns its second operand for NaN, so NaNs become zero.
+__m128 clamp_unsigned(__m128 value, float max_value) {
+    return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(max_value));
+}
+
+// One RGBA texel to four halves, sign-extended into 32-bit lanes so a
+// signed pack keeps all 16 bits.
+__m128i encode_half4(__m128 texel) {
+    __m128 sign = _mm_and_ps(texel, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u))));
+    __m128 magnitude = clamp_unsigned(_mm_xor_ps(texel, sign), max_half);
+    __m128i half = _mm_or_si128(encode_unsigned_float<10>(magnitude), _mm_srli_epi32(_mm_castps_si128(sign), 16));
+    return _mm_srai_epi32(_mm_slli_epi32(half, 16), 16);
+}
+
+void pack_half4(const float* src, uint8_t* dst) {
+    __m128i a = encode_half4(_mm_loadu_ps(src));
+    __m128i b = encode_half4(_mm_loadu_ps(src + 4));
+    __m128i c = encode_half4(_mm_loadu_ps(src + 8));
+    __m128i d = encode_half4(_mm_loadu_ps(src + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packs_epi32(a, b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_packs_epi32(c, d));
+}
+
+void pack_r11g11b10f4(const float* src, uint8_t* dst) {
+    __m128 r = _mm_loadu_ps(src);
+    __m128 g = _mm_loadu_ps(src + 4);
+    __m128 b = _mm_loadu_ps(src + 8);
+    __m128 a = _mm_loadu_ps(src + 12);
+    _MM_TRANSPOSE4_PS(r, g, b, a);
+    __m128i red = encode_unsigned_float<6>(clamp_unsigned(r, max_float11));
+    __m128i green = encode_unsigned_float<6>(clamp_unsigned(g, max_float11));
+    __m128i blue = encode_unsigned_float<5>(clamp_unsigned(b, max_float10));
+    __m128i packed = _mm_or_si128(red, _mm_or_si128(_mm_slli_epi32(green, 11), _mm_slli_epi32(blue, 22)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), packed);
+}
+
+// Follows the D3D conversion rules: the exponent comes from the brightest
+// channel and is bumped when its mantissa rounds up to 2^9.
+void pack_rgb9e5_4(const float* src, uint8_t* dst) {
+    __m128 r = _mm_loadu_ps(src);
+    __m128 g = _mm_loadu_ps(src + 4);
+    __m128 b = _mm_loadu_ps(src + 8);
+    __m128 a = _mm_loadu_ps(src + 12);
+    _MM_TRANSPOSE4_PS(r, g, b, a);
+    r = clamp_unsigned(r, max_rgb9e5);
+    g = clamp_unsigned(g, max_rgb9e5);
+    b = clamp_unsigned(b, max_rgb9e5);
+    __m128 max_channel = _mm_max_ps(r, _mm_max_ps(g, b));
+
+    // floor(log2(max)) straight from the exponent bits, no lower than -16.
+    __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(max_channel), 23), _mm_set1_epi32(127));
+    __m128i lowest = _mm_set1_epi32(-16);
+    exponent = select(_mm_cmpgt_epi32(exponent, lowest), exponent, lowest);
+    __m128i shared = _mm_add_epi32(exponent, _mm_set1_epi32(16));
+
+    // 2^(15 + 9 - shared) built as float bits.
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 24), shared), 23));
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128i max_mantissa = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(max_channel, scale), half));
+    __m128i overflow = _mm_cmpeq_epi32(max_mantissa, _mm_set1_epi32(512));
+    shared = _mm_sub_epi32(shared, overflow);
+    scale = _mm_mul_ps(scale, _mm_castsi128_ps(select(overflow, _mm_castps_si128(half), _mm_castps_si128(_mm_set1_ps(1.0f)))));
+
+    __m128i red = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+    __m128i green = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+    __m128i blue = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+    __m128i packed = _mm_or_si128(_mm_or_si128(red, _mm_slli_epi32(green, 9)),
+                                  _mm_or_si128(_mm_slli_epi32(blue, 18), _mm_slli_epi32(shared, 27)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), packed);
+}
+
+using PackFunction = void (*)(const float* src, uint8_t* dst);
+
+PackFunction get_pack_function(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::r11g11b10f: return pack_r11g11b10f4;
+        case PixelFormat::rgb9e5: return pack_rgb9e5_4;
+        case PixelFormat::rgba16f: return pack_half4;
+        default: throw std::runtime_error("Not a float pixel format.");
+    }
+}
+
+void pack_row(PackFunction pack, uint32_t texel_size, const float* src, uint32_t width, uint8_t* dst) {
+    uint32_t x = 0;
+    for (; x + 4 <= width; x += 4) {
+        pack(src + x * 4, dst + x * texel_size);
+    }
+    if (x < width) {
+        // Pad the last group with zeros and keep only the texels that exist.
+        float tail[16] = {};
+        uint8_t packed[32];
+        memcpy(tail, src + x * 4, (width - x) * 4 * sizeof(float));
+        pack(tail, packed);
+        memcpy(dst + x * texel_size, packed, (width - x) * texel_size);
+    }
+}
+
+float decode_unsigned_float(uint32_t bits, int mantissa_bits) {
+    uint32_t exponent = (bits >> mantissa_bits) & 31;
+    uint32_t mantissa = bits & ((1u << mantissa_bits) - 1);
+    if (exponent == 0) {
+        return std::ldexp(static_cast<float>(mantissa), -14 - mantissa_bits);
+    }
+    if (exponent == 31) {
+        return mantissa ? NAN : INFINITY;
+    }
+    return std::ldexp(1.0f + static_cast<float>(mantissa) / static_cast<float>(1u << mantissa_bits), static_cast<int>(exponent) - 15);
+}
+
+float decode_half(uint16_t bits) {
+    float magnitude = decode_unsigned_float(bits & 0x7FFF, 10);
+    return (bits & 0x8000) ? -magnitude : magnitude;
+}
+
+} // namespace
+
+void pack_float_rows(PixelFormat format, const float* rgba, uint32_t width, uint32_t height, uint8_t* dst, size_t dst_row_pitch, JobPool* job_pool) {
+    PackFunction pack = get_pack_function(format);
+    uint32_t texel_size = get_element_size(format);
+    auto rows = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; y++) {
+            pack_row(pack, texel_size, rgba + static_cast<size_t>(y) * width * 4, width, dst + y * dst_row_pitch);
+        }
+    };
+    // Aim for chunks of roughly 64K texels so small levels stay on one thread.
+    uint32_t grain = std::max(1u, (1u << 16) / std::max(width, 1u));
+    if (job_pool) {
+        job_pool->parallel_for(height, grain, rows);
+    } else {
+        rows(0, height);
+    }
+}
+
+void unpack_float_rows(PixelFormat format, const uint8_t* src, size_t src_row_pitch, uint32_t width, uint32_t height, float* rgba) {
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = src + y * src_row_pitch;
+        for (uint32_t x = 0; x < width; x++) {
+            float* out = rgba + (static_cast<size_t>(y) * width + x) * 4;
+            if (format == PixelFormat::rgba16f) {
+                uint16_t halves[4];
+                memcpy(halves, row + x * 8, 8);
+                for (int c = 0; c < 4; c++) {
+                    out[c] = decode_half(halves[c]);
+                }
+                continue;
+            }
+            uint32_t bits;
+            memcpy(&bits, row + x * 4, 4);
+            if (format == PixelFormat::r11g11b10f) {
+                out[0] = decode_unsigned_float(bits & 0x7FF, 6);
+                out[1] = decode_unsigned_float((bits >> 11) & 0x7FF, 6);
+                out[2] = decode_unsigned_float(bits >> 22, 5);
+            } else {
+                float scale = std::ldexp(1.0f, static_cast<int>(bits >> 27) - 24);
+                out[0] = static_cast<float>(bits & 0x1FF) * scale;
+                out[1] = static_cast<float>((bits >> 9) & 0x1FF) * scale;
+                out[2] = static_cast<float>((bits >> 18) & 0x1FF) * scale;
+            }
+            out[3] = 1.0f;
+        }
+    }
+}
+
+FloatPackReport measure_float_packing(PixelFormat format, const float* rgba, uint32_t width, uint32_t height, JobPool* job_pool) {
+    FloatPackReport report = {};
+    size_t row_pitch = get_row_size(format, width);
+    std::vector<uint8_t> packed(get_surface_size(format, width, height));
+
+    auto start = std::chrono::steady_clock::now();
+    pack_float_rows(format, rgba, width, height, packed.data(), row_pitch, job_pool);
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<float> decoded(static_cast<size_t>(width) * height * 4);
+    unpack_float_rows(format, packed.data(), row_pitch, width, height, decoded.data());
+
+    // Errors are measured against what the format can hold, so clamping to
+    // its range is not counted. Below the smallest normal half the error is
+    // taken relative to that, as those values are all but black.
+    bool has_alpha = format == PixelFormat::rgba16f;
+    float max_value[4] = {max_half, max_half, max_half, max_half};
+    if (format == PixelFormat::r11g11b10f) {
+        max_value[0] = max_value[1] = max_float11;
+        max_value[2] = max_float10;
+    } else if (format == PixelFormat::rgb9e5) {
+        max_value[0] = max_value[1] = max_value[2] = max_rgb9e5;
+    }
+    const float smallest_normal = 1.0f / 16384.0f;
+    double sum = 0.0;
+    uint64_t samples = 0;
+    size_t texels = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < texels; ++i) {
+        const float* reference = rgba + i * 4;
+        float clamped[4];
+        for (int c = 0; c < 4; c++) {
+            float lowest = has_alpha ? -max_value[c] : 0.0f;
+            clamped[c] = std::min(std::max(reference[c], lowest), max_value[c]);
+        }
+        float brightest = std::max(std::max(std::fabs(clamped[0]), std::fabs(clamped[1])), std::fabs(clamped[2]));
+        for (int c = 0; c < (has_alpha ? 4 : 3); c++) {
+            float magnitude = c == 3 ? std::fabs(clamped[3]) : brightest;
+            double error = std::fabs(static_cast<double>(decoded[i * 4 + c]) - clamped[c]) / std::max(magnitude, smallest_normal);
+            report.max_relative_error = std::max(report.max_relative_error, error);
+            sum += error;
+            ++samples;
+        }
+    }
+    report.mean_relative_error = samples ? sum / samples : 0.0;
+    report.seconds = std::chrono::duration<double>(end - start).count();
+    report.megapixels_per_second = report.seconds > 0.0 ? static_cast<double>(texels) / report.seconds / 1e6 : 0.0;
+    report.packed_bytes = packed.size();
+    return report;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "pixel_format.hpp"
+
+class JobPool;
+
+struct FloatPackReport {
+    // Per channel, relative to the brightest colour channel of the texel, so
+    // dark channels next to bright ones are judged the way the eye sees them
+    // and the shared-exponent format is not penalised for what it cannot store.
+    double max_relative_error;
+    double mean_relative_error;
+    double seconds;
+    double megapixels_per_second;
+    size_t packed_bytes;
+};
+
+// Packs tightly packed RGBA32F rows into r11g11b10f, rgb9e5 or rgba16f rows
+// dst_row_pitch bytes apart. Four texels per SSE2 step with round to nearest
+// even. Values beyond a format's range saturate to its largest finite value
+// and NaNs become zero; the two packed formats have no sign or alpha, so
+// negatives become zero and alpha is dropped.
+void pack_float_rows(PixelFormat format, const float* rgba, uint32_t width, uint32_t height, uint8_t* dst, size_t dst_row_pitch, JobPool* job_pool = nullptr);
+
+// Scalar reference decoder used for error measurement. Alpha is 1 for the
+// packed formats.
+void unpack_float_rows(PixelFormat format, const uint8_t* src, size_t src_row_pitch, uint32_t width, uint32_t height, float* rgba);
+
+// Packs, unpacks and times one surface.
+FloatPackReport measure_float_packing(PixelFormat format, const float* rgba, uint32_t width, uint32_t height, JobPool* job_pool = nullptr);
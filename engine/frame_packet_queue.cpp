@@ -0,0 +1,83 @@
+#include "frame_packet_queue.hpp"
+
+// Weight of the newest frame in the running averages.
+static const double timing_smoothing = 0.1;
+
+FramePacketQueue::FramePacketQueue() : write_slot(0), read_slot(0), closed(false), producer_waiting(false), timings() {
+    for (SlotState& state : states) {
+        state = SlotState::free;
+    }
+}
+
+void FramePacketQueue::accumulate(double& average, Clock::time_point start, Clock::time_point end) {
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    average += (ms - average) * timing_smoothing;
+}
+
+int FramePacketQueue::begin_write(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!producer_waiting) {
+        producer_waiting = true;
+        producer_wait_start = Clock::now();
+    }
+    if (!cv.wait_for(lock, timeout, [this] { return closed || states[write_slot] == SlotState::free; }) || closed) {
+        return -1;
+    }
+    states[write_slot] = SlotState::writing;
+    producer_waiting = false;
+    write_start = Clock::now();
+    accumulate(timings.simulation.wait_ms, producer_wait_start, write_start);
+    return static_cast<int>(write_slot);
+}
+
+void FramePacketQueue::publish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states[write_slot] = SlotState::ready;
+        write_slot = (write_slot + 1) % slot_count;
+        accumulate(timings.simulation.work_ms, write_start, Clock::now());
+    }
+    cv.notify_all();
+}
+
+int FramePacketQueue::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point wait_start = Clock::now();
+    cv.wait(lock, [this] { return closed || states[read_slot] == SlotState::ready; });
+    if (closed) {
+        return -1;
+    }
+    states[read_slot] = SlotState::reading;
+    read_start = Clock::now();
+    accumulate(timings.render.wait_ms, wait_start, read_start);
+    return static_cast<int>(read_slot);
+}
+
+void FramePacketQueue::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        states[read_slot] = SlotState::free;
+        read_slot = (read_slot + 1) % slot_count;
+        accumulate(timings.render.work_ms, read_start, Clock::now());
+        timings.frames++;
+    }
+    cv.notify_all();
+}
+
+void FramePacketQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    cv.notify_all();
+}
+
+bool FramePacketQueue::is_closed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return closed;
+}
+
+FramePipelineTimings FramePacketQueue::get_timings() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return timings;
+}
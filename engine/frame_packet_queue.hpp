@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Averages over recent frames, in milliseconds. Work is the time a thread
+// holds a packet; wait is the time it blocks on the other thread.
+struct FrameThreadTimings {
+    double work_ms;
+    double wait_ms;
+};
+
+struct FramePipelineTimings {
+    FrameThreadTimings simulation;
+    FrameThreadTimings render;
+    uint64_t frames;
+};
+
+// Hands frame packets from the simulation thread to the render thread
+// through two slots. The producer fills one while the consumer reads the
+// other, so simulating frame N+1 overlaps recording and submitting frame N;
+// a producer a whole frame ahead waits for the consumer to hand a slot back.
+// Slots are indices; the caller owns the packets.
+class FramePacketQueue {
+public:
+    static const uint32_t slot_count = 2;
+
+    FramePacketQueue();
+
+    FramePacketQueue(const FramePacketQueue&) = delete;
+    FramePacketQueue& operator=(const FramePacketQueue&) = delete;
+
+    // Producer. The slot to fill, or -1 if none freed up within timeout or
+    // the queue is closed. A short timeout lets a window thread keep
+    // pumping messages while the render thread catches up.
+    int begin_write(std::chrono::milliseconds timeout);
+    void publish();
+
+    // Consumer. The oldest published slot, waiting for one; -1 once closed.
+    int acquire();
+    void release();
+
+    // Wakes both sides; every later call fails.
+    void close();
+    bool is_closed() const;
+
+    FramePipelineTimings get_timings() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class SlotState {
+        free,
+        writing,
+        ready,
+        reading
+    };
+
+    static void accumulate(double& average, Clock::time_point start, Clock::time_point end);
+
+    SlotState states[slot_count];
+    uint32_t write_slot;
+    uint32_t read_slot;
+    bool closed;
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+
+    // A producer polling with short timeouts waits from its first attempt.
+    bool producer_waiting;
+    Clock::time_point producer_wait_start;
+    Clock::time_point write_start;
+    Clock::time_point read_start;
+    FramePipelineTimings timings;
+};
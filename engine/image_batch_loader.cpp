@@ -0,0 +1,257 @@
+#include "image_batch_loader.hpp"
+#include "job_pool.hpp"
+#include "image_decoder.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+static uint64_t elapsed_nanoseconds(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data) {
+    PROFILE_SCOPE("image read");
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? ftell(file) : -1;
+    ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (ok) {
+        data.resize(static_cast<size_t>(size));
+        ok = fread(data.data(), 1, data.size(), file) == data.size();
+    }
+    fclose(file);
+    return ok;
+}
+
+static bool decode_file(const std::vector<uint8_t>& file_data, DecodedImage& image, std::string& error) {
+    PROFILE_SCOPE("image decode");
+    try {
+        MemoryImageSource source(file_data.data(), file_data.size());
+        ImageInfo info = read_image_info(source);
+        image.width = info.width;
+        image.height = info.height;
+        image.channels = info.channels;
+        image.pixels.resize(static_cast<size_t>(info.width) * info.height * 4);
+        decode_image(source, image.pixels.data(), static_cast<size_t>(info.width) * 4);
+        return true;
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+std::string format_image_batch_stats(const ImageBatchStats& stats) {
+    char text[256];
+    snprintf(text, sizeof(text), "%llu images (%llu failed), %.1f MB read in %.3f s, %.1f MB decoded in %.3f s, staged in %.3f s",
+             static_cast<unsigned long long>(stats.images_loaded), static_cast<unsigned long long>(stats.images_failed), stats.bytes_read / 1e6,
+             stats.read_seconds, stats.bytes_decoded / 1e6, stats.decode_seconds, stats.stage_seconds);
+    return text;
+}
+
+ImageBatchLoader::ImageBatchLoader(JobPool& job_pool, uint32_t io_thread_count, size_t max_read_ahead_bytes, StageFunction stage) :
+    job_pool(job_pool), stage(std::move(stage)), max_read_ahead_bytes(max_read_ahead_bytes), outstanding(0),
+    read_ahead_bytes(0), stopping(false), images_loaded(0), images_failed(0), bytes_read(0), bytes_decoded(0),
+    read_nanoseconds(0), decode_nanoseconds(0), stage_nanoseconds(0)
+{
+    io_thread_count = std::max(io_thread_count, 1u);
+    for (uint32_t i = 0; i < io_thread_count; ++i) {
+        io_threads.emplace_back(&ImageBatchLoader::io_thread_main, this);
+    }
+}
+
+ImageBatchLoader::~ImageBatchLoader() {
+    // Queued reads are cancelled; decodes already handed to the pool
+    // reference this loader, so those are waited for.
+    std::deque<ImageLoadHandle> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        cancelled.swap(read_queue);
+    }
+    queue_cv.notify_all();
+    for (std::thread& thread : io_threads) {
+        thread.join();
+    }
+    for (ImageLoadHandle handle : cancelled) {
+        get_slot(handle).error = "Load cancelled.";
+        finish(handle, ImageLoadStatus::failed);
+    }
+    wait_all();
+}
+
+ImageLoadHandle ImageBatchLoader::load(const std::string& path) {
+    return load_batch({path}).front();
+}
+
+std::vector<ImageLoadHandle> ImageBatchLoader::load_batch(const std::vector<std::string>& paths) {
+    std::vector<ImageLoadHandle> handles;
+    handles.reserve(paths.size());
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex);
+        for (const std::string& path : paths) {
+            std::unique_ptr<Slot> slot = std::make_unique<Slot>();
+            slot->path = path;
+            slot->status = ImageLoadStatus::pending;
+            slot->image = {};
+            handles.push_back(static_cast<ImageLoadHandle>(slots.size()));
+            slots.push_back(std::move(slot));
+        }
+        outstanding += static_cast<uint32_t>(paths.size());
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        read_queue.insert(read_queue.end(), handles.begin(), handles.end());
+    }
+    queue_cv.notify_all();
+    return handles;
+}
+
+ImageBatchLoader::Slot& ImageBatchLoader::get_slot(ImageLoadHandle handle) const {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    if (handle >= slots.size()) {
+        throw std::runtime_error("Invalid image load handle.");
+    }
+    return *slots[handle];
+}
+
+ImageLoadStatus ImageBatchLoader::get_status(ImageLoadHandle handle) const {
+    return get_slot(handle).status.load(std::memory_order_acquire);
+}
+
+ImageLoadStatus ImageBatchLoader::wait(ImageLoadHandle handle) {
+    Slot& slot = get_slot(handle);
+    std::unique_lock<std::mutex> lock(slots_mutex);
+    done_cv.wait(lock, [&slot] { return slot.status.load(std::memory_order_acquire) != ImageLoadStatus::pending; });
+    return slot.status.load(std::memory_order_acquire);
+}
+
+void ImageBatchLoader::wait_all() {
+    std::unique_lock<std::mutex> lock(slots_mutex);
+    done_cv.wait(lock, [this] { return outstanding == 0; });
+}
+
+DecodedImage ImageBatchLoader::take(ImageLoadHandle handle) {
+    Slot& slot = get_slot(handle);
+    if (wait(handle) == ImageLoadStatus::failed) {
+        throw std::runtime_error("Failed to load texture file: " + slot.path + " (" + slot.error + ")");
+    }
+    return std::move(slot.image);
+}
+
+const std::string& ImageBatchLoader::get_error(ImageLoadHandle handle) const {
+    return get_slot(handle).error;
+}
+
+const std::string& ImageBatchLoader::get_path(ImageLoadHandle handle) const {
+    return get_slot(handle).path;
+}
+
+ImageBatchStats ImageBatchLoader::get_stats() const {
+    ImageBatchStats stats = {};
+    stats.images_loaded = images_loaded.load();
+    stats.images_failed = images_failed.load();
+    stats.bytes_read = bytes_read.load();
+    stats.bytes_decoded = bytes_decoded.load();
+    stats.read_seconds = read_nanoseconds.load() * 1e-9;
+    stats.decode_seconds = decode_nanoseconds.load() * 1e-9;
+    stats.stage_seconds = stage_nanoseconds.load() * 1e-9;
+    return stats;
+}
+
+void ImageBatchLoader::io_thread_main() {
+    Profiler::set_thread_name("image io");
+    for (;;) {
+        ImageLoadHandle handle;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            // Always allow one file in flight so a single oversized file cannot stall the queue.
+            queue_cv.wait(lock, [this] {
+                return stopping || (!read_queue.empty() && (read_ahead_bytes == 0 || read_ahead_bytes < max_read_ahead_bytes));
+            });
+            if (stopping) {
+                return;
+            }
+            handle = read_queue.front();
+            read_queue.pop_front();
+        }
+
+        Slot& slot = get_slot(handle);
+        std::vector<uint8_t> file_data;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = read_file(slot.path, file_data);
+        read_nanoseconds += elapsed_nanoseconds(start);
+        if (!ok) {
+            slot.error = "Could not read file.";
+            finish(handle, ImageLoadStatus::failed);
+            continue;
+        }
+        bytes_read += file_data.size();
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            read_ahead_bytes += file_data.size();
+        }
+        // The lambda owns the file bytes; std::function needs a copyable
+        // callable, hence the shared_ptr.
+        auto data = std::make_shared<std::vector<uint8_t>>(std::move(file_data));
+        job_pool.submit([this, handle, data] { decode(handle, std::move(*data)); });
+    }
+}
+
+void ImageBatchLoader::decode(ImageLoadHandle handle, std::vector<uint8_t> file_data) {
+    Slot& slot = get_slot(handle);
+
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    bool decoded = decode_file(file_data, slot.image, error);
+    decode_nanoseconds += elapsed_nanoseconds(start);
+
+    // The compressed bytes are no longer needed; let the I/O threads read on.
+    size_t file_size = file_data.size();
+    std::vector<uint8_t>().swap(file_data);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        read_ahead_bytes -= file_size;
+    }
+    queue_cv.notify_all();
+
+    if (!decoded) {
+        slot.error = error;
+        finish(handle, ImageLoadStatus::failed);
+        return;
+    }
+    bytes_decoded += slot.image.pixels.size();
+
+    if (stage) {
+        start = std::chrono::steady_clock::now();
+        try {
+            stage(handle, slot.image);
+        } catch (const std::exception& e) {
+            slot.error = e.what();
+            stage_nanoseconds += elapsed_nanoseconds(start);
+            finish(handle, ImageLoadStatus::failed);
+            return;
+        }
+        stage_nanoseconds += elapsed_nanoseconds(start);
+    }
+    finish(handle, ImageLoadStatus::ready);
+}
+
+void ImageBatchLoader::finish(ImageLoadHandle handle, ImageLoadStatus status) {
+    if (status == ImageLoadStatus::ready) {
+        ++images_loaded;
+    } else {
+        ++images_failed;
+    }
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex);
+        slots[handle]->status.store(status, std::memory_order_release);
+        --outstanding;
+    }
+    done_cv.notify_all();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class JobPool;
+
+using ImageLoadHandle = uint32_t;
+
+enum class ImageLoadStatus : uint32_t {
+    pending,
+    ready,
+    failed
+};
+
+// Tightly packed RGBA8.
+struct DecodedImage {
+    uint32_t width;
+    uint32_t height;
+    // Channels in the source file; pixels are always expanded to RGBA8.
+    uint32_t channels;
+    std::vector<uint8_t> pixels;
+};
+
+struct ImageBatchStats {
+    uint64_t images_loaded;
+    uint64_t images_failed;
+    uint64_t bytes_read;
+    uint64_t bytes_decoded;
+    // Summed over threads, so they can exceed wall time.
+    double read_seconds;
+    double decode_seconds;
+    double stage_seconds;
+};
+
+// One line for logs: counts, bytes and the time spent in each stage.
+std::string format_image_batch_stats(const ImageBatchStats& stats);
+
+// Loads images in three overlapping stages: I/O threads read whole files
+// into memory, JobPool workers decode them with decode_image, and the same
+// worker then runs the optional stage function (for example to fill an
+// upload heap) before the handle completes. Reads stop once
+// max_read_ahead_bytes of undecoded file data is queued, so a large batch
+// never holds more than that many compressed bytes at once.
+class ImageBatchLoader {
+public:
+    // Runs on a worker after decode. May throw; the handle then fails with
+    // the exception message.
+    using StageFunction = std::function<void(ImageLoadHandle handle, DecodedImage& image)>;
+
+    ImageBatchLoader(JobPool& job_pool, uint32_t io_thread_count = 1, size_t max_read_ahead_bytes = 64ull * 1024 * 1024, StageFunction stage = nullptr);
+    ~ImageBatchLoader();
+
+    ImageBatchLoader(const ImageBatchLoader&) = delete;
+    ImageBatchLoader& operator=(const ImageBatchLoader&) = delete;
+
+    ImageLoadHandle load(const std::string& path);
+    std::vector<ImageLoadHandle> load_batch(const std::vector<std::string>& paths);
+
+    ImageLoadStatus get_status(ImageLoadHandle handle) const;
+    ImageLoadStatus wait(ImageLoadHandle handle);
+    void wait_all();
+
+    // Moves the decoded pixels out; throws if the load failed. Waits if the
+    // handle is still pending.
+    DecodedImage take(ImageLoadHandle handle);
+    const std::string& get_error(ImageLoadHandle handle) const;
+    const std::string& get_path(ImageLoadHandle handle) const;
+
+    ImageBatchStats get_stats() const;
+
+private:
+    struct Slot {
+        std::string path;
+        std::atomic<ImageLoadStatus> status;
+        DecodedImage image;
+        std::string error;
+    };
+
+    void io_thread_main();
+    void decode(ImageLoadHandle handle, std::vector<uint8_t> file_data);
+    void finish(ImageLoadHandle handle, ImageLoadStatus status);
+    Slot& get_slot(ImageLoadHandle handle) const;
+
+    JobPool& job_pool;
+    StageFunction stage;
+    size_t max_read_ahead_bytes;
+
+    // Slots live in a deque of pointers so handles stay valid while new
+    // batches are appended from another thread.
+    std::deque<std::unique_ptr<Slot>> slots;
+    mutable std::mutex slots_mutex;
+    std::condition_variable done_cv;
+    uint32_t outstanding;
+
+    std::vector<std::thread> io_threads;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<ImageLoadHandle> read_queue;
+    size_t read_ahead_bytes;
+    bool stopping;
+
+    std::atomic<uint64_t> images_loaded;
+    std::atomic<uint64_t> images_failed;
+    std::atomic<uint64_t> bytes_read;
+    std::atomic<uint64_t> bytes_decoded;
+    std::atomic<uint64_t> read_nanoseconds;
+    std::atomic<uint64_t> decode_nanoseconds;
+    std::atomic<uint64_t> stage_nanoseconds;
+};
@@ -0,0 +1,309 @@
+#include "image_decoder.hpp"
+#include "pnm_reader.hpp"
+#include "png_reader.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// Decodes can run on several workers at once, so the counters are per thread.
+static thread_local uint64_t decoder_allocations = 0;
+static thread_local uint64_t decoder_allocated_bytes = 0;
+
+static void* counted_malloc(size_t size) {
+    decoder_allocations++;
+    decoder_allocated_bytes += size;
+    return malloc(size);
+}
+
+static void* counted_realloc(void* pointer, size_t size) {
+    decoder_allocations++;
+    decoder_allocated_bytes += size;
+    return realloc(pointer, size);
+}
+
+#define STBI_MALLOC(size) counted_malloc(size)
+#define STBI_REALLOC(pointer, size) counted_realloc(pointer, size)
+#define STBI_FREE(pointer) free(pointer)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+const uint8_t* ImageSource::get_memory(size_t& size) const {
+    size = 0;
+    return nullptr;
+}
+
+MemoryImageSource::MemoryImageSource(const uint8_t* data, size_t size) : data(data), size(size), position(0) {}
+
+size_t MemoryImageSource::read(uint8_t* dst, size_t count) {
+    size_t available = size - position;
+    count = count < available ? count : available;
+    memcpy(dst, data + position, count);
+    position += count;
+    return count;
+}
+
+void MemoryImageSource::skip(int64_t count) {
+    int64_t target = static_cast<int64_t>(position) + count;
+    position = target < 0 ? 0 : (static_cast<uint64_t>(target) > size ? size : static_cast<size_t>(target));
+}
+
+bool MemoryImageSource::at_end() const {
+    return position >= size;
+}
+
+void MemoryImageSource::rewind() {
+    position = 0;
+}
+
+const uint8_t* MemoryImageSource::get_memory(size_t& memory_size) const {
+    memory_size = size;
+    return data;
+}
+
+FileChunkImageSource::FileChunkImageSource(const std::string& path, uint64_t offset, uint64_t size) :
+    file(fopen(path.c_str(), "rb")), offset(offset), size(size), position(0)
+{
+    if (!file) {
+        throw std::runtime_error("Failed to open image source: " + path);
+    }
+    seek();
+}
+
+FileChunkImageSource::~FileChunkImageSource() {
+    fclose(file);
+}
+
+void FileChunkImageSource::seek() {
+#if defined(_WIN32)
+    _fseeki64(file, static_cast<long long>(offset + position), SEEK_SET);
+#else
+    fseeko(file, static_cast<off_t>(offset + position), SEEK_SET);
+#endif
+}
+
+size_t FileChunkImageSource::read(uint8_t* dst, size_t count) {
+    uint64_t available = size - position;
+    count = count < available ? count : static_cast<size_t>(available);
+    size_t read_count = fread(dst, 1, count, file);
+    position += read_count;
+    return read_count;
+}
+
+void FileChunkImageSource::skip(int64_t count) {
+    int64_t target = static_cast<int64_t>(position) + count;
+    position = target < 0 ? 0 : (static_cast<uint64_t>(target) > size ? size : static_cast<uint64_t>(target));
+    seek();
+}
+
+bool FileChunkImageSource::at_end() const {
+    return position >= size;
+}
+
+void FileChunkImageSource::rewind() {
+    position = 0;
+    seek();
+}
+
+static int source_read(void* user, char* data, int size) {
+    return static_cast<int>(static_cast<ImageSource*>(user)->read(reinterpret_cast<uint8_t*>(data), static_cast<size_t>(size)));
+}
+
+static void source_skip(void* user, int count) {
+    static_cast<ImageSource*>(user)->skip(count);
+}
+
+static int source_eof(void* user) {
+    return static_cast<ImageSource*>(user)->at_end() ? 1 : 0;
+}
+
+static const stbi_io_callbacks source_callbacks = {source_read, source_skip, source_eof};
+
+static bool starts_with_pnm(ImageSource& source) {
+    uint8_t magic[2] = {};
+    size_t count = source.read(magic, sizeof(magic));
+    source.rewind();
+    return is_pnm(magic, count);
+}
+
+// The PNM reader wants the whole file; only non-memory sources pay for a copy.
+static const uint8_t* get_whole_source(ImageSource& source, size_t& size, std::vector<uint8_t>& storage) {
+    const uint8_t* memory = source.get_memory(size);
+    if (memory) {
+        return memory;
+    }
+    uint8_t chunk[64 * 1024];
+    size_t count;
+    while ((count = source.read(chunk, sizeof(chunk))) > 0) {
+        storage.insert(storage.end(), chunk, chunk + count);
+    }
+    source.rewind();
+    size = storage.size();
+    return storage.data();
+}
+
+ImageInfo read_image_info(ImageSource& source) {
+    ImageInfo info = {};
+    if (starts_with_pnm(source)) {
+        // Headers are a few dozen bytes; this leaves room for comment lines.
+        uint8_t header_bytes[4096];
+        size_t count = source.read(header_bytes, sizeof(header_bytes));
+        source.rewind();
+        PnmHeader header = parse_pnm_header(header_bytes, count);
+        return {header.width, header.height, header.channels, false};
+    }
+
+    int width = 0, height = 0, channels = 0;
+    size_t memory_size = 0;
+    const uint8_t* memory = source.get_memory(memory_size);
+    int ok = memory
+        ? stbi_info_from_memory(memory, static_cast<int>(memory_size), &width, &height, &channels)
+        : stbi_info_from_callbacks(&source_callbacks, &source, &width, &height, &channels);
+    source.rewind();
+    if (!ok) {
+        const char* reason = stbi_failure_reason();
+        throw std::runtime_error(std::string("Failed to read image header: ") + (reason ? reason : "unknown format"));
+    }
+    info.width = static_cast<uint32_t>(width);
+    info.height = static_cast<uint32_t>(height);
+    info.channels = static_cast<uint32_t>(channels);
+    info.hdr = (memory
+        ? stbi_is_hdr_from_memory(memory, static_cast<int>(memory_size))
+        : stbi_is_hdr_from_callbacks(&source_callbacks, &source)) != 0;
+    source.rewind();
+    return info;
+}
+
+ImageInfo decode_image(ImageSource& source, uint8_t* dst, size_t dst_row_pitch, JobPool* job_pool, ImageDecodeStats* stats) {
+    decoder_allocations = 0;
+    decoder_allocated_bytes = 0;
+    uint64_t bytes_copied = 0;
+    ImageInfo info = {};
+
+    if (starts_with_pnm(source)) {
+        std::vector<uint8_t> storage;
+        size_t size = 0;
+        const uint8_t* data = get_whole_source(source, size, storage);
+        if (!storage.empty()) {
+            decoder_allocations++;
+            decoder_allocated_bytes += storage.capacity();
+            bytes_copied += storage.size();
+        }
+        PnmHeader header = parse_pnm_header(data, size);
+        decode_pnm(data, size, header, dst, dst_row_pitch, job_pool);
+        info = {header.width, header.height, header.channels, false};
+    } else {
+        int width = 0, height = 0, channels = 0;
+        size_t memory_size = 0;
+        const uint8_t* memory = source.get_memory(memory_size);
+        stbi_uc* pixels = memory
+            ? stbi_load_from_memory(memory, static_cast<int>(memory_size), &width, &height, &channels, 4)
+            : stbi_load_from_callbacks(&source_callbacks, &source, &width, &height, &channels, 4);
+        source.rewind();
+        if (!pixels) {
+            const char* reason = stbi_failure_reason();
+            throw std::runtime_error(std::string("Failed to decode image: ") + (reason ? reason : "unknown format"));
+        }
+        size_t row_size = static_cast<size_t>(width) * 4;
+        if (dst_row_pitch == row_size) {
+            memcpy(dst, pixels, row_size * height);
+        } else {
+            for (int y = 0; y < height; y++) {
+                memcpy(dst + y * dst_row_pitch, pixels + y * row_size, row_size);
+            }
+        }
+        bytes_copied += row_size * height;
+        stbi_image_free(pixels);
+        info = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<uint32_t>(channels), false};
+    }
+
+    if (stats) {
+        stats->allocations = decoder_allocations;
+        stats->allocated_bytes = decoder_allocated_bytes;
+        stats->bytes_copied = bytes_copied;
+    }
+    return info;
+}
+
+ImageInfo decode_image_float(ImageSource& source, float* dst, size_t dst_row_pitch, ImageDecodeStats* stats) {
+    decoder_allocations = 0;
+    decoder_allocated_bytes = 0;
+
+    int width = 0, height = 0, channels = 0;
+    size_t memory_size = 0;
+    const uint8_t* memory = source.get_memory(memory_size);
+    float* pixels = memory
+        ? stbi_loadf_from_memory(memory, static_cast<int>(memory_size), &width, &height, &channels, 4)
+        : stbi_loadf_from_callbacks(&source_callbacks, &source, &width, &height, &channels, 4);
+    source.rewind();
+    if (!pixels) {
+        const char* reason = stbi_failure_reason();
+        throw std::runtime_error(std::string("Failed to decode image: ") + (reason ? reason : "unknown format"));
+    }
+    size_t row_size = static_cast<size_t>(width) * 4 * sizeof(float);
+    for (int y = 0; y < height; y++) {
+        memcpy(reinterpret_cast<uint8_t*>(dst) + y * dst_row_pitch, pixels + static_cast<size_t>(y) * width * 4, row_size);
+    }
+    stbi_image_free(pixels);
+
+    if (stats) {
+        stats->allocations = decoder_allocations;
+        stats->allocated_bytes = decoder_allocated_bytes;
+        stats->bytes_copied = row_size * height;
+    }
+    return {static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<uint32_t>(channels), true};
+}
+
+namespace {
+
+// Binary samples are read a band at a time into one reusable buffer.
+class PnmRowReader : public ImageRowReader {
+public:
+    PnmRowReader(ImageSource& source, const PnmHeader& header) : source(source), header(header), rows_read(0) {
+        info = {header.width, header.height, header.channels, false};
+        source.rewind();
+        source.skip(static_cast<int64_t>(header.data_offset));
+    }
+
+    void read_rows(uint8_t* dst, size_t dst_row_pitch, uint32_t row_count) override {
+        if (rows_read + row_count > header.height) {
+            throw std::runtime_error("Read past the last PNM row.");
+        }
+        size_t size = get_pnm_row_size(header) * row_count;
+        samples.resize(size);
+        if (source.read(samples.data(), size) != size) {
+            throw std::runtime_error("PNM file is truncated.");
+        }
+        expand_pnm_rows(samples.data(), header, row_count, dst, dst_row_pitch);
+        rows_read += row_count;
+    }
+
+private:
+    ImageSource& source;
+    PnmHeader header;
+    uint32_t rows_read;
+    std::vector<uint8_t> samples;
+};
+
+} // namespace
+
+std::unique_ptr<ImageRowReader> open_row_reader(ImageSource& source) {
+    uint8_t header_bytes[4096];
+    size_t count = source.read(header_bytes, sizeof(header_bytes));
+    source.rewind();
+    if (is_png(header_bytes, count)) {
+        // Interlaced files only show up in the header; let them take the whole-image path.
+        if (count >= 29 && header_bytes[28] != 0) {
+            return nullptr;
+        }
+        return std::make_unique<PngRowReader>(source);
+    }
+    if (is_pnm(header_bytes, count)) {
+        PnmHeader header = parse_pnm_header(header_bytes, count);
+        if (header.ascii) {
+            return nullptr;
+        }
+        return std::make_unique<PnmRowReader>(source, header);
+    }
+    return nullptr;
+}
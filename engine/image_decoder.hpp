@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+class JobPool;
+
+// Where encoded image bytes come from. Sources already in memory (mapped
+// files, buffers) are decoded straight from that memory; anything else is
+// streamed through stb_image's I/O callbacks, so nothing has to be read
+// into a temporary buffer first.
+class ImageSource {
+public:
+    virtual ~ImageSource() = default;
+
+    virtual size_t read(uint8_t* dst, size_t size) = 0;
+    // count may be negative; stb_image uses that to step back.
+    virtual void skip(int64_t count) = 0;
+    virtual bool at_end() const = 0;
+    virtual void rewind() = 0;
+
+    // The whole source as contiguous memory, or nullptr if it is not in memory.
+    virtual const uint8_t* get_memory(size_t& size) const;
+};
+
+// Memory owned elsewhere: a MappedFile, a loaded pack or a plain buffer.
+class MemoryImageSource : public ImageSource {
+public:
+    MemoryImageSource(const uint8_t* data, size_t size);
+
+    size_t read(uint8_t* dst, size_t size) override;
+    void skip(int64_t count) override;
+    bool at_end() const override;
+    void rewind() override;
+    const uint8_t* get_memory(size_t& size) const override;
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+};
+
+// A byte range inside a larger file, such as one entry of a pack file.
+class FileChunkImageSource : public ImageSource {
+public:
+    FileChunkImageSource(const std::string& path, uint64_t offset, uint64_t size);
+    ~FileChunkImageSource();
+
+    FileChunkImageSource(const FileChunkImageSource&) = delete;
+    FileChunkImageSource& operator=(const FileChunkImageSource&) = delete;
+
+    size_t read(uint8_t* dst, size_t size) override;
+    void skip(int64_t count) override;
+    bool at_end() const override;
+    void rewind() override;
+
+private:
+    void seek();
+
+    FILE* file;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t position;
+};
+
+struct ImageInfo {
+    uint32_t width;
+    uint32_t height;
+    // Channels stored in the file; decoded output is always RGBA8.
+    uint32_t channels;
+    // Radiance .hdr and other float sources; decode with decode_image_float.
+    bool hdr;
+};
+
+// Heap traffic of one decode: allocations made by the decoder and bytes
+// moved between CPU buffers after decoding.
+struct ImageDecodeStats {
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    uint64_t bytes_copied;
+};
+
+// Both throw std::runtime_error on unreadable or unsupported data and leave
+// the source rewound for the next call.
+ImageInfo read_image_info(ImageSource& source);
+
+// Writes RGBA8 rows dst_row_pitch bytes apart; dst must hold height rows.
+// PNM files are expanded straight into dst. Other formats decode into one
+// stb_image buffer that is copied into dst and freed; stb_image has no way
+// to write into caller memory.
+ImageInfo decode_image(ImageSource& source, uint8_t* dst, size_t dst_row_pitch, JobPool* job_pool = nullptr, ImageDecodeStats* stats = nullptr);
+
+// Writes linear RGBA32F rows dst_row_pitch bytes apart. HDR files keep their
+// full range; 8-bit files are linearised with stb_image's default 2.2 gamma.
+ImageInfo decode_image_float(ImageSource& source, float* dst, size_t dst_row_pitch, ImageDecodeStats* stats = nullptr);
+
+// Decodes an image top to bottom a band of rows at a time, so memory is
+// bounded by the band rather than the whole image.
+class ImageRowReader {
+public:
+    virtual ~ImageRowReader() = default;
+
+    const ImageInfo& get_info() const { return info; }
+    // Writes the next row_count RGBA8 rows dst_row_pitch bytes apart.
+    // Throws std::runtime_error on corrupt data or when reading past the end.
+    virtual void read_rows(uint8_t* dst, size_t dst_row_pitch, uint32_t row_count) = 0;
+
+protected:
+    ImageInfo info = {};
+};
+
+// Non-interlaced PNG and binary PNM can be streamed; for anything else this
+// returns nullptr and the image goes through decode_image. The reader reads
+// from source as it goes, so source must outlive it.
+std::unique_ptr<ImageRowReader> open_row_reader(ImageSource& source);
@@ -0,0 +1,302 @@
+#include "inflate_stream.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const uint32_t fast_bits = 9;
+const uint32_t window_size = 32768;
+const uint32_t input_buffer_size = 64 * 1024;
+
+const uint16_t length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const uint8_t code_length_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+uint32_t reverse_bits(uint32_t value, uint32_t count) {
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        result = (result << 1) | (value & 1);
+        value >>= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+InflateStream::InflateStream(ReadFunction read) :
+    source(std::move(read)), input(input_buffer_size), input_position(0), input_size(0), input_ended(false),
+    bit_buffer(0), bit_count(0), padded_bits(0), window(window_size), window_position(0), total_output(0),
+    literal_codes(), distance_codes(), in_block(false), finished(false),
+    stored_remaining(0), match_length(0), match_distance(0)
+{
+    uint32_t cmf = read_bits(8);
+    uint32_t flags = read_bits(8);
+    if ((cmf & 15) != 8 || (cmf * 256 + flags) % 31 != 0 || (flags & 32)) {
+        throw std::runtime_error("Invalid zlib header.");
+    }
+}
+
+uint8_t InflateStream::read_byte() {
+    if (input_position == input_size) {
+        input_size = input_ended ? 0 : source(input.data(), input.size());
+        input_position = 0;
+        if (input_size == 0) {
+            // Past the end, decoding carries on with zero bits; using any of
+            // them is reported as truncation.
+            input_ended = true;
+            padded_bits += 8;
+            return 0;
+        }
+    }
+    return input[input_position++];
+}
+
+void InflateStream::fill_bits() {
+    if (input_size - input_position >= 8) {
+        // Branch-free refill: take 8 bytes, keep the whole ones that fit.
+        uint64_t bytes;
+        memcpy(&bytes, input.data() + input_position, 8);
+        bit_buffer |= bytes << bit_count;
+        input_position += (63 - bit_count) >> 3;
+        bit_count |= 56;
+        return;
+    }
+    while (bit_count <= 56) {
+        bit_buffer |= static_cast<uint64_t>(read_byte()) << bit_count;
+        bit_count += 8;
+    }
+}
+
+void InflateStream::consume_bits(uint32_t count) {
+    bit_buffer >>= count;
+    bit_count -= count;
+    if (bit_count < padded_bits) {
+        throw std::runtime_error("Compressed stream is truncated.");
+    }
+}
+
+uint32_t InflateStream::read_bits(uint32_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    if (bit_count < count) {
+        fill_bits();
+    }
+    uint32_t value = static_cast<uint32_t>(bit_buffer & ((1ull << count) - 1));
+    consume_bits(count);
+    return value;
+}
+
+// Canonical Huffman decoding after stb_image: codes up to fast_bits long
+// resolve with one table lookup on the next bits; longer ones compare the
+// bit-reversed next 16 bits against the last code of each length.
+void InflateStream::build_huffman(Huffman& huffman, const uint8_t* code_lengths, uint32_t count) {
+    uint32_t length_counts[17] = {};
+    uint32_t next_code[16] = {};
+    memset(huffman.fast, 0, sizeof(huffman.fast));
+    for (uint32_t i = 0; i < count; i++) {
+        length_counts[code_lengths[i]]++;
+    }
+    length_counts[0] = 0;
+    for (uint32_t i = 1; i < 16; i++) {
+        if (length_counts[i] > (1u << i)) {
+            throw std::runtime_error("Invalid Huffman code lengths.");
+        }
+    }
+    uint32_t code = 0;
+    uint32_t symbol = 0;
+    for (uint32_t i = 1; i < 16; i++) {
+        next_code[i] = code;
+        huffman.first_code[i] = static_cast<uint16_t>(code);
+        huffman.first_symbol[i] = static_cast<uint16_t>(symbol);
+        code += length_counts[i];
+        if (length_counts[i] && code - 1 >= (1u << i)) {
+            throw std::runtime_error("Invalid Huffman code lengths.");
+        }
+        huffman.max_code[i] = code << (16 - i);
+        code <<= 1;
+        symbol += length_counts[i];
+    }
+    huffman.max_code[16] = 0x10000;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length = code_lengths[i];
+        if (length == 0) {
+            continue;
+        }
+        uint32_t index = next_code[length] - huffman.first_code[length] + huffman.first_symbol[length];
+        huffman.sizes[index] = static_cast<uint8_t>(length);
+        huffman.values[index] = static_cast<uint16_t>(i);
+        if (length <= fast_bits) {
+            uint16_t entry = static_cast<uint16_t>((length << 9) | i);
+            for (uint32_t j = reverse_bits(next_code[length], length); j < (1u << fast_bits); j += 1u << length) {
+                huffman.fast[j] = entry;
+            }
+        }
+        next_code[length]++;
+    }
+}
+
+int InflateStream::decode_symbol(const Huffman& huffman) {
+    if (bit_count < 16) {
+        fill_bits();
+    }
+    uint16_t entry = huffman.fast[bit_buffer & ((1u << fast_bits) - 1)];
+    if (entry) {
+        consume_bits(entry >> 9);
+        return entry & 511;
+    }
+    uint32_t reversed = reverse_bits(static_cast<uint32_t>(bit_buffer & 0xFFFF), 16);
+    uint32_t length = fast_bits + 1;
+    while (reversed >= huffman.max_code[length]) {
+        length++;
+    }
+    if (length >= 16) {
+        throw std::runtime_error("Invalid Huffman code.");
+    }
+    uint32_t index = (reversed >> (16 - length)) - huffman.first_code[length] + huffman.first_symbol[length];
+    if (index >= 288 || huffman.sizes[index] != length) {
+        throw std::runtime_error("Invalid Huffman code.");
+    }
+    consume_bits(length);
+    return huffman.values[index];
+}
+
+void InflateStream::read_dynamic_tables() {
+    uint32_t literal_count = read_bits(5) + 257;
+    uint32_t distance_count = read_bits(5) + 1;
+    uint32_t length_code_count = read_bits(4) + 4;
+    // The 5-bit counts reach 288 and 32, but only 286 and 30 codes exist.
+    if (literal_count > 286 || distance_count > 30) {
+        throw std::runtime_error("Invalid dynamic block code counts.");
+    }
+
+    uint8_t length_code_lengths[19] = {};
+    for (uint32_t i = 0; i < length_code_count; i++) {
+        length_code_lengths[code_length_order[i]] = static_cast<uint8_t>(read_bits(3));
+    }
+    Huffman length_codes;
+    build_huffman(length_codes, length_code_lengths, 19);
+
+    uint8_t lengths[286 + 30] = {};
+    uint32_t total = literal_count + distance_count;
+    uint32_t n = 0;
+    while (n < total) {
+        int symbol = decode_symbol(length_codes);
+        if (symbol < 16) {
+            lengths[n++] = static_cast<uint8_t>(symbol);
+            continue;
+        }
+        uint8_t value = 0;
+        uint32_t repeat;
+        if (symbol == 16) {
+            if (n == 0) {
+                throw std::runtime_error("Invalid code length repeat.");
+            }
+            value = lengths[n - 1];
+            repeat = read_bits(2) + 3;
+        } else if (symbol == 17) {
+            repeat = read_bits(3) + 3;
+        } else {
+            repeat = read_bits(7) + 11;
+        }
+        if (n + repeat > total) {
+            throw std::runtime_error("Invalid code length repeat.");
+        }
+        memset(lengths + n, value, repeat);
+        n += repeat;
+    }
+    build_huffman(literal_codes, lengths, literal_count);
+    build_huffman(distance_codes, lengths + literal_count, distance_count);
+}
+
+void InflateStream::start_block() {
+    bool final_block = read_bits(1) != 0;
+    uint32_t type = read_bits(2);
+    finished = final_block;
+    if (type == 0) {
+        read_bits(bit_count % 8);
+        uint32_t length = read_bits(16);
+        uint32_t inverse = read_bits(16);
+        if ((length ^ 0xFFFF) != inverse) {
+            throw std::runtime_error("Corrupt stored block.");
+        }
+        stored_remaining = length;
+    } else if (type == 1) {
+        uint8_t lengths[288 + 32];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        memset(lengths + 288, 5, 32);
+        build_huffman(literal_codes, lengths, 288);
+        build_huffman(distance_codes, lengths + 288, 32);
+        in_block = true;
+    } else if (type == 2) {
+        read_dynamic_tables();
+        in_block = true;
+    } else {
+        throw std::runtime_error("Invalid deflate block type.");
+    }
+}
+
+size_t InflateStream::read(uint8_t* dst, size_t size) {
+    const uint32_t mask = window_size - 1;
+    size_t produced = 0;
+    while (produced < size) {
+        if (match_length) {
+            size_t count = match_length < size - produced ? match_length : size - produced;
+            for (size_t i = 0; i < count; i++) {
+                uint8_t value = window[(window_position - match_distance) & mask];
+                window[window_position] = value;
+                window_position = (window_position + 1) & mask;
+                dst[produced++] = value;
+            }
+            match_length -= static_cast<uint32_t>(count);
+            total_output += count;
+            continue;
+        }
+        if (stored_remaining) {
+            uint8_t value = static_cast<uint8_t>(read_bits(8));
+            window[window_position] = value;
+            window_position = (window_position + 1) & mask;
+            dst[produced++] = value;
+            stored_remaining--;
+            total_output++;
+            continue;
+        }
+        if (!in_block) {
+            if (finished) {
+                break;
+            }
+            start_block();
+            continue;
+        }
+
+        int symbol = decode_symbol(literal_codes);
+        if (symbol < 256) {
+            window[window_position] = static_cast<uint8_t>(symbol);
+            window_position = (window_position + 1) & mask;
+            dst[produced++] = static_cast<uint8_t>(symbol);
+            total_output++;
+        } else if (symbol == 256) {
+            in_block = false;
+        } else {
+            symbol -= 257;
+            if (symbol >= 29) {
+                throw std::runtime_error("Invalid deflate length code.");
+            }
+            match_length = length_base[symbol] + read_bits(length_extra[symbol]);
+            int distance_symbol = decode_symbol(distance_codes);
+            if (distance_symbol >= 30) {
+                throw std::runtime_error("Invalid deflate distance code.");
+            }
+            match_distance = distance_base[distance_symbol] + read_bits(distance_extra[distance_symbol]);
+            if (match_distance > total_output) {
+                throw std::runtime_error("Deflate distance reaches before the stream.");
+            }
+        }
+    }
+    return produced;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Incremental zlib (RFC 1950/1951) decoder. Input is pulled through the read
+// function as needed and output is produced in whatever amounts the caller
+// asks for, so neither the compressed nor the decompressed stream has to be
+// held in full; memory is the 32 KB window plus a small input buffer.
+class InflateStream {
+public:
+    // Returns the number of bytes read; 0 means the input has ended.
+    using ReadFunction = std::function<size_t(uint8_t* dst, size_t size)>;
+
+    explicit InflateStream(ReadFunction read);
+
+    InflateStream(const InflateStream&) = delete;
+    InflateStream& operator=(const InflateStream&) = delete;
+
+    // Fills dst and returns size, or fewer bytes once the stream has ended.
+    // Throws std::runtime_error on corrupt or truncated data.
+    size_t read(uint8_t* dst, size_t size);
+    bool at_end() const { return finished && !in_block && match_length == 0 && stored_remaining == 0; }
+
+private:
+    struct Huffman {
+        uint16_t fast[1 << 9];
+        uint16_t first_code[16];
+        uint32_t max_code[17];
+        uint16_t first_symbol[16];
+        uint8_t sizes[288];
+        uint16_t values[288];
+    };
+
+    static void build_huffman(Huffman& huffman, const uint8_t* code_lengths, uint32_t count);
+    int decode_symbol(const Huffman& huffman);
+    uint32_t read_bits(uint32_t count);
+    void consume_bits(uint32_t count);
+    void fill_bits();
+    uint8_t read_byte();
+    void start_block();
+    void read_dynamic_tables();
+
+    ReadFunction source;
+    std::vector<uint8_t> input;
+    size_t input_position;
+    size_t input_size;
+    bool input_ended;
+
+    uint64_t bit_buffer;
+    uint32_t bit_count;
+    uint32_t padded_bits;
+
+    std::vector<uint8_t> window;
+    uint32_t window_position;
+    uint64_t total_output;
+
+    Huffman literal_codes;
+    Huffman distance_codes;
+    bool in_block;
+    // Set once the final block has started; its data may still be pending.
+    bool finished;
+    uint32_t stored_remaining;
+    uint32_t match_length;
+    uint32_t match_distance;
+};
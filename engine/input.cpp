@@ -0,0 +1,169 @@
+#include "input.hpp"
+#include <cstring>
+#include <stdexcept>
+
+static const char input_file_magic[4] = {'B', 'N', 'J', 'I'};
+static const uint32_t input_file_version = 1;
+
+struct InputFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t step_ns;
+};
+
+struct InputFileRecord {
+    uint64_t tick;
+    int64_t time_ns;
+    uint8_t type;
+    uint8_t key;
+    uint16_t reserved0;
+    int32_t dx;
+    int32_t dy;
+    uint32_t reserved1;
+};
+
+static_assert(sizeof(InputFileHeader) == 16, "Input file header layout changed.");
+static_assert(sizeof(InputFileRecord) == 32, "Input file record layout changed.");
+
+InputEventRing::InputEventRing() : events(), read_index(0), write_index(0), dropped(0) {}
+
+bool InputEventRing::push(const InputEvent& event) {
+    uint32_t write = write_index.load(std::memory_order_relaxed);
+    if (write - read_index.load(std::memory_order_acquire) == capacity) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    events[write % capacity] = event;
+    write_index.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+bool InputEventRing::pop(InputEvent& event) {
+    uint32_t read = read_index.load(std::memory_order_relaxed);
+    if (read == write_index.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events[read % capacity];
+    read_index.store(read + 1, std::memory_order_release);
+    return true;
+}
+
+InputState::InputState() : keys_down(), mouse_dx(0), mouse_dy(0) {}
+
+void InputState::apply(const InputEvent& event) {
+    switch (event.type) {
+        case InputEventType::key_down:
+            keys_down[event.key] = true;
+            break;
+        case InputEventType::key_up:
+            keys_down[event.key] = false;
+            break;
+        case InputEventType::mouse_move:
+            mouse_dx += event.dx;
+            mouse_dy += event.dy;
+            break;
+        case InputEventType::focus_lost:
+            memset(keys_down, 0, sizeof(keys_down));
+            break;
+    }
+}
+
+void InputState::take_mouse_delta(int32_t& dx, int32_t& dy) {
+    dx = mouse_dx;
+    dy = mouse_dy;
+    mouse_dx = 0;
+    mouse_dy = 0;
+}
+
+InputRecorder::InputRecorder(const std::string& path, uint64_t step_ns) : path(path), first_time(0), has_first_time(false) {
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Failed to create input recording " + path + ".");
+    }
+    InputFileHeader header = {};
+    memcpy(header.magic, input_file_magic, sizeof(header.magic));
+    header.version = input_file_version;
+    header.step_ns = step_ns;
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        throw std::runtime_error("Failed to write input recording " + path + ".");
+    }
+}
+
+InputRecorder::~InputRecorder() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+void InputRecorder::write(uint64_t tick, const InputEvent& event) {
+    if (!has_first_time) {
+        first_time = event.time;
+        has_first_time = true;
+    }
+    InputFileRecord record = {};
+    record.tick = tick;
+    record.time_ns = event.time - first_time;
+    record.type = static_cast<uint8_t>(event.type);
+    record.key = event.key;
+    record.dx = event.dx;
+    record.dy = event.dy;
+    if (!file) {
+        throw std::runtime_error("Input recording " + path + " is closed.");
+    }
+    if (fwrite(&record, sizeof(record), 1, file) != 1) {
+        throw std::runtime_error("Failed to write input recording " + path + ".");
+    }
+}
+
+void InputRecorder::close() {
+    if (!file) {
+        return;
+    }
+    // Buffered records only reach the disk here; fclose reports the
+    // failure of that last flush.
+    int result = fclose(file);
+    file = nullptr;
+    if (result != 0) {
+        throw std::runtime_error("Failed to write input recording " + path + ".");
+    }
+}
+
+InputReplay::InputReplay(const std::string& path) : next_record(0), step_ns(0) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Failed to open input recording " + path + ".");
+    }
+    InputFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, input_file_magic, sizeof(header.magic)) != 0 ||
+        header.version != input_file_version) {
+        fclose(file);
+        throw std::runtime_error(path + " is not an input recording.");
+    }
+    step_ns = header.step_ns;
+
+    InputFileRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.type > static_cast<uint8_t>(InputEventType::focus_lost) || (!records.empty() && record.tick < records.back().tick)) {
+            fclose(file);
+            throw std::runtime_error("Input recording " + path + " is corrupt.");
+        }
+        Record loaded;
+        loaded.tick = record.tick;
+        loaded.event.time = record.time_ns;
+        loaded.event.type = static_cast<InputEventType>(record.type);
+        loaded.event.key = record.key;
+        loaded.event.dx = record.dx;
+        loaded.event.dy = record.dy;
+        records.push_back(loaded);
+    }
+    fclose(file);
+}
+
+bool InputReplay::next(uint64_t tick, InputEvent& event) {
+    if (next_record == records.size() || records[next_record].tick > tick) {
+        return false;
+    }
+    event = records[next_record++].event;
+    return true;
+}
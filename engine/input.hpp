@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class InputEventType : uint8_t {
+    key_down,
+    key_up,
+    mouse_move,
+    // Keys held when focus went are never released; forget them.
+    focus_lost
+};
+
+struct InputEvent {
+    // Nanoseconds on a monotonic clock, taken when the event arrived.
+    int64_t time;
+    InputEventType type;
+    // Virtual-key code, for key events.
+    uint8_t key;
+    // Raw relative motion in counts, for mouse_move.
+    int32_t dx;
+    int32_t dy;
+};
+
+// Lock-free ring for one producing and one consuming thread. The window
+// procedure pushes events as they arrive; the simulation pops them all
+// just before it needs them.
+class InputEventRing {
+public:
+    static const uint32_t capacity = 1024;
+
+    InputEventRing();
+
+    // False, and the event is dropped, when the consumer is a full ring behind.
+    bool push(const InputEvent& event);
+    bool pop(InputEvent& event);
+
+    uint64_t get_dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    InputEvent events[capacity];
+    alignas(64) std::atomic<uint32_t> read_index;
+    alignas(64) std::atomic<uint32_t> write_index;
+    std::atomic<uint64_t> dropped;
+};
+
+// Keys held and mouse motion not yet consumed, built up from events.
+class InputState {
+public:
+    InputState();
+
+    void apply(const InputEvent& event);
+    bool is_key_down(uint8_t key) const { return keys_down[key]; }
+    // Motion since the last call.
+    void take_mouse_delta(int32_t& dx, int32_t& dy);
+
+private:
+    bool keys_down[256];
+    int32_t mouse_dx;
+    int32_t mouse_dy;
+};
+
+// Input replay files tag every event with the simulation tick it was
+// applied before, so replaying them reproduces the run tick for tick
+// however the frames fall. Layout, little-endian: the header, then one
+// 32-byte record per event.
+//
+//     char magic[4] = "BNJI"; uint32_t version = 1; uint64_t step_ns;
+//     { uint64_t tick; int64_t time_ns; uint8_t type; uint8_t key;
+//       uint16_t reserved; int32_t dx; int32_t dy; uint32_t reserved; }
+//
+// Times are relative to the first event and only informative.
+class InputRecorder {
+public:
+    // Throws std::runtime_error if the file cannot be created.
+    InputRecorder(const std::string& path, uint64_t step_ns);
+    // Closes without checking; call close to find out whether the
+    // recording was complete.
+    ~InputRecorder();
+
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    // Both throw std::runtime_error if the file cannot be written, so a full
+    // disk does not leave a truncated recording unnoticed.
+    void write(uint64_t tick, const InputEvent& event);
+    void close();
+
+private:
+    std::string path;
+    FILE* file;
+    int64_t first_time;
+    bool has_first_time;
+};
+
+class InputReplay {
+public:
+    // Throws std::runtime_error if the file is missing or malformed.
+    explicit InputReplay(const std::string& path);
+
+    // The next event applied before tick, in recorded order; false once
+    // the next one belongs to a later tick.
+    bool next(uint64_t tick, InputEvent& event);
+    bool is_finished() const { return next_record == records.size(); }
+    uint64_t get_step_ns() const { return step_ns; }
+
+private:
+    struct Record {
+        uint64_t tick;
+        InputEvent event;
+    };
+
+    std::vector<Record> records;
+    size_t next_record;
+    uint64_t step_ns;
+};
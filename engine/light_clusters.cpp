@@ -0,0 +1,193 @@
+#include "light_clusters.hpp"
+#include "job_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+LightClusterer::LightClusterer(const ClusterGridDesc& desc) :
+    desc(desc), near_plane(0.1f), far_plane(100.0f), depth_scale(0.0f), depth_bias(0.0f), truncated(false)
+{
+    tiles_per_slice = desc.tiles_x * desc.tiles_y;
+    padded_tiles_per_slice = (tiles_per_slice + 3) & ~3u;
+
+    size_t bounds_size = static_cast<size_t>(padded_tiles_per_slice) * desc.slices_z;
+    bounds_min_x.resize(bounds_size);
+    bounds_min_y.resize(bounds_size);
+    bounds_max_x.resize(bounds_size);
+    bounds_max_y.resize(bounds_size);
+    slice_near.resize(desc.slices_z);
+    slice_far.resize(desc.slices_z);
+
+    slice_bins.resize(desc.slices_z);
+    for (SliceBin& bin : slice_bins) {
+        bin.counts.resize(padded_tiles_per_slice);
+        bin.truncated = false;
+    }
+    cluster_ranges.resize(get_cluster_count());
+}
+
+LightClusterer::~LightClusterer() {}
+
+void LightClusterer::set_projection(float fov, float aspect_ratio, float near_plane, float far_plane) {
+    this->near_plane = near_plane;
+    this->far_plane = far_plane;
+
+    float log_ratio = std::log(far_plane / near_plane);
+    depth_scale = desc.slices_z / log_ratio;
+    depth_bias = -static_cast<float>(desc.slices_z) * std::log(near_plane) / log_ratio;
+
+    float tan_y = std::tan(fov * 0.5f);
+    float tan_x = tan_y * aspect_ratio;
+
+    for (uint32_t k = 0; k < desc.slices_z; ++k) {
+        float z0 = near_plane * std::pow(far_plane / near_plane, static_cast<float>(k) / desc.slices_z);
+        float z1 = near_plane * std::pow(far_plane / near_plane, static_cast<float>(k + 1) / desc.slices_z);
+        slice_near[k] = z0;
+        slice_far[k] = z1;
+
+        size_t base = static_cast<size_t>(k) * padded_tiles_per_slice;
+        for (uint32_t t = 0; t < padded_tiles_per_slice; ++t) {
+            if (t >= tiles_per_slice) {
+                // Inverted bounds never pass the overlap test.
+                bounds_min_x[base + t] = 1e30f;
+                bounds_max_x[base + t] = -1e30f;
+                bounds_min_y[base + t] = 1e30f;
+                bounds_max_y[base + t] = -1e30f;
+                continue;
+            }
+            uint32_t i = t % desc.tiles_x;
+            uint32_t j = t / desc.tiles_x;
+
+            // Tile rows count down from the top of the screen, NDC y counts up.
+            float ndc_x0 = -1.0f + 2.0f * i / desc.tiles_x;
+            float ndc_x1 = -1.0f + 2.0f * (i + 1) / desc.tiles_x;
+            float ndc_y0 = 1.0f - 2.0f * (j + 1) / desc.tiles_y;
+            float ndc_y1 = 1.0f - 2.0f * j / desc.tiles_y;
+
+            float xs[4] = { ndc_x0 * tan_x * z0, ndc_x1 * tan_x * z0, ndc_x0 * tan_x * z1, ndc_x1 * tan_x * z1 };
+            float ys[4] = { ndc_y0 * tan_y * z0, ndc_y1 * tan_y * z0, ndc_y0 * tan_y * z1, ndc_y1 * tan_y * z1 };
+            bounds_min_x[base + t] = *std::min_element(xs, xs + 4);
+            bounds_max_x[base + t] = *std::max_element(xs, xs + 4);
+            bounds_min_y[base + t] = *std::min_element(ys, ys + 4);
+            bounds_max_y[base + t] = *std::max_element(ys, ys + 4);
+        }
+    }
+}
+
+void LightClusterer::bin(const float* view_matrix, const ClusterLight* lights, uint32_t light_count, JobPool* job_pool) {
+    const float* m = view_matrix;
+
+    view_lights.resize(static_cast<size_t>(light_count) * 4);
+    for (uint32_t l = 0; l < light_count; ++l) {
+        const float* p = lights[l].position;
+        float* v = &view_lights[static_cast<size_t>(l) * 4];
+        v[0] = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
+        v[1] = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
+        v[2] = p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14];
+        v[3] = lights[l].range;
+    }
+
+    auto bin_range = [this, light_count](uint32_t begin, uint32_t end) {
+        for (uint32_t k = begin; k < end; ++k) {
+            bin_slice(k, light_count);
+        }
+    };
+    if (job_pool) {
+        job_pool->parallel_for(desc.slices_z, 1, bin_range);
+    } else {
+        bin_range(0, desc.slices_z);
+    }
+
+    // Compact the per-slice lists into one index buffer in cluster order.
+    truncated = false;
+    uint32_t offset = 0;
+    light_indices.clear();
+    for (uint32_t k = 0; k < desc.slices_z; ++k) {
+        SliceBin& bin = slice_bins[k];
+        truncated |= bin.truncated;
+        const uint32_t* src = bin.indices.data();
+        for (uint32_t t = 0; t < tiles_per_slice; ++t) {
+            uint32_t count = bin.counts[t];
+            if (offset + count > desc.max_light_indices) {
+                count = desc.max_light_indices - offset;
+                truncated = true;
+            }
+            cluster_ranges[k * tiles_per_slice + t] = { offset, count };
+            light_indices.insert(light_indices.end(), src, src + count);
+            src += bin.counts[t];
+            offset += count;
+        }
+    }
+}
+
+void LightClusterer::bin_slice(uint32_t slice, uint32_t light_count) {
+    SliceBin& bin = slice_bins[slice];
+    bin.candidates.clear();
+    bin.truncated = false;
+
+    float z0 = slice_near[slice];
+    float z1 = slice_far[slice];
+    for (uint32_t l = 0; l < light_count; ++l) {
+        const float* v = &view_lights[static_cast<size_t>(l) * 4];
+        if (v[2] + v[3] >= z0 && v[2] - v[3] <= z1) {
+            bin.candidates.push_back(l);
+        }
+    }
+
+    // Gather per tile first so each cluster's list ends up contiguous.
+    const uint32_t cap = desc.max_lights_per_cluster;
+    std::vector<uint32_t>& indices = bin.indices;
+    indices.resize(static_cast<size_t>(padded_tiles_per_slice) * cap);
+    std::fill(bin.counts.begin(), bin.counts.end(), 0u);
+
+    size_t base = static_cast<size_t>(slice) * padded_tiles_per_slice;
+    const float* min_x = &bounds_min_x[base];
+    const float* min_y = &bounds_min_y[base];
+    const float* max_x = &bounds_max_x[base];
+    const float* max_y = &bounds_max_y[base];
+    const __m128 zero = _mm_setzero_ps();
+
+    for (uint32_t l : bin.candidates) {
+        const float* v = &view_lights[static_cast<size_t>(l) * 4];
+        float dz = std::max(std::max(z0 - v[2], v[2] - z1), 0.0f);
+        float radius_sq = v[3] * v[3] - dz * dz;
+        if (radius_sq < 0.0f) {
+            continue;
+        }
+        const __m128 cx = _mm_set1_ps(v[0]);
+        const __m128 cy = _mm_set1_ps(v[1]);
+        const __m128 rsq = _mm_set1_ps(radius_sq);
+
+        for (uint32_t t = 0; t < padded_tiles_per_slice; t += 4) {
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_x + t), cx), _mm_sub_ps(cx, _mm_loadu_ps(max_x + t))), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_y + t), cy), _mm_sub_ps(cy, _mm_loadu_ps(max_y + t))), zero);
+            __m128 dist_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(dist_sq, rsq));
+            while (mask) {
+                uint32_t lane = 0;
+                while (!(mask & (1 << lane))) {
+                    ++lane;
+                }
+                mask &= mask - 1;
+                uint32_t tile = t + lane;
+                uint32_t& count = bin.counts[tile];
+                if (count < cap) {
+                    indices[static_cast<size_t>(tile) * cap + count++] = l;
+                } else {
+                    bin.truncated = true;
+                }
+            }
+        }
+    }
+
+    // Squeeze out the unused tail of each tile's slot.
+    uint32_t write = 0;
+    for (uint32_t t = 0; t < tiles_per_slice; ++t) {
+        uint32_t count = bin.counts[t];
+        const uint32_t* src = &indices[static_cast<size_t>(t) * cap];
+        if (write != t * cap) {
+            std::copy(src, src + count, indices.begin() + write);
+        }
+        write += count;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class JobPool;
+
+// Matches the Light struct in shaders.hlsl. A spot_cos_outer of -1 or less
+// marks a point light.
+struct ClusterLight {
+    float position[3];
+    float range;
+    float color[3];
+    float intensity;
+    float direction[3];
+    float spot_cos_outer;
+    float spot_cos_inner;
+    float padding[3];
+};
+
+struct ClusterRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct ClusterGridDesc {
+    uint32_t tiles_x = 16;
+    uint32_t tiles_y = 9;
+    uint32_t slices_z = 24;
+    uint32_t max_lights_per_cluster = 128;
+    uint32_t max_light_indices = 16 * 9 * 24 * 32;
+};
+
+// Bins lights into a froxel grid over the camera frustum. Tiles are uniform in
+// screen space and slices are exponential in view depth, so the pixel shader
+// can locate its cluster from SV_Position and view-space z alone.
+class LightClusterer {
+public:
+    explicit LightClusterer(const ClusterGridDesc& desc = ClusterGridDesc());
+    ~LightClusterer();
+
+    void set_projection(float fov, float aspect_ratio, float near_plane, float far_plane);
+
+    // view_matrix is row-major with row vectors, as stored from an XMMATRIX.
+    void bin(const float* view_matrix, const ClusterLight* lights, uint32_t light_count, JobPool* job_pool);
+
+    const ClusterGridDesc& get_desc() const { return desc; }
+    uint32_t get_cluster_count() const { return desc.tiles_x * desc.tiles_y * desc.slices_z; }
+    const std::vector<ClusterRange>& get_cluster_ranges() const { return cluster_ranges; }
+    const std::vector<uint32_t>& get_light_indices() const { return light_indices; }
+    bool was_truncated() const { return truncated; }
+
+    // slice = log(view_z) * depth_scale + depth_bias
+    float get_depth_scale() const { return depth_scale; }
+    float get_depth_bias() const { return depth_bias; }
+
+private:
+    struct SliceBin {
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> counts;
+        bool truncated;
+    };
+
+    void bin_slice(uint32_t slice, uint32_t light_count);
+
+    ClusterGridDesc desc;
+    uint32_t tiles_per_slice;
+    uint32_t padded_tiles_per_slice;
+    float near_plane;
+    float far_plane;
+    float depth_scale;
+    float depth_bias;
+
+    // Per-slice cluster bounds in view space, stored SoA and padded to a
+    // multiple of four so the sphere test runs four clusters per iteration.
+    std::vector<float> bounds_min_x;
+    std::vector<float> bounds_min_y;
+    std::vector<float> bounds_max_x;
+    std::vector<float> bounds_max_y;
+    std::vector<float> slice_near;
+    std::vector<float> slice_far;
+
+    std::vector<float> view_lights;
+    std::vector<SliceBin> slice_bins;
+    std::vector<ClusterRange> cluster_ranges;
+    std::vector<uint32_t> light_indices;
+    bool truncated;
+};
@@ -0,0 +1,92 @@
+#include "mapped_file.hpp"
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0), file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr) {
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size)) {
+        CloseHandle(file_handle);
+        throw std::runtime_error("Failed to query file size: " + path);
+    }
+    size = static_cast<size_t>(file_size.QuadPart);
+    if (size == 0) {
+        return;
+    }
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle) {
+        CloseHandle(file_handle);
+        throw std::runtime_error("Failed to create file mapping: " + path);
+    }
+    data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!data) {
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0), file_descriptor(-1) {
+    file_descriptor = open(path.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    struct stat info;
+    if (fstat(file_descriptor, &info) != 0) {
+        close(file_descriptor);
+        throw std::runtime_error("Failed to query file size: " + path);
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        return;
+    }
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    if (mapping == MAP_FAILED) {
+        close(file_descriptor);
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    if (file_descriptor >= 0) {
+        close(file_descriptor);
+    }
+}
+
+#endif
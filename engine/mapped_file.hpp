@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the
+// object, so pointers into it can be handed straight to upload copies.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* get_data() const { return data; }
+    size_t get_size() const { return size; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+#if defined(_WIN32)
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int file_descriptor;
+#endif
+};
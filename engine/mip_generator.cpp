@@ -0,0 +1,407 @@
+#include "mip_generator.hpp"
+#include "job_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace {
+
+const float kaiser_radius = 1.5f;
+const float kaiser_alpha = 4.0f;
+
+struct Tap {
+    int32_t start;
+    uint32_t count;
+    uint32_t first_weight;
+};
+
+// The filter's support grows with the downsampling ratio, and non-power-of-two
+// sizes give ratios above 2, so each destination texel gets as many weights
+// as its support covers.
+struct TapTable {
+    std::vector<Tap> taps;
+    std::vector<float> weights;
+
+    const float* get_weights(const Tap& tap) const { return weights.data() + tap.first_weight; }
+};
+
+struct ColorTables {
+    float srgb_to_linear[256];
+    float unorm_to_float[256];
+    uint8_t linear_to_srgb[65536];
+
+    ColorTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            unorm_to_float[i] = c;
+        }
+        for (uint32_t i = 0; i < 65536; ++i) {
+            float l = i / 65535.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            linear_to_srgb[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+const ColorTables& get_color_tables() {
+    static const ColorTables tables;
+    return tables;
+}
+
+float bessel_i0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 20; ++k) {
+        term *= (x * 0.5f / k) * (x * 0.5f / k);
+        sum += term;
+    }
+    return sum;
+}
+
+float evaluate_filter(MipFilter filter, float x) {
+    float ax = std::fabs(x);
+    if (filter == MipFilter::box) {
+        return ax <= 0.5f ? 1.0f : 0.0f;
+    }
+    if (ax >= kaiser_radius) {
+        return 0.0f;
+    }
+    float sinc = ax < 1e-5f ? 1.0f : std::sin(3.14159265f * x) / (3.14159265f * x);
+    float t = x / kaiser_radius;
+    return sinc * bessel_i0(kaiser_alpha * std::sqrt(1.0f - t * t)) / bessel_i0(kaiser_alpha);
+}
+
+// Weights are evaluated in destination texel units at source texel centers.
+TapTable build_taps(MipFilter filter, uint32_t src_size, uint32_t dst_size) {
+    TapTable table;
+    table.taps.resize(dst_size);
+    float scale = static_cast<float>(src_size) / dst_size;
+    float support = (filter == MipFilter::box ? 0.5f : kaiser_radius) * scale;
+    table.weights.reserve(static_cast<size_t>(dst_size) * (static_cast<size_t>(std::ceil(support * 2.0f)) + 3));
+
+    for (uint32_t d = 0; d < dst_size; ++d) {
+        Tap& tap = table.taps[d];
+        float center = (d + 0.5f) * scale;
+        int32_t first = static_cast<int32_t>(std::floor(center - support));
+        int32_t last = static_cast<int32_t>(std::ceil(center + support));
+
+        tap.start = first;
+        tap.count = 0;
+        tap.first_weight = static_cast<uint32_t>(table.weights.size());
+        float total = 0.0f;
+        for (int32_t s = first; s <= last; ++s) {
+            float w = evaluate_filter(filter, (s + 0.5f - center) / scale);
+            if (tap.count == 0 && w == 0.0f) {
+                continue;
+            }
+            if (tap.count == 0) {
+                tap.start = s;
+            }
+            table.weights.push_back(w);
+            tap.count++;
+            total += w;
+        }
+        while (tap.count > 1 && table.weights.back() == 0.0f) {
+            table.weights.pop_back();
+            --tap.count;
+        }
+        for (uint32_t i = 0; i < tap.count; ++i) {
+            table.weights[tap.first_weight + i] /= total;
+        }
+    }
+    return table;
+}
+
+inline uint32_t wrap(int32_t i, uint32_t size) {
+    int32_t m = i % static_cast<int32_t>(size);
+    return static_cast<uint32_t>(m < 0 ? m + static_cast<int32_t>(size) : m);
+}
+
+// Source for one level: either the 8-bit input image or the float level
+// produced by the previous pass.
+struct SourceLevel {
+    const uint8_t* unorm;
+    const float* linear;
+    uint32_t width;
+    uint32_t height;
+    const float* decode_table;
+};
+
+const float* fetch_row(const SourceLevel& src, uint32_t y, float* scratch) {
+    if (src.linear) {
+        return src.linear + static_cast<size_t>(y) * src.width * 4;
+    }
+    const uint8_t* row = src.unorm + static_cast<size_t>(y) * src.width * 4;
+    const float* alpha_table = get_color_tables().unorm_to_float;
+    for (uint32_t x = 0; x < src.width; ++x) {
+        scratch[x * 4 + 0] = src.decode_table[row[x * 4 + 0]];
+        scratch[x * 4 + 1] = src.decode_table[row[x * 4 + 1]];
+        scratch[x * 4 + 2] = src.decode_table[row[x * 4 + 2]];
+        scratch[x * 4 + 3] = alpha_table[row[x * 4 + 3]];
+    }
+    return scratch;
+}
+
+void encode_pixel(__m128 color, bool srgb, uint8_t* out) {
+    const ColorTables& tables = get_color_tables();
+    color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    alignas(16) int32_t q[4];
+    if (srgb) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(q), _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set_ps(255.0f, 65535.0f, 65535.0f, 65535.0f))));
+        out[0] = tables.linear_to_srgb[q[0]];
+        out[1] = tables.linear_to_srgb[q[1]];
+        out[2] = tables.linear_to_srgb[q[2]];
+        out[3] = static_cast<uint8_t>(q[3]);
+    } else {
+        __m128i v = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f)));
+        v = _mm_packs_epi32(v, v);
+        v = _mm_packus_epi16(v, v);
+        int32_t packed = _mm_cvtsi128_si32(v);
+        memcpy(out, &packed, 4);
+    }
+}
+
+void downsample_rows(
+    const SourceLevel& src,
+    uint32_t dst_width,
+    const TapTable& taps_x,
+    const TapTable& taps_y,
+    uint32_t row_begin,
+    uint32_t row_end,
+    bool srgb,
+    uint8_t* dst_unorm,
+    float* dst_linear
+) {
+    std::vector<float> fetch_scratch(static_cast<size_t>(src.width) * 4);
+    std::vector<float> column(static_cast<size_t>(src.width) * 4);
+
+    for (uint32_t y = row_begin; y < row_end; ++y) {
+        // Vertical pass into one source-width row, then horizontal into the
+        // destination. Keeps scratch to two rows regardless of image height.
+        const Tap& ty = taps_y.taps[y];
+        const float* weights_y = taps_y.get_weights(ty);
+        std::fill(column.begin(), column.end(), 0.0f);
+        for (uint32_t t = 0; t < ty.count; ++t) {
+            const float* row = fetch_row(src, wrap(ty.start + static_cast<int32_t>(t), src.height), fetch_scratch.data());
+            __m128 w = _mm_set1_ps(weights_y[t]);
+            for (uint32_t x = 0; x < src.width; ++x) {
+                __m128 acc = _mm_loadu_ps(&column[x * 4]);
+                acc = _mm_add_ps(acc, _mm_mul_ps(w, _mm_loadu_ps(row + x * 4)));
+                _mm_storeu_ps(&column[x * 4], acc);
+            }
+        }
+
+        for (uint32_t x = 0; x < dst_width; ++x) {
+            const Tap& tx = taps_x.taps[x];
+            const float* weights_x = taps_x.get_weights(tx);
+            __m128 acc = _mm_setzero_ps();
+            for (uint32_t t = 0; t < tx.count; ++t) {
+                uint32_t sx = wrap(tx.start + static_cast<int32_t>(t), src.width);
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights_x[t]), _mm_loadu_ps(&column[sx * 4])));
+            }
+            size_t index = static_cast<size_t>(y) * dst_width + x;
+            if (dst_linear) {
+                _mm_storeu_ps(dst_linear + index * 4, acc);
+            }
+            encode_pixel(acc, srgb, dst_unorm + index * 4);
+        }
+    }
+}
+
+}
+
+uint32_t get_mip_level_count(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    uint32_t size = std::max(width, height);
+    while (size > 1) {
+        size >>= 1;
+        ++levels;
+    }
+    return levels;
+}
+
+void allocate_mip_chain(uint32_t width, uint32_t height, MipChain& out) {
+    uint32_t level_count = get_mip_level_count(width, height);
+    out.levels.resize(level_count);
+
+    size_t total = 0;
+    for (uint32_t i = 0; i < level_count; ++i) {
+        MipLevel& level = out.levels[i];
+        level.width = std::max(width >> i, 1u);
+        level.height = std::max(height >> i, 1u);
+        level.offset = total;
+        total += static_cast<size_t>(level.width) * level.height * 4;
+    }
+    out.pixels.resize(total);
+}
+
+void generate_mip_chain(
+    const uint8_t* rgba,
+    uint32_t width,
+    uint32_t height,
+    MipFilter filter,
+    bool srgb,
+    JobPool* job_pool,
+    MipChain& out
+) {
+    allocate_mip_chain(width, height, out);
+    memcpy(out.pixels.data(), rgba, static_cast<size_t>(width) * height * 4);
+    build_mip_chain(filter, srgb, job_pool, out);
+}
+
+void build_mip_chain(MipFilter filter, bool srgb, JobPool* job_pool, MipChain& out) {
+    uint32_t level_count = static_cast<uint32_t>(out.levels.size());
+    uint32_t width = out.levels[0].width;
+    uint32_t height = out.levels[0].height;
+    const uint8_t* rgba = out.pixels.data();
+
+    const ColorTables& tables = get_color_tables();
+    SourceLevel src = { rgba, nullptr, width, height, srgb ? tables.srgb_to_linear : tables.unorm_to_float };
+    std::vector<float> src_linear;
+    std::vector<float> dst_linear;
+
+    for (uint32_t i = 1; i < level_count; ++i) {
+        const MipLevel& level = out.levels[i];
+        bool keep_linear = i + 1 < level_count;
+        dst_linear.resize(keep_linear ? static_cast<size_t>(level.width) * level.height * 4 : 0);
+
+        TapTable taps_x = build_taps(filter, src.width, level.width);
+        TapTable taps_y = build_taps(filter, src.height, level.height);
+        uint8_t* dst_unorm = out.pixels.data() + level.offset;
+        float* dst_linear_ptr = keep_linear ? dst_linear.data() : nullptr;
+
+        auto rows = [&](uint32_t begin, uint32_t end) {
+            downsample_rows(src, level.width, taps_x, taps_y, begin, end, srgb, dst_unorm, dst_linear_ptr);
+        };
+        // Aim for chunks of roughly 64K source texels so small levels stay on one thread.
+        uint32_t grain = std::max(1u, (1u << 16) / std::max(src.width * 2, 1u));
+        if (job_pool) {
+            job_pool->parallel_for(level.height, grain, rows);
+        } else {
+            rows(0, level.height);
+        }
+
+        src_linear.swap(dst_linear);
+        src = { nullptr, src_linear.data(), level.width, level.height, nullptr };
+    }
+}
+
+void allocate_float_mip_chain(uint32_t width, uint32_t height, FloatMipChain& out) {
+    uint32_t level_count = get_mip_level_count(width, height);
+    out.levels.resize(level_count);
+
+    size_t total = 0;
+    for (uint32_t i = 0; i < level_count; ++i) {
+        MipLevel& level = out.levels[i];
+        level.width = std::max(width >> i, 1u);
+        level.height = std::max(height >> i, 1u);
+        level.offset = total;
+        total += static_cast<size_t>(level.width) * level.height * 4;
+    }
+    out.pixels.resize(total);
+}
+
+void build_float_mip_chain(JobPool* job_pool, FloatMipChain& out) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (size_t i = 1; i < out.levels.size(); ++i) {
+        const MipLevel& src_level = out.levels[i - 1];
+        const MipLevel& level = out.levels[i];
+        const float* src = out.pixels.data() + src_level.offset;
+        float* dst = out.pixels.data() + level.offset;
+
+        // Odd sizes clamp the second tap to the last row or column.
+        auto rows = [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = begin; y < end; ++y) {
+                const float* row0 = src + static_cast<size_t>(std::min(y * 2, src_level.height - 1)) * src_level.width * 4;
+                const float* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, src_level.height - 1)) * src_level.width * 4;
+                float* out_row = dst + static_cast<size_t>(y) * level.width * 4;
+                for (uint32_t x = 0; x < level.width; ++x) {
+                    uint32_t x0 = std::min(x * 2, src_level.width - 1) * 4;
+                    uint32_t x1 = std::min(x * 2 + 1, src_level.width - 1) * 4;
+                    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+                                            _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+                    _mm_storeu_ps(out_row + x * 4, _mm_mul_ps(sum, quarter));
+                }
+            }
+        };
+        uint32_t grain = std::max(1u, (1u << 16) / std::max(src_level.width * 2, 1u));
+        if (job_pool) {
+            job_pool->parallel_for(level.height, grain, rows);
+        } else {
+            rows(0, level.height);
+        }
+    }
+}
+
+MipRowBuilder::MipRowBuilder(uint32_t width, uint32_t height, bool srgb, RowSink sink) : srgb(srgb), sink(std::move(sink)) {
+    uint32_t level_count = get_mip_level_count(width, height);
+    levels.resize(level_count);
+    for (uint32_t i = 0; i < level_count; ++i) {
+        Level& level = levels[i];
+        level.width = std::max(width >> i, 1u);
+        level.height = std::max(height >> i, 1u);
+        level.rows_done = 0;
+        level.has_pending = false;
+        if (i > 0) {
+            level.pending.resize(static_cast<size_t>(levels[i - 1].width) * 4);
+            level.linear.resize(static_cast<size_t>(level.width) * 4);
+            level.encoded.resize(static_cast<size_t>(level.width) * 4);
+        }
+    }
+    decoded.resize(static_cast<size_t>(width) * 4);
+}
+
+void MipRowBuilder::push_row(const uint8_t* rgba) {
+    Level& top = levels[0];
+    uint32_t row = top.rows_done++;
+    sink(0, row, rgba);
+    if (levels.size() == 1) {
+        return;
+    }
+    const ColorTables& tables = get_color_tables();
+    const float* decode_table = srgb ? tables.srgb_to_linear : tables.unorm_to_float;
+    for (uint32_t i = 0; i < top.width * 4; i += 4) {
+        decoded[i + 0] = decode_table[rgba[i + 0]];
+        decoded[i + 1] = decode_table[rgba[i + 1]];
+        decoded[i + 2] = decode_table[rgba[i + 2]];
+        decoded[i + 3] = tables.unorm_to_float[rgba[i + 3]];
+    }
+    push_linear(1, row, decoded.data());
+}
+
+void MipRowBuilder::push_linear(uint32_t index, uint32_t parent_row, const float* row) {
+    Level& level = levels[index];
+    const Level& parent = levels[index - 1];
+    const float* upper = row;
+    if (parent.height > 1) {
+        if (parent_row % 2 == 0) {
+            // A trailing odd row has no partner and no destination.
+            if (parent_row / 2 < level.height) {
+                memcpy(level.pending.data(), row, level.pending.size() * sizeof(float));
+                level.has_pending = true;
+            }
+            return;
+        }
+        upper = level.pending.data();
+        level.has_pending = false;
+    }
+
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (uint32_t x = 0; x < level.width; ++x) {
+        uint32_t x0 = std::min(x * 2, parent.width - 1) * 4;
+        uint32_t x1 = std::min(x * 2 + 1, parent.width - 1) * 4;
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(upper + x0), _mm_loadu_ps(upper + x1)),
+                                _mm_add_ps(_mm_loadu_ps(row + x0), _mm_loadu_ps(row + x1)));
+        __m128 color = _mm_mul_ps(sum, quarter);
+        _mm_storeu_ps(level.linear.data() + x * 4, color);
+        encode_pixel(color, srgb, level.encoded.data() + x * 4);
+    }
+
+    uint32_t out_row = level.rows_done++;
+    sink(index, out_row, level.encoded.data());
+    if (index + 1 < levels.size()) {
+        push_linear(index + 1, out_row, level.linear.data());
+    }
+}
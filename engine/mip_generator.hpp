@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class JobPool;
+
+enum class MipFilter {
+    box,
+    kaiser
+};
+
+struct MipLevel {
+    uint32_t width;
+    uint32_t height;
+    size_t offset;
+};
+
+// Tightly packed RGBA8 levels, largest first. Level 0 is a copy of the source.
+struct MipChain {
+    std::vector<MipLevel> levels;
+    std::vector<uint8_t> pixels;
+
+    const uint8_t* get_level_data(size_t level) const { return pixels.data() + levels[level].offset; }
+};
+
+uint32_t get_mip_level_count(uint32_t width, uint32_t height);
+
+// Filters in linear light when srgb is set (alpha is always linear) and
+// addresses the source with wrap, matching the sampler used for the chain.
+// Each level is built from the unquantized previous level.
+void generate_mip_chain(
+    const uint8_t* rgba,
+    uint32_t width,
+    uint32_t height,
+    MipFilter filter,
+    bool srgb,
+    JobPool* job_pool,
+    MipChain& out
+);
+
+// Sizes every level without filling any, so a decoder can write level 0 in
+// place; build_mip_chain then filters the rest from it.
+void allocate_mip_chain(uint32_t width, uint32_t height, MipChain& out);
+void build_mip_chain(MipFilter filter, bool srgb, JobPool* job_pool, MipChain& out);
+
+// RGBA32F levels for HDR images, laid out like MipChain.
+struct FloatMipChain {
+    std::vector<MipLevel> levels;
+    std::vector<float> pixels;
+
+    const float* get_level_data(size_t level) const { return pixels.data() + levels[level].offset; }
+};
+
+// Level 0 is written by the caller, as with allocate_mip_chain. Levels are
+// 2x2 box averages: the Kaiser filter's negative lobes ring around bright
+// HDR texels and can go negative.
+void allocate_float_mip_chain(uint32_t width, uint32_t height, FloatMipChain& out);
+void build_float_mip_chain(JobPool* job_pool, FloatMipChain& out);
+
+// Builds a mip chain from level-0 rows pushed top to bottom, so an image
+// never has to be resident in full: each level keeps at most one row of the
+// level above. Levels are 2x2 box averages, in linear light when srgb is set,
+// and odd sizes drop their last row or column. The sink receives every row
+// of every level, level 0 included, as RGBA8 as soon as it is finished.
+class MipRowBuilder {
+public:
+    using RowSink = std::function<void(uint32_t level, uint32_t row, const uint8_t* rgba)>;
+
+    MipRowBuilder(uint32_t width, uint32_t height, bool srgb, RowSink sink);
+
+    void push_row(const uint8_t* rgba);
+    uint32_t get_level_count() const { return static_cast<uint32_t>(levels.size()); }
+
+private:
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        uint32_t rows_done;
+        std::vector<float> pending;
+        bool has_pending;
+        std::vector<float> linear;
+        std::vector<uint8_t> encoded;
+    };
+
+    void push_linear(uint32_t level, uint32_t parent_row, const float* row);
+
+    std::vector<Level> levels;
+    std::vector<float> decoded;
+    bool srgb;
+    RowSink sink;
+};
@@ -1,4 +1,5 @@
 #include "pipeline.hpp"
+#include <filesystem>
 #include <stdexcept>
 #include <d3dcompiler.h>
 #include "d3dx12.h"
@@ -7,33 +8,56 @@ Pipeline::Pipeline(
     ID3D12Device* device,
     const std::wstring& shader_path,
     const std::vector<D3D12_INPUT_ELEMENT_DESC>& input_layout,
-    const D3D12_ROOT_SIGNATURE_DESC& root_signature_desc
+    const D3D12_ROOT_SIGNATURE_DESC& root_signature_desc,
+    ShaderCache* shader_cache,
+    PipelineCache* pipeline_cache
 ) {
-    Microsoft::WRL::ComPtr<ID3DBlob> signature;
-    Microsoft::WRL::ComPtr<ID3DBlob> error;
-    if (FAILED(D3D12SerializeRootSignature(&root_signature_desc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error))) {
-        throw std::runtime_error("Failed to serialize root signature.");
-    }
-    if (FAILED(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&root_signature)))) {
-        throw std::runtime_error("Failed to create root signature.");
+    if (pipeline_cache) {
+        root_signature = pipeline_cache->get_root_signature(root_signature_desc);
+    } else {
+        Microsoft::WRL::ComPtr<ID3DBlob> signature;
+        Microsoft::WRL::ComPtr<ID3DBlob> error;
+        if (FAILED(D3D12SerializeRootSignature(&root_signature_desc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error))) {
+            throw std::runtime_error("Failed to serialize root signature.");
+        }
+        if (FAILED(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&root_signature)))) {
+            throw std::runtime_error("Failed to create root signature.");
+        }
     }
 
-    Microsoft::WRL::ComPtr<ID3DBlob> vertex_shader;
-    Microsoft::WRL::ComPtr<ID3DBlob> pixel_shader;
-    UINT compile_flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    UINT compile_flags = get_default_compile_flags();
+    std::vector<uint8_t> vertex_shader = compile_shader(shader_path, "VSMain", "vs_5_0", {}, compile_flags, shader_cache);
+    std::vector<uint8_t> pixel_shader = compile_shader(shader_path, "PSMain", "ps_5_0", {}, compile_flags, shader_cache);
+    create_pipeline_state(device, { vertex_shader.data(), vertex_shader.size() }, { pixel_shader.data(), pixel_shader.size() }, input_layout, pipeline_cache);
+}
 
-    if (FAILED(D3DCompileFromFile(shader_path.c_str(), nullptr, nullptr, "VSMain", "vs_5_0", compile_flags, 0, &vertex_shader, &error))) {
-        throw std::runtime_error("Failed to compile vertex shader.");
-    }
-    if (FAILED(D3DCompileFromFile(shader_path.c_str(), nullptr, nullptr, "PSMain", "ps_5_0", compile_flags, 0, &pixel_shader, &error))) {
-        throw std::runtime_error("Failed to compile pixel shader.");
-    }
+Pipeline::Pipeline(
+    ID3D12Device* device,
+    ID3D12RootSignature* root_signature,
+    D3D12_SHADER_BYTECODE vertex_shader,
+    D3D12_SHADER_BYTECODE pixel_shader,
+    const std::vector<D3D12_INPUT_ELEMENT_DESC>& input_layout,
+    PipelineCache* pipeline_cache
+) :
+    root_signature(root_signature)
+{
+    create_pipeline_state(device, vertex_shader, pixel_shader, input_layout, pipeline_cache);
+}
+
+Pipeline::~Pipeline() {}
 
+void Pipeline::create_pipeline_state(
+    ID3D12Device* device,
+    D3D12_SHADER_BYTECODE vertex_shader,
+    D3D12_SHADER_BYTECODE pixel_shader,
+    const std::vector<D3D12_INPUT_ELEMENT_DESC>& input_layout,
+    PipelineCache* pipeline_cache
+) {
     D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
     pso_desc.InputLayout = { input_layout.data(), (UINT)input_layout.size() };
     pso_desc.pRootSignature = root_signature.Get();
-    pso_desc.VS = { vertex_shader->GetBufferPointer(), vertex_shader->GetBufferSize() };
-    pso_desc.PS = { pixel_shader->GetBufferPointer(), pixel_shader->GetBufferSize() };
+    pso_desc.VS = vertex_shader;
+    pso_desc.PS = pixel_shader;
     CD3DX12_RASTERIZER_DESC rasterizer_desc = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
     rasterizer_desc.CullMode = D3D12_CULL_MODE_NONE;
     pso_desc.RasterizerState = rasterizer_desc;
@@ -49,9 +73,66 @@ Pipeline::Pipeline(
     pso_desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
     pso_desc.SampleDesc.Count = 1;
 
-    if (FAILED(device->CreateGraphicsPipelineState(&pso_desc, IID_PPV_ARGS(&pipeline_state)))) {
+    if (pipeline_cache) {
+        pipeline_state = pipeline_cache->get_graphics_pipeline(pso_desc);
+    } else if (FAILED(device->CreateGraphicsPipelineState(&pso_desc, IID_PPV_ARGS(&pipeline_state)))) {
         throw std::runtime_error("Failed to create pipeline state.");
     }
 }
 
-Pipeline::~Pipeline() {}
+UINT Pipeline::get_default_compile_flags() {
+#if defined(OPTIMIZE_SHADERS)
+    return D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#else
+    return D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+}
+
+std::vector<uint8_t> Pipeline::compile_shader(
+    const std::wstring& shader_path,
+    const char* entry_point,
+    const char* target,
+    const std::vector<ShaderDefine>& defines,
+    UINT flags,
+    ShaderCache* shader_cache
+) {
+    Microsoft::WRL::ComPtr<ID3DBlob> source;
+    if (FAILED(D3DReadFileToBlob(shader_path.c_str(), &source))) {
+        throw std::runtime_error("Failed to read shader file.");
+    }
+
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const ShaderDefine& define : defines) {
+        macros.push_back({ define.name.c_str(), define.value.c_str() });
+    }
+    macros.push_back({ nullptr, nullptr });
+
+    // Preprocessing is cheap next to compiling and folds every include into
+    // the text, so hashing its output catches edits anywhere in the tree.
+    std::string source_name = std::filesystem::path(shader_path).string();
+    Microsoft::WRL::ComPtr<ID3DBlob> preprocessed;
+    Microsoft::WRL::ComPtr<ID3DBlob> error;
+    if (FAILED(D3DPreprocess(source->GetBufferPointer(), source->GetBufferSize(), source_name.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, &preprocessed, &error))) {
+        throw std::runtime_error("Failed to preprocess shader: " + source_name);
+    }
+
+    std::vector<uint8_t> bytecode;
+    uint64_t key = 0;
+    if (shader_cache) {
+        key = make_shader_cache_key(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize(), entry_point, target, defines, flags);
+        if (shader_cache->load(key, bytecode)) {
+            return bytecode;
+        }
+    }
+
+    Microsoft::WRL::ComPtr<ID3DBlob> blob;
+    if (FAILED(D3DCompile(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize(), source_name.c_str(), nullptr, nullptr, entry_point, target, flags, 0, &blob, &error))) {
+        throw std::runtime_error(std::string("Failed to compile shader entry point: ") + entry_point);
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+    bytecode.assign(data, data + blob->GetBufferSize());
+    if (shader_cache) {
+        shader_cache->store(key, bytecode.data(), bytecode.size());
+    }
+    return bytecode;
+}
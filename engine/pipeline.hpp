@@ -4,6 +4,8 @@
 #include <wrl.h>
 #include <string>
 #include <vector>
+#include "shader_cache.hpp"
+#include "pipeline_cache.hpp"
 
 class Pipeline {
 public:
@@ -11,14 +13,50 @@ public:
         ID3D12Device* device,
         const std::wstring& shader_path,
         const std::vector<D3D12_INPUT_ELEMENT_DESC>& input_layout,
-        const D3D12_ROOT_SIGNATURE_DESC& root_signature_desc
+        const D3D12_ROOT_SIGNATURE_DESC& root_signature_desc,
+        ShaderCache* shader_cache = nullptr,
+        PipelineCache* pipeline_cache = nullptr
+    );
+    // From precompiled bytecode, such as the blobs embedded at build time,
+    // with a root signature shared between pipelines. The bytecode only has
+    // to live for the call.
+    Pipeline(
+        ID3D12Device* device,
+        ID3D12RootSignature* root_signature,
+        D3D12_SHADER_BYTECODE vertex_shader,
+        D3D12_SHADER_BYTECODE pixel_shader,
+        const std::vector<D3D12_INPUT_ELEMENT_DESC>& input_layout,
+        PipelineCache* pipeline_cache = nullptr
     );
     ~Pipeline();
 
     ID3D12RootSignature* get_root_signature() const { return root_signature.Get(); }
     ID3D12PipelineState* get_pipeline_state() const { return pipeline_state.Get(); }
 
+    // Flags runtime compiles use; they match the build-time compile, which
+    // optimizes in release builds and keeps debug info otherwise.
+    static UINT get_default_compile_flags();
+
+    // Preprocesses the file (includes resolved relative to it), then takes
+    // the bytecode from shader_cache when present or compiles and stores it.
+    static std::vector<uint8_t> compile_shader(
+        const std::wstring& shader_path,
+        const char* entry_point,
+        const char* target,
+        const std::vector<ShaderDefine>& defines,
+        UINT flags,
+        ShaderCache* shader_cache
+    );
+
 private:
+    void create_pipeline_state(
+        ID3D12Device* device,
+        D3D12_SHADER_BYTECODE vertex_shader,
+        D3D12_SHADER_BYTECODE pixel_shader,
+        const std::vector<D3D12_INPUT_ELEMENT_DESC>& input_layout,
+        PipelineCache* pipeline_cache
+    );
+
     Microsoft::WRL::ComPtr<ID3D12RootSignature> root_signature;
     Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline_state;
 };
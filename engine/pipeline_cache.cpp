@@ -0,0 +1,243 @@
+#include "pipeline_cache.hpp"
+#include "content_hash.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cwchar>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data) {
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(path, error);
+    if (error || size > SIZE_MAX) {
+        return false;
+    }
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    data.resize(static_cast<size_t>(size));
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+static uint64_t hash_shader(const D3D12_SHADER_BYTECODE& shader) {
+    return shader.pShaderBytecode ? hash_content(shader.pShaderBytecode, shader.BytecodeLength) : 0;
+}
+
+static PipelineStencilOp describe_stencil(const D3D12_DEPTH_STENCILOP_DESC& op) {
+    return { static_cast<uint32_t>(op.StencilFailOp), static_cast<uint32_t>(op.StencilDepthFailOp), static_cast<uint32_t>(op.StencilPassOp), static_cast<uint32_t>(op.StencilFunc) };
+}
+
+PipelineCache::PipelineCache(ID3D12Device* device, const std::string& library_path) :
+    device(device), library_path(library_path), library_dirty(false), stats()
+{
+    // Pipeline libraries need ID3D12Device1; without one the cache still
+    // deduplicates within the run.
+    Microsoft::WRL::ComPtr<ID3D12Device1> device1;
+    if (FAILED(this->device.As(&device1))) {
+        return;
+    }
+    if (!read_file(library_path, library_data)) {
+        library_data.clear();
+    }
+    // A library from another driver or adapter fails to open; start over.
+    if (library_data.empty() || FAILED(device1->CreatePipelineLibrary(library_data.data(), library_data.size(), IID_PPV_ARGS(&library)))) {
+        library_data.clear();
+        library.Reset();
+        if (FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&library)))) {
+            library.Reset();
+        }
+    }
+}
+
+Microsoft::WRL::ComPtr<ID3D12RootSignature> PipelineCache::get_root_signature(const D3D12_ROOT_SIGNATURE_DESC& desc) {
+    Microsoft::WRL::ComPtr<ID3DBlob> signature;
+    Microsoft::WRL::ComPtr<ID3DBlob> error;
+    if (FAILED(D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error))) {
+        throw std::runtime_error("Failed to serialize root signature.");
+    }
+    uint64_t key = hash_content(signature->GetBufferPointer(), signature->GetBufferSize());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = root_signatures.find(key);
+    if (it != root_signatures.end()) {
+        return it->second;
+    }
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> root_signature;
+    if (FAILED(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&root_signature)))) {
+        throw std::runtime_error("Failed to create root signature.");
+    }
+    stats.root_signatures_created++;
+    root_signature_hashes.emplace(root_signature.Get(), key);
+    root_signatures.emplace(key, root_signature);
+    return root_signature;
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineCache::get_graphics_pipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) {
+    std::unique_lock<std::mutex> lock(mutex);
+    stats.requests++;
+    uint64_t key = hash_pipeline_desc(describe(desc));
+    auto it = pipelines.find(key);
+    if (it != pipelines.end()) {
+        stats.memory_hits++;
+        return it->second;
+    }
+
+    wchar_t name[17];
+    swprintf(name, 17, L"%016llx", static_cast<unsigned long long>(key));
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline_state;
+    if (library && SUCCEEDED(library->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(&pipeline_state)))) {
+        stats.library_hits++;
+    } else {
+        // Compiling is the slow part, so other threads may use the cache
+        // meanwhile; if one of them built the same pipeline, theirs wins.
+        lock.unlock();
+        if (FAILED(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipeline_state)))) {
+            throw std::runtime_error("Failed to create pipeline state.");
+        }
+        lock.lock();
+        it = pipelines.find(key);
+        if (it != pipelines.end()) {
+            return it->second;
+        }
+        stats.created++;
+        if (library && SUCCEEDED(library->StorePipeline(name, pipeline_state.Get()))) {
+            library_dirty = true;
+        }
+    }
+    pipelines.emplace(key, pipeline_state);
+    return pipeline_state;
+}
+
+uint32_t PipelineCache::purge_unused() {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t purged = 0;
+    for (auto it = pipelines.begin(); it != pipelines.end();) {
+        // Release returns the count left, which is 1 when only this map holds it.
+        it->second->AddRef();
+        if (it->second->Release() == 1) {
+            it = pipelines.erase(it);
+            purged++;
+        } else {
+            ++it;
+        }
+    }
+    return purged;
+}
+
+bool PipelineCache::save() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!library || !library_dirty) {
+        return true;
+    }
+    std::vector<uint8_t> data(library->GetSerializedSize());
+    if (FAILED(library->Serialize(data.data(), data.size()))) {
+        return false;
+    }
+
+    std::string temp_path = library_path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    ok = fclose(file) == 0 && ok;
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(temp_path, library_path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    library_dirty = false;
+    return true;
+}
+
+PipelineCacheStats PipelineCache::get_stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+PipelineDesc PipelineCache::describe(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) const {
+    if (desc.StreamOutput.NumEntries > 0) {
+        throw std::runtime_error("Pipeline cache does not support stream output.");
+    }
+    auto root_signature = root_signature_hashes.find(desc.pRootSignature);
+    if (root_signature == root_signature_hashes.end()) {
+        throw std::runtime_error("Pipeline root signature was not created by the pipeline cache.");
+    }
+
+    PipelineDesc out = {};
+    out.root_signature_hash = root_signature->second;
+    out.shader_hashes[static_cast<size_t>(PipelineShaderStage::vertex)] = hash_shader(desc.VS);
+    out.shader_hashes[static_cast<size_t>(PipelineShaderStage::pixel)] = hash_shader(desc.PS);
+    out.shader_hashes[static_cast<size_t>(PipelineShaderStage::domain)] = hash_shader(desc.DS);
+    out.shader_hashes[static_cast<size_t>(PipelineShaderStage::hull)] = hash_shader(desc.HS);
+    out.shader_hashes[static_cast<size_t>(PipelineShaderStage::geometry)] = hash_shader(desc.GS);
+    for (UINT i = 0; i < desc.InputLayout.NumElements; ++i) {
+        const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+        out.input_layout.push_back({
+            element.SemanticName, element.SemanticIndex, static_cast<uint32_t>(element.Format), element.InputSlot,
+            element.AlignedByteOffset, static_cast<uint32_t>(element.InputSlotClass), element.InstanceDataStepRate
+        });
+    }
+    out.ib_strip_cut_value = static_cast<uint32_t>(desc.IBStripCutValue);
+    out.primitive_topology_type = static_cast<uint32_t>(desc.PrimitiveTopologyType);
+
+    const D3D12_RASTERIZER_DESC& rasterizer = desc.RasterizerState;
+    out.fill_mode = static_cast<uint32_t>(rasterizer.FillMode);
+    out.cull_mode = static_cast<uint32_t>(rasterizer.CullMode);
+    out.front_counter_clockwise = rasterizer.FrontCounterClockwise != FALSE;
+    out.depth_bias = rasterizer.DepthBias;
+    out.depth_bias_clamp = rasterizer.DepthBiasClamp;
+    out.slope_scaled_depth_bias = rasterizer.SlopeScaledDepthBias;
+    out.depth_clip_enable = rasterizer.DepthClipEnable != FALSE;
+    out.multisample_enable = rasterizer.MultisampleEnable != FALSE;
+    out.antialiased_line_enable = rasterizer.AntialiasedLineEnable != FALSE;
+    out.forced_sample_count = rasterizer.ForcedSampleCount;
+    out.conservative_raster = static_cast<uint32_t>(rasterizer.ConservativeRaster);
+
+    out.alpha_to_coverage_enable = desc.BlendState.AlphaToCoverageEnable != FALSE;
+    out.independent_blend_enable = desc.BlendState.IndependentBlendEnable != FALSE;
+    for (UINT i = 0; i < 8; ++i) {
+        const D3D12_RENDER_TARGET_BLEND_DESC& blend = desc.BlendState.RenderTarget[i];
+        PipelineRenderTargetBlend& target = out.render_target_blend[i];
+        target.blend_enable = blend.BlendEnable != FALSE;
+        target.logic_op_enable = blend.LogicOpEnable != FALSE;
+        target.src_blend = static_cast<uint32_t>(blend.SrcBlend);
+        target.dest_blend = static_cast<uint32_t>(blend.DestBlend);
+        target.blend_op = static_cast<uint32_t>(blend.BlendOp);
+        target.src_blend_alpha = static_cast<uint32_t>(blend.SrcBlendAlpha);
+        target.dest_blend_alpha = static_cast<uint32_t>(blend.DestBlendAlpha);
+        target.blend_op_alpha = static_cast<uint32_t>(blend.BlendOpAlpha);
+        target.logic_op = static_cast<uint32_t>(blend.LogicOp);
+        target.render_target_write_mask = blend.RenderTargetWriteMask;
+    }
+    out.sample_mask = desc.SampleMask;
+
+    const D3D12_DEPTH_STENCIL_DESC& depth_stencil = desc.DepthStencilState;
+    out.depth_enable = depth_stencil.DepthEnable != FALSE;
+    out.depth_write_mask = static_cast<uint32_t>(depth_stencil.DepthWriteMask);
+    out.depth_func = static_cast<uint32_t>(depth_stencil.DepthFunc);
+    out.stencil_enable = depth_stencil.StencilEnable != FALSE;
+    out.stencil_read_mask = depth_stencil.StencilReadMask;
+    out.stencil_write_mask = depth_stencil.StencilWriteMask;
+    out.front_face = describe_stencil(depth_stencil.FrontFace);
+    out.back_face = describe_stencil(depth_stencil.BackFace);
+
+    out.num_render_targets = desc.NumRenderTargets;
+    for (UINT i = 0; i < 8; ++i) {
+        out.rtv_formats[i] = static_cast<uint32_t>(desc.RTVFormats[i]);
+    }
+    out.dsv_format = static_cast<uint32_t>(desc.DSVFormat);
+    out.sample_count = desc.SampleDesc.Count;
+    out.sample_quality = desc.SampleDesc.Quality;
+    out.node_mask = desc.NodeMask;
+    out.flags = static_cast<uint32_t>(desc.Flags);
+    return out;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "pipeline_desc.hpp"
+
+struct PipelineCacheStats {
+    uint64_t requests;
+    // Same normalized description already created this run.
+    uint64_t memory_hits;
+    // Loaded from the serialized pipeline library instead of compiled.
+    uint64_t library_hits;
+    uint64_t created;
+    uint64_t root_signatures_created;
+};
+
+// Hands out one root signature per serialized blob and one pipeline state
+// per normalized description. Pipelines are also stored in an
+// ID3D12PipelineLibrary that save() writes to disk, so a later run loads
+// them instead of compiling; a library the driver rejects is discarded.
+// Root signatures used in pipeline descriptions must come from this cache,
+// as their blob hash is part of the key. Safe to use from several threads;
+// pipeline compiles run outside the lock. Objects are handed out with a
+// reference taken under the lock, so purge_unused on another thread cannot
+// release them before the caller holds them.
+class PipelineCache {
+public:
+    PipelineCache(ID3D12Device* device, const std::string& library_path);
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> get_root_signature(const D3D12_ROOT_SIGNATURE_DESC& desc);
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> get_graphics_pipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+    // Releases pipelines nothing outside the cache references any more,
+    // such as those of an edited shader once the GPU is done with them.
+    // The library keeps its stored copy. Returns the number released.
+    uint32_t purge_unused();
+
+    // Writes the library if pipelines were added since it was loaded. The
+    // file is replaced atomically; returns false if it could not be written.
+    bool save();
+
+    PipelineCacheStats get_stats() const;
+
+private:
+    PipelineDesc describe(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) const;
+
+    Microsoft::WRL::ComPtr<ID3D12Device> device;
+    Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> library;
+    // The library reads from this memory for as long as it lives.
+    std::vector<uint8_t> library_data;
+    std::string library_path;
+    bool library_dirty;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12RootSignature>> root_signatures;
+    std::unordered_map<ID3D12RootSignature*, uint64_t> root_signature_hashes;
+    std::unordered_map<uint64_t, Microsoft::WRL::ComPtr<ID3D12PipelineState>> pipelines;
+    PipelineCacheStats stats;
+};
@@ -0,0 +1,235 @@
+#include "pipeline_desc.hpp"
+#include "content_hash.hpp"
+#include <cctype>
+
+// D3D12_APPEND_ALIGNED_ELEMENT
+static const uint32_t append_aligned_element = 0xffffffff;
+static const uint32_t max_input_slots = 32;
+
+uint32_t get_vertex_format_size(uint32_t format) {
+    // DXGI_FORMAT values.
+    switch (format) {
+    case 2: case 3: case 4:
+        return 16;
+    case 6: case 7: case 8:
+        return 12;
+    case 10: case 11: case 12: case 13: case 14: case 16: case 17: case 18:
+        return 8;
+    case 24: case 25: case 26: case 28: case 29: case 30: case 31: case 32:
+    case 34: case 35: case 36: case 37: case 38: case 41: case 42: case 43: case 87:
+        return 4;
+    case 49: case 50: case 51: case 52: case 54: case 56: case 57: case 58: case 59:
+        return 2;
+    case 61: case 62: case 63: case 64:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void resolve_input_offsets(std::vector<PipelineInputElement>& elements) {
+    // Offsets continue per slot, as the runtime computes them. A format of
+    // unknown size leaves the rest of its slot as written.
+    uint32_t next_offset[max_input_slots] = {};
+    bool resolvable[max_input_slots];
+    for (bool& slot : resolvable) {
+        slot = true;
+    }
+    for (PipelineInputElement& element : elements) {
+        if (element.input_slot >= max_input_slots || !resolvable[element.input_slot]) {
+            continue;
+        }
+        uint32_t size = get_vertex_format_size(element.format);
+        if (element.aligned_byte_offset == append_aligned_element) {
+            if (size == 0) {
+                resolvable[element.input_slot] = false;
+                continue;
+            }
+            // Appended elements are aligned to 4 bytes or their size, whichever is smaller.
+            uint32_t alignment = size < 4 ? size : 4;
+            element.aligned_byte_offset = (next_offset[element.input_slot] + alignment - 1) / alignment * alignment;
+        }
+        if (size == 0) {
+            resolvable[element.input_slot] = false;
+            continue;
+        }
+        next_offset[element.input_slot] = element.aligned_byte_offset + size;
+    }
+}
+
+static bool blend_equal(const PipelineRenderTargetBlend& a, const PipelineRenderTargetBlend& b) {
+    return a.blend_enable == b.blend_enable && a.logic_op_enable == b.logic_op_enable && a.src_blend == b.src_blend &&
+           a.dest_blend == b.dest_blend && a.blend_op == b.blend_op && a.src_blend_alpha == b.src_blend_alpha &&
+           a.dest_blend_alpha == b.dest_blend_alpha && a.blend_op_alpha == b.blend_op_alpha && a.logic_op == b.logic_op &&
+           a.render_target_write_mask == b.render_target_write_mask;
+}
+
+void normalize_pipeline_desc(PipelineDesc& desc) {
+    for (PipelineInputElement& element : desc.input_layout) {
+        for (char& c : element.semantic_name) {
+            c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        }
+        if (element.input_slot_class == 0) {
+            element.instance_data_step_rate = 0;
+        }
+    }
+    resolve_input_offsets(desc.input_layout);
+
+    if (desc.depth_bias_clamp == 0.0f) {
+        desc.depth_bias_clamp = 0.0f;
+    }
+    if (desc.slope_scaled_depth_bias == 0.0f) {
+        desc.slope_scaled_depth_bias = 0.0f;
+    }
+
+    if (desc.num_render_targets > 8) {
+        desc.num_render_targets = 8;
+    }
+    if (!desc.independent_blend_enable) {
+        for (uint32_t i = 1; i < 8; ++i) {
+            desc.render_target_blend[i] = desc.render_target_blend[0];
+        }
+    }
+    for (uint32_t i = 0; i < 8; ++i) {
+        PipelineRenderTargetBlend& blend = desc.render_target_blend[i];
+        if (i >= desc.num_render_targets) {
+            blend = {};
+            desc.rtv_formats[i] = 0;
+            continue;
+        }
+        if (!blend.blend_enable) {
+            blend.src_blend = blend.dest_blend = blend.blend_op = 0;
+            blend.src_blend_alpha = blend.dest_blend_alpha = blend.blend_op_alpha = 0;
+        }
+        if (!blend.logic_op_enable) {
+            blend.logic_op = 0;
+        }
+    }
+    // With one target or identical targets the flag makes no difference.
+    bool targets_match = true;
+    for (uint32_t i = 1; i < desc.num_render_targets; ++i) {
+        targets_match = targets_match && blend_equal(desc.render_target_blend[i], desc.render_target_blend[0]);
+    }
+    if (targets_match) {
+        desc.independent_blend_enable = false;
+    }
+
+    if (!desc.depth_enable) {
+        desc.depth_write_mask = 0;
+        desc.depth_func = 0;
+    }
+    if (!desc.stencil_enable) {
+        desc.stencil_read_mask = 0;
+        desc.stencil_write_mask = 0;
+        desc.front_face = {};
+        desc.back_face = {};
+    }
+
+    if (desc.sample_count < 32) {
+        desc.sample_mask &= (1u << desc.sample_count) - 1;
+    }
+    if (desc.node_mask == 0) {
+        desc.node_mask = 1;
+    }
+}
+
+namespace {
+
+class FieldWriter {
+public:
+    template <typename T>
+    void write(T value) {
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void write(const std::string& value) {
+        write(static_cast<uint64_t>(value.size()));
+        bytes.append(value);
+    }
+
+    void write_blend(const PipelineRenderTargetBlend& blend) {
+        write(blend.blend_enable);
+        write(blend.logic_op_enable);
+        write(blend.src_blend);
+        write(blend.dest_blend);
+        write(blend.blend_op);
+        write(blend.src_blend_alpha);
+        write(blend.dest_blend_alpha);
+        write(blend.blend_op_alpha);
+        write(blend.logic_op);
+        write(blend.render_target_write_mask);
+    }
+
+    void write_stencil(const PipelineStencilOp& op) {
+        write(op.stencil_fail_op);
+        write(op.stencil_depth_fail_op);
+        write(op.stencil_pass_op);
+        write(op.stencil_func);
+    }
+
+    std::string bytes;
+};
+
+} // namespace
+
+uint64_t hash_pipeline_desc(const PipelineDesc& source) {
+    PipelineDesc desc = source;
+    normalize_pipeline_desc(desc);
+
+    FieldWriter out;
+    out.write(desc.root_signature_hash);
+    for (uint64_t shader_hash : desc.shader_hashes) {
+        out.write(shader_hash);
+    }
+    out.write(static_cast<uint64_t>(desc.input_layout.size()));
+    for (const PipelineInputElement& element : desc.input_layout) {
+        out.write(element.semantic_name);
+        out.write(element.semantic_index);
+        out.write(element.format);
+        out.write(element.input_slot);
+        out.write(element.aligned_byte_offset);
+        out.write(element.input_slot_class);
+        out.write(element.instance_data_step_rate);
+    }
+    out.write(desc.ib_strip_cut_value);
+    out.write(desc.primitive_topology_type);
+
+    out.write(desc.fill_mode);
+    out.write(desc.cull_mode);
+    out.write(desc.front_counter_clockwise);
+    out.write(desc.depth_bias);
+    out.write(desc.depth_bias_clamp);
+    out.write(desc.slope_scaled_depth_bias);
+    out.write(desc.depth_clip_enable);
+    out.write(desc.multisample_enable);
+    out.write(desc.antialiased_line_enable);
+    out.write(desc.forced_sample_count);
+    out.write(desc.conservative_raster);
+
+    out.write(desc.alpha_to_coverage_enable);
+    out.write(desc.independent_blend_enable);
+    for (const PipelineRenderTargetBlend& blend : desc.render_target_blend) {
+        out.write_blend(blend);
+    }
+    out.write(desc.sample_mask);
+
+    out.write(desc.depth_enable);
+    out.write(desc.depth_write_mask);
+    out.write(desc.depth_func);
+    out.write(desc.stencil_enable);
+    out.write(desc.stencil_read_mask);
+    out.write(desc.stencil_write_mask);
+    out.write_stencil(desc.front_face);
+    out.write_stencil(desc.back_face);
+
+    out.write(desc.num_render_targets);
+    for (uint32_t format : desc.rtv_formats) {
+        out.write(format);
+    }
+    out.write(desc.dsv_format);
+    out.write(desc.sample_count);
+    out.write(desc.sample_quality);
+    out.write(desc.node_mask);
+    out.write(desc.flags);
+    return hash_content(out.bytes.data(), out.bytes.size());
+}
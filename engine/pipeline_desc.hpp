@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Plain mirror of D3D12_GRAPHICS_PIPELINE_STATE_DESC with the same enum
+// values, so pipeline descriptions can be normalized, hashed and compared
+// without d3d12.h. Shaders and the root signature are reduced to hashes of
+// their bytecode and serialized blob. Stream output is not supported.
+struct PipelineInputElement {
+    std::string semantic_name;
+    uint32_t semantic_index;
+    uint32_t format;
+    uint32_t input_slot;
+    uint32_t aligned_byte_offset;
+    uint32_t input_slot_class;
+    uint32_t instance_data_step_rate;
+};
+
+struct PipelineRenderTargetBlend {
+    bool blend_enable;
+    bool logic_op_enable;
+    uint32_t src_blend;
+    uint32_t dest_blend;
+    uint32_t blend_op;
+    uint32_t src_blend_alpha;
+    uint32_t dest_blend_alpha;
+    uint32_t blend_op_alpha;
+    uint32_t logic_op;
+    uint8_t render_target_write_mask;
+};
+
+struct PipelineStencilOp {
+    uint32_t stencil_fail_op;
+    uint32_t stencil_depth_fail_op;
+    uint32_t stencil_pass_op;
+    uint32_t stencil_func;
+};
+
+enum class PipelineShaderStage : uint32_t {
+    vertex,
+    pixel,
+    domain,
+    hull,
+    geometry,
+    count
+};
+
+struct PipelineDesc {
+    uint64_t root_signature_hash;
+    // Zero for stages that are not used.
+    uint64_t shader_hashes[static_cast<size_t>(PipelineShaderStage::count)];
+    std::vector<PipelineInputElement> input_layout;
+    uint32_t ib_strip_cut_value;
+    uint32_t primitive_topology_type;
+
+    uint32_t fill_mode;
+    uint32_t cull_mode;
+    bool front_counter_clockwise;
+    int32_t depth_bias;
+    float depth_bias_clamp;
+    float slope_scaled_depth_bias;
+    bool depth_clip_enable;
+    bool multisample_enable;
+    bool antialiased_line_enable;
+    uint32_t forced_sample_count;
+    uint32_t conservative_raster;
+
+    bool alpha_to_coverage_enable;
+    bool independent_blend_enable;
+    PipelineRenderTargetBlend render_target_blend[8];
+    uint32_t sample_mask;
+
+    bool depth_enable;
+    uint32_t depth_write_mask;
+    uint32_t depth_func;
+    bool stencil_enable;
+    uint8_t stencil_read_mask;
+    uint8_t stencil_write_mask;
+    PipelineStencilOp front_face;
+    PipelineStencilOp back_face;
+
+    uint32_t num_render_targets;
+    uint32_t rtv_formats[8];
+    uint32_t dsv_format;
+    uint32_t sample_count;
+    uint32_t sample_quality;
+    uint32_t node_mask;
+    uint32_t flags;
+};
+
+// Clears state the runtime ignores so equivalent descriptions compare
+// equal: blend settings of disabled or unused targets, depth and stencil
+// settings when those tests are off, formats past num_render_targets and
+// sample mask bits past sample_count. Semantic names are upper-cased, as
+// they match case-insensitively, and appended input element offsets are
+// resolved for the common vertex formats.
+void normalize_pipeline_desc(PipelineDesc& desc);
+
+// Hash of the normalized description, field by field, so padding and
+// pointer values never leak in.
+uint64_t hash_pipeline_desc(const PipelineDesc& desc);
+
+// Byte size of one element in the given DXGI format, or 0 for formats
+// the offset resolution does not know.
+uint32_t get_vertex_format_size(uint32_t format);
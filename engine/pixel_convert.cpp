@@ -0,0 +1,69 @@
+#include "pixel_convert.hpp"
+#include <cstring>
+#include <emmintrin.h>
+
+void swizzle_grey_alpha(uint8_t* rgba, size_t pixel_count) {
+    const __m128i keep = _mm_set1_epi32(static_cast<int>(0xFFFF00FFu));
+    const __m128i green = _mm_set1_epi32(0x0000FF00);
+    size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i* p = reinterpret_cast<__m128i*>(rgba + i * 4);
+        __m128i texels = _mm_loadu_si128(p);
+        texels = _mm_or_si128(_mm_and_si128(texels, keep), _mm_and_si128(_mm_srli_epi32(texels, 16), green));
+        _mm_storeu_si128(p, texels);
+    }
+    for (; i < pixel_count; i++) {
+        rgba[i * 4 + 1] = rgba[i * 4 + 3];
+    }
+}
+
+static void pack_r8_row(const uint8_t* src, uint32_t width, uint8_t* dst) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(src + x * 4);
+        __m128i a = _mm_and_si128(_mm_loadu_si128(p + 0), mask);
+        __m128i b = _mm_and_si128(_mm_loadu_si128(p + 1), mask);
+        __m128i c = _mm_and_si128(_mm_loadu_si128(p + 2), mask);
+        __m128i d = _mm_and_si128(_mm_loadu_si128(p + 3), mask);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+    }
+    for (; x < width; x++) {
+        dst[x] = src[x * 4];
+    }
+}
+
+static void pack_rg8_row(const uint8_t* src, uint32_t width, uint8_t* dst) {
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i* p = reinterpret_cast<const __m128i*>(src + x * 4);
+        // Sign-extending the low half lets the signed pack keep all 16 bits.
+        __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(p + 0), 16), 16);
+        __m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(p + 1), 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), _mm_packs_epi32(a, b));
+    }
+    for (; x < width; x++) {
+        dst[x * 2] = src[x * 4];
+        dst[x * 2 + 1] = src[x * 4 + 1];
+    }
+}
+
+void pack_rgba8_rows(const uint8_t* rgba, uint32_t width, uint32_t height, PixelFormat format, uint8_t* dst, size_t dst_row_pitch) {
+    size_t src_pitch = static_cast<size_t>(width) * 4;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* src = rgba + y * src_pitch;
+        uint8_t* row = dst + y * dst_row_pitch;
+        switch (format) {
+            case PixelFormat::r8:
+                pack_r8_row(src, width, row);
+                break;
+            case PixelFormat::rg8:
+                pack_rg8_row(src, width, row);
+                break;
+            default:
+                memcpy(row, src, src_pitch);
+                break;
+        }
+    }
+}
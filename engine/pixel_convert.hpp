@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "pixel_format.hpp"
+
+// Moves alpha into green so a grey plus alpha image, which decoders expand
+// to (l, l, l, a), keeps both channels in the first two bytes of each texel.
+void swizzle_grey_alpha(uint8_t* rgba, size_t pixel_count);
+
+// Narrows tightly packed RGBA8 rows to R8 or RG8 (the first one or two
+// bytes of each texel), writing rows dst_row_pitch bytes apart. Other
+// formats are copied unchanged. SSE2 does 16 texels per step.
+void pack_rgba8_rows(const uint8_t* rgba, uint32_t width, uint32_t height, PixelFormat format, uint8_t* dst, size_t dst_row_pitch);
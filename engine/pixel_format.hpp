@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Texel layouts the asset pipeline can produce. Kept free of DXGI so the
+// encoders and loaders build without the Windows SDK; texture.cpp maps these
+// onto DXGI formats.
+enum class PixelFormat : uint32_t {
+    rgba8,
+    bc1,
+    bc3,
+    bc4,
+    bc5,
+    bc7,
+    r8,
+    rg8,
+    // sRGB variants decode to linear when sampled. D3D has none for one- or
+    // two-channel formats.
+    rgba8_srgb,
+    bc1_srgb,
+    bc3_srgb,
+    bc7_srgb,
+    // HDR. The two packed formats hold non-negative RGB in 4 bytes per texel;
+    // rgba16f keeps sign, alpha and more precision at 8 bytes.
+    r11g11b10f,
+    rgb9e5,
+    rgba16f
+};
+
+// What 8-bit texel values encode, which decides how mips are filtered:
+// colour in sRGB is converted to linear light first, data such as masks,
+// normals and roughness is averaged as stored. Set per asset; the channel
+// count says nothing about it.
+enum class ColorSpace : uint32_t {
+    srgb,
+    linear
+};
+
+inline bool is_float_format(PixelFormat format) {
+    return format == PixelFormat::r11g11b10f || format == PixelFormat::rgb9e5 || format == PixelFormat::rgba16f;
+}
+
+// HDR images need a float format; anything else asked for falls back to R11G11B10.
+inline PixelFormat select_hdr_format(PixelFormat requested) {
+    return is_float_format(requested) ? requested : PixelFormat::r11g11b10f;
+}
+
+inline bool is_srgb(PixelFormat format) {
+    return format == PixelFormat::rgba8_srgb || format == PixelFormat::bc1_srgb ||
+           format == PixelFormat::bc3_srgb || format == PixelFormat::bc7_srgb;
+}
+
+// Same texel layout without the sRGB decode; what encoders and copies work with.
+inline PixelFormat get_linear_format(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::rgba8_srgb: return PixelFormat::rgba8;
+        case PixelFormat::bc1_srgb: return PixelFormat::bc1;
+        case PixelFormat::bc3_srgb: return PixelFormat::bc3;
+        case PixelFormat::bc7_srgb: return PixelFormat::bc7;
+        default: return format;
+    }
+}
+
+inline bool is_block_compressed(PixelFormat format) {
+    switch (get_linear_format(format)) {
+        case PixelFormat::rgba8:
+        case PixelFormat::r8:
+        case PixelFormat::rg8:
+        case PixelFormat::r11g11b10f:
+        case PixelFormat::rgb9e5:
+        case PixelFormat::rgba16f:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Bytes per 4x4 block for BCn formats, bytes per texel otherwise.
+inline uint32_t get_element_size(PixelFormat format) {
+    switch (get_linear_format(format)) {
+        case PixelFormat::bc1:
+        case PixelFormat::bc4:
+            return 8;
+        case PixelFormat::bc3:
+        case PixelFormat::bc5:
+        case PixelFormat::bc7:
+            return 16;
+        case PixelFormat::r8:
+            return 1;
+        case PixelFormat::rg8:
+            return 2;
+        case PixelFormat::rgba16f:
+            return 8;
+        default:
+            return 4;
+    }
+}
+
+// Picks the smallest format that holds every channel the source has, given
+// the format the caller asked for. One-channel images become R8 or BC4,
+// two-channel (grey plus alpha) images RG8 or BC5; sRGB requests keep their
+// format since there are no sRGB one- or two-channel formats.
+inline PixelFormat select_native_format(PixelFormat requested, uint32_t source_channels) {
+    if (source_channels > 2 || is_srgb(requested)) {
+        return requested;
+    }
+    bool single = source_channels == 1;
+    switch (requested) {
+        case PixelFormat::rgba8:
+            return single ? PixelFormat::r8 : PixelFormat::rg8;
+        case PixelFormat::bc1:
+        case PixelFormat::bc3:
+        case PixelFormat::bc7:
+            return single ? PixelFormat::bc4 : PixelFormat::bc5;
+        default:
+            return requested;
+    }
+}
+
+// Tightly packed bytes per row of texels, or per row of blocks.
+inline size_t get_row_size(PixelFormat format, uint32_t width) {
+    if (is_block_compressed(format)) {
+        return static_cast<size_t>(width / 4 + (width % 4 != 0)) * get_element_size(format);
+    }
+    return static_cast<size_t>(width) * get_element_size(format);
+}
+
+inline uint32_t get_row_count(PixelFormat format, uint32_t height) {
+    return is_block_compressed(format) ? height / 4 + (height % 4 != 0) : height;
+}
+
+inline size_t get_surface_size(PixelFormat format, uint32_t width, uint32_t height) {
+    return get_row_size(format, width) * get_row_count(format, height);
+}
+
+// Bytes of a full chain of mip_levels levels, for comparing formats.
+inline uint64_t get_mip_chain_size(PixelFormat format, uint32_t width, uint32_t height, uint32_t mip_levels) {
+    uint64_t size = 0;
+    for (uint32_t mip = 0; mip < mip_levels; mip++) {
+        uint32_t mip_width = width >> mip ? width >> mip : 1;
+        uint32_t mip_height = height >> mip ? height >> mip : 1;
+        size += get_surface_size(format, mip_width, mip_height);
+    }
+    return size;
+}
@@ -0,0 +1,316 @@
+#include "png_reader.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const uint8_t png_signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+
+constexpr uint32_t make_chunk_type(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(a) << 24 | static_cast<uint32_t>(b) << 16 | static_cast<uint32_t>(c) << 8 | static_cast<uint32_t>(d);
+}
+
+const uint32_t chunk_ihdr = make_chunk_type('I', 'H', 'D', 'R');
+const uint32_t chunk_plte = make_chunk_type('P', 'L', 'T', 'E');
+const uint32_t chunk_trns = make_chunk_type('t', 'R', 'N', 'S');
+const uint32_t chunk_idat = make_chunk_type('I', 'D', 'A', 'T');
+const uint32_t chunk_iend = make_chunk_type('I', 'E', 'N', 'D');
+
+const uint32_t color_grey = 0;
+const uint32_t color_rgb = 2;
+const uint32_t color_palette = 3;
+const uint32_t color_grey_alpha = 4;
+const uint32_t color_rgba = 6;
+
+uint32_t read_be32(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 | static_cast<uint32_t>(data[2]) << 8 | data[3];
+}
+
+void read_exact(ImageSource& source, uint8_t* dst, size_t size) {
+    if (source.read(dst, size) != size) {
+        throw std::runtime_error("PNG file is truncated.");
+    }
+}
+
+uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+} // namespace
+
+bool is_png(const uint8_t* data, size_t size) {
+    return size >= 8 && memcmp(data, png_signature, 8) == 0;
+}
+
+PngRowReader::PngRowReader(ImageSource& source) :
+    source(source), bit_depth(0), color_type(0), samples_per_pixel(0), row_bytes(0), filter_stride(0), rows_read(0),
+    palette(), has_color_key(false), color_key(), data_remaining(0), data_ended(false)
+{
+    uint8_t signature[8];
+    read_exact(source, signature, 8);
+    if (!is_png(signature, 8)) {
+        throw std::runtime_error("Not a PNG file.");
+    }
+
+    bool has_header = false;
+    bool has_palette = false;
+    bool has_palette_alpha = false;
+    for (;;) {
+        uint32_t length, type;
+        if (!read_chunk_header(length, type)) {
+            throw std::runtime_error("PNG file has no image data.");
+        }
+        if (type == chunk_idat) {
+            if (!has_header || (color_type == color_palette && !has_palette)) {
+                throw std::runtime_error("PNG image data comes before its header or palette.");
+            }
+            data_remaining = length;
+            break;
+        }
+
+        if (type == chunk_ihdr) {
+            uint8_t header[13];
+            if (length != 13) {
+                throw std::runtime_error("Malformed PNG header.");
+            }
+            read_exact(source, header, 13);
+            info.width = read_be32(header);
+            info.height = read_be32(header + 4);
+            bit_depth = header[8];
+            color_type = header[9];
+            if (info.width == 0 || info.height == 0 || info.width > (1u << 24) || info.height > (1u << 24)) {
+                throw std::runtime_error("Unsupported PNG dimensions.");
+            }
+            if (header[10] != 0 || header[11] != 0) {
+                throw std::runtime_error("Unsupported PNG compression or filter method.");
+            }
+            if (header[12] != 0) {
+                throw std::runtime_error("Interlaced PNGs cannot be streamed.");
+            }
+            switch (color_type) {
+                case color_grey: samples_per_pixel = 1; break;
+                case color_rgb: samples_per_pixel = 3; break;
+                case color_palette: samples_per_pixel = 1; break;
+                case color_grey_alpha: samples_per_pixel = 2; break;
+                case color_rgba: samples_per_pixel = 4; break;
+                default: throw std::runtime_error("Unsupported PNG colour type.");
+            }
+            bool valid_depth = bit_depth == 8 || bit_depth == 16;
+            if (color_type == color_grey || color_type == color_palette) {
+                valid_depth = bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8 || (bit_depth == 16 && color_type == color_grey);
+            }
+            if (!valid_depth) {
+                throw std::runtime_error("Unsupported PNG bit depth.");
+            }
+            has_header = true;
+        } else if (type == chunk_plte) {
+            if (length % 3 != 0 || length > 768) {
+                throw std::runtime_error("Malformed PNG palette.");
+            }
+            uint8_t entries[768];
+            read_exact(source, entries, length);
+            for (uint32_t i = 0; i < length / 3; i++) {
+                palette[i * 4 + 0] = entries[i * 3 + 0];
+                palette[i * 4 + 1] = entries[i * 3 + 1];
+                palette[i * 4 + 2] = entries[i * 3 + 2];
+                palette[i * 4 + 3] = 255;
+            }
+            has_palette = true;
+        } else if (type == chunk_trns && has_header) {
+            uint8_t values[256];
+            if (length > sizeof(values)) {
+                throw std::runtime_error("Malformed PNG transparency.");
+            }
+            read_exact(source, values, length);
+            if (color_type == color_palette) {
+                for (uint32_t i = 0; i < length; i++) {
+                    palette[i * 4 + 3] = values[i];
+                }
+                has_palette_alpha = true;
+            } else if ((color_type == color_grey && length == 2) || (color_type == color_rgb && length == 6)) {
+                for (uint32_t i = 0; i < length / 2; i++) {
+                    color_key[i] = static_cast<uint16_t>(values[i * 2] << 8 | values[i * 2 + 1]);
+                }
+                has_color_key = true;
+            }
+        } else if (type == chunk_iend || (type >> 29 & 1) == 0) {
+            // An uppercase first letter marks a chunk the image cannot be decoded without.
+            throw std::runtime_error("Unsupported or misplaced critical PNG chunk.");
+        } else {
+            source.skip(length);
+        }
+        source.skip(4); // CRC
+    }
+
+    switch (color_type) {
+        case color_grey: info.channels = has_color_key ? 2 : 1; break;
+        case color_rgb: info.channels = has_color_key ? 4 : 3; break;
+        case color_palette: info.channels = has_palette_alpha ? 4 : 3; break;
+        default: info.channels = samples_per_pixel; break;
+    }
+    info.hdr = false;
+
+    uint32_t bits_per_pixel = bit_depth * samples_per_pixel;
+    row_bytes = (static_cast<size_t>(info.width) * bits_per_pixel + 7) / 8;
+    filter_stride = bits_per_pixel >= 8 ? bits_per_pixel / 8 : 1;
+    current.resize(row_bytes + 1);
+    previous.assign(row_bytes + 1, 0);
+    inflater = std::make_unique<InflateStream>([this](uint8_t* dst, size_t size) { return read_image_data(dst, size); });
+}
+
+bool PngRowReader::read_chunk_header(uint32_t& length, uint32_t& type) {
+    uint8_t header[8];
+    if (source.read(header, 8) != 8) {
+        return false;
+    }
+    length = read_be32(header);
+    type = read_be32(header + 4);
+    if (length > 0x7FFFFFFFu) {
+        throw std::runtime_error("Malformed PNG chunk.");
+    }
+    return true;
+}
+
+// Image data may be split over any number of consecutive IDAT chunks.
+size_t PngRowReader::read_image_data(uint8_t* dst, size_t size) {
+    while (data_remaining == 0) {
+        if (data_ended) {
+            return 0;
+        }
+        source.skip(4); // CRC of the previous IDAT
+        uint32_t length, type;
+        if (!read_chunk_header(length, type) || type != chunk_idat) {
+            data_ended = true;
+            return 0;
+        }
+        data_remaining = length;
+    }
+    size_t count = source.read(dst, size < data_remaining ? size : data_remaining);
+    if (count == 0) {
+        throw std::runtime_error("PNG file is truncated.");
+    }
+    data_remaining -= static_cast<uint32_t>(count);
+    return count;
+}
+
+void PngRowReader::unfilter_row() {
+    uint8_t* row = current.data() + 1;
+    const uint8_t* above = previous.data() + 1;
+    size_t stride = filter_stride;
+    switch (current[0]) {
+        case 0:
+            break;
+        case 1:
+            for (size_t i = stride; i < row_bytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + row[i - stride]);
+            }
+            break;
+        case 2:
+            for (size_t i = 0; i < row_bytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + above[i]);
+            }
+            break;
+        case 3:
+            for (size_t i = 0; i < stride && i < row_bytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + (above[i] >> 1));
+            }
+            for (size_t i = stride; i < row_bytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + ((row[i - stride] + above[i]) >> 1));
+            }
+            break;
+        case 4:
+            for (size_t i = 0; i < stride && i < row_bytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + above[i]);
+            }
+            for (size_t i = stride; i < row_bytes; i++) {
+                row[i] = static_cast<uint8_t>(row[i] + paeth(row[i - stride], above[i], above[i - stride]));
+            }
+            break;
+        default:
+            throw std::runtime_error("Invalid PNG filter type.");
+    }
+}
+
+void PngRowReader::expand_row(uint8_t* dst) const {
+    const uint8_t* row = current.data() + 1;
+    uint32_t width = info.width;
+
+    if (bit_depth < 8) {
+        // Packed samples, most significant bits first. Grey is rescaled to 8 bits.
+        uint32_t per_byte = 8 / bit_depth;
+        uint32_t mask = (1u << bit_depth) - 1;
+        uint32_t scale = color_type == color_grey ? 255 / mask : 1;
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t shift = (per_byte - 1 - x % per_byte) * bit_depth;
+            uint32_t value = (row[x / per_byte] >> shift) & mask;
+            if (color_type == color_palette) {
+                memcpy(dst + x * 4, palette + value * 4, 4);
+            } else {
+                uint8_t grey = static_cast<uint8_t>(value * scale);
+                bool transparent = has_color_key && value == color_key[0];
+                dst[x * 4 + 0] = grey;
+                dst[x * 4 + 1] = grey;
+                dst[x * 4 + 2] = grey;
+                dst[x * 4 + 3] = transparent ? 0 : 255;
+            }
+        }
+        return;
+    }
+
+    uint32_t sample_size = bit_depth / 8;
+    for (uint32_t x = 0; x < width; x++) {
+        const uint8_t* pixel = row + static_cast<size_t>(x) * samples_per_pixel * sample_size;
+        uint8_t* out = dst + x * 4;
+        auto sample = [&](uint32_t index) { return pixel[index * sample_size]; };
+        auto full_sample = [&](uint32_t index) {
+            return static_cast<uint16_t>(sample_size == 2 ? pixel[index * 2] << 8 | pixel[index * 2 + 1] : pixel[index]);
+        };
+        switch (color_type) {
+            case color_grey:
+                out[0] = out[1] = out[2] = sample(0);
+                out[3] = has_color_key && full_sample(0) == color_key[0] ? 0 : 255;
+                break;
+            case color_rgb:
+                out[0] = sample(0);
+                out[1] = sample(1);
+                out[2] = sample(2);
+                out[3] = has_color_key && full_sample(0) == color_key[0] && full_sample(1) == color_key[1] && full_sample(2) == color_key[2] ? 0 : 255;
+                break;
+            case color_palette:
+                memcpy(out, palette + pixel[0] * 4, 4);
+                break;
+            case color_grey_alpha:
+                out[0] = out[1] = out[2] = sample(0);
+                out[3] = sample(1);
+                break;
+            default:
+                out[0] = sample(0);
+                out[1] = sample(1);
+                out[2] = sample(2);
+                out[3] = sample(3);
+                break;
+        }
+    }
+}
+
+void PngRowReader::read_rows(uint8_t* dst, size_t dst_row_pitch, uint32_t row_count) {
+    if (rows_read + row_count > info.height) {
+        throw std::runtime_error("Read past the last PNG row.");
+    }
+    for (uint32_t i = 0; i < row_count; i++) {
+        if (inflater->read(current.data(), current.size()) != current.size()) {
+            throw std::runtime_error("PNG image data is truncated.");
+        }
+        unfilter_row();
+        expand_row(dst + i * dst_row_pitch);
+        current.swap(previous);
+    }
+    rows_read += row_count;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "image_decoder.hpp"
+#include "inflate_stream.hpp"
+
+bool is_png(const uint8_t* data, size_t size);
+
+// Streams a non-interlaced PNG row by row: IDAT data is pulled from the
+// source and inflated only as far as the rows asked for, so memory is two
+// scanlines plus the inflate window. All colour types and bit depths are
+// expanded to RGBA8; 16-bit samples keep their high byte. CRCs are not
+// checked, matching stb_image.
+class PngRowReader : public ImageRowReader {
+public:
+    // Reads the chunks up to the first IDAT. Throws std::runtime_error on
+    // malformed files and on interlaced ones, which cannot be streamed.
+    explicit PngRowReader(ImageSource& source);
+
+    void read_rows(uint8_t* dst, size_t dst_row_pitch, uint32_t row_count) override;
+
+private:
+    size_t read_image_data(uint8_t* dst, size_t size);
+    bool read_chunk_header(uint32_t& length, uint32_t& type);
+    void unfilter_row();
+    void expand_row(uint8_t* dst) const;
+
+    ImageSource& source;
+    uint32_t bit_depth;
+    uint32_t color_type;
+    uint32_t samples_per_pixel;
+    size_t row_bytes;
+    uint32_t filter_stride;
+    uint32_t rows_read;
+
+    uint8_t palette[256 * 4];
+    bool has_color_key;
+    uint16_t color_key[3];
+
+    uint32_t data_remaining;
+    bool data_ended;
+    std::unique_ptr<InflateStream> inflater;
+    // Filter byte plus scanline; previous starts as zeros for the first row's filters.
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> previous;
+};
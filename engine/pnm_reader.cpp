@@ -0,0 +1,367 @@
+#include "pnm_reader.hpp"
+#include "job_pool.hpp"
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <emmintrin.h>
+#if defined(__SSSE3__) || defined(_MSC_VER)
+#include <tmmintrin.h>
+#define PNM_HAS_SSSE3 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static uint32_t count_trailing_zeros(uint32_t value) {
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+}
+#else
+static uint32_t count_trailing_zeros(uint32_t value) {
+    return static_cast<uint32_t>(__builtin_ctz(value));
+}
+#endif
+
+bool is_pnm(const uint8_t* data, size_t size) {
+    return size >= 2 && data[0] == 'P' && (data[1] == '2' || data[1] == '3' || data[1] == '5' || data[1] == '6');
+}
+
+static bool is_space(uint8_t c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Header fields are separated by whitespace and may be interleaved with
+// comments running to the end of the line.
+static uint32_t read_header_value(const uint8_t* data, size_t size, size_t& offset) {
+    while (offset < size) {
+        if (data[offset] == '#') {
+            while (offset < size && data[offset] != '\n' && data[offset] != '\r') {
+                offset++;
+            }
+        } else if (is_space(data[offset])) {
+            offset++;
+        } else {
+            break;
+        }
+    }
+    if (offset >= size || data[offset] < '0' || data[offset] > '9') {
+        throw std::runtime_error("Malformed PNM header.");
+    }
+    uint64_t value = 0;
+    while (offset < size && data[offset] >= '0' && data[offset] <= '9') {
+        value = value * 10 + (data[offset++] - '0');
+        if (value > 0xFFFFFFFFu) {
+            throw std::runtime_error("Malformed PNM header.");
+        }
+    }
+    return static_cast<uint32_t>(value);
+}
+
+PnmHeader parse_pnm_header(const uint8_t* data, size_t size) {
+    if (!is_pnm(data, size)) {
+        throw std::runtime_error("Not a PNM file.");
+    }
+
+    PnmHeader header = {};
+    header.ascii = data[1] == '2' || data[1] == '3';
+    header.channels = (data[1] == '3' || data[1] == '6') ? 3 : 1;
+
+    size_t offset = 2;
+    header.width = read_header_value(data, size, offset);
+    header.height = read_header_value(data, size, offset);
+    header.max_value = read_header_value(data, size, offset);
+    if (header.width == 0 || header.height == 0 || header.width > 16384 || header.height > 16384) {
+        throw std::runtime_error("Unsupported PNM dimensions.");
+    }
+    if (header.max_value == 0 || header.max_value > 65535) {
+        throw std::runtime_error("Unsupported PNM maximum value.");
+    }
+
+    // Exactly one whitespace byte separates the header from binary samples.
+    if (offset >= size || !is_space(data[offset])) {
+        throw std::runtime_error("Malformed PNM header.");
+    }
+    header.data_offset = offset + 1;
+    return header;
+}
+
+static std::vector<uint8_t> build_scale_table(uint32_t max_value) {
+    std::vector<uint8_t> table(max_value + 1);
+    for (uint32_t i = 0; i <= max_value; i++) {
+        table[i] = static_cast<uint8_t>((i * 255u + max_value / 2) / max_value);
+    }
+    return table;
+}
+
+static void expand_rgb_row(const uint8_t* src, const uint8_t* src_end, uint32_t width, uint8_t* dst) {
+    uint32_t x = 0;
+#ifdef PNM_HAS_SSSE3
+    // Four 16-byte loads cover 16 pixels; the last one reads 4 bytes past the
+    // 48 consumed, so stop while that still lies inside the file.
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    for (; x + 16 <= width && src + x * 3 + 52 <= src_end; x += 16) {
+        const uint8_t* s = src + x * 3;
+        __m128i* d = reinterpret_cast<__m128i*>(dst + x * 4);
+        _mm_storeu_si128(d + 0, _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 0)), shuffle), alpha));
+        _mm_storeu_si128(d + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 12)), shuffle), alpha));
+        _mm_storeu_si128(d + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 24)), shuffle), alpha));
+        _mm_storeu_si128(d + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 36)), shuffle), alpha));
+    }
+#else
+    (void)src_end;
+#endif
+    for (; x < width; x++) {
+        dst[x * 4 + 0] = src[x * 3 + 0];
+        dst[x * 4 + 1] = src[x * 3 + 1];
+        dst[x * 4 + 2] = src[x * 3 + 2];
+        dst[x * 4 + 3] = 255;
+    }
+}
+
+static void expand_grey_row(const uint8_t* src, uint32_t width, uint8_t* dst) {
+    uint32_t x = 0;
+#ifdef PNM_HAS_SSSE3
+    const __m128i shuffles[4] = {
+        _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1),
+        _mm_setr_epi8(4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1),
+        _mm_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11, -1),
+        _mm_setr_epi8(12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15, 15, -1),
+    };
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    for (; x + 16 <= width; x += 16) {
+        __m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        __m128i* d = reinterpret_cast<__m128i*>(dst + x * 4);
+        for (int i = 0; i < 4; i++) {
+            _mm_storeu_si128(d + i, _mm_or_si128(_mm_shuffle_epi8(grey, shuffles[i]), alpha));
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        uint32_t value = src[x] * 0x010101u | 0xFF000000u;
+        memcpy(dst + x * 4, &value, 4);
+    }
+}
+
+// Rescaled or 16-bit samples; rare enough that a table lookup per sample is fine.
+// Returns false if a sample exceeds max_value. Rows may be expanded on pool
+// workers, so the caller throws once they are done.
+static bool expand_scaled_row(const uint8_t* src, uint32_t width, uint32_t channels, uint32_t max_value, const uint8_t* table, uint8_t* dst) {
+    bool wide = max_value > 255;
+    bool in_range = true;
+    for (uint32_t x = 0; x < width; x++) {
+        uint8_t rgb[3] = {};
+        for (uint32_t c = 0; c < channels; c++) {
+            uint32_t sample = wide ? (static_cast<uint32_t>(src[0]) << 8 | src[1]) : src[0];
+            src += wide ? 2 : 1;
+            in_range &= sample <= max_value;
+            rgb[c] = table[sample > max_value ? 0 : sample];
+        }
+        dst[x * 4 + 0] = rgb[0];
+        dst[x * 4 + 1] = channels == 3 ? rgb[1] : rgb[0];
+        dst[x * 4 + 2] = channels == 3 ? rgb[2] : rgb[0];
+        dst[x * 4 + 3] = 255;
+    }
+    return in_range;
+}
+
+static bool expand_binary_row(const uint8_t* src, const uint8_t* end, const PnmHeader& header, const std::vector<uint8_t>& table, uint8_t* row) {
+    if (!table.empty()) {
+        return expand_scaled_row(src, header.width, header.channels, header.max_value, table.data(), row);
+    }
+    if (header.channels == 3) {
+        expand_rgb_row(src, end, header.width, row);
+    } else {
+        expand_grey_row(src, header.width, row);
+    }
+    return true;
+}
+
+size_t get_pnm_row_size(const PnmHeader& header) {
+    return static_cast<size_t>(header.width) * header.channels * (header.max_value > 255 ? 2 : 1);
+}
+
+void expand_pnm_rows(const uint8_t* samples, const PnmHeader& header, uint32_t row_count, uint8_t* dst, size_t dst_row_pitch) {
+    size_t src_row_size = get_pnm_row_size(header);
+    const uint8_t* end = samples + src_row_size * row_count;
+    std::vector<uint8_t> table;
+    if (header.max_value != 255) {
+        table = build_scale_table(header.max_value);
+    }
+    bool in_range = true;
+    for (uint32_t y = 0; y < row_count; y++) {
+        in_range &= expand_binary_row(samples + y * src_row_size, end, header, table, dst + y * dst_row_pitch);
+    }
+    if (!in_range) {
+        throw std::runtime_error("PNM sample exceeds maximum value.");
+    }
+}
+
+static void decode_binary(const uint8_t* data, size_t size, const PnmHeader& header, uint8_t* dst, size_t dst_row_pitch, JobPool* job_pool) {
+    const uint8_t* samples = data + header.data_offset;
+    const uint8_t* end = data + size;
+    size_t src_row_size = get_pnm_row_size(header);
+    if (header.data_offset + src_row_size * header.height > size) {
+        throw std::runtime_error("PNM file is truncated.");
+    }
+    std::vector<uint8_t> table;
+    if (header.max_value != 255) {
+        table = build_scale_table(header.max_value);
+    }
+
+    // Nothing may throw inside a pool job; a bad sample is recorded and
+    // reported once every row is done.
+    std::atomic<bool> out_of_range(false);
+    auto decode_rows = [&](uint32_t begin, uint32_t end_row) {
+        bool in_range = true;
+        for (uint32_t y = begin; y < end_row; y++) {
+            in_range &= expand_binary_row(samples + y * src_row_size, end, header, table, dst + y * dst_row_pitch);
+        }
+        if (!in_range) {
+            out_of_range.store(true, std::memory_order_relaxed);
+        }
+    };
+
+    // Rows are independent; split large images so the copy runs on every core.
+    uint32_t grain = static_cast<uint32_t>((256 * 1024) / (static_cast<size_t>(header.width) * 4) + 1);
+    if (job_pool) {
+        job_pool->parallel_for(header.height, grain, decode_rows);
+    } else {
+        decode_rows(0, header.height);
+    }
+    if (out_of_range.load(std::memory_order_relaxed)) {
+        throw std::runtime_error("PNM sample exceeds maximum value.");
+    }
+}
+
+static void decode_ascii(const uint8_t* data, size_t size, const PnmHeader& header, uint8_t* dst, size_t dst_row_pitch) {
+    std::vector<uint8_t> table = build_scale_table(header.max_value);
+
+    // Samples are parsed into one packed row, which is then expanded with the
+    // same shuffles as binary files. The padding covers their over-read.
+    size_t row_samples = static_cast<size_t>(header.width) * header.channels;
+    std::vector<uint8_t> row(row_samples + 16);
+    size_t filled = 0;
+    uint32_t y = 0;
+    bool out_of_range = false;
+
+    auto push = [&](uint32_t value) {
+        out_of_range |= value > header.max_value;
+        row[filled++] = table[value > header.max_value ? 0 : value];
+        if (filled == row_samples) {
+            if (header.channels == 3) {
+                expand_rgb_row(row.data(), row.data() + row.size(), header.width, dst + y * dst_row_pitch);
+            } else {
+                expand_grey_row(row.data(), header.width, dst + y * dst_row_pitch);
+            }
+            filled = 0;
+            y++;
+        }
+    };
+
+    const __m128i zero_char = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+
+    // Each 16-byte block is classified into digit and separator bitmasks with
+    // SSE2. Token starts come from the digit mask, so the loop runs once per
+    // sample rather than once per character, and short tokens are converted
+    // without a digit loop.
+    alignas(16) uint8_t digit_values[32] = {};
+    uint32_t carried_value = 0;
+    uint32_t carried_digits = 0;
+    const uint8_t* p = data + header.data_offset;
+    const uint8_t* end = data + size;
+    while (y < header.height && p < end) {
+        uint8_t tail[16];
+        const uint8_t* block = p;
+        if (end - p < 16) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, end - p);
+            block = tail;
+        }
+        p += 16;
+
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+        __m128i values = _mm_sub_epi8(chars, zero_char);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(values, nine), values);
+        __m128i control = _mm_sub_epi8(chars, tab);
+        __m128i is_separator = _mm_or_si128(_mm_cmpeq_epi8(chars, space), _mm_cmpeq_epi8(_mm_min_epu8(control, four), control));
+        _mm_store_si128(reinterpret_cast<__m128i*>(digit_values), values);
+        uint32_t digit_mask = static_cast<uint32_t>(_mm_movemask_epi8(is_digit));
+        uint32_t invalid_mask = ~(digit_mask | static_cast<uint32_t>(_mm_movemask_epi8(is_separator))) & 0xFFFFu;
+        // Anything from the first invalid byte on is only an error if samples are still missing.
+        uint32_t valid_end = invalid_mask ? count_trailing_zeros(invalid_mask) : 16;
+        uint32_t valid_mask = (1u << valid_end) - 1;
+        digit_mask &= valid_mask;
+
+        uint32_t starts = digit_mask & ~(digit_mask << 1);
+        if (carried_digits > 0) {
+            uint32_t run = count_trailing_zeros(~digit_mask);
+            for (uint32_t i = 0; i < run; i++) {
+                carried_value = carried_value * 10 + digit_values[i];
+            }
+            carried_digits += run;
+            if (carried_digits > 5) {
+                throw std::runtime_error("PNM sample exceeds maximum value.");
+            }
+            if (run == 16) {
+                continue;
+            }
+            push(carried_value);
+            carried_value = 0;
+            carried_digits = 0;
+            starts &= ~1u;
+        }
+
+        while (starts && y < header.height) {
+            uint32_t start = count_trailing_zeros(starts);
+            starts &= starts - 1;
+            uint32_t run = count_trailing_zeros(~(digit_mask >> start));
+            if (start + run == 16) {
+                for (uint32_t i = start; i < 16; i++) {
+                    carried_value = carried_value * 10 + digit_values[i];
+                }
+                carried_digits = run;
+                break;
+            }
+            const uint8_t* d = digit_values + start;
+            if (run <= 3) {
+                uint32_t candidates[4] = {0, d[0], d[0] * 10u + d[1], d[0] * 100u + d[1] * 10u + d[2]};
+                push(candidates[run]);
+            } else if (run <= 5) {
+                uint32_t value = 0;
+                for (uint32_t i = 0; i < run; i++) {
+                    value = value * 10 + d[i];
+                }
+                push(value);
+            } else {
+                throw std::runtime_error("PNM sample exceeds maximum value.");
+            }
+        }
+
+        if (valid_end < 16 && y < header.height) {
+            throw std::runtime_error("Unexpected character in PNM data.");
+        }
+    }
+    if (y < header.height && carried_digits > 0) {
+        push(carried_value);
+    }
+    if (out_of_range) {
+        throw std::runtime_error("PNM sample exceeds maximum value.");
+    }
+    if (y < header.height) {
+        throw std::runtime_error("PNM file is truncated.");
+    }
+}
+
+void decode_pnm(const uint8_t* data, size_t size, const PnmHeader& header, uint8_t* dst, size_t dst_row_pitch, JobPool* job_pool) {
+    if (header.ascii) {
+        decode_ascii(data, size, header, dst, dst_row_pitch);
+    } else {
+        decode_binary(data, size, header, dst, dst_row_pitch, job_pool);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class JobPool;
+
+struct PnmHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t max_value;
+    // 1 for P2/P5 greymaps, 3 for P3/P6 pixmaps.
+    uint32_t channels;
+    bool ascii;
+    size_t data_offset;
+};
+
+bool is_pnm(const uint8_t* data, size_t size);
+
+// Throws std::runtime_error on anything that is not a well-formed P2, P3,
+// P5 or P6 header. Only the header has to be present in data; decode_pnm
+// checks the samples.
+PnmHeader parse_pnm_header(const uint8_t* data, size_t size);
+
+// Expands to RGBA8 rows dst_row_pitch bytes apart, so the destination can be
+// a tightly packed buffer or an upload heap footprint. Binary 8-bit files
+// are expanded straight from data with SSSE3 shuffles (rows split across
+// job_pool when given); ASCII files are tokenized 16 bytes at a time with
+// SSE2 character classes. Samples are rescaled when max_value is not 255.
+void decode_pnm(const uint8_t* data, size_t size, const PnmHeader& header, uint8_t* dst, size_t dst_row_pitch, JobPool* job_pool = nullptr);
+
+// Bytes per row of binary samples.
+size_t get_pnm_row_size(const PnmHeader& header);
+
+// Expands row_count rows of binary samples, starting at any row, the same
+// way decode_pnm does. Lets a caller stream a file in bands.
+void expand_pnm_rows(const uint8_t* samples, const PnmHeader& header, uint32_t row_count, uint8_t* dst, size_t dst_row_pitch);
@@ -1,10 +1,25 @@
 #include "renderer.hpp"
 #include "d3dx12.h"
+#include "profiler.hpp"
+#include <chrono>
+#include <cmath>
 #include <stdexcept>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
+// The build points SHADER_SOURCE_DIRECTORY at engine/; only hot reload reads from it.
+#if !defined(SHADER_SOURCE_DIRECTORY)
+#define SHADER_SOURCE_DIRECTORY "engine"
+#endif
+#define WIDEN_STRING(text) L##text
+#define WIDE_STRING(text) WIDEN_STRING(text)
+
+static const char *shader_directory = SHADER_SOURCE_DIRECTORY;
+static const wchar_t *shader_path = WIDE_STRING(SHADER_SOURCE_DIRECTORY "/shaders.hlsl");
+static const char *permutation_manifest_path = SHADER_SOURCE_DIRECTORY "/shader_permutations.txt";
+static const ShaderPermutation scene_permutation = shader_default_permutation;
+
 struct Vertex
 {
     XMFLOAT3 position;
@@ -12,39 +27,116 @@ struct Vertex
     XMFLOAT2 uv;
 };
 
-Renderer::Renderer(UINT width, UINT height, HWND hwnd)
-    : width(width), height(height), hwnd(hwnd), frame_index(0), rotation_angle(0.0f)
+// Must match DrawConstants, ObjectData and Material in shaders.hlsl.
+struct DrawConstants
+{
+    UINT object_index;
+    UINT material_index;
+};
+
+struct ObjectData
+{
+    XMFLOAT4X4 model;
+};
+
+struct MaterialData
+{
+    XMFLOAT4 base_color;
+};
+
+static void set_root_constant_buffer(ID3D12GraphicsCommandList *cmd_list, int parameter, const Buffer &buffer)
+{
+    if (parameter >= 0)
+    {
+        cmd_list->SetGraphicsRootConstantBufferView(parameter, buffer.get_resource()->GetGPUVirtualAddress());
+    }
+}
+
+static void set_root_shader_resource(ID3D12GraphicsCommandList *cmd_list, int parameter, const Buffer &buffer)
+{
+    if (parameter >= 0)
+    {
+        cmd_list->SetGraphicsRootShaderResourceView(parameter, buffer.get_resource()->GetGPUVirtualAddress());
+    }
+}
+
+Renderer::Renderer(UINT width, UINT height, HWND hwnd, UINT frames_in_flight, bool vsync)
+    : width(width), height(height), hwnd(hwnd), frame_index(0), back_buffer_index(0), frames_in_flight(frames_in_flight), frame_latency_waitable(nullptr), frame_latency_acquired(false), vsync(vsync), tearing_supported(false), swap_chain_flags(0), latency_stats(), latency_total_ms(0.0), pipeline(nullptr), pipeline_cache_saved(false), shader_reload_requested(false), cube_streamed_texture(nullptr), cube_streaming_id(0), frame_number(0), requested_width(width), requested_height(height), requested_frames_in_flight(frames_in_flight), requested_vsync(vsync), simulation_frame_number(0), last_update_time(0)
 {
 
     viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
     scissor_rect = CD3DX12_RECT(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
 
+    if (frames_in_flight < 1 || frames_in_flight > max_frames_in_flight)
+    {
+        throw std::runtime_error("Frames in flight must be between 1 and 4.");
+    }
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    qpc_frequency = frequency.QuadPart;
+    latency_stats.frames_in_flight = frames_in_flight;
+    latency_stats.vsync = vsync;
+
     // Initialize fence values and resource states
     fence_counter = 1;
-    for (UINT i = 0; i < frame_count; ++i)
+    for (UINT i = 0; i < max_frames_in_flight; ++i)
     {
         fence_values[i] = 0;
-        render_target_states[i] = D3D12_RESOURCE_STATE_PRESENT;
         command_list_in_use[i] = false;
     }
+    for (UINT i = 0; i < max_back_buffers; ++i)
+    {
+        render_target_states[i] = D3D12_RESOURCE_STATE_PRESENT;
+    }
     depth_buffer_state = D3D12_RESOURCE_STATE_DEPTH_WRITE;
 
+    job_pool = std::make_unique<JobPool>();
+    shader_job_pool = std::make_unique<JobPool>();
+
     init_pipeline();
     load_assets();
 
     camera = std::make_unique<Camera>(XM_PIDIV2, static_cast<float>(width) / height, 0.1f, 100.0f, 5.0f);
-    camera_buffer = std::make_unique<Buffer>(device.Get(), 256, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
-    light_buffer = std::make_unique<Buffer>(device.Get(), 256, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+    simulation = std::make_unique<Simulation>();
+    SimulationObject cube = {{0.0f, 0.0f, 0.0f}, 0.0f, 0.6f};
+    simulation->add_object(cube);
+    MaterialData default_material = {XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f)};
+    material_buffer = std::make_unique<Buffer>(device.Get(), sizeof(MaterialData), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+    memcpy(material_buffer->map(), &default_material, sizeof(default_material));
+    material_buffer->unmap();
+
+    light_clusterer = std::make_unique<LightClusterer>();
+    light_clusterer->set_projection(camera->get_fov(), camera->get_aspect_ratio(), camera->get_near_plane(), camera->get_far_plane());
+
+    // Every slot is created up front so frames in flight can change at runtime.
+    const ClusterGridDesc &grid = light_clusterer->get_desc();
+    for (UINT i = 0; i < max_frames_in_flight; ++i)
+    {
+        camera_buffers[i] = std::make_unique<Buffer>(device.Get(), 256, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+        object_buffers[i] = std::make_unique<Buffer>(device.Get(), max_scene_objects * sizeof(ObjectData), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+        light_buffers[i] = std::make_unique<Buffer>(device.Get(), 256, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+        light_list_buffers[i] = std::make_unique<Buffer>(device.Get(), max_scene_lights * sizeof(ClusterLight), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+        cluster_range_buffers[i] = std::make_unique<Buffer>(device.Get(), light_clusterer->get_cluster_count() * sizeof(ClusterRange), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+        light_index_buffers[i] = std::make_unique<Buffer>(device.Get(), grid.max_light_indices * sizeof(uint32_t), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+    }
+    create_scene_lights();
+
+    render_thread = std::thread(&Renderer::render_thread_main, this);
 }
 
 Renderer::~Renderer()
 {
-    // Wait for all frames to complete
-    for (UINT i = 0; i < frame_count; ++i)
+    packet_queue.close();
+    if (render_thread.joinable())
     {
-        wait_for_frame(i);
+        render_thread.join();
     }
+    wait_for_gpu();
     CloseHandle(fence_event);
+    if (frame_latency_waitable)
+    {
+        CloseHandle(frame_latency_waitable);
+    }
 }
 
 void Renderer::init_pipeline()
@@ -80,14 +172,28 @@ void Renderer::init_pipeline()
         throw std::runtime_error("Failed to create command queue.");
     }
 
+    // Tearing lets presents without vsync go out immediately under the compositor.
+    ComPtr<IDXGIFactory5> factory5;
+    BOOL allow_tearing = FALSE;
+    if (SUCCEEDED(factory.As(&factory5)) && SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allow_tearing, sizeof(allow_tearing))))
+    {
+        tearing_supported = allow_tearing != FALSE;
+    }
+    swap_chain_flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    if (tearing_supported)
+    {
+        swap_chain_flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+    }
+
     DXGI_SWAP_CHAIN_DESC1 swap_chain_desc = {};
-    swap_chain_desc.BufferCount = frame_count;
+    swap_chain_desc.BufferCount = get_back_buffer_count();
     swap_chain_desc.Width = width;
     swap_chain_desc.Height = height;
     swap_chain_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     swap_chain_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
     swap_chain_desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
     swap_chain_desc.SampleDesc.Count = 1;
+    swap_chain_desc.Flags = swap_chain_flags;
 
     ComPtr<IDXGISwapChain1> swap_chain1;
     if (FAILED(factory->CreateSwapChainForHwnd(
@@ -101,10 +207,15 @@ void Renderer::init_pipeline()
         throw std::runtime_error("Failed to create swap chain.");
     }
     swap_chain1.As(&swap_chain);
-    frame_index = swap_chain->GetCurrentBackBufferIndex();
+    back_buffer_index = swap_chain->GetCurrentBackBufferIndex();
+    if (FAILED(swap_chain->SetMaximumFrameLatency(frames_in_flight)))
+    {
+        throw std::runtime_error("Failed to set maximum frame latency.");
+    }
+    frame_latency_waitable = swap_chain->GetFrameLatencyWaitableObject();
 
     D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc = {};
-    rtv_heap_desc.NumDescriptors = frame_count;
+    rtv_heap_desc.NumDescriptors = max_back_buffers;
     rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
     rtv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
     if (FAILED(device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&rtv_heap))))
@@ -123,7 +234,7 @@ void Renderer::init_pipeline()
     }
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_handle(rtv_heap->GetCPUDescriptorHandleForHeapStart());
-    for (UINT i = 0; i < frame_count; i++)
+    for (UINT i = 0; i < get_back_buffer_count(); i++)
     {
         if (FAILED(swap_chain->GetBuffer(i, IID_PPV_ARGS(&render_targets[i]))))
         {
@@ -136,7 +247,7 @@ void Renderer::init_pipeline()
     create_depth_buffer();
 
     // Create per-frame command allocators (pipeline created later)
-    for (UINT i = 0; i < frame_count; ++i)
+    for (UINT i = 0; i < max_frames_in_flight; ++i)
     {
         if (FAILED(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&command_allocators[i]))))
         {
@@ -147,29 +258,7 @@ void Renderer::init_pipeline()
 
 void Renderer::load_assets()
 {
-    D3D12_DESCRIPTOR_RANGE srv_range = {};
-    srv_range.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-    srv_range.NumDescriptors = 1;
-    srv_range.BaseShaderRegister = 0;
-    srv_range.RegisterSpace = 0;
-    srv_range.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-
-    D3D12_ROOT_PARAMETER root_params[3] = {};
-    root_params[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-    root_params[0].Descriptor.ShaderRegister = 0;
-    root_params[0].Descriptor.RegisterSpace = 0;
-    root_params[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
-
-    root_params[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-    root_params[1].Descriptor.ShaderRegister = 1;
-    root_params[1].Descriptor.RegisterSpace = 0;
-    root_params[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-
-    root_params[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-    root_params[2].DescriptorTable.NumDescriptorRanges = 1;
-    root_params[2].DescriptorTable.pDescriptorRanges = &srv_range;
-    root_params[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-
+    PROFILE_SCOPE("load assets");
     D3D12_STATIC_SAMPLER_DESC sampler_desc = {};
     sampler_desc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
     sampler_desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
@@ -185,22 +274,53 @@ void Renderer::load_assets()
     sampler_desc.RegisterSpace = 0;
     sampler_desc.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
-    D3D12_ROOT_SIGNATURE_DESC root_signature_desc = {};
-    root_signature_desc.NumParameters = 3;
-    root_signature_desc.pParameters = root_params;
-    root_signature_desc.NumStaticSamplers = 1;
-    root_signature_desc.pStaticSamplers = &sampler_desc;
-    root_signature_desc.Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+    // The root signature follows from what the shaders bind, recorded at
+    // build time, over every permutation: per-draw data as root constants,
+    // other constant and structured buffers as root descriptors and the
+    // texture through a table.
+    binding_layout = derive_binding_layout(get_embedded_bindings());
+    RootSignatureDesc root_signature_desc(binding_layout, {sampler_desc}, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    root_parameters.draw_constants = binding_layout.find("DrawConstants");
+    root_parameters.camera = binding_layout.find("CameraBuffer");
+    root_parameters.light_constants = binding_layout.find("LightBuffer");
+    root_parameters.diffuse_texture = binding_layout.find("diffuseTexture");
+    root_parameters.lights = binding_layout.find("lights");
+    root_parameters.cluster_ranges = binding_layout.find("clusterRanges");
+    root_parameters.light_indices = binding_layout.find("lightIndices");
+    root_parameters.objects = binding_layout.find("objects");
+    root_parameters.materials = binding_layout.find("materials");
+    if (root_parameters.draw_constants < 0 || binding_layout.parameters[root_parameters.draw_constants].kind != RootParameterKind::constants ||
+        binding_layout.parameters[root_parameters.draw_constants].value_count * 4 < sizeof(DrawConstants))
+    {
+        throw std::runtime_error("DrawConstants must fit in root constants.");
+    }
 
-    std::vector<D3D12_INPUT_ELEMENT_DESC> input_layout = {
+    input_layout = {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
         {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
         {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
-
-    pipeline = std::make_unique<Pipeline>(device.Get(), L"C:\\Users\\supre\\Repository\\Repositories\\benjamin\\engine\\shaders.hlsl", input_layout, root_signature_desc);
+    packed_input_layout = {
+        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"NORMAL", 0, DXGI_FORMAT_R10G10B10A2_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+        {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
+
+    shader_cache = std::make_unique<ShaderCache>("shader_cache");
+    pipeline_cache = std::make_unique<PipelineCache>(device.Get(), "shader_cache/pipelines.bin");
+    root_signature = pipeline_cache->get_root_signature(root_signature_desc.get());
+    shader_permutations = start_shader_permutations(true);
+    pipeline = shader_permutations->wait(scene_permutation);
+    try
+    {
+        shader_watcher = std::make_unique<FileWatcher>(shader_directory);
+    }
+    catch (const std::exception &e)
+    {
+        // Shipped builds have no shader sources next to them.
+        OutputDebugStringA((std::string("Shader hot reload disabled: ") + e.what() + "\n").c_str());
+    }
 
     // Create per-frame command lists now that pipeline is available
-    for (UINT i = 0; i < frame_count; ++i)
+    for (UINT i = 0; i < max_frames_in_flight; ++i)
     {
         if (FAILED(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, command_allocators[i].Get(), pipeline->get_pipeline_state(), IID_PPV_ARGS(&command_lists[i]))))
         {
@@ -364,16 +484,42 @@ void Renderer::load_assets()
         throw std::runtime_error("Failed to create SRV heap.");
     }
 
-    // Load texture
-    cube_texture = std::make_unique<Texture>(device.Get(), command_lists[0].Get(), "C:/Users/supre/Repository/Repositories/benjamin/assets/grass.png");
+    texture_streamer = std::make_unique<TextureStreamer>(texture_budget_bytes, 2, [this](StreamingTextureId id, uint32_t mip, std::vector<uint8_t> &data) {
+        return streamed_textures[id]->read_mip(mip, data);
+    });
 
-    // Create SRV for texture
+    // Load texture. Pre-baked containers start with their mip tail and stream the rest.
+    const std::string cube_texture_path = "C:/Users/supre/Repository/Repositories/benjamin/assets/grass.png";
     D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
     srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srv_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srv_desc.Texture2D.MipLevels = 1;
-    device->CreateShaderResourceView(cube_texture->get_resource(), &srv_desc, srv_heap->GetCPUDescriptorHandleForHeapStart());
+    ID3D12Resource *cube_resource = nullptr;
+    if (cube_texture_path.ends_with(".dds") || cube_texture_path.ends_with(".ktx2"))
+    {
+        streamed_textures.push_back(std::make_unique<StreamedTexture>(device.Get(), command_queue.Get(), command_lists[0].Get(), cube_texture_path));
+        cube_streamed_texture = streamed_textures.back().get();
+        cube_streaming_id = texture_streamer->register_texture(cube_streamed_texture->get_streaming_desc());
+        srv_desc.Format = cube_streamed_texture->get_format();
+        srv_desc.Texture2D.MipLevels = cube_streamed_texture->get_mip_levels();
+        cube_resource = cube_streamed_texture->get_resource();
+    }
+    else
+    {
+        // Loads record into the setup command list, which is executed before the first frame.
+        texture_cache = std::make_unique<ResourceCache<Texture>>(
+            [this](const std::string &path, const uint8_t *data, size_t size) {
+                return std::make_unique<Texture>(device.Get(), command_lists[0].Get(), path, data, size, job_pool.get(), PixelFormat::bc7, ColorSpace::srgb);
+            },
+            [](const Texture &texture) { return texture.get_size_in_bytes(); });
+        cube_texture = texture_cache->acquire(cube_texture_path);
+        srv_desc.Format = cube_texture->get_format();
+        srv_desc.Shader4ComponentMapping = cube_texture->get_component_mapping();
+        srv_desc.Texture2D.MipLevels = cube_texture->get_mip_levels();
+        cube_resource = cube_texture->get_resource();
+    }
+
+    // Create SRV for texture
+    device->CreateShaderResourceView(cube_resource, &srv_desc, srv_heap->GetCPUDescriptorHandleForHeapStart());
 
     vertex_buffer_view.BufferLocation = vertex_buffer->GetGPUVirtualAddress();
     vertex_buffer_view.StrideInBytes = sizeof(Vertex);
@@ -408,6 +554,7 @@ void Renderer::load_assets()
 
 void Renderer::begin_frame()
 {
+    PROFILE_SCOPE("begin frame");
     // Wait for this frame's resources to be available before reusing them
     wait_for_frame(frame_index);
 
@@ -425,23 +572,28 @@ void Renderer::begin_frame()
     command_list_in_use[frame_index] = true;
 }
 
-void Renderer::populate_command_list()
+void Renderer::populate_command_list(const FramePacket &packet)
 {
+    PROFILE_SCOPE("record");
     ID3D12GraphicsCommandList *cmd_list = command_lists[frame_index].Get();
 
-    // Update matrices and buffers
-    camera->update();
-    rotation_angle += 0.01f;
+    // Update buffers from the packet
+    update_texture_streaming(packet);
 
-    DirectX::XMMATRIX model = XMMatrixRotationY(rotation_angle);
-    DirectX::XMMATRIX view = camera->get_view_matrix();
-    DirectX::XMMATRIX proj = camera->get_projection_matrix();
+    void *mapped = camera_buffers[frame_index]->map();
+    memcpy(mapped, &packet.view, sizeof(XMFLOAT4X4));
+    memcpy((char *)mapped + sizeof(XMFLOAT4X4), &packet.projection, sizeof(XMFLOAT4X4));
+    camera_buffers[frame_index]->unmap();
 
-    void *mapped = camera_buffer->map();
-    memcpy(mapped, &model, sizeof(XMMATRIX));
-    memcpy((char *)mapped + sizeof(XMMATRIX), &view, sizeof(XMMATRIX));
-    memcpy((char *)mapped + 2 * sizeof(XMMATRIX), &proj, sizeof(XMMATRIX));
-    camera_buffer->unmap();
+    // One entry per draw; draws only pass its index.
+    ObjectData *objects = static_cast<ObjectData *>(object_buffers[frame_index]->map());
+    for (size_t i = 0; i < packet.draws.size(); ++i)
+    {
+        objects[i].model = packet.draws[i].model;
+    }
+    object_buffers[frame_index]->unmap();
+
+    update_light_clusters(packet);
 
     struct LightData
     {
@@ -449,20 +601,34 @@ void Renderer::populate_command_list()
         float intensity;
         XMFLOAT3 color;
         float ambient;
+        XMUINT3 cluster_dims;
+        UINT point_light_count;
+        XMFLOAT2 screen_size;
+        float cluster_depth_scale;
+        float cluster_depth_bias;
+        float texture_min_lod;
+        XMFLOAT3 padding;
     };
 
+    const ClusterGridDesc &grid = light_clusterer->get_desc();
     LightData light_data = {};
     light_data.direction = XMFLOAT3(-0.5f, -1.0f, -0.5f);
     light_data.intensity = 1.0f;
     light_data.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
     light_data.ambient = 0.15f;
-
-    void *light_mapped = light_buffer->map();
+    light_data.cluster_dims = XMUINT3(grid.tiles_x, grid.tiles_y, grid.slices_z);
+    light_data.point_light_count = static_cast<UINT>(packet.lights.size());
+    light_data.screen_size = XMFLOAT2(static_cast<float>(width), static_cast<float>(height));
+    light_data.cluster_depth_scale = light_clusterer->get_depth_scale();
+    light_data.cluster_depth_bias = light_clusterer->get_depth_bias();
+    light_data.texture_min_lod = cube_streamed_texture ? cube_streamed_texture->get_min_lod() : 0.0f;
+
+    void *light_mapped = light_buffers[frame_index]->map();
     memcpy(light_mapped, &light_data, sizeof(LightData));
-    light_buffer->unmap();
+    light_buffers[frame_index]->unmap();
 
     // Execute render pass only (depth prepass disabled for debugging)
-    populate_render_pass();
+    populate_render_pass(packet);
 
     if (FAILED(cmd_list->Close()))
     {
@@ -480,7 +646,7 @@ void Renderer::transition_resource(ID3D12GraphicsCommandList *cmd_list, ID3D12Re
     }
 }
 
-void Renderer::populate_depth_pass()
+void Renderer::populate_depth_pass(const FramePacket &packet)
 {
     ID3D12GraphicsCommandList *cmd_list = command_lists[frame_index].Get();
 
@@ -499,26 +665,32 @@ void Renderer::populate_depth_pass()
     // Setup depth pass rendering
     cmd_list->SetPipelineState(pipeline->get_pipeline_state());
     cmd_list->SetGraphicsRootSignature(pipeline->get_root_signature());
-    cmd_list->SetGraphicsRootConstantBufferView(0, camera_buffer->get_resource()->GetGPUVirtualAddress());
+    set_root_constant_buffer(cmd_list, root_parameters.camera, *camera_buffers[frame_index]);
+    set_root_shader_resource(cmd_list, root_parameters.objects, *object_buffers[frame_index]);
 
     cmd_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     cmd_list->IASetVertexBuffers(0, 1, &vertex_buffer_view);
     cmd_list->IASetIndexBuffer(&index_buffer_view);
-    cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+    for (UINT i = 0; i < static_cast<UINT>(packet.draws.size()); ++i)
+    {
+        DrawConstants draw = {i, packet.draws[i].material_index};
+        cmd_list->SetGraphicsRoot32BitConstants(root_parameters.draw_constants, sizeof(DrawConstants) / 4, &draw, 0);
+        cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+    }
 }
 
-void Renderer::populate_render_pass()
+void Renderer::populate_render_pass(const FramePacket &packet)
 {
     ID3D12GraphicsCommandList *cmd_list = command_lists[frame_index].Get();
 
     // Explicitly transition render target to RENDER_TARGET state
-    transition_resource(cmd_list, render_targets[frame_index].Get(), render_target_states[frame_index], D3D12_RESOURCE_STATE_RENDER_TARGET);
+    transition_resource(cmd_list, render_targets[back_buffer_index].Get(), render_target_states[back_buffer_index], D3D12_RESOURCE_STATE_RENDER_TARGET);
     
     // Transition depth buffer to readable state for rendering
     transition_resource(cmd_list, depth_stencil_buffer.Get(), depth_buffer_state, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 
     // Set render targets with depth
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_handle(rtv_heap->GetCPUDescriptorHandleForHeapStart(), frame_index, rtv_descriptor_size);
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_handle(rtv_heap->GetCPUDescriptorHandleForHeapStart(), back_buffer_index, rtv_descriptor_size);
     CD3DX12_CPU_DESCRIPTOR_HANDLE dsv_handle(dsv_heap->GetCPUDescriptorHandleForHeapStart());
     cmd_list->OMSetRenderTargets(1, &rtv_handle, FALSE, &dsv_handle);
     
@@ -539,18 +711,32 @@ void Renderer::populate_render_pass()
     // Set pipeline state and root signature
     cmd_list->SetPipelineState(pipeline->get_pipeline_state());
     cmd_list->SetGraphicsRootSignature(pipeline->get_root_signature());
-    cmd_list->SetGraphicsRootConstantBufferView(0, camera_buffer->get_resource()->GetGPUVirtualAddress());
-    cmd_list->SetGraphicsRootConstantBufferView(1, light_buffer->get_resource()->GetGPUVirtualAddress());
-    cmd_list->SetGraphicsRootDescriptorTable(2, srv_heap->GetGPUDescriptorHandleForHeapStart());
-
-    // Draw
+    set_root_constant_buffer(cmd_list, root_parameters.camera, *camera_buffers[frame_index]);
+    set_root_constant_buffer(cmd_list, root_parameters.light_constants, *light_buffers[frame_index]);
+    if (root_parameters.diffuse_texture >= 0)
+    {
+        cmd_list->SetGraphicsRootDescriptorTable(root_parameters.diffuse_texture, srv_heap->GetGPUDescriptorHandleForHeapStart());
+    }
+    set_root_shader_resource(cmd_list, root_parameters.lights, *light_list_buffers[frame_index]);
+    set_root_shader_resource(cmd_list, root_parameters.cluster_ranges, *cluster_range_buffers[frame_index]);
+    set_root_shader_resource(cmd_list, root_parameters.light_indices, *light_index_buffers[frame_index]);
+    set_root_shader_resource(cmd_list, root_parameters.objects, *object_buffers[frame_index]);
+    set_root_shader_resource(cmd_list, root_parameters.materials, *material_buffer);
+
+    // Draw: per-draw state is the two root constants. The scene has one
+    // mesh, so draws differ only in object and material.
     cmd_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     cmd_list->IASetVertexBuffers(0, 1, &vertex_buffer_view);
     cmd_list->IASetIndexBuffer(&index_buffer_view);
-    cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+    for (UINT i = 0; i < static_cast<UINT>(packet.draws.size()); ++i)
+    {
+        DrawConstants draw = {i, packet.draws[i].material_index};
+        cmd_list->SetGraphicsRoot32BitConstants(root_parameters.draw_constants, sizeof(DrawConstants) / 4, &draw, 0);
+        cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+    }
 
     // Explicitly transition back to PRESENT state
-    transition_resource(cmd_list, render_targets[frame_index].Get(), render_target_states[frame_index], D3D12_RESOURCE_STATE_PRESENT);
+    transition_resource(cmd_list, render_targets[back_buffer_index].Get(), render_target_states[back_buffer_index], D3D12_RESOURCE_STATE_PRESENT);
 }
 
 void Renderer::end_frame()
@@ -562,20 +748,225 @@ void Renderer::end_frame()
     }
 }
 
-void Renderer::render()
+bool Renderer::update(InputEventRing &input_events)
+{
+    PROFILE_SCOPE("update");
+    // Work the job threads handed back for this thread (API calls that
+    // must come from the thread owning the window).
+    job_pool->run_main_thread_jobs();
+    shader_job_pool->run_main_thread_jobs();
+
+    // Wait for DXGI to take another frame before anything samples input;
+    // otherwise the packet waits behind the display with stale input. This
+    // paces the simulation to the display, and the render thread through
+    // the packet queue. Only wait briefly: swap chain calls on the render
+    // thread can need this thread to keep pumping window messages. A frame
+    // taken here is kept until a packet slot frees up.
+    if (!frame_latency_acquired)
+    {
+        PROFILE_SCOPE("wait for swap chain");
+        frame_latency_acquired = WaitForSingleObjectEx(frame_latency_waitable, 1, TRUE) == WAIT_OBJECT_0;
+    }
+    int slot = frame_latency_acquired ? packet_queue.begin_write(std::chrono::milliseconds(1)) : -1;
+    if (slot < 0)
+    {
+        if (packet_queue.is_closed() && render_error)
+        {
+            std::rethrow_exception(render_error);
+        }
+        return false;
+    }
+    frame_latency_acquired = false;
+    advance_simulation(input_events);
+    build_frame_packet(frame_packets[slot]);
+    packet_queue.publish();
+    return true;
+}
+
+void Renderer::advance_simulation(InputEventRing &input_events)
+{
+    PROFILE_SCOPE("simulate");
+    // Real time since the last packet, spent in whole steps; a long stall
+    // catches up a few steps in a burst and drops the rest.
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    if (last_update_time != 0)
+    {
+        timestep.add_time(static_cast<double>(now.QuadPart - last_update_time) / qpc_frequency);
+    }
+    last_update_time = now.QuadPart;
+
+    float dt = static_cast<float>(timestep.get_step_seconds());
+    while (timestep.step())
+    {
+        consume_input(input_events);
+        camera->update(dt, input_state);
+        simulation->step(timestep.get_step_seconds());
+    }
+    // As late as possible before recording: look input that arrived during
+    // the steps still turns this frame's view.
+    consume_input(input_events);
+}
+
+void Renderer::consume_input(InputEventRing &input_events)
+{
+    PROFILE_SCOPE("input");
+    // Events apply before the step numbered by the current tick, live or
+    // replayed, which keeps a replay in step with its recording.
+    uint64_t tick = simulation->get_tick();
+    InputEvent event;
+    while (input_events.pop(event))
+    {
+        if (input_replay)
+        {
+            continue;
+        }
+        input_state.apply(event);
+        if (input_recorder)
+        {
+            input_recorder->write(tick, event);
+        }
+    }
+    if (input_replay)
+    {
+        while (input_replay->next(tick, event))
+        {
+            input_state.apply(event);
+        }
+        if (input_replay->is_finished())
+        {
+            input_replay.reset();
+        }
+    }
+
+    int32_t dx;
+    int32_t dy;
+    input_state.take_mouse_delta(dx, dy);
+    camera->look(dx, dy);
+}
+
+void Renderer::record_input(const std::string &path)
+{
+    input_recorder = std::make_unique<InputRecorder>(path, std::llround(timestep.get_step_seconds() * 1e9));
+}
+
+void Renderer::stop_input_recording()
+{
+    if (input_recorder)
+    {
+        std::unique_ptr<InputRecorder> recorder = std::move(input_recorder);
+        recorder->close();
+    }
+}
+
+void Renderer::replay_input(const std::string &path)
 {
+    std::unique_ptr<InputReplay> replay = std::make_unique<InputReplay>(path);
+    if (replay->get_step_ns() != static_cast<uint64_t>(std::llround(timestep.get_step_seconds() * 1e9)))
+    {
+        throw std::runtime_error("Input recording " + path + " was made with a different simulation step.");
+    }
+    // Start from a clean slate, as the recording did.
+    input_state = InputState();
+    input_replay = std::move(replay);
+}
+
+void Renderer::build_frame_packet(FramePacket &packet)
+{
+    PROFILE_SCOPE("build frame packet");
+    LARGE_INTEGER input_time;
+    QueryPerformanceCounter(&input_time);
+    float alpha = timestep.get_alpha();
+
+    packet.frame_number = ++simulation_frame_number;
+    packet.input_time = input_time.QuadPart;
+    packet.width = requested_width;
+    packet.height = requested_height;
+    packet.frames_in_flight = requested_frames_in_flight;
+    packet.vsync = requested_vsync;
+    XMStoreFloat4x4(&packet.view, camera->get_interpolated_view_matrix(alpha));
+    XMStoreFloat4x4(&packet.projection, camera->get_projection_matrix());
+    packet.camera_position = camera->get_interpolated_position(alpha);
+    packet.fov = camera->get_fov();
+    packet.aspect_ratio = camera->get_aspect_ratio();
+    packet.near_plane = camera->get_near_plane();
+    packet.far_plane = camera->get_far_plane();
+
+    // The vectors keep their capacity from the last use of this slot.
+    simulation->interpolate(alpha, object_transforms);
+    packet.draws.clear();
+    for (size_t i = 0; i < object_transforms.size() && i < max_scene_objects; ++i)
+    {
+        const ObjectTransform &transform = object_transforms[i];
+        DrawPacket draw = {};
+        XMStoreFloat4x4(&draw.model, XMMatrixRotationY(transform.yaw) * XMMatrixTranslation(transform.position[0], transform.position[1], transform.position[2]));
+        draw.material_index = 0;
+        packet.draws.push_back(draw);
+    }
+    packet.lights.assign(scene_lights.begin(), scene_lights.end());
+}
+
+void Renderer::render_thread_main()
+{
+    Profiler::set_thread_name("render");
+    try
+    {
+        for (int slot = packet_queue.acquire(); slot >= 0; slot = packet_queue.acquire())
+        {
+            render(frame_packets[slot]);
+            packet_queue.release();
+        }
+    }
+    catch (...)
+    {
+        // Closing wakes the main thread, which rethrows it from update().
+        render_error = std::current_exception();
+        packet_queue.close();
+    }
+}
+
+void Renderer::apply_frame_settings(const FramePacket &packet)
+{
+    if (packet.width != width || packet.height != height)
+    {
+        resize_swap_chain(packet.width, packet.height);
+        light_clusterer->set_projection(packet.fov, packet.aspect_ratio, packet.near_plane, packet.far_plane);
+    }
+    if (packet.frames_in_flight != frames_in_flight)
+    {
+        apply_frames_in_flight(packet.frames_in_flight);
+    }
+    if (packet.vsync != vsync)
+    {
+        apply_vsync(packet.vsync);
+    }
+}
+
+void Renderer::render(const FramePacket &packet)
+{
+    PROFILE_SCOPE("render");
+    apply_frame_settings(packet);
+    // update() already waited for the swap chain to take this frame.
     begin_frame();
-    populate_command_list();
+    populate_command_list(packet);
 
     // Execute the command list for this frame
     ID3D12CommandList *cmd_lists[] = {command_lists[frame_index].Get()};
-    command_queue->ExecuteCommandLists(_countof(cmd_lists), cmd_lists);
+    {
+        PROFILE_SCOPE("execute");
+        command_queue->ExecuteCommandLists(_countof(cmd_lists), cmd_lists);
+    }
 
     // Present the back buffer
-    if (FAILED(swap_chain->Present(1, 0)))
+    UINT present_flags = !vsync && tearing_supported ? DXGI_PRESENT_ALLOW_TEARING : 0;
     {
-        throw std::runtime_error("Failed to present swap chain.");
+        PROFILE_SCOPE("present");
+        if (FAILED(swap_chain->Present(vsync ? 1 : 0, present_flags)))
+        {
+            throw std::runtime_error("Failed to present swap chain.");
+        }
     }
+    record_present_latency(packet.input_time);
 
     // Assign fence value before signaling
     fence_values[frame_index] = fence_counter;
@@ -584,64 +975,266 @@ void Renderer::render()
     // Signal fence for this frame
     end_frame();
 
+    // Frame boundary: the only point where pipelines may be swapped
+    update_shader_reload();
+
     // Mark command list as no longer in use
     command_list_in_use[frame_index] = false;
 
     // Move to next frame
-    frame_index = swap_chain->GetCurrentBackBufferIndex();
+    frame_index = (frame_index + 1) % frames_in_flight;
+    back_buffer_index = swap_chain->GetCurrentBackBufferIndex();
 }
 
-void Renderer::wait_for_frame(UINT frame_idx)
+void Renderer::record_present_latency(INT64 input_time)
 {
-    // If this frame has been used before, wait for GPU to finish with it
-    if (fence_values[frame_idx] > 0 && fence->GetCompletedValue() < fence_values[frame_idx])
+    UINT present_id = 0;
+    if (FAILED(swap_chain->GetLastPresentCount(&present_id)))
     {
-        if (FAILED(fence->SetEventOnCompletion(fence_values[frame_idx], fence_event)))
+        return;
+    }
+    pending_presents.push_back({present_id, input_time});
+
+    // Statistics only name the latest present to reach the screen and the
+    // vblank it did so at; presents it skipped over are dropped unmeasured.
+    DXGI_FRAME_STATISTICS frame_stats;
+    if (SUCCEEDED(swap_chain->GetFrameStatistics(&frame_stats)))
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex);
+        while (!pending_presents.empty() && pending_presents.front().present_id <= frame_stats.PresentCount)
         {
-            throw std::runtime_error("Failed to set fence event.");
+            const PendingPresent &present = pending_presents.front();
+            if (present.present_id == frame_stats.PresentCount && frame_stats.SyncQPCTime.QuadPart > present.input_time)
+            {
+                double ms = (frame_stats.SyncQPCTime.QuadPart - present.input_time) * 1000.0 / qpc_frequency;
+                latency_stats.last_ms = ms;
+                latency_stats.max_ms = ms > latency_stats.max_ms ? ms : latency_stats.max_ms;
+                latency_total_ms += ms;
+                latency_stats.samples++;
+                latency_stats.average_ms = latency_total_ms / latency_stats.samples;
+            }
+            pending_presents.pop_front();
         }
-        WaitForSingleObject(fence_event, INFINITE);
+    }
+    // Statistics are unavailable in some presentation modes; keep the queue bounded.
+    while (pending_presents.size() > 2 * max_frames_in_flight)
+    {
+        pending_presents.pop_front();
     }
 }
 
+FrameLatencyStats Renderer::get_latency_stats() const
+{
+    std::lock_guard<std::mutex> lock(latency_mutex);
+    return latency_stats;
+}
+
 void Renderer::resize(UINT new_width, UINT new_height)
 {
     if (new_width == 0 || new_height == 0)
         return;
 
-    // Wait for all frames to complete before resizing
-    for (UINT i = 0; i < frame_count; ++i)
+    requested_width = new_width;
+    requested_height = new_height;
+    camera->set_aspect_ratio(static_cast<float>(new_width) / new_height);
+}
+
+void Renderer::set_frames_in_flight(UINT count)
+{
+    if (count < 1 || count > max_frames_in_flight)
+    {
+        throw std::runtime_error("Frames in flight must be between 1 and 4.");
+    }
+    requested_frames_in_flight = count;
+}
+
+void Renderer::set_vsync(bool enabled)
+{
+    requested_vsync = enabled;
+}
+
+void Renderer::apply_frames_in_flight(UINT count)
+{
+    wait_for_gpu();
+    frames_in_flight = count;
+    if (FAILED(swap_chain->SetMaximumFrameLatency(frames_in_flight)))
+    {
+        throw std::runtime_error("Failed to set maximum frame latency.");
+    }
+    resize_back_buffers(width, height);
+    frame_index = 0;
+    pending_presents.clear();
+    std::lock_guard<std::mutex> lock(latency_mutex);
+    latency_stats = {};
+    latency_stats.frames_in_flight = frames_in_flight;
+    latency_stats.vsync = vsync;
+    latency_total_ms = 0.0;
+}
+
+void Renderer::apply_vsync(bool enabled)
+{
+    vsync = enabled;
+    pending_presents.clear();
+    std::lock_guard<std::mutex> lock(latency_mutex);
+    latency_stats = {};
+    latency_stats.frames_in_flight = frames_in_flight;
+    latency_stats.vsync = vsync;
+    latency_total_ms = 0.0;
+}
+
+UINT Renderer::get_back_buffer_count() const
+{
+    return frames_in_flight < 2 ? 2 : frames_in_flight;
+}
+
+void Renderer::wait_for_gpu()
+{
+    for (UINT i = 0; i < max_frames_in_flight; ++i)
     {
         wait_for_frame(i);
     }
+}
 
-    // Release old render targets
-    for (UINT i = 0; i < frame_count; i++)
+std::unique_ptr<ShaderPermutationSet> Renderer::start_shader_permutations(bool embedded)
+{
+    ShaderPermutationSet::PipelineFactory factory =
+        [this](const ShaderPermutation &permutation, D3D12_SHADER_BYTECODE vertex_shader, D3D12_SHADER_BYTECODE pixel_shader)
+        {
+            const std::vector<D3D12_INPUT_ELEMENT_DESC> &layout = permutation.features & shader_feature_packed_vertices ? packed_input_layout : input_layout;
+            return std::make_unique<Pipeline>(device.Get(), root_signature.Get(), vertex_shader, pixel_shader, layout, pipeline_cache.get());
+        };
+
+    if (embedded)
     {
-        render_targets[i].Reset();
+        return std::make_unique<ShaderPermutationSet>(
+            *shader_job_pool, get_embedded_manifest(),
+            [](const ShaderStageCompile &compile, std::vector<uint8_t> &)
+            {
+                const EmbeddedShader *shader = find_embedded_shader(compile.stage, compile.permutation);
+                if (!shader)
+                {
+                    throw std::runtime_error("Shader permutation was not compiled into the build.");
+                }
+                return D3D12_SHADER_BYTECODE{shader->bytecode, shader->size};
+            },
+            std::move(factory));
     }
 
-    // Resize swap chain
-    if (FAILED(swap_chain->ResizeBuffers(frame_count, new_width, new_height, DXGI_FORMAT_R8G8B8A8_UNORM, 0)))
+    return std::make_unique<ShaderPermutationSet>(
+        *shader_job_pool, load_permutation_manifest(permutation_manifest_path),
+        [this](const ShaderStageCompile &compile, std::vector<uint8_t> &storage)
+        {
+            bool vertex = compile.stage == PipelineShaderStage::vertex;
+            storage = Pipeline::compile_shader(shader_path, vertex ? "VSMain" : "PSMain", vertex ? "vs_5_0" : "ps_5_0",
+                                               get_permutation_defines(compile.permutation, compile.stage), Pipeline::get_default_compile_flags(), shader_cache.get());
+            D3D12_SHADER_BYTECODE bytecode = {storage.data(), storage.size()};
+            // The root signature is fixed for the run; edits must bind within it.
+            std::string missing;
+            if (!binding_layout.covers(reflect_shader_bindings(bytecode, compile.stage), &missing))
+            {
+                throw std::runtime_error("Shader binding " + missing + " is not in the root signature; restart to pick it up.");
+            }
+            return bytecode;
+        },
+        std::move(factory));
+}
+
+void Renderer::update_shader_reload()
+{
+    PROFILE_SCOPE("shader reload");
+    UINT64 completed_fence = fence->GetCompletedValue();
+    bool released = false;
+    while (!retired_shader_permutations.empty() && retired_shader_permutations.front().fence_value <= completed_fence)
     {
-        throw std::runtime_error("Failed to resize swap chain buffers.");
+        retired_shader_permutations.pop_front();
+        released = true;
+    }
+    if (released)
+    {
+        pipeline_cache->purge_unused();
     }
 
-    // Get current back buffer index
-    frame_index = swap_chain->GetCurrentBackBufferIndex();
+    std::vector<std::string> changes;
+    if (shader_watcher)
+    {
+        changes = shader_watcher->take_changes();
+    }
+    for (const std::string &name : changes)
+    {
+        bool is_shader = name.size() > 5 && name.compare(name.size() - 5, 5, ".hlsl") == 0;
+        shader_reload_requested = shader_reload_requested || is_shader || name == "shader_permutations.txt";
+    }
+    // Edits made while a rebuild runs start another one after it.
+    if (shader_reload_requested && !pending_shader_permutations)
+    {
+        shader_reload_requested = false;
+        try
+        {
+            pending_shader_permutations = start_shader_permutations(false);
+        }
+        catch (const std::exception &e)
+        {
+            set_shader_reload_error(e.what());
+        }
+    }
 
-    // Recreate render target views
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_handle(rtv_heap->GetCPUDescriptorHandleForHeapStart());
-    for (UINT i = 0; i < frame_count; i++)
+    if (pending_shader_permutations && pending_shader_permutations->is_complete())
     {
-        if (FAILED(swap_chain->GetBuffer(i, IID_PPV_ARGS(&render_targets[i]))))
+        std::string error = pending_shader_permutations->get_first_error();
+        if (error.empty())
         {
-            throw std::runtime_error("Failed to get swap chain buffer.");
+            // The frame just submitted may still draw with the old set.
+            retired_shader_permutations.push_back({fence_values[frame_index], std::move(shader_permutations)});
+            shader_permutations = std::move(pending_shader_permutations);
+            pipeline = shader_permutations->get_pipeline(scene_permutation);
+            pipeline_cache_saved = false;
         }
-        device->CreateRenderTargetView(render_targets[i].Get(), nullptr, rtv_handle);
-        rtv_handle.Offset(1, rtv_descriptor_size);
+        else
+        {
+            pending_shader_permutations.reset();
+        }
+        set_shader_reload_error(error);
     }
 
+    // Permutations keep landing over the first frames; persist them once all are in.
+    if (!pipeline_cache_saved && shader_permutations->is_complete())
+    {
+        pipeline_cache->save();
+        pipeline_cache_saved = true;
+    }
+}
+
+void Renderer::set_shader_reload_error(const std::string &error)
+{
+    std::lock_guard<std::mutex> lock(shader_reload_error_mutex);
+    shader_reload_error = error;
+}
+
+std::string Renderer::get_shader_reload_error() const
+{
+    std::lock_guard<std::mutex> lock(shader_reload_error_mutex);
+    return shader_reload_error;
+}
+
+void Renderer::wait_for_frame(UINT frame_idx)
+{
+    // If this frame has been used before, wait for GPU to finish with it
+    if (fence_values[frame_idx] > 0 && fence->GetCompletedValue() < fence_values[frame_idx])
+    {
+        if (FAILED(fence->SetEventOnCompletion(fence_values[frame_idx], fence_event)))
+        {
+            throw std::runtime_error("Failed to set fence event.");
+        }
+        WaitForSingleObject(fence_event, INFINITE);
+    }
+}
+
+void Renderer::resize_swap_chain(UINT new_width, UINT new_height)
+{
+    // Wait for all frames to complete before resizing
+    wait_for_gpu();
+    resize_back_buffers(new_width, new_height);
+
     // Update viewport and scissor rect
     width = new_width;
     height = new_height;
@@ -651,9 +1244,35 @@ void Renderer::resize(UINT new_width, UINT new_height)
     // Recreate depth buffer
     depth_stencil_buffer.Reset();
     create_depth_buffer();
+}
+
+void Renderer::resize_back_buffers(UINT new_width, UINT new_height)
+{
+    // Release old render targets
+    for (UINT i = 0; i < max_back_buffers; i++)
+    {
+        render_targets[i].Reset();
+        render_target_states[i] = D3D12_RESOURCE_STATE_PRESENT;
+    }
 
-    // Update camera aspect ratio
-    camera->set_aspect_ratio(static_cast<float>(width) / height);
+    // Resize swap chain; the flags have to match creation
+    if (FAILED(swap_chain->ResizeBuffers(get_back_buffer_count(), new_width, new_height, DXGI_FORMAT_R8G8B8A8_UNORM, swap_chain_flags)))
+    {
+        throw std::runtime_error("Failed to resize swap chain buffers.");
+    }
+    back_buffer_index = swap_chain->GetCurrentBackBufferIndex();
+
+    // Recreate render target views
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtv_handle(rtv_heap->GetCPUDescriptorHandleForHeapStart());
+    for (UINT i = 0; i < get_back_buffer_count(); i++)
+    {
+        if (FAILED(swap_chain->GetBuffer(i, IID_PPV_ARGS(&render_targets[i]))))
+        {
+            throw std::runtime_error("Failed to get swap chain buffer.");
+        }
+        device->CreateRenderTargetView(render_targets[i].Get(), nullptr, rtv_handle);
+        rtv_handle.Offset(1, rtv_descriptor_size);
+    }
 }
 
 void Renderer::create_depth_buffer()
@@ -686,4 +1305,99 @@ void Renderer::create_depth_buffer()
     dsv_desc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
 
     device->CreateDepthStencilView(depth_stencil_buffer.Get(), &dsv_desc, dsv_heap->GetCPUDescriptorHandleForHeapStart());
-}
\ No newline at end of file
+}
+
+void Renderer::create_scene_lights()
+{
+    // Rings of small colored point lights around the cube, with a few spots
+    // mixed in, to exercise the cluster grid.
+    scene_lights.clear();
+    const UINT ring_count = 16;
+    const UINT lights_per_ring = 64;
+    for (UINT ring = 0; ring < ring_count; ++ring)
+    {
+        float ring_radius = 2.0f + ring * 1.5f;
+        float ring_height = -2.0f + 4.0f * ring / (ring_count - 1);
+        for (UINT i = 0; i < lights_per_ring && scene_lights.size() < max_scene_lights; ++i)
+        {
+            float angle = XM_2PI * i / lights_per_ring + ring * 0.37f;
+            ClusterLight light = {};
+            light.position[0] = cosf(angle) * ring_radius;
+            light.position[1] = ring_height;
+            light.position[2] = sinf(angle) * ring_radius;
+            light.range = 1.5f;
+            light.color[0] = 0.5f + 0.5f * cosf(angle);
+            light.color[1] = 0.5f + 0.5f * cosf(angle + XM_2PI / 3.0f);
+            light.color[2] = 0.5f + 0.5f * cosf(angle + 2.0f * XM_2PI / 3.0f);
+            light.intensity = 2.0f;
+            light.spot_cos_outer = -2.0f;
+            if (i % 8 == 0)
+            {
+                // Spot pointing back at the origin
+                float inv_len = 1.0f / sqrtf(ring_radius * ring_radius + ring_height * ring_height);
+                light.direction[0] = -light.position[0] * inv_len;
+                light.direction[1] = -light.position[1] * inv_len;
+                light.direction[2] = -light.position[2] * inv_len;
+                light.range = 4.0f;
+                light.spot_cos_outer = cosf(XMConvertToRadians(30.0f));
+                light.spot_cos_inner = cosf(XMConvertToRadians(20.0f));
+            }
+            scene_lights.push_back(light);
+        }
+    }
+}
+
+void Renderer::update_light_clusters(const FramePacket &packet)
+{
+    PROFILE_SCOPE("light binning");
+    light_clusterer->bin(&packet.view.m[0][0], packet.lights.data(), static_cast<uint32_t>(packet.lights.size()), job_pool.get());
+
+    void *light_list = light_list_buffers[frame_index]->map();
+    memcpy(light_list, packet.lights.data(), packet.lights.size() * sizeof(ClusterLight));
+    light_list_buffers[frame_index]->unmap();
+
+    const std::vector<ClusterRange> &ranges = light_clusterer->get_cluster_ranges();
+    void *range_data = cluster_range_buffers[frame_index]->map();
+    memcpy(range_data, ranges.data(), ranges.size() * sizeof(ClusterRange));
+    cluster_range_buffers[frame_index]->unmap();
+
+    const std::vector<uint32_t> &indices = light_clusterer->get_light_indices();
+    void *index_data = light_index_buffers[frame_index]->map();
+    memcpy(index_data, indices.data(), indices.size() * sizeof(uint32_t));
+    light_index_buffers[frame_index]->unmap();
+}
+
+void Renderer::update_texture_streaming(const FramePacket &packet)
+{
+    PROFILE_SCOPE("texture streaming");
+    ++frame_number;
+
+    if (cube_streamed_texture)
+    {
+        // The cube sits at the origin; its bounding sphere sets the wanted detail.
+        XMFLOAT3 eye = packet.camera_position;
+        float distance = sqrtf(eye.x * eye.x + eye.y * eye.y + eye.z * eye.z);
+        float screen_size = TextureStreamer::compute_screen_size(0.87f, distance, packet.fov, static_cast<float>(height));
+        texture_streamer->request(cube_streaming_id, screen_size, frame_number);
+    }
+
+    // Everything recorded or queued now retires with this frame's fence.
+    UINT64 retire_fence = fence_counter;
+    ID3D12GraphicsCommandList *cmd_list = command_lists[frame_index].Get();
+
+    StreamingUpdate update = texture_streamer->update(frame_number);
+    for (const MipEviction &eviction : update.evicted)
+    {
+        streamed_textures[eviction.texture]->evict(command_queue.Get(), eviction.resident_mip, retire_fence);
+    }
+    for (const StreamedMip &mip : update.loaded)
+    {
+        streamed_textures[mip.texture]->make_resident(device.Get(), command_queue.Get(), cmd_list, mip.mip, mip.data, retire_fence);
+    }
+
+    UINT64 completed_fence = fence->GetCompletedValue();
+    for (std::unique_ptr<StreamedTexture> &texture : streamed_textures)
+    {
+        texture->release_retired(completed_fence);
+    }
+}
@@ -4,35 +4,156 @@
 #include <dxgi1_6.h>
 #include <DirectXMath.h>
 #include <wrl.h>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include "pipeline.hpp"
+#include "shader_permutation_set.hpp"
+#include "embedded_shaders.hpp"
+#include "shader_reflection.hpp"
 #include "camera.hpp"
 #include "buffer.hpp"
 #include "texture.hpp"
+#include "job_pool.hpp"
+#include "light_clusters.hpp"
+#include "streamed_texture.hpp"
+#include "texture_streamer.hpp"
+#include "resource_cache.hpp"
+#include "file_watcher.hpp"
+#include "frame_packet_queue.hpp"
+#include "fixed_timestep.hpp"
+#include "simulation.hpp"
+#include "input.hpp"
+
+struct FrameLatencyStats
+{
+    UINT frames_in_flight;
+    bool vsync;
+    // From sampling input for a frame to the vblank that put it on screen,
+    // per DXGI frame statistics; display processing comes on top.
+    double last_ms;
+    double average_ms;
+    double max_ms;
+    UINT64 samples;
+};
+
+struct DrawPacket
+{
+    DirectX::XMFLOAT4X4 model;
+    UINT material_index;
+};
+
+// Everything the render thread needs for one frame. The main thread builds
+// it; once published it is read-only until the render thread releases it.
+struct FramePacket
+{
+    UINT64 frame_number;
+    // When input was sampled for this frame (QPC ticks).
+    INT64 input_time;
+    // Settings as of this frame; the render thread applies changes first.
+    UINT width;
+    UINT height;
+    UINT frames_in_flight;
+    bool vsync;
+    DirectX::XMFLOAT4X4 view;
+    DirectX::XMFLOAT4X4 projection;
+    DirectX::XMFLOAT3 camera_position;
+    float fov;
+    float aspect_ratio;
+    float near_plane;
+    float far_plane;
+    // At most max_scene_objects; the index of a draw is its object index.
+    std::vector<DrawPacket> draws;
+    std::vector<ClusterLight> lights;
+};
 
 class Renderer
 {
 public:
-    Renderer(UINT width, UINT height, HWND hwnd);
+    Renderer(UINT width, UINT height, HWND hwnd, UINT frames_in_flight = 2, bool vsync = true);
     ~Renderer();
 
-    void render();
+    // Main thread. Runs the fixed simulation steps the elapsed time calls
+    // for, then hands a packet blending the last two steps to the render
+    // thread, which records and submits it while the main thread moves on.
+    // Input events are drained before every step and once more just before
+    // the packet is built. False when the render thread still holds both
+    // packets; pump messages and call again. Rethrows anything the render
+    // thread threw.
+    bool update(InputEventRing& input_events);
+
+    // Main thread. Recording writes every input event applied, tagged with
+    // its simulation tick. Replaying applies a recording's events at the
+    // same ticks in place of live input, until it runs out. Both throw
+    // std::runtime_error on file errors.
+    void record_input(const std::string& path);
+    void replay_input(const std::string& path);
+    // Closes the recording, if any; throws if it could not all be written.
+    void stop_input_recording();
+    bool is_replaying_input() const { return input_replay != nullptr; }
+
+    // Main thread; like the settings below, the render thread applies the
+    // change with the next packet.
     void resize(UINT new_width, UINT new_height);
+    // Frames the CPU may run ahead of the display, 1 to max_frames_in_flight.
+    // Fewer lowers input latency, more absorbs frame time spikes. Applying it
+    // waits for the GPU to go idle.
+    void set_frames_in_flight(UINT count);
+    UINT get_frames_in_flight() const { return requested_frames_in_flight; }
+    // Without vsync, presents tear when the display supports it.
+    void set_vsync(bool enabled);
+    bool get_vsync() const { return requested_vsync; }
+
+    // Measured since the last change of either setting.
+    FrameLatencyStats get_latency_stats() const;
+    FramePipelineTimings get_frame_timings() const { return packet_queue.get_timings(); }
+    // Why the last shader reload was rejected; empty once one succeeds.
+    std::string get_shader_reload_error() const;
+
+    static const UINT max_frames_in_flight = 4;
 
 private:
     void init_pipeline();
     void load_assets();
+    void advance_simulation(InputEventRing& input_events);
+    // Applies pending events ahead of the next step and turns the camera.
+    void consume_input(InputEventRing& input_events);
+    void build_frame_packet(FramePacket& packet);
+    void render_thread_main();
+    void render(const FramePacket& packet);
+    void apply_frame_settings(const FramePacket& packet);
+    void resize_swap_chain(UINT new_width, UINT new_height);
+    void apply_frames_in_flight(UINT count);
+    void apply_vsync(bool enabled);
     void begin_frame();
-    void populate_command_list();
-    void populate_depth_pass();
-    void populate_render_pass();
+    void populate_command_list(const FramePacket& packet);
+    void populate_depth_pass(const FramePacket& packet);
+    void populate_render_pass(const FramePacket& packet);
     void transition_resource(ID3D12GraphicsCommandList* cmd_list, ID3D12Resource* resource, D3D12_RESOURCE_STATES& current_state, D3D12_RESOURCE_STATES new_state);
     void end_frame();
     void wait_for_frame(UINT frame_idx);
     void create_depth_buffer();
+    // Resizes the swap chain to the current back buffer count and recreates the views.
+    void resize_back_buffers(UINT new_width, UINT new_height);
+    UINT get_back_buffer_count() const;
+    void wait_for_gpu();
+    void record_present_latency(INT64 input_time);
+    void create_scene_lights();
+    void update_light_clusters(const FramePacket& packet);
+    void update_texture_streaming(const FramePacket& packet);
+    // Embedded bytecode at startup; hot reload compiles from the sources.
+    std::unique_ptr<ShaderPermutationSet> start_shader_permutations(bool embedded);
+    void update_shader_reload();
+    void set_shader_reload_error(const std::string& error);
 
-    static const UINT frame_count = 2;
+    // Flip model needs two buffers even with one frame in flight.
+    static const UINT max_back_buffers = max_frames_in_flight;
+    static const UINT max_scene_lights = 4096;
+    static const UINT max_scene_objects = 1024;
+    static const UINT64 texture_budget_bytes = 256ull * 1024 * 1024;
 
     UINT width;
     UINT height;
@@ -44,41 +165,149 @@ private:
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> rtv_heap;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> dsv_heap;
     UINT rtv_descriptor_size;
-    Microsoft::WRL::ComPtr<ID3D12Resource> render_targets[frame_count];
-    D3D12_RESOURCE_STATES render_target_states[frame_count];
+    Microsoft::WRL::ComPtr<ID3D12Resource> render_targets[max_back_buffers];
+    D3D12_RESOURCE_STATES render_target_states[max_back_buffers];
     Microsoft::WRL::ComPtr<ID3D12Resource> depth_stencil_buffer;
     D3D12_RESOURCE_STATES depth_buffer_state;
 
     // Per-frame resources
-    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> command_allocators[frame_count];
-    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> command_lists[frame_count];
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> command_allocators[max_frames_in_flight];
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> command_lists[max_frames_in_flight];
     Microsoft::WRL::ComPtr<ID3D12Fence> fence;
-    UINT64 fence_values[frame_count];
+    UINT64 fence_values[max_frames_in_flight];
     UINT64 fence_counter;
     HANDLE fence_event;
+    // Per-frame resource slot, cycling through frames_in_flight; the back
+    // buffer being drawn is tracked separately.
     UINT frame_index;
+    UINT back_buffer_index;
+    UINT frames_in_flight;
+
+    // Signaled when DXGI can take another frame; waited on before input is
+    // sampled, so frames are not queued behind the display.
+    HANDLE frame_latency_waitable;
+    // Main thread: a frame was taken from the waitable but no packet slot
+    // was free yet.
+    bool frame_latency_acquired;
+    bool vsync;
+    bool tearing_supported;
+    UINT swap_chain_flags;
+
+    struct PendingPresent
+    {
+        UINT present_id;
+        INT64 input_time;
+    };
+    std::deque<PendingPresent> pending_presents;
+    // Written by the render thread, read by the main thread.
+    mutable std::mutex latency_mutex;
+    FrameLatencyStats latency_stats;
+    double latency_total_ms;
+    INT64 qpc_frequency;
     
     // Resource lifetime tracking
-    bool command_list_in_use[frame_count];
+    bool command_list_in_use[max_frames_in_flight];
 
     D3D12_VIEWPORT viewport;
     D3D12_RECT scissor_rect;
 
-    std::unique_ptr<Pipeline> pipeline;
+    std::unique_ptr<ShaderCache> shader_cache;
+    std::unique_ptr<PipelineCache> pipeline_cache;
+    // Derived from the embedded shaders' reflection; every permutation
+    // shares the one root signature built from it.
+    BindingLayout binding_layout;
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> root_signature;
+    // Root parameter indices in binding_layout, -1 where no shader reads it.
+    struct SceneRootParameters {
+        int draw_constants;
+        int camera;
+        int light_constants;
+        int diffuse_texture;
+        int lights;
+        int cluster_ranges;
+        int light_indices;
+        int objects;
+        int materials;
+    };
+    SceneRootParameters root_parameters;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> input_layout;
+    std::vector<D3D12_INPUT_ELEMENT_DESC> packed_input_layout;
+    // Every manifest permutation builds in the background; pipeline is the
+    // one the scene draws with, waited for at startup.
+    std::unique_ptr<ShaderPermutationSet> shader_permutations;
+    Pipeline* pipeline;
+    bool pipeline_cache_saved;
+
+    // Hot reload: edits rebuild a whole new set off the render thread, which
+    // replaces the live one between frames only if every permutation built.
+    // Replaced sets are freed once the fence passes the last frame using them.
+    struct RetiredShaderPermutations {
+        UINT64 fence_value;
+        std::unique_ptr<ShaderPermutationSet> permutations;
+    };
+    std::unique_ptr<FileWatcher> shader_watcher;
+    std::unique_ptr<ShaderPermutationSet> pending_shader_permutations;
+    std::deque<RetiredShaderPermutations> retired_shader_permutations;
+    bool shader_reload_requested;
+    mutable std::mutex shader_reload_error_mutex;
+    std::string shader_reload_error;
     Microsoft::WRL::ComPtr<ID3D12Resource> vertex_buffer;
     D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view;
     Microsoft::WRL::ComPtr<ID3D12Resource> index_buffer;
     D3D12_INDEX_BUFFER_VIEW index_buffer_view;
     UINT index_count;
 
+    // Main thread only; the render thread sees it through packets.
     std::unique_ptr<Camera> camera;
-    std::unique_ptr<Buffer> camera_buffer;
-    std::unique_ptr<Buffer> light_buffer;
+    std::unique_ptr<Buffer> camera_buffers[max_frames_in_flight];
+    std::unique_ptr<Buffer> light_buffers[max_frames_in_flight];
+    // Per-object matrices, indexed by the objectIndex root constant.
+    std::unique_ptr<Buffer> object_buffers[max_frames_in_flight];
+    std::unique_ptr<Buffer> material_buffer;
     Microsoft::WRL::ComPtr<ID3D12Resource> vertex_upload_heap;
     Microsoft::WRL::ComPtr<ID3D12Resource> index_upload_heap;
 
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> srv_heap;
-    std::unique_ptr<Texture> cube_texture;
+    // Before the handles so they release into a live cache.
+    std::unique_ptr<ResourceCache<Texture>> texture_cache;
+    ResourceHandle<Texture> cube_texture;
+
+    // Pre-baked container textures stream their mips; indexed by StreamingTextureId.
+    // Streamer is declared after the textures so its I/O threads stop before the textures they read go away.
+    std::vector<std::unique_ptr<StreamedTexture>> streamed_textures;
+    std::unique_ptr<TextureStreamer> texture_streamer;
+    StreamedTexture* cube_streamed_texture;
+    StreamingTextureId cube_streaming_id;
+    UINT64 frame_number;
+
+    std::unique_ptr<JobPool> job_pool;
+    // Shader compiles get their own workers so a parallel_for on the render
+    // thread never picks one up while it waits.
+    std::unique_ptr<JobPool> shader_job_pool;
+    std::unique_ptr<LightClusterer> light_clusterer;
+    // Main thread; copied into every packet.
+    std::vector<ClusterLight> scene_lights;
+    std::unique_ptr<Buffer> light_list_buffers[max_frames_in_flight];
+    std::unique_ptr<Buffer> cluster_range_buffers[max_frames_in_flight];
+    std::unique_ptr<Buffer> light_index_buffers[max_frames_in_flight];
+
+    // Main thread: the simulation and the settings it puts in packets.
+    UINT requested_width;
+    UINT requested_height;
+    UINT requested_frames_in_flight;
+    bool requested_vsync;
+    UINT64 simulation_frame_number;
+    std::unique_ptr<Simulation> simulation;
+    FixedTimestep timestep;
+    INT64 last_update_time;
+    std::vector<ObjectTransform> object_transforms;
+    InputState input_state;
+    std::unique_ptr<InputRecorder> input_recorder;
+    std::unique_ptr<InputReplay> input_replay;
 
-    float rotation_angle;
+    // Last, so the render thread is stopped before anything it uses goes.
+    FramePacket frame_packets[FramePacketQueue::slot_count];
+    FramePacketQueue packet_queue;
+    std::exception_ptr render_error;
+    std::thread render_thread;
 };
\ No newline at end of file
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "content_hash.hpp"
+#include "mapped_file.hpp"
+
+struct ResourceCacheStats {
+    uint64_t requests;
+    // Same path asked for again; no file access at all.
+    uint64_t path_hits;
+    // New path whose bytes match a resident resource; read, hashed and compared but not loaded.
+    uint64_t content_hits;
+    uint64_t misses;
+    // Resource bytes (GPU memory for textures) not allocated thanks to content hits.
+    uint64_t bytes_saved;
+    uint32_t resident_count;
+    uint64_t resident_bytes;
+
+    double get_hit_rate() const { return requests ? static_cast<double>(path_hits + content_hits) / requests : 0.0; }
+};
+
+// One line for logs: hit rate, what the hits saved and what is resident.
+inline std::string format_resource_cache_stats(const ResourceCacheStats& stats) {
+    char text[256];
+    snprintf(text, sizeof(text), "%llu requests, %.0f%% hits (%llu path, %llu content), %llu misses, %.1f MB saved, %u resident in %.1f MB",
+             static_cast<unsigned long long>(stats.requests), stats.get_hit_rate() * 100.0, static_cast<unsigned long long>(stats.path_hits),
+             static_cast<unsigned long long>(stats.content_hits), static_cast<unsigned long long>(stats.misses), stats.bytes_saved / 1e6,
+             stats.resident_count, stats.resident_bytes / 1e6);
+    return text;
+}
+
+template <typename Resource>
+class ResourceCache;
+
+// Shared reference to a cached resource. Copies add a reference; the last
+// one to go leaves the resource cached but unused until purge_unused.
+// Handles must not outlive their cache.
+template <typename Resource>
+class ResourceHandle {
+public:
+    ResourceHandle() : cache(nullptr), index(0) {}
+    ~ResourceHandle() { reset(); }
+
+    ResourceHandle(const ResourceHandle& other) : cache(other.cache), index(other.index) {
+        if (cache) {
+            cache->add_reference(index);
+        }
+    }
+
+    ResourceHandle(ResourceHandle&& other) noexcept : cache(other.cache), index(other.index) {
+        other.cache = nullptr;
+    }
+
+    ResourceHandle& operator=(ResourceHandle other) noexcept {
+        std::swap(cache, other.cache);
+        std::swap(index, other.index);
+        return *this;
+    }
+
+    void reset() {
+        if (cache) {
+            cache->release_reference(index);
+            cache = nullptr;
+        }
+    }
+
+    Resource* get() const { return cache ? cache->get_resource(index) : nullptr; }
+    Resource* operator->() const { return get(); }
+    Resource& operator*() const { return *get(); }
+    explicit operator bool() const { return cache != nullptr; }
+
+private:
+    friend class ResourceCache<Resource>;
+
+    ResourceHandle(ResourceCache<Resource>* cache, uint32_t index) : cache(cache), index(index) {
+        cache->add_reference(index);
+    }
+
+    ResourceCache<Resource>* cache;
+    uint32_t index;
+};
+
+// Loads each distinct file once. Requests are matched by path first; a new
+// path is memory-mapped and hashed with XXH3, so copies of the same file
+// under different names share one resource. A hash match is only trusted
+// once the bytes compare equal. Meant for the thread that owns
+// the device and command list, so there is no locking.
+template <typename Resource>
+class ResourceCache {
+public:
+    // Builds a resource from the file bytes; path is passed for extension dispatch and errors.
+    using LoadFunction = std::function<std::unique_ptr<Resource>(const std::string& path, const uint8_t* data, size_t size)>;
+    using SizeFunction = std::function<uint64_t(const Resource& resource)>;
+
+    ResourceCache(LoadFunction load, SizeFunction get_size) :
+        load(std::move(load)), get_size(std::move(get_size)), stats()
+    {
+    }
+
+    ResourceCache(const ResourceCache&) = delete;
+    ResourceCache& operator=(const ResourceCache&) = delete;
+
+    ResourceHandle<Resource> acquire(const std::string& path) {
+        stats.requests++;
+        auto path_it = path_index.find(path);
+        if (path_it != path_index.end()) {
+            stats.path_hits++;
+            return ResourceHandle<Resource>(this, path_it->second);
+        }
+
+        MappedFile file(path);
+        uint64_t hash = hash_content(file.get_data(), file.get_size());
+        auto range = content_index.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            Entry& entry = entries[it->second];
+            if (entry.file_size == file.get_size() && has_same_bytes(entry, file)) {
+                stats.content_hits++;
+                stats.bytes_saved += entry.resource_size;
+                entry.paths.push_back(path);
+                path_index.emplace(path, it->second);
+                return ResourceHandle<Resource>(this, it->second);
+            }
+        }
+
+        std::unique_ptr<Resource> resource = load(path, file.get_data(), file.get_size());
+        if (!resource) {
+            throw std::runtime_error("Failed to load cached resource: " + path);
+        }
+        stats.misses++;
+
+        uint32_t index;
+        if (!free_entries.empty()) {
+            index = free_entries.back();
+            free_entries.pop_back();
+        } else {
+            index = static_cast<uint32_t>(entries.size());
+            entries.emplace_back();
+        }
+        Entry& entry = entries[index];
+        entry.resource_size = get_size(*resource);
+        entry.resource = std::move(resource);
+        entry.content_hash = hash;
+        entry.file_size = file.get_size();
+        entry.references = 0;
+        entry.paths = {path};
+        path_index.emplace(path, index);
+        content_index.emplace(hash, index);
+        stats.resident_count++;
+        stats.resident_bytes += entry.resource_size;
+        return ResourceHandle<Resource>(this, index);
+    }
+
+    // Destroys resources no handle refers to. Call once the GPU is done with
+    // them, e.g. after a fence wait; returns the number destroyed.
+    uint32_t purge_unused() {
+        uint32_t purged = 0;
+        for (uint32_t index = 0; index < entries.size(); ++index) {
+            Entry& entry = entries[index];
+            if (!entry.resource || entry.references > 0) {
+                continue;
+            }
+            for (const std::string& path : entry.paths) {
+                path_index.erase(path);
+            }
+            auto range = content_index.equal_range(entry.content_hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == index) {
+                    content_index.erase(it);
+                    break;
+                }
+            }
+            stats.resident_count--;
+            stats.resident_bytes -= entry.resource_size;
+            entry = Entry();
+            free_entries.push_back(index);
+            purged++;
+        }
+        return purged;
+    }
+
+    const ResourceCacheStats& get_stats() const { return stats; }
+
+private:
+    friend class ResourceHandle<Resource>;
+
+    struct Entry {
+        std::unique_ptr<Resource> resource;
+        uint64_t content_hash = 0;
+        uint64_t file_size = 0;
+        uint64_t resource_size = 0;
+        uint32_t references = 0;
+        // Every path that resolved to this entry, so a purge can drop them all.
+        std::vector<std::string> paths;
+    };
+
+    // Compares against a file the entry was loaded from. A hash collision,
+    // or that file having changed or gone since, is a miss.
+    static bool has_same_bytes(const Entry& entry, const MappedFile& file) {
+        try {
+            MappedFile other(entry.paths.front());
+            return other.get_size() == file.get_size() && (file.get_size() == 0 || memcmp(other.get_data(), file.get_data(), file.get_size()) == 0);
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+    }
+
+    void add_reference(uint32_t index) { entries[index].references++; }
+    void release_reference(uint32_t index) { entries[index].references--; }
+    Resource* get_resource(uint32_t index) const { return entries[index].resource.get(); }
+
+    LoadFunction load;
+    SizeFunction get_size;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> free_entries;
+    std::unordered_map<std::string, uint32_t> path_index;
+    std::unordered_multimap<uint64_t, uint32_t> content_index;
+    ResourceCacheStats stats;
+};
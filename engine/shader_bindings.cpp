@@ -0,0 +1,149 @@
+#include "shader_bindings.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// b, t and s registers are numbered separately.
+enum class RegisterClass {
+    constant_buffer,
+    shader_resource,
+    sampler
+};
+
+RegisterClass get_register_class(ShaderBindingType type) {
+    switch (type) {
+    case ShaderBindingType::constant_buffer:
+        return RegisterClass::constant_buffer;
+    case ShaderBindingType::sampler:
+        return RegisterClass::sampler;
+    default:
+        return RegisterClass::shader_resource;
+    }
+}
+
+RootParameterKind get_parameter_kind(const ShaderBinding& binding) {
+    switch (binding.type) {
+    case ShaderBindingType::constant_buffer:
+        return binding.size <= max_root_constant_bytes ? RootParameterKind::constants : RootParameterKind::constant_buffer;
+    case ShaderBindingType::structured_buffer:
+        return RootParameterKind::shader_resource;
+    default:
+        return RootParameterKind::descriptor_table;
+    }
+}
+
+bool same_register(const ShaderBinding& a, const ShaderBinding& b) {
+    return get_register_class(a.type) == get_register_class(b.type) && a.register_index == b.register_index && a.space == b.space;
+}
+
+uint32_t get_stage_bit(PipelineShaderStage stage) {
+    return 1u << static_cast<uint32_t>(stage);
+}
+
+} // namespace
+
+int BindingLayout::find(const std::string& name) const {
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        if (parameters[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+uint32_t BindingLayout::get_size_in_dwords() const {
+    uint32_t size = 0;
+    for (const RootParameterLayout& parameter : parameters) {
+        switch (parameter.kind) {
+        case RootParameterKind::constants:
+            size += parameter.value_count;
+            break;
+        case RootParameterKind::descriptor_table:
+            size += 1;
+            break;
+        default:
+            // Root descriptors are 64-bit GPU addresses.
+            size += 2;
+            break;
+        }
+    }
+    return size;
+}
+
+bool BindingLayout::covers(const std::vector<ShaderBinding>& bindings, std::string* missing) const {
+    for (const ShaderBinding& binding : bindings) {
+        bool found = false;
+        if (binding.type == ShaderBindingType::sampler) {
+            for (const ShaderBinding& sampler : samplers) {
+                found = found || (same_register(sampler, binding) && sampler.name == binding.name);
+            }
+        } else {
+            RootParameterKind kind = get_parameter_kind(binding);
+            for (const RootParameterLayout& parameter : parameters) {
+                // Small constant buffers also fit a root CBV; one that grew
+                // past its root constants fits nothing.
+                bool fits = parameter.kind == kind;
+                if (kind == RootParameterKind::constants) {
+                    fits = parameter.kind == RootParameterKind::constant_buffer ||
+                           (parameter.kind == RootParameterKind::constants && binding.size <= parameter.value_count * 4);
+                }
+                found = found || (fits && parameter.name == binding.name && parameter.register_index == binding.register_index &&
+                                  parameter.space == binding.space && (parameter.stages & get_stage_bit(binding.stage)) != 0);
+            }
+        }
+        if (!found) {
+            if (missing) {
+                *missing = binding.name;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+BindingLayout derive_binding_layout(const std::vector<ShaderBinding>& bindings) {
+    struct MergedBinding {
+        ShaderBinding binding;
+        uint32_t stages;
+    };
+    std::vector<MergedBinding> merged;
+    for (const ShaderBinding& binding : bindings) {
+        auto it = std::find_if(merged.begin(), merged.end(), [&](const MergedBinding& other) { return same_register(other.binding, binding); });
+        if (it == merged.end()) {
+            merged.push_back({ binding, get_stage_bit(binding.stage) });
+            continue;
+        }
+        if (it->binding.name != binding.name || it->binding.type != binding.type) {
+            throw std::runtime_error("Shader bindings " + it->binding.name + " and " + binding.name + " share a register.");
+        }
+        it->stages |= get_stage_bit(binding.stage);
+        it->binding.size = std::max(it->binding.size, binding.size);
+    }
+
+    BindingLayout layout;
+    for (const MergedBinding& entry : merged) {
+        const ShaderBinding& binding = entry.binding;
+        if (binding.type == ShaderBindingType::sampler) {
+            layout.samplers.push_back(binding);
+            continue;
+        }
+        RootParameterLayout parameter = { get_parameter_kind(binding), binding.name, binding.register_index, binding.space, 0, entry.stages };
+        if (parameter.kind == RootParameterKind::constants) {
+            parameter.value_count = std::max((binding.size + 3) / 4, 1u);
+        }
+        layout.parameters.push_back(parameter);
+    }
+    // Per-draw constants first; registers in order within each kind.
+    std::stable_sort(layout.parameters.begin(), layout.parameters.end(), [](const RootParameterLayout& a, const RootParameterLayout& b) {
+        if (a.kind != b.kind) {
+            return a.kind < b.kind;
+        }
+        return a.space != b.space ? a.space < b.space : a.register_index < b.register_index;
+    });
+
+    if (layout.get_size_in_dwords() > max_root_signature_dwords) {
+        throw std::runtime_error("Shader bindings do not fit in a root signature.");
+    }
+    return layout;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "pipeline_desc.hpp"
+
+// Resource bindings read back from shader bytecode, and the root signature
+// layout derived from them. Kept free of d3d12.h so layouts can be derived
+// and checked from recorded reflection data; shader_reflection.hpp does the
+// reflecting and turns a layout into a D3D12 root signature.
+enum class ShaderBindingType : uint32_t {
+    constant_buffer,
+    structured_buffer,
+    texture,
+    sampler
+};
+
+struct ShaderBinding {
+    std::string name;
+    ShaderBindingType type;
+    uint32_t register_index;
+    uint32_t space;
+    // Constant buffers only: bytes up to the end of the last variable.
+    uint32_t size;
+    PipelineShaderStage stage;
+};
+
+enum class RootParameterKind : uint32_t {
+    // 32-bit constants written straight into the root signature.
+    constants,
+    constant_buffer,
+    shader_resource,
+    descriptor_table
+};
+
+struct RootParameterLayout {
+    RootParameterKind kind;
+    std::string name;
+    uint32_t register_index;
+    uint32_t space;
+    // Constants only.
+    uint32_t value_count;
+    // Bit per PipelineShaderStage that reads it.
+    uint32_t stages;
+};
+
+// Constant buffers this small become root constants.
+static const uint32_t max_root_constant_bytes = 16;
+// D3D12's root signature limit.
+static const uint32_t max_root_signature_dwords = 64;
+
+struct BindingLayout {
+    // Root parameter order: constants, then constant buffers, then root
+    // SRVs, then one single-descriptor table per texture.
+    std::vector<RootParameterLayout> parameters;
+    // Expected to be static samplers.
+    std::vector<ShaderBinding> samplers;
+
+    // Root parameter index for a binding name, or -1.
+    int find(const std::string& name) const;
+    uint32_t get_size_in_dwords() const;
+    // Whether every binding has a parameter (or sampler) it fits. Reports
+    // the first one that does not through missing.
+    bool covers(const std::vector<ShaderBinding>& bindings, std::string* missing = nullptr) const;
+};
+
+// Merges the bindings of every stage and permutation that will share the
+// root signature; the same register seen from several stages becomes one
+// parameter visible to all of them. Throws std::runtime_error when two
+// bindings claim one register under different names or types, or when the
+// layout goes over max_root_signature_dwords.
+BindingLayout derive_binding_layout(const std::vector<ShaderBinding>& bindings);
@@ -0,0 +1,145 @@
+#include "shader_cache.hpp"
+#include "content_hash.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+// Bump when the key inputs or the entry layout change.
+static const uint32_t shader_cache_version = 1;
+static const uint32_t shader_cache_magic = 0x31435342; // "BSC1"
+
+struct ShaderCacheEntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t payload_size;
+    uint64_t payload_hash;
+};
+
+static void append_field(std::string& out, const void* data, size_t size) {
+    uint64_t length = size;
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.append(static_cast<const char*>(data), size);
+}
+
+static void append_field(std::string& out, const std::string& value) {
+    append_field(out, value.data(), value.size());
+}
+
+uint64_t make_shader_cache_key(
+    const void* preprocessed_source,
+    size_t source_size,
+    const std::string& entry_point,
+    const std::string& target,
+    const std::vector<ShaderDefine>& defines,
+    uint32_t flags
+) {
+    // Every field is length-prefixed so neighbouring strings cannot run
+    // into each other and collide.
+    std::string fields;
+    fields.reserve(source_size + 256);
+    append_field(fields, &shader_cache_version, sizeof(shader_cache_version));
+    append_field(fields, preprocessed_source, source_size);
+    append_field(fields, entry_point);
+    append_field(fields, target);
+    uint64_t define_count = defines.size();
+    append_field(fields, &define_count, sizeof(define_count));
+    for (const ShaderDefine& define : defines) {
+        append_field(fields, define.name);
+        append_field(fields, define.value);
+    }
+    append_field(fields, &flags, sizeof(flags));
+    return hash_content(fields.data(), fields.size());
+}
+
+ShaderCache::ShaderCache(const std::string& directory) :
+    directory(directory), hits(0), misses(0), stores(0), rejected(0), bytes_loaded(0), temp_counter(0)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        throw std::runtime_error("Failed to create shader cache directory: " + directory);
+    }
+}
+
+std::string ShaderCache::get_entry_path(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+bool ShaderCache::load(uint64_t key, std::vector<uint8_t>& bytecode) {
+    FILE* file = fopen(get_entry_path(key).c_str(), "rb");
+    if (!file) {
+        ++misses;
+        return false;
+    }
+    ShaderCacheEntryHeader header = {};
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == shader_cache_magic &&
+              header.version == shader_cache_version && header.key == key && header.payload_size <= (1ull << 30);
+    if (ok) {
+        bytecode.resize(static_cast<size_t>(header.payload_size));
+        ok = fread(bytecode.data(), 1, bytecode.size(), file) == bytecode.size() && fgetc(file) == EOF &&
+             hash_content(bytecode.data(), bytecode.size()) == header.payload_hash;
+    }
+    fclose(file);
+    if (!ok) {
+        bytecode.clear();
+        ++rejected;
+        ++misses;
+        return false;
+    }
+    ++hits;
+    bytes_loaded += bytecode.size();
+    return true;
+}
+
+bool ShaderCache::store(uint64_t key, const void* bytecode, size_t size) {
+    // The temporary name is unique per thread and call, and only differs
+    // between processes by time, which is enough for the rename to be the
+    // single point where the entry appears.
+    std::string path = get_entry_path(key);
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".%zx.%llx.%x.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()),
+             static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count()), temp_counter++);
+    std::string temp_path = path + suffix;
+
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    ShaderCacheEntryHeader header = {};
+    header.magic = shader_cache_magic;
+    header.version = shader_cache_version;
+    header.key = key;
+    header.payload_size = size;
+    header.payload_hash = hash_content(bytecode, size);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(bytecode, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(temp_path, path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    ++stores;
+    return true;
+}
+
+ShaderCacheStats ShaderCache::get_stats() const {
+    ShaderCacheStats stats = {};
+    stats.hits = hits.load();
+    stats.misses = misses.load();
+    stats.stores = stores.load();
+    stats.rejected = rejected.load();
+    stats.bytes_loaded = bytes_loaded.load();
+    return stats;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShaderDefine {
+    std::string name;
+    std::string value;
+};
+
+struct ShaderCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    // Entries that were present but unreadable, truncated or for another key.
+    uint64_t rejected;
+    uint64_t bytes_loaded;
+};
+
+// Identifies one compile. The source must be the preprocessor output, so
+// edits to included files change the key as well; defines are hashed in
+// the order given.
+uint64_t make_shader_cache_key(
+    const void* preprocessed_source,
+    size_t source_size,
+    const std::string& entry_point,
+    const std::string& target,
+    const std::vector<ShaderDefine>& defines,
+    uint32_t flags
+);
+
+// Compiled bytecode kept as one file per key in a local directory. Entries
+// are written to a temporary file and renamed into place, so concurrent
+// writers and crashed runs never leave a partial entry behind, and every
+// entry carries a hash of its payload that is checked on load. Safe to use
+// from several threads.
+class ShaderCache {
+public:
+    // Creates the directory if needed.
+    explicit ShaderCache(const std::string& directory);
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    bool load(uint64_t key, std::vector<uint8_t>& bytecode);
+    // Returns false if the entry could not be written; the cache is only an
+    // optimization, so callers carry on with the bytecode they have.
+    bool store(uint64_t key, const void* bytecode, size_t size);
+
+    std::string get_entry_path(uint64_t key) const;
+    ShaderCacheStats get_stats() const;
+
+private:
+    std::string directory;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> stores;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> bytes_loaded;
+    std::atomic<uint32_t> temp_counter;
+};
@@ -0,0 +1,154 @@
+#include "shader_permutation_set.hpp"
+#include "job_pool.hpp"
+#include <stdexcept>
+
+static uint64_t elapsed_nanoseconds(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+ShaderPermutationSet::ShaderPermutationSet(JobPool& job_pool, const std::vector<ShaderPermutation>& manifest, StageFunction get_stage, PipelineFactory factory) :
+    job_pool(job_pool), get_stage(std::move(get_stage)), factory(std::move(factory)),
+    plan(plan_permutations(manifest)), start_time(std::chrono::steady_clock::now()), compiles_done(0), pipelines_ready(0), failed(0),
+    compile_nanoseconds(0), wall_nanoseconds(0), outstanding(0)
+{
+    compiles.resize(plan.compiles.size());
+    pipelines = std::make_unique<PipelineSlot[]>(plan.pipelines.size());
+    for (uint32_t i = 0; i < plan.pipelines.size(); ++i) {
+        compiles[plan.vertex_compiles[i]].dependents.push_back(i);
+        compiles[plan.pixel_compiles[i]].dependents.push_back(i);
+    }
+    outstanding = static_cast<uint32_t>(plan.pipelines.size());
+    for (uint32_t i = 0; i < compiles.size(); ++i) {
+        job_pool.submit([this, i] { compile(i); });
+    }
+}
+
+ShaderPermutationSet::~ShaderPermutationSet() {
+    // Jobs still queued reference this set.
+    wait_all();
+}
+
+int ShaderPermutationSet::find_pipeline(const ShaderPermutation& permutation) const {
+    for (uint32_t i = 0; i < plan.pipelines.size(); ++i) {
+        if (plan.pipelines[i] == permutation) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void ShaderPermutationSet::compile(uint32_t index) {
+    CompileSlot& slot = compiles[index];
+    slot.bytecode = {};
+    auto start = std::chrono::steady_clock::now();
+    try {
+        slot.bytecode = get_stage(plan.compiles[index], slot.storage);
+    } catch (const std::exception& e) {
+        slot.error = e.what();
+    }
+    compile_nanoseconds += elapsed_nanoseconds(start);
+    ++compiles_done;
+
+    // The second stage to land hands the pipeline on; the counter orders
+    // both stages' writes before the read.
+    for (uint32_t dependent : slot.dependents) {
+        if (pipelines[dependent].stages_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            continue;
+        }
+        const std::string& vertex_error = compiles[plan.vertex_compiles[dependent]].error;
+        const std::string& pixel_error = compiles[plan.pixel_compiles[dependent]].error;
+        if (!vertex_error.empty() || !pixel_error.empty()) {
+            finish_pipeline(dependent, vertex_error.empty() ? pixel_error : vertex_error);
+        } else {
+            job_pool.submit([this, dependent] { build(dependent); });
+        }
+    }
+}
+
+void ShaderPermutationSet::build(uint32_t index) {
+    std::string error;
+    try {
+        pipelines[index].pipeline = factory(plan.pipelines[index], compiles[plan.vertex_compiles[index]].bytecode, compiles[plan.pixel_compiles[index]].bytecode);
+        if (!pipelines[index].pipeline) {
+            error = "Pipeline factory returned nothing.";
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    finish_pipeline(index, error);
+}
+
+void ShaderPermutationSet::finish_pipeline(uint32_t index, const std::string& error) {
+    PipelineSlot& slot = pipelines[index];
+    slot.error = error;
+    if (error.empty()) {
+        ++pipelines_ready;
+    } else {
+        slot.pipeline.reset();
+        ++failed;
+    }
+    slot.done.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        if (--outstanding == 0) {
+            wall_nanoseconds = elapsed_nanoseconds(start_time);
+        }
+    }
+    done_cv.notify_all();
+}
+
+Pipeline* ShaderPermutationSet::get_pipeline(const ShaderPermutation& permutation) const {
+    int index = find_pipeline(permutation);
+    if (index < 0 || !pipelines[index].done.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return pipelines[index].pipeline.get();
+}
+
+Pipeline* ShaderPermutationSet::wait(const ShaderPermutation& permutation) {
+    int index = find_pipeline(permutation);
+    if (index < 0) {
+        throw std::runtime_error("Shader permutation is not in the manifest.");
+    }
+    PipelineSlot& slot = pipelines[index];
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&slot] { return slot.done.load(std::memory_order_acquire); });
+    }
+    if (!slot.error.empty()) {
+        throw std::runtime_error("Failed to build shader permutation: " + slot.error);
+    }
+    return slot.pipeline.get();
+}
+
+void ShaderPermutationSet::wait_all() {
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [this] { return outstanding == 0; });
+}
+
+bool ShaderPermutationSet::is_complete() const {
+    std::lock_guard<std::mutex> lock(done_mutex);
+    return outstanding == 0;
+}
+
+std::string ShaderPermutationSet::get_first_error() const {
+    for (uint32_t i = 0; i < plan.pipelines.size(); ++i) {
+        if (pipelines[i].done.load(std::memory_order_acquire) && !pipelines[i].error.empty()) {
+            return pipelines[i].error;
+        }
+    }
+    return std::string();
+}
+
+ShaderPermutationStats ShaderPermutationSet::get_stats() const {
+    ShaderPermutationStats stats = {};
+    stats.permutation_space = get_permutation_space_size();
+    stats.pipeline_count = static_cast<uint32_t>(plan.pipelines.size());
+    stats.compile_count = static_cast<uint32_t>(plan.compiles.size());
+    stats.compiles_done = compiles_done.load();
+    stats.pipelines_ready = pipelines_ready.load();
+    stats.failed = failed.load();
+    stats.compile_seconds = compile_nanoseconds.load() * 1e-9;
+    stats.wall_seconds = wall_nanoseconds.load() * 1e-9;
+    return stats;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "pipeline.hpp"
+#include "shader_permutations.hpp"
+
+class JobPool;
+
+// Builds every pipeline a permutation manifest lists in the background.
+// Stage compiles (or embedded bytecode lookups) shared between permutations
+// run once each as JobPool jobs;
+// a pipeline is created as soon as both of its stages are in. The render
+// thread polls get_pipeline, or waits for the one it cannot draw without.
+class ShaderPermutationSet {
+public:
+    // Called on a worker for each stage compile. Returns the bytecode,
+    // which either lives in storage or outlives the set (embedded shaders);
+    // throws on failure.
+    using StageFunction = std::function<D3D12_SHADER_BYTECODE(const ShaderStageCompile& compile, std::vector<uint8_t>& storage)>;
+    // Called on a worker with the stage bytecode; returns the pipeline.
+    using PipelineFactory = std::function<std::unique_ptr<Pipeline>(const ShaderPermutation& permutation, D3D12_SHADER_BYTECODE vertex_shader, D3D12_SHADER_BYTECODE pixel_shader)>;
+
+    ShaderPermutationSet(JobPool& job_pool, const std::vector<ShaderPermutation>& manifest, StageFunction get_stage, PipelineFactory factory);
+    ~ShaderPermutationSet();
+
+    ShaderPermutationSet(const ShaderPermutationSet&) = delete;
+    ShaderPermutationSet& operator=(const ShaderPermutationSet&) = delete;
+
+    // Null while still building, when it failed, or when not in the manifest.
+    Pipeline* get_pipeline(const ShaderPermutation& permutation) const;
+    // Blocks until the permutation is built; throws if it failed or is not in the manifest.
+    Pipeline* wait(const ShaderPermutation& permutation);
+    void wait_all();
+    bool is_complete() const;
+    // Empty when nothing has failed so far.
+    std::string get_first_error() const;
+
+    ShaderPermutationStats get_stats() const;
+
+private:
+    struct CompileSlot {
+        std::vector<uint8_t> storage;
+        D3D12_SHADER_BYTECODE bytecode;
+        std::vector<uint32_t> dependents;
+        std::string error;
+    };
+
+    struct PipelineSlot {
+        std::unique_ptr<Pipeline> pipeline;
+        std::atomic<uint32_t> stages_pending{2};
+        std::atomic<bool> done{false};
+        std::string error;
+    };
+
+    int find_pipeline(const ShaderPermutation& permutation) const;
+    void compile(uint32_t index);
+    void build(uint32_t index);
+    void finish_pipeline(uint32_t index, const std::string& error);
+
+    JobPool& job_pool;
+    StageFunction get_stage;
+    PipelineFactory factory;
+    ShaderPermutationPlan plan;
+    std::vector<CompileSlot> compiles;
+    std::unique_ptr<PipelineSlot[]> pipelines;
+
+    std::chrono::steady_clock::time_point start_time;
+    std::atomic<uint32_t> compiles_done;
+    std::atomic<uint32_t> pipelines_ready;
+    std::atomic<uint32_t> failed;
+    std::atomic<uint64_t> compile_nanoseconds;
+    std::atomic<uint64_t> wall_nanoseconds;
+
+    mutable std::mutex done_mutex;
+    std::condition_variable done_cv;
+    uint32_t outstanding;
+};
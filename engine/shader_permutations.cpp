@@ -0,0 +1,148 @@
+#include "shader_permutations.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+static const uint32_t light_tier_limits[shader_light_tier_count] = { 0, 16, 64, 4096 };
+
+struct FeatureName {
+    ShaderFeature feature;
+    const char* name;
+    const char* define;
+    PipelineShaderStage stage;
+};
+
+static const FeatureName feature_names[] = {
+    { shader_feature_instancing, "instancing", "INSTANCING", PipelineShaderStage::vertex },
+    { shader_feature_alpha_test, "alpha_test", "ALPHA_TEST", PipelineShaderStage::pixel },
+    { shader_feature_packed_vertices, "packed_vertices", "PACKED_VERTICES", PipelineShaderStage::vertex },
+};
+
+uint32_t get_light_tier_limit(uint32_t light_tier) {
+    return light_tier_limits[light_tier < shader_light_tier_count ? light_tier : shader_default_light_tier];
+}
+
+uint32_t get_permutation_space_size() {
+    return (shader_feature_all + 1) * shader_light_tier_count;
+}
+
+ShaderPermutation mask_permutation(const ShaderPermutation& permutation, PipelineShaderStage stage) {
+    ShaderPermutation masked = {};
+    for (const FeatureName& feature : feature_names) {
+        if (feature.stage == stage) {
+            masked.features |= permutation.features & feature.feature;
+        }
+    }
+    masked.light_tier = stage == PipelineShaderStage::pixel ? permutation.light_tier : 0;
+    return masked;
+}
+
+std::vector<ShaderDefine> get_permutation_defines(const ShaderPermutation& permutation, PipelineShaderStage stage) {
+    ShaderPermutation masked = mask_permutation(permutation, stage);
+    std::vector<ShaderDefine> defines;
+    for (const FeatureName& feature : feature_names) {
+        if (feature.stage == stage) {
+            defines.push_back({ feature.define, masked.features & feature.feature ? "1" : "0" });
+        }
+    }
+    if (stage == PipelineShaderStage::pixel) {
+        defines.push_back({ "CLUSTER_LIGHT_LIMIT", std::to_string(get_light_tier_limit(masked.light_tier)) });
+    }
+    return defines;
+}
+
+static ShaderPermutation parse_manifest_line(const std::string& line) {
+    ShaderPermutation permutation = { 0, shader_default_light_tier };
+    std::istringstream words(line);
+    std::string word;
+    while (words >> word) {
+        if (word.compare(0, 7, "lights=") == 0) {
+            unsigned long count = strtoul(word.c_str() + 7, nullptr, 10);
+            permutation.light_tier = 0;
+            while (permutation.light_tier < shader_default_light_tier && light_tier_limits[permutation.light_tier] < count) {
+                permutation.light_tier++;
+            }
+            continue;
+        }
+        bool known = false;
+        for (const FeatureName& feature : feature_names) {
+            if (word == feature.name) {
+                permutation.features |= feature.feature;
+                known = true;
+            }
+        }
+        if (!known) {
+            throw std::runtime_error("Unknown shader feature in permutation manifest: " + word);
+        }
+    }
+    return permutation;
+}
+
+std::vector<ShaderPermutation> parse_permutation_manifest(const std::string& text) {
+    std::vector<ShaderPermutation> permutations = { shader_default_permutation };
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        permutations.push_back(parse_manifest_line(line));
+    }
+    return permutations;
+}
+
+std::vector<ShaderPermutation> load_permutation_manifest(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Failed to open shader permutation manifest: " + path);
+    }
+    std::string text;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, read);
+    }
+    fclose(file);
+    return parse_permutation_manifest(text);
+}
+
+static uint32_t add_compile(ShaderPermutationPlan& plan, PipelineShaderStage stage, const ShaderPermutation& permutation) {
+    ShaderPermutation masked = mask_permutation(permutation, stage);
+    for (uint32_t i = 0; i < plan.compiles.size(); ++i) {
+        if (plan.compiles[i].stage == stage && plan.compiles[i].permutation == masked) {
+            return i;
+        }
+    }
+    plan.compiles.push_back({ stage, masked });
+    return static_cast<uint32_t>(plan.compiles.size() - 1);
+}
+
+ShaderPermutationPlan plan_permutations(const std::vector<ShaderPermutation>& manifest) {
+    // Manifests list a handful of entries, so linear searches are fine.
+    ShaderPermutationPlan plan;
+    for (const ShaderPermutation& requested : manifest) {
+        ShaderPermutation permutation = { requested.features & shader_feature_all,
+                                          requested.light_tier < shader_light_tier_count ? requested.light_tier : shader_default_light_tier };
+        bool duplicate = false;
+        for (const ShaderPermutation& existing : plan.pipelines) {
+            duplicate = duplicate || existing == permutation;
+        }
+        if (duplicate) {
+            continue;
+        }
+        plan.pipelines.push_back(permutation);
+        plan.vertex_compiles.push_back(add_compile(plan, PipelineShaderStage::vertex, permutation));
+        plan.pixel_compiles.push_back(add_compile(plan, PipelineShaderStage::pixel, permutation));
+    }
+    return plan;
+}
+
+std::string format_shader_permutation_stats(const ShaderPermutationStats& stats) {
+    char text[256];
+    snprintf(text, sizeof(text), "%u of %u pipelines ready (%u failed, %u permutations possible), %u of %u compiles (%u unpruned), %.3f s compiling, %.3f s wall",
+             stats.pipelines_ready, stats.pipeline_count, stats.failed, stats.permutation_space, stats.compiles_done, stats.compile_count,
+             stats.pipeline_count * 2, stats.compile_seconds, stats.wall_seconds);
+    return text;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "pipeline_desc.hpp"
+#include "shader_cache.hpp"
+
+// Feature bits of a shaders.hlsl permutation; each maps to a 0/1 define.
+enum ShaderFeature : uint32_t {
+    shader_feature_instancing = 1u << 0,
+    shader_feature_alpha_test = 1u << 1,
+    shader_feature_packed_vertices = 1u << 2,
+    shader_feature_all = (1u << 3) - 1
+};
+
+// Light tiers bound the clustered light loop; CLUSTER_LIGHT_LIMIT is 0
+// (directional light only), 16, 64 or 4096 (every scene light).
+static const uint32_t shader_light_tier_count = 4;
+static const uint32_t shader_default_light_tier = shader_light_tier_count - 1;
+
+struct ShaderPermutation {
+    uint32_t features;
+    uint32_t light_tier;
+
+    uint32_t get_key() const { return features | light_tier << 8; }
+    bool operator==(const ShaderPermutation& other) const { return get_key() == other.get_key(); }
+};
+
+// What the scene draws with; every manifest includes it.
+static const ShaderPermutation shader_default_permutation = { 0, shader_default_light_tier };
+
+uint32_t get_light_tier_limit(uint32_t light_tier);
+
+// Every combination the shader supports, used or not.
+uint32_t get_permutation_space_size();
+
+// Keeps only the features the stage's code reads, so permutations that
+// differ elsewhere share one compile: the vertex shader sees instancing and
+// packed vertices, the pixel shader alpha test and the light tier.
+ShaderPermutation mask_permutation(const ShaderPermutation& permutation, PipelineShaderStage stage);
+
+// Defines for the stage, every feature spelled out as 0 or 1.
+std::vector<ShaderDefine> get_permutation_defines(const ShaderPermutation& permutation, PipelineShaderStage stage);
+
+// One permutation per line: feature names (instancing, alpha_test,
+// packed_vertices) and optionally lights=N, rounded up to the next tier;
+// without it the default tier is used. '#' starts a comment. The result
+// starts with shader_default_permutation whether listed or not. Throws
+// std::runtime_error on unknown words.
+std::vector<ShaderPermutation> parse_permutation_manifest(const std::string& text);
+std::vector<ShaderPermutation> load_permutation_manifest(const std::string& path);
+
+struct ShaderStageCompile {
+    PipelineShaderStage stage;
+    // Already masked for the stage.
+    ShaderPermutation permutation;
+};
+
+// What actually has to be built for a manifest: the distinct pipelines and
+// the distinct stage compiles they share.
+struct ShaderPermutationPlan {
+    std::vector<ShaderPermutation> pipelines;
+    std::vector<ShaderStageCompile> compiles;
+    // Per pipeline, indices into compiles.
+    std::vector<uint32_t> vertex_compiles;
+    std::vector<uint32_t> pixel_compiles;
+};
+
+ShaderPermutationPlan plan_permutations(const std::vector<ShaderPermutation>& manifest);
+
+struct ShaderPermutationStats {
+    // Combinations the shader supports.
+    uint32_t permutation_space;
+    // Distinct pipelines the manifest asks for.
+    uint32_t pipeline_count;
+    // Distinct stage compiles those need, against two per pipeline unpruned.
+    uint32_t compile_count;
+    uint32_t compiles_done;
+    uint32_t pipelines_ready;
+    uint32_t failed;
+    // Summed over workers, and from construction to the last pipeline.
+    double compile_seconds;
+    double wall_seconds;
+};
+
+// One line for logs: pipelines and compiles against the unpruned counts,
+// failures and the time spent.
+std::string format_shader_permutation_stats(const ShaderPermutationStats& stats);
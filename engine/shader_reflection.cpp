@@ -0,0 +1,124 @@
+#include "shader_reflection.hpp"
+#include <d3dcompiler.h>
+#include <d3d12shader.h>
+#include <wrl.h>
+#include <stdexcept>
+
+static uint32_t get_constant_buffer_size(ID3D12ShaderReflection* reflection, const char* name) {
+    // The declared size is padded to 16 bytes; root constants only need
+    // what the variables cover.
+    ID3D12ShaderReflectionConstantBuffer* buffer = reflection->GetConstantBufferByName(name);
+    D3D12_SHADER_BUFFER_DESC buffer_desc;
+    if (FAILED(buffer->GetDesc(&buffer_desc))) {
+        throw std::runtime_error(std::string("Failed to reflect constant buffer ") + name + ".");
+    }
+    uint32_t size = 0;
+    for (UINT i = 0; i < buffer_desc.Variables; ++i) {
+        D3D12_SHADER_VARIABLE_DESC variable_desc;
+        if (SUCCEEDED(buffer->GetVariableByIndex(i)->GetDesc(&variable_desc)) && variable_desc.StartOffset + variable_desc.Size > size) {
+            size = variable_desc.StartOffset + variable_desc.Size;
+        }
+    }
+    return size;
+}
+
+static D3D12_SHADER_VISIBILITY get_visibility(uint32_t stages) {
+    if (stages == 1u << static_cast<uint32_t>(PipelineShaderStage::vertex)) {
+        return D3D12_SHADER_VISIBILITY_VERTEX;
+    }
+    if (stages == 1u << static_cast<uint32_t>(PipelineShaderStage::pixel)) {
+        return D3D12_SHADER_VISIBILITY_PIXEL;
+    }
+    return D3D12_SHADER_VISIBILITY_ALL;
+}
+
+std::vector<ShaderBinding> reflect_shader_bindings(D3D12_SHADER_BYTECODE bytecode, PipelineShaderStage stage) {
+    Microsoft::WRL::ComPtr<ID3D12ShaderReflection> reflection;
+    D3D12_SHADER_DESC shader_desc;
+    if (FAILED(D3DReflect(bytecode.pShaderBytecode, bytecode.BytecodeLength, IID_PPV_ARGS(&reflection))) || FAILED(reflection->GetDesc(&shader_desc))) {
+        throw std::runtime_error("Failed to reflect shader bytecode.");
+    }
+
+    std::vector<ShaderBinding> bindings;
+    for (UINT i = 0; i < shader_desc.BoundResources; ++i) {
+        D3D12_SHADER_INPUT_BIND_DESC bind_desc;
+        if (FAILED(reflection->GetResourceBindingDesc(i, &bind_desc))) {
+            throw std::runtime_error("Failed to reflect shader binding.");
+        }
+        if (bind_desc.BindCount != 1) {
+            throw std::runtime_error(std::string("Shader binding ") + bind_desc.Name + " is an array, which is not supported.");
+        }
+        ShaderBinding binding = { bind_desc.Name, ShaderBindingType::texture, bind_desc.BindPoint, bind_desc.Space, 0, stage };
+        switch (bind_desc.Type) {
+        case D3D_SIT_CBUFFER:
+            binding.type = ShaderBindingType::constant_buffer;
+            binding.size = get_constant_buffer_size(reflection.Get(), bind_desc.Name);
+            break;
+        case D3D_SIT_STRUCTURED:
+        case D3D_SIT_BYTEADDRESS:
+            binding.type = ShaderBindingType::structured_buffer;
+            break;
+        case D3D_SIT_TEXTURE:
+            binding.type = ShaderBindingType::texture;
+            break;
+        case D3D_SIT_SAMPLER:
+            binding.type = ShaderBindingType::sampler;
+            break;
+        default:
+            throw std::runtime_error(std::string("Shader binding ") + bind_desc.Name + " has an unsupported type.");
+        }
+        bindings.push_back(binding);
+    }
+    return bindings;
+}
+
+RootSignatureDesc::RootSignatureDesc(const BindingLayout& layout, const std::vector<D3D12_STATIC_SAMPLER_DESC>& static_samplers, D3D12_ROOT_SIGNATURE_FLAGS flags) :
+    desc()
+{
+    // Ranges are pointed into, so they must not reallocate.
+    ranges.reserve(layout.parameters.size());
+    for (const RootParameterLayout& layout_parameter : layout.parameters) {
+        D3D12_ROOT_PARAMETER parameter = {};
+        parameter.ShaderVisibility = get_visibility(layout_parameter.stages);
+        switch (layout_parameter.kind) {
+        case RootParameterKind::constants:
+            parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+            parameter.Constants.ShaderRegister = layout_parameter.register_index;
+            parameter.Constants.RegisterSpace = layout_parameter.space;
+            parameter.Constants.Num32BitValues = layout_parameter.value_count;
+            break;
+        case RootParameterKind::constant_buffer:
+        case RootParameterKind::shader_resource:
+            parameter.ParameterType = layout_parameter.kind == RootParameterKind::constant_buffer ? D3D12_ROOT_PARAMETER_TYPE_CBV : D3D12_ROOT_PARAMETER_TYPE_SRV;
+            parameter.Descriptor.ShaderRegister = layout_parameter.register_index;
+            parameter.Descriptor.RegisterSpace = layout_parameter.space;
+            break;
+        case RootParameterKind::descriptor_table:
+            ranges.push_back({ D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, layout_parameter.register_index, layout_parameter.space, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND });
+            parameter.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+            parameter.DescriptorTable.NumDescriptorRanges = 1;
+            parameter.DescriptorTable.pDescriptorRanges = &ranges.back();
+            break;
+        }
+        parameters.push_back(parameter);
+    }
+
+    for (const ShaderBinding& layout_sampler : layout.samplers) {
+        const D3D12_STATIC_SAMPLER_DESC* match = nullptr;
+        for (const D3D12_STATIC_SAMPLER_DESC& sampler : static_samplers) {
+            if (sampler.ShaderRegister == layout_sampler.register_index && sampler.RegisterSpace == layout_sampler.space) {
+                match = &sampler;
+            }
+        }
+        if (!match) {
+            throw std::runtime_error("No static sampler for shader sampler " + layout_sampler.name + ".");
+        }
+        samplers.push_back(*match);
+    }
+
+    desc.NumParameters = static_cast<UINT>(parameters.size());
+    desc.pParameters = parameters.data();
+    desc.NumStaticSamplers = static_cast<UINT>(samplers.size());
+    desc.pStaticSamplers = samplers.data();
+    desc.Flags = flags;
+}
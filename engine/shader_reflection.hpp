@@ -0,0 +1,29 @@
+#pragma once
+
+#include <d3d12.h>
+#include <vector>
+#include "shader_bindings.hpp"
+
+// Reads the resources a compiled stage binds. Throws std::runtime_error for
+// bytecode that does not reflect or binds something a root signature built
+// by RootSignatureDesc cannot hold (UAVs, resource arrays).
+std::vector<ShaderBinding> reflect_shader_bindings(D3D12_SHADER_BYTECODE bytecode, PipelineShaderStage stage);
+
+// D3D12_ROOT_SIGNATURE_DESC for a BindingLayout, owning the arrays it points
+// to. Each layout sampler takes the static sampler with its register from
+// static_samplers; a missing one throws std::runtime_error.
+class RootSignatureDesc {
+public:
+    RootSignatureDesc(const BindingLayout& layout, const std::vector<D3D12_STATIC_SAMPLER_DESC>& static_samplers, D3D12_ROOT_SIGNATURE_FLAGS flags);
+
+    RootSignatureDesc(const RootSignatureDesc&) = delete;
+    RootSignatureDesc& operator=(const RootSignatureDesc&) = delete;
+
+    const D3D12_ROOT_SIGNATURE_DESC& get() const { return desc; }
+
+private:
+    std::vector<D3D12_DESCRIPTOR_RANGE> ranges;
+    std::vector<D3D12_ROOT_PARAMETER> parameters;
+    std::vector<D3D12_STATIC_SAMPLER_DESC> samplers;
+    D3D12_ROOT_SIGNATURE_DESC desc;
+};
@@ -1,5 +1,18 @@
+// Permutation features; see shader_permutations.hpp for how they are set.
+#ifndef INSTANCING
+#define INSTANCING 0
+#endif
+#ifndef ALPHA_TEST
+#define ALPHA_TEST 0
+#endif
+#ifndef PACKED_VERTICES
+#define PACKED_VERTICES 0
+#endif
+#ifndef CLUSTER_LIGHT_LIMIT
+#define CLUSTER_LIGHT_LIMIT 4096
+#endif
+
 cbuffer CameraBuffer : register(b0) {
-    row_major float4x4 modelMatrix;
     row_major float4x4 viewMatrix;
     row_major float4x4 projectionMatrix;
 };
@@ -9,27 +22,124 @@ cbuffer LightBuffer : register(b1) {
     float lightIntensity;
     float3 lightColor;
     float ambientIntensity;
+    uint3 clusterDims;
+    uint pointLightCount;
+    float2 screenSize;
+    float clusterDepthScale;
+    float clusterDepthBias;
+    float textureMinLod;
+    float3 lightPadding;
+};
+
+// Per-draw data, small enough to be passed as root constants.
+cbuffer DrawConstants : register(b2) {
+    uint objectIndex;
+    uint materialIndex;
+};
+
+// Must match ObjectData and MaterialData in renderer.cpp.
+struct ObjectData {
+    row_major float4x4 modelMatrix;
+};
+
+struct Material {
+    float4 baseColor;
+};
+
+// Must match ClusterLight in light_clusters.hpp.
+struct Light {
+    float3 position;
+    float range;
+    float3 color;
+    float intensity;
+    float3 direction;
+    float spotCosOuter;
+    float spotCosInner;
+    float3 padding;
 };
 
 Texture2D diffuseTexture : register(t0);
+StructuredBuffer<Light> lights : register(t1);
+StructuredBuffer<uint2> clusterRanges : register(t2);
+StructuredBuffer<uint> lightIndices : register(t3);
+StructuredBuffer<ObjectData> objects : register(t5);
+StructuredBuffer<Material> materials : register(t6);
 SamplerState linearSampler : register(s0);
 
+#if INSTANCING
+struct InstanceData {
+    row_major float4x4 transform;
+};
+
+// Per-instance object transforms, applied before the object's own.
+StructuredBuffer<InstanceData> instances : register(t4);
+#endif
+
+struct VSInput {
+    float3 position : POSITION;
+#if PACKED_VERTICES
+    // R10G10B10A2_UNORM; remapped to [-1, 1] below. UVs arrive as R16G16_FLOAT.
+    float4 normal : NORMAL;
+#else
+    float3 normal : NORMAL;
+#endif
+    float2 uv : TEXCOORD;
+#if INSTANCING
+    uint instanceId : SV_InstanceID;
+#endif
+};
+
 struct PSInput {
     float4 position : SV_POSITION;
+    float3 worldPos : WORLDPOS;
+    float viewDepth : VIEWDEPTH;
     float3 normal : NORMAL;
     float2 uv : TEXCOORD;
 };
 
-PSInput VSMain(float3 position : POSITION, float3 normal : NORMAL, float2 uv : TEXCOORD) {
+PSInput VSMain(VSInput input) {
+    float4x4 model = objects[objectIndex].modelMatrix;
+#if INSTANCING
+    model = mul(instances[input.instanceId].transform, model);
+#endif
+#if PACKED_VERTICES
+    float3 normal = input.normal.xyz * 2.0f - 1.0f;
+#else
+    float3 normal = input.normal;
+#endif
+
     PSInput result;
-    float4 worldPos = mul(float4(position, 1.0f), modelMatrix);
+    float4 worldPos = mul(float4(input.position, 1.0f), model);
     float4 viewPos = mul(worldPos, viewMatrix);
     result.position = mul(viewPos, projectionMatrix);
-    result.normal = mul(normal, (float3x3)modelMatrix);
-    result.uv = uv;
+    result.worldPos = worldPos.xyz;
+    result.viewDepth = viewPos.z;
+    result.normal = mul(normal, (float3x3)model);
+    result.uv = input.uv;
     return result;
 }
 
+uint clusterIndex(float2 pixel, float viewDepth) {
+    uint2 tile = min(uint2(pixel / screenSize * float2(clusterDims.xy)), clusterDims.xy - 1);
+    int slice = int(floor(log(max(viewDepth, 1e-4f)) * clusterDepthScale + clusterDepthBias));
+    uint z = uint(clamp(slice, 0, int(clusterDims.z) - 1));
+    return (z * clusterDims.y + tile.y) * clusterDims.x + tile.x;
+}
+
+float3 shadeLight(Light light, float3 worldPos, float3 normal) {
+    float3 toLight = light.position - worldPos;
+    float dist = length(toLight);
+    float3 l = toLight / max(dist, 1e-4f);
+
+    float falloff = saturate(1.0f - dist / light.range);
+    float attenuation = falloff * falloff;
+    if (light.spotCosOuter > -1.0f) {
+        float cosAngle = dot(-l, light.direction);
+        attenuation *= smoothstep(light.spotCosOuter, light.spotCosInner, cosAngle);
+    }
+    return max(dot(normal, l), 0.0f) * attenuation * light.intensity * light.color;
+}
+
 float4 PSMain(PSInput input) : SV_TARGET {
     float3 normal = normalize(input.normal);
     float3 lightDir = normalize(-lightDirection);
@@ -38,6 +148,18 @@ float4 PSMain(PSInput input) : SV_TARGET {
     float3 ambient = ambientIntensity * lightColor;
     float3 diffuseLight = diffuse * lightColor;
 
-    float4 texColor = diffuseTexture.Sample(linearSampler, input.uv);
+#if CLUSTER_LIGHT_LIMIT > 0
+    uint2 range = clusterRanges[clusterIndex(input.position.xy, input.viewDepth)];
+    uint count = min(range.y, CLUSTER_LIGHT_LIMIT);
+    for (uint i = 0; i < count; ++i) {
+        diffuseLight += shadeLight(lights[lightIndices[range.x + i]], input.worldPos, normal);
+    }
+#endif
+
+    // Streamed textures only have mips from textureMinLod down mapped.
+    float4 texColor = diffuseTexture.Sample(linearSampler, input.uv, int2(0, 0), textureMinLod) * materials[materialIndex].baseColor;
+#if ALPHA_TEST
+    clip(texColor.a - 0.5f);
+#endif
     return float4(texColor.rgb * (ambient + diffuseLight), texColor.a);
 }
@@ -0,0 +1,224 @@
+#include "streamed_texture.hpp"
+#include "texture.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using Microsoft::WRL::ComPtr;
+
+StreamedTexture::StreamedTexture(ID3D12Device* device, ID3D12CommandQueue* command_queue, ID3D12GraphicsCommandList* command_list, const std::string& file_path) :
+    file(std::make_unique<MappedFile>(file_path))
+{
+    container = parse_texture_container(file->get_data(), file->get_size());
+    if (container.array_size != 1) {
+        throw std::runtime_error("Streamed textures must have a single array slice: " + file_path);
+    }
+    format = to_dxgi_format(container.format);
+
+    resource_desc = {};
+    resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    resource_desc.Width = container.width;
+    resource_desc.Height = container.height;
+    resource_desc.DepthOrArraySize = 1;
+    resource_desc.MipLevels = static_cast<UINT16>(container.mip_levels);
+    resource_desc.Format = format;
+    resource_desc.SampleDesc.Count = 1;
+    resource_desc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+
+    if (FAILED(device->CreateReservedResource(&resource_desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resource)))) {
+        throw std::runtime_error("Failed to create reserved texture resource.");
+    }
+
+    UINT subresource_count = container.mip_levels;
+    tilings.resize(subresource_count);
+    UINT total_tiles = 0;
+    device->GetResourceTiling(resource.Get(), &total_tiles, &packed_mip_info, nullptr, &subresource_count, 0, tilings.data());
+
+    // Without a packed tail the coarsest standard mip serves as the tail.
+    tail_mip = packed_mip_info.NumPackedMips > 0 ? packed_mip_info.NumStandardMips : container.mip_levels - 1;
+    resident_mip = tail_mip;
+    mip_heaps.resize(container.mip_levels);
+
+    if (packed_mip_info.NumPackedMips > 0) {
+        tail_heap = map_tiles(device, command_queue, packed_mip_info.NumStandardMips, packed_mip_info.NumTilesForPackedMips);
+    } else {
+        const D3D12_SUBRESOURCE_TILING& tiling = tilings[tail_mip];
+        tail_heap = map_tiles(device, command_queue, tail_mip, tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles);
+    }
+
+    tail_upload_buffer = record_copies(device, command_list, tail_mip, container.mip_levels - tail_mip, nullptr);
+
+    D3D12_RESOURCE_BARRIER barrier = {};
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Transition.pResource = resource.Get();
+    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    command_list->ResourceBarrier(1, &barrier);
+}
+
+StreamedTexture::~StreamedTexture() {}
+
+StreamingTextureDesc StreamedTexture::get_streaming_desc() const {
+    StreamingTextureDesc desc = {};
+    desc.width = container.width;
+    desc.height = container.height;
+    desc.mip_levels = container.mip_levels;
+    desc.tail_mip = tail_mip;
+    desc.mip_sizes.resize(container.mip_levels, 0);
+    for (uint32_t mip = 0; mip < tail_mip; ++mip) {
+        const D3D12_SUBRESOURCE_TILING& tiling = tilings[mip];
+        desc.mip_sizes[mip] = static_cast<uint64_t>(tiling.WidthInTiles) * tiling.HeightInTiles * tiling.DepthInTiles * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+    }
+    UINT tail_tiles = packed_mip_info.NumPackedMips > 0 ? packed_mip_info.NumTilesForPackedMips :
+        tilings[tail_mip].WidthInTiles * tilings[tail_mip].HeightInTiles * tilings[tail_mip].DepthInTiles;
+    desc.mip_sizes[tail_mip] = static_cast<uint64_t>(tail_tiles) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+    return desc;
+}
+
+bool StreamedTexture::read_mip(uint32_t mip, std::vector<uint8_t>& data) const {
+    if (mip >= container.subresources.size()) {
+        return false;
+    }
+    const ContainerSubresource& sub = container.subresources[mip];
+    size_t size = sub.row_size * sub.row_count;
+    data.resize(size);
+    memcpy(data.data(), file->get_data() + sub.offset, size);
+    return true;
+}
+
+ComPtr<ID3D12Heap> StreamedTexture::map_tiles(ID3D12Device* device, ID3D12CommandQueue* command_queue, UINT subresource, UINT tile_count) {
+    D3D12_HEAP_DESC heap_desc = {};
+    heap_desc.SizeInBytes = static_cast<UINT64>(tile_count) * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+    heap_desc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heap_desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heap_desc.Flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES;
+
+    ComPtr<ID3D12Heap> heap;
+    if (FAILED(device->CreateHeap(&heap_desc, IID_PPV_ARGS(&heap)))) {
+        throw std::runtime_error("Failed to create texture tile heap.");
+    }
+
+    D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+    coordinate.Subresource = subresource;
+    D3D12_TILE_REGION_SIZE region = {};
+    region.NumTiles = tile_count;
+    D3D12_TILE_RANGE_FLAGS range_flags = D3D12_TILE_RANGE_FLAG_NONE;
+    UINT heap_offset = 0;
+    command_queue->UpdateTileMappings(resource.Get(), 1, &coordinate, &region, heap.Get(), 1, &range_flags, &heap_offset, &tile_count, D3D12_TILE_MAPPING_FLAG_NONE);
+    return heap;
+}
+
+// Copies mips [first_mip, first_mip + mip_count) from the file, or a single
+// mip from data when given, through a fresh upload buffer.
+ComPtr<ID3D12Resource> StreamedTexture::record_copies(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, UINT first_mip, UINT mip_count, const std::vector<uint8_t>* data) {
+    PROFILE_SCOPE("stream mip copy");
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(mip_count);
+    std::vector<UINT> row_counts(mip_count);
+    std::vector<UINT64> row_sizes(mip_count);
+    UINT64 upload_size = 0;
+    device->GetCopyableFootprints(&resource_desc, first_mip, mip_count, 0, footprints.data(), row_counts.data(), row_sizes.data(), &upload_size);
+
+    D3D12_HEAP_PROPERTIES upload_heap_props = {};
+    upload_heap_props.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+    D3D12_RESOURCE_DESC upload_desc = {};
+    upload_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    upload_desc.Width = upload_size;
+    upload_desc.Height = 1;
+    upload_desc.DepthOrArraySize = 1;
+    upload_desc.MipLevels = 1;
+    upload_desc.SampleDesc.Count = 1;
+    upload_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    ComPtr<ID3D12Resource> upload_buffer;
+    if (FAILED(device->CreateCommittedResource(&upload_heap_props, D3D12_HEAP_FLAG_NONE, &upload_desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&upload_buffer)))) {
+        throw std::runtime_error("Failed to create streaming upload buffer.");
+    }
+
+    UINT8* mapped_data;
+    D3D12_RANGE read_range = {};
+    if (FAILED(upload_buffer->Map(0, &read_range, reinterpret_cast<void**>(&mapped_data)))) {
+        throw std::runtime_error("Failed to map streaming upload buffer.");
+    }
+    for (UINT i = 0; i < mip_count; i++) {
+        const ContainerSubresource& sub = container.subresources[first_mip + i];
+        UINT8* dst = mapped_data + footprints[i].Offset;
+        if (data) {
+            for (UINT row = 0; row < sub.row_count; row++) {
+                memcpy(dst + row * footprints[i].Footprint.RowPitch, data->data() + row * sub.row_size, sub.row_size);
+            }
+        } else {
+            copy_container_subresource(file->get_data(), sub, dst, footprints[i].Footprint.RowPitch);
+        }
+    }
+    upload_buffer->Unmap(0, nullptr);
+
+    for (UINT i = 0; i < mip_count; i++) {
+        D3D12_TEXTURE_COPY_LOCATION dst = {};
+        dst.pResource = resource.Get();
+        dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst.SubresourceIndex = first_mip + i;
+
+        D3D12_TEXTURE_COPY_LOCATION src = {};
+        src.pResource = upload_buffer.Get();
+        src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src.PlacedFootprint = footprints[i];
+
+        command_list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
+    return upload_buffer;
+}
+
+void StreamedTexture::make_resident(ID3D12Device* device, ID3D12CommandQueue* command_queue, ID3D12GraphicsCommandList* command_list, uint32_t mip, const std::vector<uint8_t>& data, UINT64 retire_fence) {
+    PROFILE_SCOPE("stream mip upload");
+    if (mip + 1 != resident_mip) {
+        throw std::runtime_error("Streamed mip " + std::to_string(mip) + " does not follow resident mip " + std::to_string(resident_mip) + ".");
+    }
+    const D3D12_SUBRESOURCE_TILING& tiling = tilings[mip];
+    mip_heaps[mip] = map_tiles(device, command_queue, mip, tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles);
+
+    D3D12_RESOURCE_BARRIER barrier = {};
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Transition.pResource = resource.Get();
+    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+    barrier.Transition.Subresource = mip;
+    command_list->ResourceBarrier(1, &barrier);
+
+    ComPtr<ID3D12Resource> upload_buffer = record_copies(device, command_list, mip, 1, &data);
+    retired.push_back({ nullptr, upload_buffer, retire_fence });
+
+    std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    command_list->ResourceBarrier(1, &barrier);
+
+    resident_mip = mip;
+}
+
+void StreamedTexture::evict(ID3D12CommandQueue* command_queue, uint32_t new_resident_mip, UINT64 retire_fence) {
+    PROFILE_SCOPE("stream mip evict");
+    for (uint32_t mip = resident_mip; mip < new_resident_mip && mip < tail_mip; mip++) {
+        D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+        coordinate.Subresource = mip;
+        D3D12_TILE_REGION_SIZE region = {};
+        region.NumTiles = tilings[mip].WidthInTiles * tilings[mip].HeightInTiles * tilings[mip].DepthInTiles;
+        D3D12_TILE_RANGE_FLAGS range_flags = D3D12_TILE_RANGE_FLAG_NULL;
+        command_queue->UpdateTileMappings(resource.Get(), 1, &coordinate, &region, nullptr, 1, &range_flags, nullptr, nullptr, D3D12_TILE_MAPPING_FLAG_NONE);
+
+        retired.push_back({ mip_heaps[mip], nullptr, retire_fence });
+        mip_heaps[mip].Reset();
+    }
+    if (new_resident_mip > tail_mip) {
+        new_resident_mip = tail_mip;
+    }
+    if (new_resident_mip > resident_mip) {
+        resident_mip = new_resident_mip;
+    }
+}
+
+void StreamedTexture::release_retired(UINT64 completed_fence) {
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [completed_fence](const Retired& entry) {
+        return entry.fence_value <= completed_fence;
+    }), retired.end());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+#include "texture_container.hpp"
+#include "texture_streamer.hpp"
+
+// Reserved (tiled) texture backed by a DDS/KTX2 container. Only the mip tail
+// is mapped at creation; finer mips get their own heap when streamed in and
+// lose it on eviction, so GPU memory tracks what TextureStreamer decides.
+// Shaders must clamp sampling to get_min_lod(), since unmapped tiles are
+// undefined on tier 1 hardware.
+class StreamedTexture {
+public:
+    StreamedTexture(ID3D12Device* device, ID3D12CommandQueue* command_queue, ID3D12GraphicsCommandList* command_list, const std::string& file_path);
+    ~StreamedTexture();
+
+    StreamingTextureDesc get_streaming_desc() const;
+
+    // Copies one mip out of the mapped file. Safe to call from I/O threads.
+    bool read_mip(uint32_t mip, std::vector<uint8_t>& data) const;
+
+    // Tile mapping changes go through the queue, so they are ordered against
+    // frames already submitted. Memory that is no longer needed is kept until
+    // retire_fence completes. make_resident throws unless mip is the next
+    // finer one after the resident mips.
+    void make_resident(ID3D12Device* device, ID3D12CommandQueue* command_queue, ID3D12GraphicsCommandList* command_list, uint32_t mip, const std::vector<uint8_t>& data, UINT64 retire_fence);
+    void evict(ID3D12CommandQueue* command_queue, uint32_t new_resident_mip, UINT64 retire_fence);
+    void release_retired(UINT64 completed_fence);
+
+    ID3D12Resource* get_resource() const { return resource.Get(); }
+    DXGI_FORMAT get_format() const { return format; }
+    UINT get_mip_levels() const { return container.mip_levels; }
+    float get_min_lod() const { return static_cast<float>(resident_mip); }
+
+private:
+    struct Retired {
+        Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+        Microsoft::WRL::ComPtr<ID3D12Resource> upload_buffer;
+        UINT64 fence_value;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12Heap> map_tiles(ID3D12Device* device, ID3D12CommandQueue* command_queue, UINT subresource, UINT tile_count);
+    Microsoft::WRL::ComPtr<ID3D12Resource> record_copies(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, UINT first_mip, UINT mip_count, const std::vector<uint8_t>* data);
+
+    std::unique_ptr<MappedFile> file;
+    TextureContainer container;
+    DXGI_FORMAT format;
+    D3D12_RESOURCE_DESC resource_desc;
+    Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+
+    D3D12_PACKED_MIP_INFO packed_mip_info;
+    std::vector<D3D12_SUBRESOURCE_TILING> tilings;
+    uint32_t tail_mip;
+    uint32_t resident_mip;
+
+    Microsoft::WRL::ComPtr<ID3D12Heap> tail_heap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> tail_upload_buffer;
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> mip_heaps;
+    std::vector<Retired> retired;
+};
@@ -1,36 +1,354 @@
 #include "texture.hpp"
+#include "mip_generator.hpp"
+#include "block_compress.hpp"
+#include "mapped_file.hpp"
+#include "texture_container.hpp"
+#include "image_batch_loader.hpp"
+#include "pixel_convert.hpp"
+#include "float_pack.hpp"
+#include "profiler.hpp"
+#include <cctype>
+#include <cstring>
 #include <stdexcept>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 #include "d3dx12.h"
 
-Texture::Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::string& file_path) {
-    int tex_width, tex_height, channels;
-    stbi_uc* pixels = stbi_load(file_path.c_str(), &tex_width, &tex_height, &channels, 4);
-    if (!pixels) {
-        throw std::runtime_error("Failed to load texture file: " + file_path);
+DXGI_FORMAT to_dxgi_format(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::bc1: return DXGI_FORMAT_BC1_UNORM;
+        case PixelFormat::bc3: return DXGI_FORMAT_BC3_UNORM;
+        case PixelFormat::bc4: return DXGI_FORMAT_BC4_UNORM;
+        case PixelFormat::bc5: return DXGI_FORMAT_BC5_UNORM;
+        case PixelFormat::bc7: return DXGI_FORMAT_BC7_UNORM;
+        case PixelFormat::r8: return DXGI_FORMAT_R8_UNORM;
+        case PixelFormat::rg8: return DXGI_FORMAT_R8G8_UNORM;
+        case PixelFormat::rgba8_srgb: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        case PixelFormat::bc1_srgb: return DXGI_FORMAT_BC1_UNORM_SRGB;
+        case PixelFormat::bc3_srgb: return DXGI_FORMAT_BC3_UNORM_SRGB;
+        case PixelFormat::bc7_srgb: return DXGI_FORMAT_BC7_UNORM_SRGB;
+        case PixelFormat::r11g11b10f: return DXGI_FORMAT_R11G11B10_FLOAT;
+        case PixelFormat::rgb9e5: return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+        case PixelFormat::rgba16f: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+        default: return DXGI_FORMAT_R8G8B8A8_UNORM;
     }
+}
+
+// Images larger than this decoded are streamed in bands when their format allows.
+static const UINT64 streaming_decode_threshold = 64ull * 1024 * 1024;
+static const UINT default_band_rows = 64;
+
+static bool has_extension(const std::string& path, const char* extension) {
+    size_t length = strlen(extension);
+    if (path.size() < length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (tolower(static_cast<unsigned char>(path[path.size() - length + i])) != extension[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static UINT get_level_extent(UINT extent, UINT level) {
+    return extent >> level ? extent >> level : 1;
+}
+
+// D3D12 requires the top level of a block-compressed texture to be whole
+// blocks; smaller or odd sizes use the uncompressed format with the same channels.
+static PixelFormat fit_format(PixelFormat format, UINT width, UINT height) {
+    if (!is_block_compressed(format) || (width % 4 == 0 && height % 4 == 0)) {
+        return format;
+    }
+    switch (format) {
+        case PixelFormat::bc4: return PixelFormat::r8;
+        case PixelFormat::bc5: return PixelFormat::rg8;
+        default: return is_srgb(format) ? PixelFormat::rgba8_srgb : PixelFormat::rgba8;
+    }
+}
+
+Texture::Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::string& file_path, JobPool* job_pool, PixelFormat format,
+                 ColorSpace color_space) :
+    mip_levels(1), array_size(1), format(DXGI_FORMAT_R8G8B8A8_UNORM), resource_size(0), native_bytes_saved(0), component_mapping(D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING),
+    filter_srgb(color_space == ColorSpace::srgb), swizzle_alpha(false), load_stats()
+{
+    MappedFile file(file_path);
+    load_file(device, file_path, file.get_data(), file.get_size(), job_pool, format);
+    record_upload(command_list);
+}
+
+Texture::Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::string& name, const UINT8* data, size_t size, JobPool* job_pool, PixelFormat format,
+                 ColorSpace color_space) :
+    mip_levels(1), array_size(1), format(DXGI_FORMAT_R8G8B8A8_UNORM), resource_size(0), native_bytes_saved(0), component_mapping(D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING),
+    filter_srgb(color_space == ColorSpace::srgb), swizzle_alpha(false), load_stats()
+{
+    load_file(device, name, data, size, job_pool, format);
+    record_upload(command_list);
+}
+
+Texture::Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, ImageSource& source, UINT band_rows, JobPool* job_pool, PixelFormat format,
+                 ColorSpace color_space) :
+    mip_levels(1), array_size(1), format(DXGI_FORMAT_R8G8B8A8_UNORM), resource_size(0), native_bytes_saved(0), component_mapping(D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING),
+    filter_srgb(color_space == ColorSpace::srgb), swizzle_alpha(false), load_stats()
+{
+    load_image(device, "image source", source, band_rows, job_pool, format);
+    record_upload(command_list);
+}
+
+Texture::Texture(ID3D12Device* device, const DecodedImage& image, JobPool* job_pool, PixelFormat format,
+                 ColorSpace color_space) :
+    mip_levels(1), array_size(1), format(DXGI_FORMAT_R8G8B8A8_UNORM), resource_size(0), native_bytes_saved(0), component_mapping(D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING),
+    filter_srgb(color_space == ColorSpace::srgb), swizzle_alpha(false), load_stats()
+{
+    stage_image(device, {image.pixels.data()}, image.width, image.height, image.channels, job_pool, format);
+}
+
+Texture::Texture(ID3D12Device* device, const std::vector<const DecodedImage*>& slices, JobPool* job_pool, PixelFormat format,
+                 ColorSpace color_space) :
+    mip_levels(1), array_size(1), format(DXGI_FORMAT_R8G8B8A8_UNORM), resource_size(0), native_bytes_saved(0), component_mapping(D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING),
+    filter_srgb(color_space == ColorSpace::srgb), swizzle_alpha(false), load_stats()
+{
+    if (slices.empty()) {
+        throw std::runtime_error("Texture array needs at least one slice.");
+    }
+    std::vector<const UINT8*> slice_pixels;
+    UINT channels = 0;
+    for (const DecodedImage* slice : slices) {
+        if (slice->width != slices[0]->width || slice->height != slices[0]->height) {
+            throw std::runtime_error("Texture array slices must share one size.");
+        }
+        slice_pixels.push_back(slice->pixels.data());
+        channels = slice->channels > channels ? slice->channels : channels;
+    }
+    stage_image(device, slice_pixels, slices[0]->width, slices[0]->height, channels, job_pool, format);
+}
+
+Texture::~Texture() {}
+
+void Texture::load_file(ID3D12Device* device, const std::string& name, const UINT8* data, size_t size, JobPool* job_pool, PixelFormat pixel_format) {
+    PROFILE_SCOPE("texture load");
+    if (has_extension(name, ".dds") || has_extension(name, ".ktx2")) {
+        load_container(device, data, size);
+    } else {
+        MemoryImageSource source(data, size);
+        load_image(device, name, source, 0, job_pool, pixel_format);
+    }
+}
+
+void Texture::load_image(ID3D12Device* device, const std::string& file_path, ImageSource& source, UINT band_rows, JobPool* job_pool, PixelFormat pixel_format) {
+    // The file is decoded straight into level 0 of the mip chain, which is
+    // both the filter source and what gets staged, so there is no separate
+    // pixel buffer or copy in between.
+    MipChain mip_chain;
+    ImageInfo info = {};
+    try {
+        info = read_image_info(source);
+        if (info.hdr) {
+            load_hdr_image(device, source, info, job_pool, pixel_format);
+            return;
+        }
+        if (band_rows > 0 || static_cast<UINT64>(info.width) * info.height * 4 > streaming_decode_threshold) {
+            std::unique_ptr<ImageRowReader> reader = open_row_reader(source);
+            if (reader) {
+                load_image_rows(device, *reader, band_rows > 0 ? band_rows : default_band_rows, job_pool, pixel_format);
+                return;
+            }
+        }
+        PROFILE_SCOPE("texture decode");
+        allocate_mip_chain(info.width, info.height, mip_chain);
+        decode_image(source, mip_chain.pixels.data(), static_cast<size_t>(info.width) * 4, job_pool, &load_stats);
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Failed to load texture file: " + file_path + " (" + e.what() + ")");
+    }
+
+    UINT8* mapped_data = begin_staging(device, info.width, info.height, 1, info.channels, pixel_format);
+    {
+        PROFILE_SCOPE("texture mips");
+        build_mip_chain(MipFilter::kaiser, filter_srgb, job_pool, mip_chain);
+    }
+    if (swizzle_alpha) {
+        swizzle_grey_alpha(mip_chain.pixels.data(), mip_chain.pixels.size() / 4);
+    }
+    write_slice(mapped_data, 0, mip_chain, pixel_format, job_pool);
+    upload_heap->Unmap(0, nullptr);
+}
+
+void Texture::load_image_rows(ID3D12Device* device, ImageRowReader& reader, UINT band_rows, JobPool* job_pool, PixelFormat pixel_format) {
+    PROFILE_SCOPE("texture decode rows");
+    const ImageInfo& info = reader.get_info();
+    UINT8* mapped_data = begin_staging(device, info.width, info.height, 1, info.channels, pixel_format);
+    PixelFormat layout = get_linear_format(pixel_format);
+    bool compressed = is_block_compressed(pixel_format);
+
+    // BC levels collect a band of whole block rows and encode it in one go,
+    // so the job pool has rows to split. Uncompressed rows go straight out.
+    UINT flush_rows = band_rows < 4 ? 4 : band_rows & ~3u;
+    std::vector<std::vector<UINT8>> pending(compressed ? mip_levels : 0);
+    for (UINT level = 0; level < pending.size(); level++) {
+        pending[level].resize(static_cast<size_t>(get_level_extent(info.width, level)) * 4 * flush_rows);
+    }
+    std::vector<UINT8> swizzled(swizzle_alpha ? static_cast<size_t>(info.width) * 4 : 0);
+
+    MipRowBuilder builder(info.width, info.height, filter_srgb, [&](uint32_t level, uint32_t row, const uint8_t* rgba) {
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = footprints[level];
+        UINT level_width = get_level_extent(info.width, level);
+        UINT level_height = get_level_extent(info.height, level);
+        size_t row_size = static_cast<size_t>(level_width) * 4;
+        if (swizzle_alpha) {
+            memcpy(swizzled.data(), rgba, row_size);
+            swizzle_grey_alpha(swizzled.data(), level_width);
+            rgba = swizzled.data();
+        }
+        if (!compressed) {
+            pack_rgba8_rows(rgba, level_width, 1, layout, mapped_data + footprint.Offset + row * footprint.Footprint.RowPitch, footprint.Footprint.RowPitch);
+            return;
+        }
+        UINT slot = row % flush_rows;
+        memcpy(pending[level].data() + slot * row_size, rgba, row_size);
+        if (slot + 1 == flush_rows || row + 1 == level_height) {
+            UINT first_block_row = (row - slot) / 4;
+            compress_surface(layout, pending[level].data(), level_width, slot + 1, BlockQuality::fast, job_pool,
+                             mapped_data + footprint.Offset + first_block_row * footprint.Footprint.RowPitch, footprint.Footprint.RowPitch);
+        }
+    });
 
+    std::vector<UINT8> band(static_cast<size_t>(info.width) * 4 * band_rows);
+    for (UINT y = 0; y < info.height; y += band_rows) {
+        UINT count = info.height - y < band_rows ? info.height - y : band_rows;
+        reader.read_rows(band.data(), static_cast<size_t>(info.width) * 4, count);
+        for (UINT i = 0; i < count; i++) {
+            builder.push_row(band.data() + static_cast<size_t>(i) * info.width * 4);
+        }
+    }
+    upload_heap->Unmap(0, nullptr);
+
+    load_stats.allocations = 2 + static_cast<uint64_t>(pending.size());
+    load_stats.allocated_bytes = band.size() + swizzled.size();
+    for (const std::vector<UINT8>& buffer : pending) {
+        load_stats.allocated_bytes += buffer.size();
+    }
+    load_stats.bytes_copied = 0;
+}
+
+void Texture::load_hdr_image(ID3D12Device* device, ImageSource& source, const ImageInfo& info, JobPool* job_pool, PixelFormat pixel_format) {
+    FloatMipChain mip_chain;
+    allocate_float_mip_chain(info.width, info.height, mip_chain);
+    decode_image_float(source, mip_chain.pixels.data(), static_cast<size_t>(info.width) * 4 * sizeof(float), &load_stats);
+    build_float_mip_chain(job_pool, mip_chain);
+
+    pixel_format = select_hdr_format(pixel_format);
+    UINT8* mapped_data = begin_staging(device, info.width, info.height, 1, 4, pixel_format);
+    for (UINT mip = 0; mip < mip_levels; mip++) {
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = footprints[mip];
+        const MipLevel& level = mip_chain.levels[mip];
+        pack_float_rows(pixel_format, mip_chain.get_level_data(mip), level.width, level.height, mapped_data + footprint.Offset, footprint.Footprint.RowPitch, job_pool);
+    }
+    upload_heap->Unmap(0, nullptr);
+}
+
+void Texture::stage_image(ID3D12Device* device, const std::vector<const UINT8*>& slices, UINT tex_width, UINT tex_height, UINT source_channels, JobPool* job_pool, PixelFormat pixel_format) {
+    UINT8* mapped_data = begin_staging(device, tex_width, tex_height, static_cast<UINT>(slices.size()), source_channels, pixel_format);
+
+    // One chain at a time keeps large arrays from holding every slice's mips at once.
+    MipChain mip_chain;
+    for (UINT slice = 0; slice < array_size; slice++) {
+        {
+            PROFILE_SCOPE("texture mips");
+            generate_mip_chain(slices[slice], tex_width, tex_height, MipFilter::kaiser, filter_srgb, job_pool, mip_chain);
+        }
+        if (swizzle_alpha) {
+            swizzle_grey_alpha(mip_chain.pixels.data(), mip_chain.pixels.size() / 4);
+        }
+        write_slice(mapped_data, slice, mip_chain, pixel_format, job_pool);
+    }
+    upload_heap->Unmap(0, nullptr);
+}
+
+UINT8* Texture::begin_staging(ID3D12Device* device, UINT tex_width, UINT tex_height, UINT slice_count, UINT source_channels, PixelFormat& pixel_format) {
+    mip_levels = get_mip_level_count(tex_width, tex_height);
+    array_size = slice_count;
+
+    PixelFormat requested_format = fit_format(pixel_format, tex_width, tex_height);
+    pixel_format = fit_format(select_native_format(pixel_format, source_channels), tex_width, tex_height);
+    format = to_dxgi_format(pixel_format);
+
+    // Grey sources sample as (l, l, l, 1) or (l, l, l, a) like the RGBA8
+    // expansion did, so shaders need no changes. Whether their mips are
+    // filtered in linear light is the asset's colour space, as for any other.
+    bool native = pixel_format != requested_format;
+    swizzle_alpha = native && source_channels == 2;
+    if (native) {
+        UINT alpha = source_channels == 2 ? 1 : D3D12_SHADER_COMPONENT_MAPPING_FORCE_VALUE_1;
+        component_mapping = D3D12_ENCODE_SHADER_4_COMPONENT_MAPPING(0, 0, 0, alpha);
+    }
+    native_bytes_saved = (get_mip_chain_size(requested_format, tex_width, tex_height, mip_levels) -
+                          get_mip_chain_size(pixel_format, tex_width, tex_height, mip_levels)) * slice_count;
+
+    return create_resources(device, tex_width, tex_height);
+}
+
+void Texture::write_slice(UINT8* mapped_data, UINT slice, const MipChain& mip_chain, PixelFormat pixel_format, JobPool* job_pool) {
+    PROFILE_SCOPE("texture write");
+    for (UINT mip = 0; mip < mip_levels; mip++) {
+        UINT subresource = mip + slice * mip_levels;
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = footprints[subresource];
+        const MipLevel& level = mip_chain.levels[mip];
+        const UINT8* src = mip_chain.get_level_data(mip);
+        UINT8* dst = mapped_data + footprint.Offset;
+        if (is_block_compressed(pixel_format)) {
+            // Encode straight into the footprint; row_counts are block rows here.
+            compress_surface(get_linear_format(pixel_format), src, level.width, level.height, BlockQuality::fast, job_pool, dst, footprint.Footprint.RowPitch);
+            continue;
+        }
+        pack_rgba8_rows(src, level.width, row_counts[subresource], get_linear_format(pixel_format), dst, footprint.Footprint.RowPitch);
+    }
+}
+
+void Texture::load_container(ID3D12Device* device, const UINT8* data, size_t size) {
+    PROFILE_SCOPE("texture container copy");
+    TextureContainer container = parse_texture_container(data, size);
+
+    mip_levels = container.mip_levels;
+    array_size = container.array_size;
+    format = to_dxgi_format(container.format);
+
+    // Pages fault in as each subresource is copied, so there is no decode
+    // and no intermediate pixel buffer between the file and the upload heap.
+    UINT8* mapped_data = create_resources(device, container.width, container.height);
+    for (size_t i = 0; i < container.subresources.size(); i++) {
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = footprints[i];
+        copy_container_subresource(data, container.subresources[i], mapped_data + footprint.Offset, footprint.Footprint.RowPitch);
+    }
+    upload_heap->Unmap(0, nullptr);
+}
+
+UINT8* Texture::create_resources(ID3D12Device* device, UINT width, UINT height) {
     D3D12_HEAP_PROPERTIES heap_props = {};
     heap_props.Type = D3D12_HEAP_TYPE_DEFAULT;
 
     D3D12_RESOURCE_DESC texture_desc = {};
     texture_desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    texture_desc.Width = tex_width;
-    texture_desc.Height = tex_height;
-    texture_desc.DepthOrArraySize = 1;
-    texture_desc.MipLevels = 1;
-    texture_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    texture_desc.Width = width;
+    texture_desc.Height = height;
+    texture_desc.DepthOrArraySize = static_cast<UINT16>(array_size);
+    texture_desc.MipLevels = static_cast<UINT16>(mip_levels);
+    texture_desc.Format = format;
     texture_desc.SampleDesc.Count = 1;
     texture_desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 
     if (FAILED(device->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &texture_desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resource)))) {
-        stbi_image_free(pixels);
         throw std::runtime_error("Failed to create texture resource.");
     }
 
-    UINT64 row_pitch = (tex_width * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
-    UINT64 upload_buffer_size = row_pitch * tex_height;
+    // Let the device lay out every subresource; mip row pitches and offsets
+    // are not simple multiples of the top level once widths drop below the
+    // pitch alignment.
+    UINT subresource_count = mip_levels * array_size;
+    footprints.resize(subresource_count);
+    row_counts.resize(subresource_count);
+    std::vector<UINT64> row_sizes(subresource_count);
+    UINT64 upload_buffer_size = 0;
+    device->GetCopyableFootprints(&texture_desc, 0, subresource_count, 0, footprints.data(), row_counts.data(), row_sizes.data(), &upload_buffer_size);
+    resource_size = upload_buffer_size;
 
     D3D12_HEAP_PROPERTIES upload_heap_props = {};
     upload_heap_props.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -45,38 +363,32 @@ Texture::Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list,
     upload_buffer_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 
     if (FAILED(device->CreateCommittedResource(&upload_heap_props, D3D12_HEAP_FLAG_NONE, &upload_buffer_desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&upload_heap)))) {
-        stbi_image_free(pixels);
         throw std::runtime_error("Failed to create texture upload heap.");
     }
 
     UINT8* mapped_data;
     CD3DX12_RANGE read_range(0, 0);
     if (FAILED(upload_heap->Map(0, &read_range, reinterpret_cast<void**>(&mapped_data)))) {
-        stbi_image_free(pixels);
         throw std::runtime_error("Failed to map upload heap.");
     }
+    return mapped_data;
+}
 
-    for (int y = 0; y < tex_height; y++) {
-        memcpy(mapped_data + y * row_pitch, pixels + y * tex_width * 4, tex_width * 4);
-    }
-    upload_heap->Unmap(0, nullptr);
-
-    D3D12_TEXTURE_COPY_LOCATION dst = {};
-    dst.pResource = resource.Get();
-    dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-    dst.SubresourceIndex = 0;
+void Texture::record_upload(ID3D12GraphicsCommandList* command_list) {
+    PROFILE_SCOPE("texture record upload");
+    for (UINT i = 0; i < static_cast<UINT>(footprints.size()); i++) {
+        D3D12_TEXTURE_COPY_LOCATION dst = {};
+        dst.pResource = resource.Get();
+        dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+        dst.SubresourceIndex = i;
 
-    D3D12_TEXTURE_COPY_LOCATION src = {};
-    src.pResource = upload_heap.Get();
-    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    src.PlacedFootprint.Offset = 0;
-    src.PlacedFootprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    src.PlacedFootprint.Footprint.Width = tex_width;
-    src.PlacedFootprint.Footprint.Height = tex_height;
-    src.PlacedFootprint.Footprint.Depth = 1;
-    src.PlacedFootprint.Footprint.RowPitch = static_cast<UINT>(row_pitch);
+        D3D12_TEXTURE_COPY_LOCATION src = {};
+        src.pResource = upload_heap.Get();
+        src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+        src.PlacedFootprint = footprints[i];
 
-    command_list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+        command_list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+    }
 
     D3D12_RESOURCE_BARRIER barrier = {};
     barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -85,8 +397,4 @@ Texture::Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list,
     barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
     barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
     command_list->ResourceBarrier(1, &barrier);
-
-    stbi_image_free(pixels);
 }
-
-Texture::~Texture() {}
@@ -3,15 +3,88 @@
 #include <d3d12.h>
 #include <wrl.h>
 #include <string>
+#include <vector>
+#include "image_decoder.hpp"
+#include "pixel_format.hpp"
+
+class JobPool;
+struct DecodedImage;
+struct MipChain;
+
+DXGI_FORMAT to_dxgi_format(PixelFormat format);
 
 class Texture {
 public:
-    Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::string& file_path);
+    // .dds and .ktx2 files are memory-mapped and their pre-baked subresources
+    // copied straight into the upload heap; format is ignored for them. Other
+    // images are decoded, mipmapped and, for BCn formats, encoded at load
+    // time with the fast encoder. Images whose size is not a multiple of 4
+    // fall back to the uncompressed format with the same channels. HDR images
+    // use format if it is a float format and R11G11B10 otherwise.
+    // color_space says how the texels are encoded so mips are filtered
+    // correctly; it is ignored for containers and HDR images.
+    Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::string& file_path, JobPool* job_pool = nullptr, PixelFormat format = PixelFormat::rgba8,
+            ColorSpace color_space = ColorSpace::srgb);
+    // Same, from file bytes already in memory; name picks the loader by extension.
+    Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::string& name, const UINT8* data, size_t size, JobPool* job_pool = nullptr, PixelFormat format = PixelFormat::rgba8,
+            ColorSpace color_space = ColorSpace::srgb);
+    // Streams PNG and binary PNM sources band_rows rows at a time: each band
+    // is decoded, staged and fed to a running box-filtered mip chain, so
+    // apart from the upload heap memory stays at about two bands however
+    // large the image is. Other sources are decoded whole. The path
+    // constructors stream on their own above 64 MB of decoded pixels.
+    Texture(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, ImageSource& source, UINT band_rows, JobPool* job_pool = nullptr, PixelFormat format = PixelFormat::rgba8,
+            ColorSpace color_space = ColorSpace::srgb);
+    // Builds the resources and fills the upload heap from already decoded
+    // pixels without recording anything, so it may run on a worker thread.
+    // The owner of the command list then calls record_upload.
+    Texture(ID3D12Device* device, const DecodedImage& image, JobPool* job_pool = nullptr, PixelFormat format = PixelFormat::rgba8,
+            ColorSpace color_space = ColorSpace::srgb);
+    // Same, as a Texture2DArray with one slice per image; all must share one size.
+    Texture(ID3D12Device* device, const std::vector<const DecodedImage*>& slices, JobPool* job_pool = nullptr, PixelFormat format = PixelFormat::rgba8,
+            ColorSpace color_space = ColorSpace::srgb);
     ~Texture();
 
+    void record_upload(ID3D12GraphicsCommandList* command_list);
+
     ID3D12Resource* get_resource() const { return resource.Get(); }
+    UINT get_mip_levels() const { return mip_levels; }
+    UINT get_array_size() const { return array_size; }
+    DXGI_FORMAT get_format() const { return format; }
+    // Bytes of texel data across every subresource, as laid out for upload.
+    UINT64 get_size_in_bytes() const { return resource_size; }
+    // Bytes the requested format would have taken beyond the native channel
+    // format actually used; zero for RGB(A) sources and containers.
+    UINT64 get_native_format_savings() const { return native_bytes_saved; }
+    // SRV swizzle that makes R8/RG8/BC4/BC5 grey images sample like RGBA.
+    UINT get_component_mapping() const { return component_mapping; }
+    // Decoder heap traffic for textures loaded from image files; zero otherwise.
+    const ImageDecodeStats& get_load_stats() const { return load_stats; }
 
 private:
+    void load_file(ID3D12Device* device, const std::string& name, const UINT8* data, size_t size, JobPool* job_pool, PixelFormat pixel_format);
+    void load_image(ID3D12Device* device, const std::string& file_path, ImageSource& source, UINT band_rows, JobPool* job_pool, PixelFormat pixel_format);
+    void load_image_rows(ID3D12Device* device, ImageRowReader& reader, UINT band_rows, JobPool* job_pool, PixelFormat pixel_format);
+    void load_hdr_image(ID3D12Device* device, ImageSource& source, const ImageInfo& info, JobPool* job_pool, PixelFormat pixel_format);
+    void stage_image(ID3D12Device* device, const std::vector<const UINT8*>& slices, UINT width, UINT height, UINT source_channels, JobPool* job_pool, PixelFormat pixel_format);
+    void load_container(ID3D12Device* device, const UINT8* data, size_t size);
+    UINT8* begin_staging(ID3D12Device* device, UINT width, UINT height, UINT slice_count, UINT source_channels, PixelFormat& pixel_format);
+    void write_slice(UINT8* mapped_data, UINT slice, const MipChain& mip_chain, PixelFormat pixel_format, JobPool* job_pool);
+    UINT8* create_resources(ID3D12Device* device, UINT width, UINT height);
+
     Microsoft::WRL::ComPtr<ID3D12Resource> resource;
     Microsoft::WRL::ComPtr<ID3D12Resource> upload_heap;
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+    std::vector<UINT> row_counts;
+    UINT mip_levels;
+    UINT array_size;
+    DXGI_FORMAT format;
+    UINT64 resource_size;
+    UINT64 native_bytes_saved;
+    UINT component_mapping;
+    // Mips of sRGB colour are filtered in linear light.
+    bool filter_srgb;
+    // Set by begin_staging for the mip chains that follow it.
+    bool swizzle_alpha;
+    ImageDecodeStats load_stats;
 };
@@ -0,0 +1,310 @@
+#include "texture_container.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+namespace {
+
+const uint8_t ktx2_identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+const uint32_t dds_magic = 0x20534444;
+const uint32_t dds_header_size = 124;
+const uint32_t ddpf_alphapixels = 0x1;
+const uint32_t ddpf_fourcc = 0x4;
+const uint32_t ddpf_rgb = 0x40;
+const uint32_t ddscaps2_cubemap = 0x200;
+
+// D3D12 limits; anything larger could not be created anyway, and capping
+// here keeps every size computed from the header far from overflow.
+const uint32_t max_extent = 16384;
+const uint32_t max_array_size = 2048;
+const uint32_t max_mip_levels = 15;
+
+constexpr uint32_t make_fourcc(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+uint32_t read_u32(const uint8_t* data, size_t offset) {
+    uint32_t value;
+    memcpy(&value, data + offset, 4);
+    return value;
+}
+
+uint64_t read_u64(const uint8_t* data, size_t offset) {
+    uint64_t value;
+    memcpy(&value, data + offset, 8);
+    return value;
+}
+
+void describe_mip(PixelFormat format, uint32_t width, uint32_t height, uint32_t mip, size_t offset, ContainerSubresource& out) {
+    out.width = std::max(width >> mip, 1u);
+    out.height = std::max(height >> mip, 1u);
+    out.offset = offset;
+    out.row_size = get_row_size(format, out.width);
+    out.row_count = get_row_count(format, out.height);
+}
+
+void validate_extent(const TextureContainer& container) {
+    if (container.width == 0 || container.height == 0 || container.width > max_extent || container.height > max_extent ||
+        container.array_size == 0 || container.array_size > max_array_size || container.mip_levels > max_mip_levels ||
+        (std::max(container.width, container.height) >> (container.mip_levels - 1)) == 0) {
+        throw std::runtime_error("Invalid texture container dimensions.");
+    }
+}
+
+// Offsets and lengths come from the file, so sums and products of them are
+// checked rather than trusted to stay inside size_t.
+size_t checked_add(size_t a, size_t b) {
+    if (b > SIZE_MAX - a) {
+        throw std::runtime_error("Texture container sizes overflow.");
+    }
+    return a + b;
+}
+
+size_t checked_multiply(size_t a, size_t b) {
+    if (a != 0 && b > SIZE_MAX / a) {
+        throw std::runtime_error("Texture container sizes overflow.");
+    }
+    return a * b;
+}
+
+PixelFormat dds_dxgi_format(uint32_t dxgi_format) {
+    switch (dxgi_format) {
+        case 10: // DXGI_FORMAT_R16G16B16A16_FLOAT
+            return PixelFormat::rgba16f;
+        case 26: // DXGI_FORMAT_R11G11B10_FLOAT
+            return PixelFormat::r11g11b10f;
+        case 28: // DXGI_FORMAT_R8G8B8A8_UNORM
+            return PixelFormat::rgba8;
+        case 29: // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+            return PixelFormat::rgba8_srgb;
+        case 49: // DXGI_FORMAT_R8G8_UNORM
+            return PixelFormat::rg8;
+        case 61: // DXGI_FORMAT_R8_UNORM
+            return PixelFormat::r8;
+        case 67: // DXGI_FORMAT_R9G9B9E5_SHAREDEXP
+            return PixelFormat::rgb9e5;
+        case 71: // DXGI_FORMAT_BC1_UNORM
+            return PixelFormat::bc1;
+        case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+            return PixelFormat::bc1_srgb;
+        case 77: // DXGI_FORMAT_BC3_UNORM
+            return PixelFormat::bc3;
+        case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+            return PixelFormat::bc3_srgb;
+        case 80: // DXGI_FORMAT_BC4_UNORM
+            return PixelFormat::bc4;
+        case 83: // DXGI_FORMAT_BC5_UNORM
+            return PixelFormat::bc5;
+        case 98: // DXGI_FORMAT_BC7_UNORM
+            return PixelFormat::bc7;
+        case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+            return PixelFormat::bc7_srgb;
+        default:
+            throw std::runtime_error("Unsupported DDS DXGI format: " + std::to_string(dxgi_format));
+    }
+}
+
+PixelFormat dds_legacy_format(const uint8_t* pixel_format) {
+    uint32_t flags = read_u32(pixel_format, 4);
+    uint32_t fourcc = read_u32(pixel_format, 8);
+    if (flags & ddpf_fourcc) {
+        switch (fourcc) {
+            case make_fourcc('D', 'X', 'T', '1'):
+                return PixelFormat::bc1;
+            case make_fourcc('D', 'X', 'T', '5'):
+                return PixelFormat::bc3;
+            case make_fourcc('A', 'T', 'I', '1'):
+            case make_fourcc('B', 'C', '4', 'U'):
+                return PixelFormat::bc4;
+            case make_fourcc('A', 'T', 'I', '2'):
+            case make_fourcc('B', 'C', '5', 'U'):
+                return PixelFormat::bc5;
+            default:
+                throw std::runtime_error("Unsupported DDS FourCC.");
+        }
+    }
+    uint32_t bit_count = read_u32(pixel_format, 12);
+    if ((flags & ddpf_rgb) && (flags & ddpf_alphapixels) && bit_count == 32 &&
+        read_u32(pixel_format, 16) == 0x000000FF && read_u32(pixel_format, 20) == 0x0000FF00 &&
+        read_u32(pixel_format, 24) == 0x00FF0000 && read_u32(pixel_format, 28) == 0xFF000000) {
+        return PixelFormat::rgba8;
+    }
+    throw std::runtime_error("Unsupported DDS pixel format.");
+}
+
+TextureContainer parse_dds(const uint8_t* data, size_t size) {
+    if (size < 4 + dds_header_size || read_u32(data, 4) != dds_header_size) {
+        throw std::runtime_error("Truncated DDS header.");
+    }
+    const uint8_t* header = data + 4;
+    const uint8_t* pixel_format = header + 72;
+
+    TextureContainer container = {};
+    container.height = read_u32(header, 8);
+    container.width = read_u32(header, 12);
+    container.mip_levels = std::max(read_u32(header, 24), 1u);
+    container.array_size = 1;
+
+    size_t data_offset = 4 + dds_header_size;
+    if ((read_u32(pixel_format, 4) & ddpf_fourcc) && read_u32(pixel_format, 8) == make_fourcc('D', 'X', '1', '0')) {
+        if (size < data_offset + 20) {
+            throw std::runtime_error("Truncated DDS DX10 header.");
+        }
+        const uint8_t* dx10 = data + data_offset;
+        container.format = dds_dxgi_format(read_u32(dx10, 0));
+        if (read_u32(dx10, 4) != 3) { // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+            throw std::runtime_error("Only 2D DDS textures are supported.");
+        }
+        container.array_size = std::max(read_u32(dx10, 12), 1u);
+        if (container.array_size > max_array_size) {
+            throw std::runtime_error("Invalid texture container dimensions.");
+        }
+        if (read_u32(dx10, 8) & 0x4) { // D3D11_RESOURCE_MISC_TEXTURECUBE
+            container.array_size *= 6;
+        }
+        data_offset += 20;
+    } else {
+        container.format = dds_legacy_format(pixel_format);
+        if (read_u32(header, 108) & ddscaps2_cubemap) {
+            container.array_size = 6;
+        }
+    }
+
+    validate_extent(container);
+
+    // DDS stores every mip of slice 0, then every mip of slice 1, ...
+    size_t offset = data_offset;
+    container.subresources.resize(static_cast<size_t>(container.mip_levels) * container.array_size);
+    for (uint32_t slice = 0; slice < container.array_size; ++slice) {
+        for (uint32_t mip = 0; mip < container.mip_levels; ++mip) {
+            ContainerSubresource& sub = container.subresources[mip + slice * container.mip_levels];
+            describe_mip(container.format, container.width, container.height, mip, offset, sub);
+            offset = checked_add(offset, checked_multiply(sub.row_size, sub.row_count));
+        }
+    }
+    if (offset > size) {
+        throw std::runtime_error("Truncated DDS payload.");
+    }
+    return container;
+}
+
+PixelFormat ktx2_vk_format(uint32_t vk_format) {
+    switch (vk_format) {
+        case 9: // VK_FORMAT_R8_UNORM
+            return PixelFormat::r8;
+        case 16: // VK_FORMAT_R8G8_UNORM
+            return PixelFormat::rg8;
+        case 37: // VK_FORMAT_R8G8B8A8_UNORM
+            return PixelFormat::rgba8;
+        case 43: // VK_FORMAT_R8G8B8A8_SRGB
+            return PixelFormat::rgba8_srgb;
+        case 97: // VK_FORMAT_R16G16B16A16_SFLOAT
+            return PixelFormat::rgba16f;
+        case 122: // VK_FORMAT_B10G11R11_UFLOAT_PACK32
+            return PixelFormat::r11g11b10f;
+        case 123: // VK_FORMAT_E5B9G9R9_UFLOAT_PACK32
+            return PixelFormat::rgb9e5;
+        case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+        case 133:
+            return PixelFormat::bc1;
+        case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+        case 134:
+            return PixelFormat::bc1_srgb;
+        case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+            return PixelFormat::bc3;
+        case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+            return PixelFormat::bc3_srgb;
+        case 139: // VK_FORMAT_BC4_UNORM_BLOCK
+            return PixelFormat::bc4;
+        case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+            return PixelFormat::bc5;
+        case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+            return PixelFormat::bc7;
+        case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+            return PixelFormat::bc7_srgb;
+        default:
+            throw std::runtime_error("Unsupported KTX2 vkFormat: " + std::to_string(vk_format));
+    }
+}
+
+TextureContainer parse_ktx2(const uint8_t* data, size_t size) {
+    const size_t level_index_offset = 80;
+    if (size < level_index_offset) {
+        throw std::runtime_error("Truncated KTX2 header.");
+    }
+
+    TextureContainer container = {};
+    container.format = ktx2_vk_format(read_u32(data, 12));
+    container.width = read_u32(data, 20);
+    container.height = std::max(read_u32(data, 24), 1u);
+    if (read_u32(data, 28) > 1) {
+        throw std::runtime_error("3D KTX2 textures are not supported.");
+    }
+    uint64_t layer_count = std::max(read_u32(data, 32), 1u);
+    uint64_t face_count = std::max(read_u32(data, 36), 1u);
+    if (layer_count * face_count > max_array_size) {
+        throw std::runtime_error("Invalid texture container dimensions.");
+    }
+    container.mip_levels = std::max(read_u32(data, 40), 1u);
+    container.array_size = static_cast<uint32_t>(layer_count * face_count);
+    if (read_u32(data, 44) != 0) {
+        throw std::runtime_error("Supercompressed KTX2 textures are not supported.");
+    }
+    validate_extent(container);
+    if (size < level_index_offset + static_cast<size_t>(container.mip_levels) * 24) {
+        throw std::runtime_error("Truncated KTX2 level index.");
+    }
+
+    // Each level holds every layer and face back to back.
+    container.subresources.resize(static_cast<size_t>(container.mip_levels) * container.array_size);
+    for (uint32_t mip = 0; mip < container.mip_levels; ++mip) {
+        const size_t entry = level_index_offset + static_cast<size_t>(mip) * 24;
+        uint64_t level_offset = read_u64(data, entry);
+        uint64_t level_length = read_u64(data, entry + 8);
+        if (level_offset > size || level_length > size - level_offset) {
+            throw std::runtime_error("Truncated KTX2 payload.");
+        }
+
+        size_t offset = static_cast<size_t>(level_offset);
+        for (uint32_t slice = 0; slice < container.array_size; ++slice) {
+            ContainerSubresource& sub = container.subresources[mip + slice * container.mip_levels];
+            describe_mip(container.format, container.width, container.height, mip, offset, sub);
+            offset = checked_add(offset, checked_multiply(sub.row_size, sub.row_count));
+        }
+        if (offset - level_offset > level_length) {
+            throw std::runtime_error("KTX2 level is smaller than its images.");
+        }
+    }
+    return container;
+}
+
+}
+
+bool is_texture_container(const uint8_t* data, size_t size) {
+    return (size >= 4 && read_u32(data, 0) == dds_magic) ||
+           (size >= sizeof(ktx2_identifier) && memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0);
+}
+
+TextureContainer parse_texture_container(const uint8_t* data, size_t size) {
+    if (size >= 4 && read_u32(data, 0) == dds_magic) {
+        return parse_dds(data, size);
+    }
+    if (size >= sizeof(ktx2_identifier) && memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0) {
+        return parse_ktx2(data, size);
+    }
+    throw std::runtime_error("Unknown texture container.");
+}
+
+void copy_container_subresource(const uint8_t* file_data, const ContainerSubresource& subresource, uint8_t* dst, size_t dst_row_pitch) {
+    const uint8_t* src = file_data + subresource.offset;
+    if (dst_row_pitch == subresource.row_size) {
+        memcpy(dst, src, subresource.row_size * subresource.row_count);
+        return;
+    }
+    for (uint32_t row = 0; row < subresource.row_count; ++row) {
+        memcpy(dst + row * dst_row_pitch, src + row * subresource.row_size, subresource.row_size);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "pixel_format.hpp"
+
+// One mip of one array slice inside a container file, tightly packed.
+struct ContainerSubresource {
+    size_t offset;
+    size_t row_size;
+    uint32_t row_count;
+    uint32_t width;
+    uint32_t height;
+};
+
+// Layout of a pre-baked texture. Subresources are ordered like D3D12
+// subresource indices: mip + slice * mip_levels.
+struct TextureContainer {
+    PixelFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    uint32_t array_size;
+    std::vector<ContainerSubresource> subresources;
+};
+
+// Parses DDS (legacy FourCC and DX10 headers) or uncompressed KTX2 by
+// magic. Only describes the payload; nothing is copied. Throws on
+// malformed or unsupported files.
+TextureContainer parse_texture_container(const uint8_t* data, size_t size);
+
+bool is_texture_container(const uint8_t* data, size_t size);
+
+// Copies one subresource row by row into a destination with a wider pitch.
+void copy_container_subresource(const uint8_t* file_data, const ContainerSubresource& subresource, uint8_t* dst, size_t dst_row_pitch);
@@ -0,0 +1,56 @@
+#include "texture_loader.hpp"
+#include "profiler.hpp"
+#include <stdexcept>
+
+TextureLoader::TextureLoader(ID3D12Device* device, JobPool& job_pool, PixelFormat format, ColorSpace color_space, uint32_t io_thread_count) :
+    device(device), format(format), color_space(color_space),
+    loader(job_pool, io_thread_count, 64ull * 1024 * 1024, [this](ImageLoadHandle handle, DecodedImage& image) { stage(handle, image); })
+{
+}
+
+ImageLoadHandle TextureLoader::load(const std::string& path) {
+    return loader.load(path);
+}
+
+std::vector<ImageLoadHandle> TextureLoader::load_batch(const std::vector<std::string>& paths) {
+    return loader.load_batch(paths);
+}
+
+bool TextureLoader::is_ready(ImageLoadHandle handle) const {
+    return loader.get_status(handle) != ImageLoadStatus::pending;
+}
+
+void TextureLoader::wait_all() {
+    loader.wait_all();
+}
+
+void TextureLoader::stage(ImageLoadHandle handle, DecodedImage& image) {
+    PROFILE_SCOPE("image stage");
+    // Parallelism comes from loading many images at once, so each texture
+    // builds its mips and blocks on this worker alone.
+    std::unique_ptr<Texture> texture = std::make_unique<Texture>(device, image, nullptr, format, color_space);
+    // The upload heap holds everything now; drop the decoded copy early.
+    std::vector<uint8_t>().swap(image.pixels);
+
+    std::lock_guard<std::mutex> lock(textures_mutex);
+    textures[handle] = std::move(texture);
+}
+
+std::unique_ptr<Texture> TextureLoader::take(ImageLoadHandle handle, ID3D12GraphicsCommandList* command_list) {
+    if (loader.wait(handle) == ImageLoadStatus::failed) {
+        throw std::runtime_error("Failed to load texture file: " + loader.get_path(handle) + " (" + loader.get_error(handle) + ")");
+    }
+
+    std::unique_ptr<Texture> texture;
+    {
+        std::lock_guard<std::mutex> lock(textures_mutex);
+        auto it = textures.find(handle);
+        if (it == textures.end()) {
+            throw std::runtime_error("Texture was already taken.");
+        }
+        texture = std::move(it->second);
+        textures.erase(it);
+    }
+    texture->record_upload(command_list);
+    return texture;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <d3d12.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "image_batch_loader.hpp"
+#include "pixel_format.hpp"
+#include "texture.hpp"
+
+// Bulk texture loading. Each image is read, decoded, mipmapped, encoded and
+// copied into its own upload heap on the job pool, one image per worker, so
+// a large batch scales with core count. Only the copy commands are recorded
+// on the calling thread, when a finished texture is taken. Handles are the
+// ImageBatchLoader ones. Pre-baked .dds/.ktx2 files should still go through
+// Texture directly; they need no decode.
+class TextureLoader {
+public:
+    // Every image in the loader is staged as format and color_space.
+    TextureLoader(ID3D12Device* device, JobPool& job_pool, PixelFormat format = PixelFormat::rgba8, ColorSpace color_space = ColorSpace::srgb,
+                  uint32_t io_thread_count = 1);
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    ImageLoadHandle load(const std::string& path);
+    std::vector<ImageLoadHandle> load_batch(const std::vector<std::string>& paths);
+
+    bool is_ready(ImageLoadHandle handle) const;
+    void wait_all();
+
+    // Waits for the texture if needed, records its upload and hands it over.
+    // Throws if the image could not be loaded.
+    std::unique_ptr<Texture> take(ImageLoadHandle handle, ID3D12GraphicsCommandList* command_list);
+
+    ImageBatchStats get_stats() const { return loader.get_stats(); }
+
+private:
+    void stage(ImageLoadHandle handle, DecodedImage& image);
+
+    ID3D12Device* device;
+    PixelFormat format;
+    ColorSpace color_space;
+    std::mutex textures_mutex;
+    std::unordered_map<ImageLoadHandle, std::unique_ptr<Texture>> textures;
+    // Declared last so in-flight stages finish before the map is destroyed.
+    ImageBatchLoader loader;
+};
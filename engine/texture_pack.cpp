@@ -0,0 +1,99 @@
+#include "texture_pack.hpp"
+#include "image_batch_loader.hpp"
+#include <cstring>
+#include <stdexcept>
+
+// Copies image into the page and repeats its edge texels across the padding
+// so bilinear taps and the first few mips never pick up a neighbour.
+static void blit_extruded(DecodedImage& page, const DecodedImage& image, const AtlasRect& rect, uint32_t padding) {
+    int32_t pad = static_cast<int32_t>(padding);
+    int32_t width = static_cast<int32_t>(image.width);
+    int32_t height = static_cast<int32_t>(image.height);
+    for (int32_t y = -pad; y < height + pad; y++) {
+        int32_t src_y = y < 0 ? 0 : (y >= height ? height - 1 : y);
+        const UINT8* src = image.pixels.data() + static_cast<size_t>(src_y) * image.width * 4;
+        UINT8* dst = page.pixels.data() + (static_cast<size_t>(rect.y + y) * page.width + rect.x) * 4;
+        for (int32_t x = -pad; x < 0; x++) {
+            memcpy(dst + x * 4, src, 4);
+        }
+        memcpy(dst, src, static_cast<size_t>(width) * 4);
+        for (int32_t x = width; x < width + pad; x++) {
+            memcpy(dst + x * 4, src + (width - 1) * 4, 4);
+        }
+    }
+}
+
+TexturePack::TexturePack(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::vector<std::string>& paths, JobPool& job_pool,
+                         PixelFormat format, ColorSpace color_space, const TexturePackOptions& options)
+{
+    std::vector<DecodedImage> images;
+    images.reserve(paths.size());
+    {
+        ImageBatchLoader loader(job_pool);
+        for (ImageLoadHandle handle : loader.load_batch(paths)) {
+            images.push_back(loader.take(handle));
+        }
+        load_stats = loader.get_stats();
+    }
+
+    std::vector<ImageExtent> extents;
+    extents.reserve(images.size());
+    for (const DecodedImage& image : images) {
+        extents.push_back({image.width, image.height});
+    }
+    plan = plan_texture_pack(extents, options);
+
+    for (uint32_t group_index = 0; group_index < plan.groups.size(); group_index++) {
+        const PackGroup& group = plan.groups[group_index];
+        std::vector<const DecodedImage*> slices;
+
+        std::vector<DecodedImage> pages;
+        if (group.kind == PackGroupKind::array) {
+            for (uint32_t member : group.members) {
+                slices.push_back(&images[member]);
+            }
+        } else {
+            pages.resize(group.slice_count);
+            for (DecodedImage& page : pages) {
+                page.width = group.width;
+                page.height = group.height;
+                page.channels = 0;
+                page.pixels.assign(static_cast<size_t>(group.width) * group.height * 4, 0);
+            }
+            for (uint32_t member : group.members) {
+                const PackedTextureLocation& location = plan.locations[member];
+                DecodedImage& page = pages[location.slice];
+                blit_extruded(page, images[member], location.rect, group.padding);
+                page.channels = images[member].channels > page.channels ? images[member].channels : page.channels;
+                std::vector<uint8_t>().swap(images[member].pixels);
+            }
+            for (const DecodedImage& page : pages) {
+                slices.push_back(&page);
+            }
+        }
+
+        textures.push_back(std::make_unique<Texture>(device, slices, &job_pool, format, color_space));
+        textures.back()->record_upload(command_list);
+    }
+}
+
+UINT64 TexturePack::get_native_format_savings() const {
+    UINT64 saved = 0;
+    for (const std::unique_ptr<Texture>& texture : textures) {
+        saved += texture->get_native_format_savings();
+    }
+    return saved;
+}
+
+void TexturePack::create_srvs(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE first, UINT descriptor_size) const {
+    for (const std::unique_ptr<Texture>& texture : textures) {
+        D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+        srv_desc.Shader4ComponentMapping = texture->get_component_mapping();
+        srv_desc.Format = texture->get_format();
+        srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+        srv_desc.Texture2DArray.MipLevels = texture->get_mip_levels();
+        srv_desc.Texture2DArray.ArraySize = texture->get_array_size();
+        device->CreateShaderResourceView(texture->get_resource(), &srv_desc, first);
+        first.ptr += descriptor_size;
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <d3d12.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "atlas_packer.hpp"
+#include "image_batch_loader.hpp"
+#include "pixel_format.hpp"
+#include "texture.hpp"
+
+// Packs many small textures into a few Texture2DArrays: same-size images
+// share an array, odd sizes go onto atlas pages, which are slices of one
+// more array. Shaders sample slot = locations[i] as
+// tex.Sample(s, float3(frac(uv) * slot.uv.scale + slot.uv.offset, slot.slice)),
+// so a whole pack needs one descriptor per group instead of one per image.
+class TexturePack {
+public:
+    // Decodes every image on the job pool, then stages and records the upload
+    // of each group. Image i keeps index i in get_location. Images share
+    // textures, so they share one format and colour space.
+    TexturePack(ID3D12Device* device, ID3D12GraphicsCommandList* command_list, const std::vector<std::string>& paths, JobPool& job_pool,
+                PixelFormat format = PixelFormat::rgba8, ColorSpace color_space = ColorSpace::srgb, const TexturePackOptions& options = {});
+
+    uint32_t get_group_count() const { return static_cast<uint32_t>(textures.size()); }
+    Texture* get_group_texture(uint32_t group) const { return textures[group].get(); }
+    const PackedTextureLocation& get_location(uint32_t index) const { return plan.locations[index]; }
+    const TexturePackPlan& get_plan() const { return plan; }
+    // Read and decode totals of the images.
+    const ImageBatchStats& get_load_stats() const { return load_stats; }
+    // Groups whose images are all grey or grey plus alpha use R8/RG8 (or BC4/BC5).
+    UINT64 get_native_format_savings() const;
+
+    // Writes one Texture2DArray SRV per group into consecutive descriptors.
+    void create_srvs(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE first, UINT descriptor_size) const;
+
+private:
+    TexturePackPlan plan;
+    ImageBatchStats load_stats;
+    std::vector<std::unique_ptr<Texture>> textures;
+};
@@ -0,0 +1,237 @@
+#include "texture_streamer.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+TextureStreamer::TextureStreamer(uint64_t budget_bytes, uint32_t io_thread_count, LoadFunction load) :
+    load(std::move(load)), budget_bytes(budget_bytes), resident_bytes(0), pending_bytes(0), pending_requests(0),
+    loads_completed(0), evictions(0), stopping(false)
+{
+    io_thread_count = std::max(io_thread_count, 1u);
+    for (uint32_t i = 0; i < io_thread_count; ++i) {
+        io_threads.emplace_back(&TextureStreamer::io_thread_main, this);
+    }
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+        load_queue.clear();
+    }
+    queue_cv.notify_all();
+    for (std::thread& thread : io_threads) {
+        thread.join();
+    }
+}
+
+StreamingTextureId TextureStreamer::register_texture(const StreamingTextureDesc& desc) {
+    if (desc.mip_levels == 0 || desc.tail_mip >= desc.mip_levels || desc.mip_sizes.size() != desc.mip_levels) {
+        throw std::runtime_error("Invalid streaming texture description.");
+    }
+
+    TextureState state = {};
+    state.desc = desc;
+    state.resident_mip = desc.tail_mip;
+    state.wanted_mip = desc.tail_mip;
+    for (uint32_t mip = desc.tail_mip; mip < desc.mip_levels; ++mip) {
+        resident_bytes += desc.mip_sizes[mip];
+    }
+    textures.push_back(std::move(state));
+    return static_cast<StreamingTextureId>(textures.size() - 1);
+}
+
+void TextureStreamer::set_budget(uint64_t budget_bytes) {
+    this->budget_bytes = budget_bytes;
+}
+
+void TextureStreamer::request(StreamingTextureId texture, float screen_size, uint64_t frame) {
+    TextureState& state = textures[texture];
+    uint32_t wanted = compute_wanted_mip(state.desc, screen_size);
+    // Several uses in one frame: the largest on-screen use wins.
+    if (state.last_used_frame == frame) {
+        state.wanted_mip = std::min(state.wanted_mip, wanted);
+        state.priority = std::max(state.priority, screen_size);
+    } else {
+        state.wanted_mip = wanted;
+        state.priority = screen_size;
+    }
+    state.last_used_frame = frame;
+}
+
+StreamingUpdate TextureStreamer::update(uint64_t frame) {
+    PROFILE_SCOPE("streaming update");
+    StreamingUpdate result;
+
+    std::vector<StreamedMip> finished;
+    std::vector<StreamedMip> finished_failed;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        finished.swap(completed);
+        finished_failed.swap(failed);
+    }
+    for (StreamedMip& mip : finished) {
+        TextureState& state = textures[mip.texture];
+        uint64_t size = state.desc.mip_sizes[mip.mip];
+        state.load_pending = false;
+        state.just_loaded = true;
+        pending_bytes -= size;
+        --pending_requests;
+        state.resident_mip = mip.mip;
+        resident_bytes += size;
+        ++loads_completed;
+        result.loaded.push_back(std::move(mip));
+    }
+    for (const StreamedMip& mip : finished_failed) {
+        TextureState& state = textures[mip.texture];
+        state.load_pending = false;
+        pending_bytes -= state.desc.mip_sizes[mip.mip];
+        --pending_requests;
+    }
+
+    // Highest on-screen detail deficit first.
+    std::vector<StreamingTextureId> wanting;
+    for (StreamingTextureId id = 0; id < textures.size(); ++id) {
+        const TextureState& state = textures[id];
+        if (!state.load_pending && state.wanted_mip < state.resident_mip) {
+            wanting.push_back(id);
+        }
+    }
+    std::sort(wanting.begin(), wanting.end(), [this](StreamingTextureId a, StreamingTextureId b) {
+        const TextureState& sa = textures[a];
+        const TextureState& sb = textures[b];
+        float pa = sa.priority * (sa.resident_mip - sa.wanted_mip);
+        float pb = sb.priority * (sb.resident_mip - sb.wanted_mip);
+        return pa > pb;
+    });
+
+    std::vector<LoadRequest> requests;
+    for (StreamingTextureId id : wanting) {
+        TextureState& state = textures[id];
+        uint32_t mip = state.resident_mip - 1;
+        uint64_t size = state.desc.mip_sizes[mip];
+        if (resident_bytes + pending_bytes + size > budget_bytes && !evict_for(size, frame, id, result.evicted)) {
+            continue;
+        }
+        state.load_pending = true;
+        pending_bytes += size;
+        ++pending_requests;
+        requests.push_back({ id, mip });
+    }
+
+    if (!requests.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            load_queue.insert(load_queue.end(), requests.begin(), requests.end());
+        }
+        queue_cv.notify_all();
+    }
+    for (const StreamedMip& mip : result.loaded) {
+        textures[mip.texture].just_loaded = false;
+    }
+    return result;
+}
+
+bool TextureStreamer::evict_for(uint64_t bytes, uint64_t frame, StreamingTextureId requester, std::vector<MipEviction>& evicted) {
+    while (resident_bytes + pending_bytes + bytes > budget_bytes) {
+        // Prefer textures holding more detail than they want, then the least
+        // recently used. Textures seen this frame at their wanted detail are kept.
+        StreamingTextureId victim = UINT32_MAX;
+        bool victim_over_detailed = false;
+        for (StreamingTextureId id = 0; id < textures.size(); ++id) {
+            const TextureState& state = textures[id];
+            if (id == requester || state.load_pending || state.just_loaded || state.resident_mip >= state.desc.tail_mip) {
+                continue;
+            }
+            bool over_detailed = state.resident_mip < state.wanted_mip;
+            if (!over_detailed && state.last_used_frame >= frame) {
+                continue;
+            }
+            if (victim == UINT32_MAX ||
+                (over_detailed && !victim_over_detailed) ||
+                (over_detailed == victim_over_detailed && state.last_used_frame < textures[victim].last_used_frame)) {
+                victim = id;
+                victim_over_detailed = over_detailed;
+            }
+        }
+        if (victim == UINT32_MAX) {
+            return false;
+        }
+
+        TextureState& state = textures[victim];
+        resident_bytes -= state.desc.mip_sizes[state.resident_mip];
+        ++state.resident_mip;
+        ++evictions;
+        if (!evicted.empty() && evicted.back().texture == victim) {
+            evicted.back().resident_mip = state.resident_mip;
+        } else {
+            evicted.push_back({ victim, state.resident_mip });
+        }
+    }
+    return true;
+}
+
+void TextureStreamer::io_thread_main() {
+    Profiler::set_thread_name("texture streaming io");
+    for (;;) {
+        LoadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping || !load_queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            request = load_queue.front();
+            load_queue.pop_front();
+        }
+
+        StreamedMip mip = { request.texture, request.mip, {} };
+        bool loaded;
+        {
+            PROFILE_SCOPE("stream mip read");
+            loaded = load(request.texture, request.mip, mip.data);
+        }
+
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        (loaded ? completed : failed).push_back(std::move(mip));
+    }
+}
+
+uint32_t TextureStreamer::get_resident_mip(StreamingTextureId texture) const {
+    return textures[texture].resident_mip;
+}
+
+uint32_t TextureStreamer::get_wanted_mip(StreamingTextureId texture) const {
+    return textures[texture].wanted_mip;
+}
+
+StreamingCounters TextureStreamer::get_counters() const {
+    StreamingCounters counters = {};
+    counters.budget_bytes = budget_bytes;
+    counters.resident_bytes = resident_bytes;
+    counters.pending_bytes = pending_bytes;
+    counters.pending_requests = pending_requests;
+    counters.loads_completed = loads_completed;
+    counters.evictions = evictions;
+    return counters;
+}
+
+uint32_t TextureStreamer::compute_wanted_mip(const StreamingTextureDesc& desc, float screen_size) {
+    if (screen_size <= 0.0f) {
+        return desc.tail_mip;
+    }
+    float texels = static_cast<float>(std::max(desc.width, desc.height));
+    float mip = std::floor(std::log2(texels / screen_size));
+    if (mip <= 0.0f) {
+        return 0;
+    }
+    return std::min(static_cast<uint32_t>(mip), desc.tail_mip);
+}
+
+float TextureStreamer::compute_screen_size(float radius, float distance, float fov, float viewport_height) {
+    if (distance <= radius) {
+        return viewport_height * 4.0f;
+    }
+    return radius / (distance * std::tan(fov * 0.5f)) * viewport_height;
+}
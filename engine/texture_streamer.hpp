@@ -0,0 +1,123 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using StreamingTextureId = uint32_t;
+
+struct StreamingTextureDesc {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    // First mip of the tail that stays resident for the texture's lifetime.
+    uint32_t tail_mip;
+    // Resident cost of each mip, in whatever unit the budget is expressed in.
+    std::vector<uint64_t> mip_sizes;
+};
+
+struct StreamedMip {
+    StreamingTextureId texture;
+    uint32_t mip;
+    std::vector<uint8_t> data;
+};
+
+struct MipEviction {
+    StreamingTextureId texture;
+    uint32_t resident_mip;
+};
+
+struct StreamingUpdate {
+    std::vector<StreamedMip> loaded;
+    std::vector<MipEviction> evicted;
+};
+
+struct StreamingCounters {
+    uint64_t budget_bytes;
+    uint64_t resident_bytes;
+    uint64_t pending_bytes;
+    uint32_t pending_requests;
+    uint64_t loads_completed;
+    uint64_t evictions;
+};
+
+// Decides which mips of each texture should be resident. Textures start with
+// only their tail; each frame callers report how large a texture appears on
+// screen, and update() streams in the next finer mip for textures that want
+// more detail, one mip at a time, on background I/O threads. When a load
+// would exceed the budget, the finest mips of least recently used textures
+// are evicted first. GPU work is left to the caller, so this class has no
+// graphics API dependency.
+class TextureStreamer {
+public:
+    // Runs on an I/O thread. Returns false if the mip could not be read.
+    using LoadFunction = std::function<bool(StreamingTextureId texture, uint32_t mip, std::vector<uint8_t>& data)>;
+
+    TextureStreamer(uint64_t budget_bytes, uint32_t io_thread_count, LoadFunction load);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    StreamingTextureId register_texture(const StreamingTextureDesc& desc);
+    void set_budget(uint64_t budget_bytes);
+
+    // screen_size is the texture's larger on-screen extent in pixels.
+    void request(StreamingTextureId texture, float screen_size, uint64_t frame);
+
+    // A texture never appears in both lists of one update, so callers may
+    // apply them in either order.
+    StreamingUpdate update(uint64_t frame);
+
+    uint32_t get_resident_mip(StreamingTextureId texture) const;
+    uint32_t get_wanted_mip(StreamingTextureId texture) const;
+    StreamingCounters get_counters() const;
+
+    static uint32_t compute_wanted_mip(const StreamingTextureDesc& desc, float screen_size);
+
+    // Larger on-screen extent, in pixels, of a sphere seen by a perspective camera.
+    static float compute_screen_size(float radius, float distance, float fov, float viewport_height);
+
+private:
+    struct TextureState {
+        StreamingTextureDesc desc;
+        uint32_t resident_mip;
+        uint32_t wanted_mip;
+        uint64_t last_used_frame;
+        float priority;
+        bool load_pending;
+        // Set while update() hands out a mip for the texture; the caller maps
+        // it after the update returns, so it cannot be evicted in the same one.
+        bool just_loaded;
+    };
+
+    struct LoadRequest {
+        StreamingTextureId texture;
+        uint32_t mip;
+    };
+
+    void io_thread_main();
+    bool evict_for(uint64_t bytes, uint64_t frame, StreamingTextureId requester, std::vector<MipEviction>& evicted);
+
+    LoadFunction load;
+    std::vector<TextureState> textures;
+    uint64_t budget_bytes;
+    uint64_t resident_bytes;
+    uint64_t pending_bytes;
+    uint32_t pending_requests;
+    uint64_t loads_completed;
+    uint64_t evictions;
+
+    std::vector<std::thread> io_threads;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<LoadRequest> load_queue;
+    std::vector<StreamedMip> completed;
+    std::vector<StreamedMip> failed;
+    bool stopping;
+};
@@ -1,8 +1,17 @@
 #include "window.hpp"
 #include "renderer.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cwchar>
 #include <stdexcept>
 
-Window::Window(UINT width, UINT height, const wchar_t* title) {
+Window::Window(UINT width, UINT height, const wchar_t* title) : title(title), last_title_update(0), quit_after_replay(false), profile_path("profile.json") {
+    Profiler::set_thread_name("main");
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    qpc_frequency = frequency.QuadPart;
+
     WNDCLASSW wc = {};
     wc.lpfnWndProc = window_proc;
     wc.hInstance = GetModuleHandle(nullptr);
@@ -24,32 +33,147 @@ Window::Window(UINT width, UINT height, const wchar_t* title) {
 
     SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
 
+    // Raw mouse motion: unaccelerated counts, one message per report.
+    RAWINPUTDEVICE mouse = {};
+    mouse.usUsagePage = 0x01;
+    mouse.usUsage = 0x02;
+    mouse.hwndTarget = hwnd;
+    if (!RegisterRawInputDevices(&mouse, 1, sizeof(mouse))) {
+        throw std::runtime_error("Failed to register raw mouse input.");
+    }
+
     ShowWindow(hwnd, SW_SHOW);
 
     renderer = std::make_unique<Renderer>(width, height, hwnd);
 }
 
 Window::~Window() {
+    // Stops the render thread before the window it presents to goes away.
+    renderer.reset();
+    if (Profiler::is_enabled()) {
+        save_profile();
+    }
     DestroyWindow(hwnd);
 }
 
 void Window::run() {
-    MSG msg = {};
-    while (msg.message != WM_QUIT) {
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+    for (;;) {
+        // Everything queued goes before the next update, so no input waits
+        // behind a frame.
+        MSG msg = {};
+        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                // A recording that failed to finish is reported like any
+                // other error, rather than left truncated on disk.
+                renderer->stop_input_recording();
+                return;
+            }
             TranslateMessage(&msg);
             DispatchMessage(&msg);
-        } else {
-            try {
-                renderer->render();
-            } catch (const std::exception& e) {
-                MessageBoxA(nullptr, e.what(), "Render Error", MB_OK | MB_ICONERROR);
-                break;
+        }
+        try {
+            // Hands a frame to the render thread, or returns right away
+            // while the display or the render thread is behind so messages
+            // keep flowing.
+            if (renderer->update(input_events)) {
+                update_title();
             }
+        } catch (const std::exception& e) {
+            MessageBoxA(nullptr, e.what(), "Render Error", MB_OK | MB_ICONERROR);
+            return;
+        }
+        if (quit_after_replay && !renderer->is_replaying_input()) {
+            quit_after_replay = false;
+            PostQuitMessage(0);
         }
     }
 }
 
+void Window::record_input(const std::string& path) {
+    renderer->record_input(path);
+}
+
+void Window::replay_input(const std::string& path) {
+    renderer->replay_input(path);
+    quit_after_replay = true;
+}
+
+void Window::capture_profile(const std::string& path) {
+    profile_path = path;
+    Profiler::start();
+}
+
+void Window::toggle_profile() {
+    if (Profiler::is_enabled()) {
+        save_profile();
+    } else {
+        Profiler::start();
+    }
+}
+
+void Window::save_profile() {
+    // Also runs from the destructor, so failures are shown, not thrown.
+    try {
+        Profiler::write_chrome_trace(profile_path);
+    } catch (const std::exception& e) {
+        MessageBoxA(nullptr, e.what(), "Profiler Error", MB_OK | MB_ICONERROR);
+    }
+}
+
+void Window::push_input(InputEventType type, uint8_t key, int32_t dx, int32_t dy) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    InputEvent event;
+    event.time = now.QuadPart / qpc_frequency * 1000000000 + now.QuadPart % qpc_frequency * 1000000000 / qpc_frequency;
+    event.type = type;
+    event.key = key;
+    event.dx = dx;
+    event.dy = dy;
+    input_events.push(event);
+}
+
+void Window::handle_raw_input(HRAWINPUT handle) {
+    RAWINPUT raw;
+    UINT size = sizeof(raw);
+    if (GetRawInputData(handle, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) == static_cast<UINT>(-1)) {
+        return;
+    }
+    if (raw.header.dwType != RIM_TYPEMOUSE || (raw.data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE)) {
+        return;
+    }
+    if (raw.data.mouse.lLastX != 0 || raw.data.mouse.lLastY != 0) {
+        push_input(InputEventType::mouse_move, 0, raw.data.mouse.lLastX, raw.data.mouse.lLastY);
+    }
+}
+
+void Window::update_title() {
+    ULONGLONG now = GetTickCount64();
+    if (now - last_title_update < 1000) {
+        return;
+    }
+    last_title_update = now;
+    FrameLatencyStats stats = renderer->get_latency_stats();
+    FramePipelineTimings timings = renderer->get_frame_timings();
+    wchar_t text[512];
+    swprintf(text, 512, L"%ls | %u frames in flight, vsync %ls | input to display %.1f ms avg, %.1f ms max"
+             L" | simulate %.2f ms (wait %.2f), render %.2f ms (wait %.2f)",
+             title.c_str(), stats.frames_in_flight, stats.vsync ? L"on" : L"off", stats.average_ms, stats.max_ms,
+             timings.simulation.work_ms, timings.simulation.wait_ms, timings.render.work_ms, timings.render.wait_ms);
+    if (Profiler::is_enabled()) {
+        size_t length = wcslen(text);
+        swprintf(text + length, 512 - length, L" | profiling");
+    }
+    // A rejected shader edit keeps the old shaders running; show the first
+    // line of why, short enough to fit the title.
+    std::string reload_error = renderer->get_shader_reload_error();
+    if (!reload_error.empty()) {
+        size_t length = wcslen(text);
+        int shown = static_cast<int>(std::min<size_t>(reload_error.find('\n'), 160));
+        swprintf(text + length, 512 - length, L" | shader reload failed: %.*hs", shown, reload_error.c_str());
+    }
+    SetWindowTextW(hwnd, text);
+}
+
 LRESULT CALLBACK Window::window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
     Window* window = reinterpret_cast<Window*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
 
@@ -57,11 +181,45 @@ LRESULT CALLBACK Window::window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM
         case WM_DESTROY:
             PostQuitMessage(0);
             return 0;
+        case WM_INPUT:
+            if (window) {
+                window->handle_raw_input(reinterpret_cast<HRAWINPUT>(lparam));
+            }
+            // DefWindowProc releases the input data.
+            break;
+        case WM_KILLFOCUS:
+            if (window) {
+                window->push_input(InputEventType::focus_lost, 0, 0, 0);
+            }
+            break;
+        case WM_KEYUP:
+            if (window && wparam < 256) {
+                window->push_input(InputEventType::key_up, static_cast<uint8_t>(wparam), 0, 0);
+            }
+            break;
         case WM_KEYDOWN:
+            // Bit 30 marks auto-repeat; only the first press is an event.
+            if (window && wparam < 256 && !(lparam & (1 << 30))) {
+                window->push_input(InputEventType::key_down, static_cast<uint8_t>(wparam), 0, 0);
+            }
             if (wparam == VK_ESCAPE) {
                 PostQuitMessage(0);
                 return 0;
             }
+            // P starts or ends a profiler capture.
+            if (window && wparam == 'P' && !(lparam & (1 << 30))) {
+                window->toggle_profile();
+                return 0;
+            }
+            // 1-4 pick the frames in flight, V toggles vsync.
+            if (window && window->renderer && wparam >= '1' && wparam <= '4') {
+                window->renderer->set_frames_in_flight(static_cast<UINT>(wparam - '0'));
+                return 0;
+            }
+            if (window && window->renderer && wparam == 'V') {
+                window->renderer->set_vsync(!window->renderer->get_vsync());
+                return 0;
+            }
             break;
         case WM_SIZE:
             if (window && window->renderer) {
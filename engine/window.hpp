@@ -2,7 +2,9 @@
 
 #include <windows.h>
 #include <memory>
+#include <string>
 #include "renderer.hpp"
+#include "input.hpp"
 
 class Window {
 public:
@@ -11,9 +13,30 @@ public:
 
     void run();
 
+    // See Renderer::record_input and replay_input. A replay closes the
+    // window once it runs out, so runs driven by one end on their own.
+    void record_input(const std::string& path);
+    void replay_input(const std::string& path);
+
+    // Starts a profiler capture written to path when the window closes, or
+    // when P ends it. Without one, P captures to profile.json.
+    void capture_profile(const std::string& path);
+
 private:
     static LRESULT CALLBACK window_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam);
+    void update_title();
+    void push_input(InputEventType type, uint8_t key, int32_t dx, int32_t dy);
+    void handle_raw_input(HRAWINPUT handle);
+    void toggle_profile();
+    void save_profile();
 
     HWND hwnd;
+    std::wstring title;
+    ULONGLONG last_title_update;
+    INT64 qpc_frequency;
+    bool quit_after_replay;
+    std::string profile_path;
+    // Filled by window_proc, drained by the simulation.
+    InputEventRing input_events;
     std::unique_ptr<Renderer> renderer;
 };
@@ -0,0 +1,199 @@
+// Packs random and hand-picked rectangle sets and checks every layout:
+// placements stay inside their page with their padding, padded rectangles
+// never overlap, alignment holds, and texture pack plans group and remap
+// images as documented.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "atlas_packer.hpp"
+#include "check.hpp"
+
+static std::vector<ImageExtent> make_extents(uint32_t count, uint32_t max_extent, uint32_t seed) {
+    std::vector<ImageExtent> extents(count);
+    for (ImageExtent& extent : extents) {
+        seed = seed * 1664525u + 1013904223u;
+        extent.width = 1 + (seed >> 8) % max_extent;
+        seed = seed * 1664525u + 1013904223u;
+        extent.height = 1 + (seed >> 8) % max_extent;
+    }
+    return extents;
+}
+
+static bool is_power_of_two(uint32_t value) {
+    return value && !(value & (value - 1));
+}
+
+// Checks the layout against the contract in atlas_packer.hpp. Returns false
+// on the first violation so a broken layout is reported once.
+static bool is_valid_layout(const AtlasLayout& layout, const std::vector<ImageExtent>& extents, uint32_t max_size, uint32_t padding,
+                            uint32_t alignment) {
+    padding = (padding + alignment - 1) / alignment * alignment;
+    if (layout.padding != padding || layout.placements.size() != extents.size() || layout.width > max_size || layout.height > max_size) {
+        return false;
+    }
+    if (!extents.empty() && (!is_power_of_two(layout.width) || !is_power_of_two(layout.height) || layout.page_count == 0)) {
+        return false;
+    }
+    std::vector<AtlasRect> padded(extents.size());
+    for (size_t i = 0; i < extents.size(); ++i) {
+        const AtlasPlacement& placement = layout.placements[i];
+        const AtlasRect& rect = placement.rect;
+        if (placement.page >= layout.page_count || rect.width != extents[i].width || rect.height != extents[i].height) {
+            return false;
+        }
+        if (rect.x < padding || rect.y < padding || (rect.x - padding) % alignment || (rect.y - padding) % alignment) {
+            return false;
+        }
+        padded[i] = { rect.x - padding, rect.y - padding, rect.width + 2 * padding, rect.height + 2 * padding };
+        if (padded[i].x + padded[i].width > layout.width || padded[i].y + padded[i].height > layout.height) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < padded.size(); ++i) {
+        for (size_t j = i + 1; j < padded.size(); ++j) {
+            if (layout.placements[i].page != layout.placements[j].page) {
+                continue;
+            }
+            const AtlasRect& a = padded[i];
+            const AtlasRect& b = padded[j];
+            if (a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void test_random_layouts() {
+    const uint32_t settings[][4] = {
+        // count, largest extent, padding, alignment
+        { 1, 64, 0, 1 }, { 50, 64, 0, 1 }, { 200, 100, 2, 1 }, { 200, 100, 3, 4 }, { 500, 40, 4, 4 }, { 300, 500, 1, 4 }, { 64, 1000, 8, 4 },
+    };
+    uint32_t seed = 1;
+    for (const auto& setting : settings) {
+        std::vector<ImageExtent> extents = make_extents(setting[0], setting[1], seed++);
+        AtlasLayout layout = pack_atlas(extents, 2048, setting[2], setting[3]);
+        CHECK(is_valid_layout(layout, extents, 2048, setting[2], setting[3]));
+    }
+
+    // More than one max-size page holds: spills onto further pages.
+    std::vector<ImageExtent> extents = make_extents(400, 120, 99);
+    AtlasLayout layout = pack_atlas(extents, 512, 2, 4);
+    CHECK(layout.page_count > 1 && layout.width == 512 && layout.height == 512);
+    CHECK(is_valid_layout(layout, extents, 512, 2, 4));
+}
+
+static void test_smallest_page() {
+    // Sixteen 16x16 tiles fill a 64x64 page exactly.
+    std::vector<ImageExtent> tiles(16, { 16, 16 });
+    AtlasLayout layout = pack_atlas(tiles, 4096, 0, 1);
+    CHECK(layout.width == 64 && layout.height == 64 && layout.page_count == 1);
+    CHECK(is_valid_layout(layout, tiles, 4096, 0, 1));
+
+    // Half that fits a 64x32 page.
+    tiles.resize(8);
+    layout = pack_atlas(tiles, 4096, 0, 1);
+    CHECK(layout.width == 64 && layout.height == 32);
+
+    std::vector<ImageExtent> none;
+    layout = pack_atlas(none, 4096, 4, 4);
+    CHECK(layout.page_count == 0 && layout.placements.empty());
+}
+
+static void test_too_large() {
+    std::vector<ImageExtent> fits = { { 248, 248 } };
+    CHECK(pack_atlas(fits, 256, 4, 4).page_count == 1);
+    std::vector<ImageExtent> padded_too_large = { { 250, 10 } };
+    CHECK_THROWS(pack_atlas(padded_too_large, 256, 4, 4));
+}
+
+static void test_skyline() {
+    SkylinePacker packer(32, 32);
+    AtlasRect rect;
+    CHECK(packer.insert(32, 16, rect) && rect.x == 0 && rect.y == 0);
+    CHECK(packer.insert(16, 16, rect) && rect.x == 0 && rect.y == 16);
+    CHECK(packer.insert(16, 16, rect) && rect.x == 16 && rect.y == 16);
+    CHECK(std::fabs(packer.get_occupancy() - 1.0f) < 1e-6f);
+    CHECK(!packer.insert(1, 1, rect));
+    SkylinePacker small(8, 8);
+    CHECK(!small.insert(9, 1, rect));
+}
+
+static void test_uv_remap() {
+    std::vector<ImageExtent> extents = { { 30, 10 }, { 12, 20 } };
+    AtlasLayout layout = pack_atlas(extents, 1024, 1, 1);
+    for (uint32_t i = 0; i < extents.size(); ++i) {
+        UvRemap remap = compute_uv_remap(layout, i);
+        const AtlasRect& rect = layout.placements[i].rect;
+        // The corners of the texture's own UV square land on the corners of its rectangle.
+        CHECK(std::fabs(remap.offset_u * layout.width - rect.x) < 1e-3f);
+        CHECK(std::fabs(remap.offset_v * layout.height - rect.y) < 1e-3f);
+        CHECK(std::fabs((remap.scale_u + remap.offset_u) * layout.width - (rect.x + rect.width)) < 1e-3f);
+        CHECK(std::fabs((remap.scale_v + remap.offset_v) * layout.height - (rect.y + rect.height)) < 1e-3f);
+    }
+}
+
+static void test_pack_plan() {
+    // Three 64x64 and two 32x16 become arrays; the odd sizes share an atlas.
+    std::vector<ImageExtent> extents = { { 64, 64 }, { 10, 20 }, { 32, 16 }, { 64, 64 }, { 7, 7 }, { 32, 16 }, { 64, 64 } };
+    TexturePackOptions options;
+    options.max_array_layers = 2;
+    TexturePackPlan plan = plan_texture_pack(extents, options);
+    CHECK(plan.locations.size() == extents.size());
+
+    uint32_t arrays = 0;
+    uint32_t atlases = 0;
+    for (const PackGroup& group : plan.groups) {
+        (group.kind == PackGroupKind::array ? arrays : atlases)++;
+        CHECK(group.slice_count >= 1 && (group.kind == PackGroupKind::atlas || group.slice_count <= options.max_array_layers));
+    }
+    // 64x64 splits into two arrays of at most two layers.
+    CHECK(arrays == 3 && atlases == 1);
+
+    for (uint32_t i = 0; i < extents.size(); ++i) {
+        const PackedTextureLocation& location = plan.locations[i];
+        const PackGroup& group = plan.groups[location.group];
+        CHECK(std::find(group.members.begin(), group.members.end(), i) != group.members.end());
+        CHECK(location.rect.width == extents[i].width && location.rect.height == extents[i].height);
+        CHECK(location.rect.x + location.rect.width <= group.width && location.rect.y + location.rect.height <= group.height);
+        if (group.kind == PackGroupKind::array) {
+            CHECK(group.padding == 0);
+            CHECK(group.width == extents[i].width && group.height == extents[i].height);
+            CHECK(group.members[location.slice] == i);
+            CHECK(location.uv.scale_u == 1.0f && location.uv.offset_u == 0.0f);
+        } else {
+            CHECK(extents[i].width != 64 && extents[i].width != 32);
+            CHECK(group.padding == options.padding);
+            CHECK(location.rect.x >= group.padding && location.rect.y >= group.padding);
+        }
+    }
+
+    // The gap to extrude into is the padding after rounding to the alignment.
+    TexturePackOptions unaligned = options;
+    unaligned.padding = 3;
+    unaligned.alignment = 4;
+    for (const PackGroup& group : plan_texture_pack(extents, unaligned).groups) {
+        CHECK(group.padding == (group.kind == PackGroupKind::atlas ? 4u : 0u));
+    }
+
+    // Deterministic: the same input gives the same plan.
+    TexturePackPlan again = plan_texture_pack(extents, options);
+    bool same = again.groups.size() == plan.groups.size();
+    for (uint32_t i = 0; same && i < extents.size(); ++i) {
+        same = again.locations[i].group == plan.locations[i].group && again.locations[i].slice == plan.locations[i].slice &&
+               again.locations[i].rect.x == plan.locations[i].rect.x && again.locations[i].rect.y == plan.locations[i].rect.y;
+    }
+    CHECK(same);
+}
+
+int main() {
+    test_random_layouts();
+    test_smallest_page();
+    test_too_large();
+    test_skyline();
+    test_uv_remap();
+    test_pack_plan();
+    return finish_checks("atlas_packer_test");
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+// Assertions for the headless tests. A failed check reports where and what,
+// and the test exits non-zero once it has run the rest of its checks.
+inline int& get_check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++get_check_failures();                                                   \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_THROWS(expression)                                                      \
+    do {                                                                              \
+        bool thrown = false;                                                          \
+        try {                                                                         \
+            (void)(expression);                                                       \
+        } catch (const std::exception&) {                                             \
+            thrown = true;                                                            \
+        }                                                                             \
+        if (!thrown) {                                                                \
+            fprintf(stderr, "%s:%d: expected a throw: %s\n", __FILE__, __LINE__, #expression); \
+            ++get_check_failures();                                                   \
+        }                                                                             \
+    } while (0)
+
+// Returns from main.
+inline int finish_checks(const char* name) {
+    int failures = get_check_failures();
+    if (failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, failures);
+        return EXIT_FAILURE;
+    }
+    printf("%s: passed\n", name);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+// Checks pack_float_rows bit for bit against scalar reference encoders for
+// rgba16f, r11g11b10f and rgb9e5: random values across the whole range,
+// rounding ties, subnormals, saturation, NaN and infinity, row tails and
+// padded pitches, serially and on a job pool. Also bounds the relative error
+// reported by measure_float_packing.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "check.hpp"
+#include "float_pack.hpp"
+#include "job_pool.hpp"
+
+// Non-negative finite value to a float with a 5-bit exponent (bias 15) and
+// mantissa_bits of mantissa, rounded to nearest even in double precision.
+static uint32_t encode_unsigned_reference(float value, int mantissa_bits, float max_value) {
+    double v = std::isnan(value) ? 0.0 : std::min(std::max(static_cast<double>(value), 0.0), static_cast<double>(max_value));
+    if (v == 0.0) {
+        return 0;
+    }
+    int exponent = std::ilogb(v);
+    if (exponent < -14) {
+        // Rounding up into the smallest normal carries into the exponent field.
+        return static_cast<uint32_t>(std::nearbyint(std::ldexp(v, 14 + mantissa_bits)));
+    }
+    uint32_t rounded = static_cast<uint32_t>(std::nearbyint(std::ldexp(v, mantissa_bits - exponent)));
+    return (static_cast<uint32_t>(exponent + 15) << mantissa_bits) + rounded - (1u << mantissa_bits);
+}
+
+static uint16_t encode_half_reference(float value) {
+    uint16_t sign = !std::isnan(value) && std::signbit(value) ? 0x8000 : 0;
+    return static_cast<uint16_t>(sign | encode_unsigned_reference(std::isnan(value) ? 0.0f : std::fabs(value), 10, 65504.0f));
+}
+
+static uint32_t encode_r11g11b10f_reference(const float* rgba) {
+    return encode_unsigned_reference(rgba[0], 6, 65024.0f) | encode_unsigned_reference(rgba[1], 6, 65024.0f) << 11 |
+           encode_unsigned_reference(rgba[2], 5, 64512.0f) << 22;
+}
+
+// The D3D conversion rules, in float as they are written.
+static uint32_t encode_rgb9e5_reference(const float* rgba) {
+    float channels[3];
+    for (int c = 0; c < 3; ++c) {
+        channels[c] = std::isnan(rgba[c]) ? 0.0f : std::min(std::max(rgba[c], 0.0f), 65408.0f);
+    }
+    float max_channel = std::max(channels[0], std::max(channels[1], channels[2]));
+    int exponent = max_channel > 0.0f ? std::max(std::ilogb(max_channel), -16) : -16;
+    int shared = exponent + 16;
+    float denominator = std::ldexp(1.0f, shared - 24);
+    if (std::floor(max_channel / denominator + 0.5f) == 512.0f) {
+        denominator *= 2.0f;
+        shared++;
+    }
+    uint32_t bits = static_cast<uint32_t>(shared) << 27;
+    for (int c = 0; c < 3; ++c) {
+        bits |= static_cast<uint32_t>(std::floor(channels[c] / denominator + 0.5f)) << (9 * c);
+    }
+    return bits;
+}
+
+static const PixelFormat formats[] = { PixelFormat::rgba16f, PixelFormat::r11g11b10f, PixelFormat::rgb9e5 };
+
+// Values every encoder has to get right, then random magnitudes spread
+// evenly over 2^-30 to 2^17, some of them negative.
+static std::vector<float> make_values(size_t count) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    std::vector<float> values = {
+        0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 1.0f / 3.0f, 65504.0f, 65520.0f, 65536.0f, 65024.0f, 64512.0f, 65408.0f, 70000.0f, 1e10f,
+        infinity, -infinity, std::numeric_limits<float>::quiet_NaN(), -2.0f, 6.1035156e-05f, 6.0e-05f, 5.9604645e-08f, 2.9802322e-08f,
+        2.9802326e-08f, 1e-20f, std::numeric_limits<float>::denorm_min(),
+        // Ties and near-ties for a 10-, 6- and 5-bit mantissa.
+        1.0f + 1.0f / 2048.0f, 1.0f + 3.0f / 2048.0f, 1.0f + 1.0f / 128.0f, 1.0f + 3.0f / 128.0f, 1.0f + 1.0f / 64.0f, 1.0f + 3.0f / 64.0f,
+        std::nextafter(1.0f + 1.0f / 2048.0f, 2.0f), std::nextafter(1.0f + 1.0f / 128.0f, 0.0f), 2.0f - 1.0f / 4096.0f, 2.0f - 1.0f / 256.0f,
+    };
+    uint32_t state = 7;
+    while (values.size() < count) {
+        state = state * 1664525u + 1013904223u;
+        float exponent = -30.0f + 47.0f * ((state >> 8) / 16777216.0f);
+        state = state * 1664525u + 1013904223u;
+        float mantissa = 1.0f + (state >> 8) / 16777216.0f;
+        float value = std::ldexp(mantissa, static_cast<int>(std::floor(exponent)));
+        values.push_back((state & 1) && values.size() % 7 == 0 ? -value : value);
+    }
+    return values;
+}
+
+static void encode_reference(PixelFormat format, const float* texel, uint8_t* dst) {
+    if (format == PixelFormat::rgba16f) {
+        for (int c = 0; c < 4; ++c) {
+            uint16_t half = encode_half_reference(texel[c]);
+            memcpy(dst + c * 2, &half, 2);
+        }
+        return;
+    }
+    uint32_t bits = format == PixelFormat::r11g11b10f ? encode_r11g11b10f_reference(texel) : encode_rgb9e5_reference(texel);
+    memcpy(dst, &bits, 4);
+}
+
+static void test_against_reference(JobPool& job_pool) {
+    std::vector<float> values = make_values(4096);
+    // Widths off a multiple of four exercise the padded last group; the
+    // pitch leaves a gap after each row that must stay untouched.
+    const uint32_t sizes[][2] = { { 1, 1 }, { 3, 5 }, { 4, 4 }, { 37, 19 }, { 128, 600 } };
+    for (PixelFormat format : formats) {
+        uint32_t texel_size = get_element_size(format);
+        for (const auto& size : sizes) {
+            uint32_t width = size[0];
+            uint32_t height = size[1];
+            std::vector<float> rgba(static_cast<size_t>(width) * height * 4);
+            for (size_t i = 0; i < rgba.size(); ++i) {
+                rgba[i] = values[(i * 31 + width) % values.size()];
+            }
+            size_t pitch = static_cast<size_t>(width) * texel_size + 12;
+            std::vector<uint8_t> serial(pitch * height, 0xCD);
+            std::vector<uint8_t> parallel(pitch * height, 0xCD);
+            pack_float_rows(format, rgba.data(), width, height, serial.data(), pitch, nullptr);
+            pack_float_rows(format, rgba.data(), width, height, parallel.data(), pitch, &job_pool);
+            CHECK(serial == parallel);
+
+            uint32_t mismatches = 0;
+            bool gap_untouched = true;
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    uint8_t expected[8];
+                    encode_reference(format, &rgba[(static_cast<size_t>(y) * width + x) * 4], expected);
+                    if (memcmp(expected, &serial[y * pitch + x * texel_size], texel_size) != 0) {
+                        if (mismatches++ == 0) {
+                            const float* texel = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+                            fprintf(stderr, "format %u texel (%g, %g, %g, %g) differs from the reference\n", static_cast<uint32_t>(format),
+                                    texel[0], texel[1], texel[2], texel[3]);
+                        }
+                    }
+                }
+                for (size_t i = static_cast<size_t>(width) * texel_size; i < pitch; ++i) {
+                    gap_untouched &= serial[y * pitch + i] == 0xCD;
+                }
+            }
+            CHECK(mismatches == 0);
+            CHECK(gap_untouched);
+        }
+    }
+}
+
+// Every finite encoding decodes to a value that packs back to itself.
+static void test_round_trip() {
+    std::vector<uint16_t> halves;
+    for (uint32_t bits = 0; bits < 0x10000; ++bits) {
+        if ((bits & 0x7C00) != 0x7C00) {
+            halves.push_back(static_cast<uint16_t>(bits));
+        }
+    }
+    while (halves.size() % 4) {
+        halves.push_back(0);
+    }
+    uint32_t texels = static_cast<uint32_t>(halves.size() / 4);
+    std::vector<float> rgba(halves.size());
+    unpack_float_rows(PixelFormat::rgba16f, reinterpret_cast<const uint8_t*>(halves.data()), halves.size() * 2, texels, 1, rgba.data());
+    std::vector<uint16_t> repacked(halves.size());
+    pack_float_rows(PixelFormat::rgba16f, rgba.data(), texels, 1, reinterpret_cast<uint8_t*>(repacked.data()), repacked.size() * 2);
+    CHECK(repacked == halves);
+
+    // 11-bit red and green and 10-bit blue, every finite pattern of each.
+    std::vector<uint32_t> packed;
+    for (uint32_t bits = 0; bits < 0x7C0; ++bits) {
+        packed.push_back(bits | bits << 11 | (bits >> 1) << 22);
+    }
+    texels = static_cast<uint32_t>(packed.size());
+    rgba.resize(static_cast<size_t>(texels) * 4);
+    unpack_float_rows(PixelFormat::r11g11b10f, reinterpret_cast<const uint8_t*>(packed.data()), packed.size() * 4, texels, 1, rgba.data());
+    std::vector<uint32_t> repacked32(packed.size());
+    pack_float_rows(PixelFormat::r11g11b10f, rgba.data(), texels, 1, reinterpret_cast<uint8_t*>(repacked32.data()), repacked32.size() * 4);
+    CHECK(repacked32 == packed);
+}
+
+static void test_error_bounds(JobPool& job_pool) {
+    // Finite, in-range HDR colours; the error is relative to the brightest channel.
+    std::vector<float> values = make_values(4096 * 4);
+    std::vector<float> rgba;
+    for (float value : values) {
+        if (std::isfinite(value) && std::fabs(value) < 60000.0f) {
+            rgba.push_back(std::fabs(value));
+        }
+    }
+    rgba.resize(rgba.size() / 256 * 256);
+    uint32_t width = 64;
+    uint32_t height = static_cast<uint32_t>(rgba.size() / 4 / width);
+    // Half an ulp of the mantissa: 10 bits, 5 bits for blue in R11G11B10,
+    // 9 bits of the shared exponent's scale for RGB9E5.
+    const double bounds[] = { 1.0 / 2048.0 + 1e-7, 1.0 / 64.0 + 1e-7, 1.0 / 512.0 + 1e-7 };
+    for (size_t i = 0; i < 3; ++i) {
+        FloatPackReport report = measure_float_packing(formats[i], rgba.data(), width, height, &job_pool);
+        CHECK(report.max_relative_error <= bounds[i]);
+        CHECK(report.mean_relative_error < report.max_relative_error);
+        CHECK(report.packed_bytes == static_cast<size_t>(width) * height * get_element_size(formats[i]));
+    }
+}
+
+int main() {
+    JobPool job_pool(3);
+    test_against_reference(job_pool);
+    test_round_trip();
+    test_error_bounds(job_pool);
+    CHECK_THROWS(pack_float_rows(PixelFormat::rgba8, nullptr, 0, 0, nullptr, 0));
+    return finish_checks("float_pack_test");
+}
@@ -0,0 +1,137 @@
+// Loads a batch of PPM and PGM files through ImageBatchLoader, some missing,
+// corrupt or rejected by the stage function, and checks the pixels, the
+// per-handle status and the counters get_stats reports. A read-ahead limit
+// smaller than one file still lets the batch through.
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "image_batch_loader.hpp"
+#include "job_pool.hpp"
+
+static std::vector<uint8_t> make_pnm(uint32_t width, uint32_t height, uint32_t channels, uint8_t seed) {
+    std::string header = (channels == 1 ? "P5\n" : "P6\n") + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::vector<uint8_t> file(header.begin(), header.end());
+    for (uint32_t i = 0; i < width * height * channels; ++i) {
+        file.push_back(static_cast<uint8_t>(seed + i * 3));
+    }
+    return file;
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+    FILE* file = fopen(path.c_str(), "wb");
+    CHECK(file != nullptr);
+    if (file) {
+        CHECK(fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        CHECK(fclose(file) == 0);
+    }
+}
+
+struct Batch {
+    std::vector<std::string> paths;
+    std::vector<bool> loads;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_decoded = 0;
+    std::string rejected;
+};
+
+// Sixteen good images, a missing file, a truncated one, and one the stage
+// function throws on. Files that exist count as read; images that decode
+// count as decoded even when staging then fails.
+static Batch make_batch(const std::filesystem::path& root) {
+    Batch batch;
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t channels = i % 4 == 0 ? 1 : 3;
+        std::vector<uint8_t> file = make_pnm(8 + i, 5 + i % 3, channels, static_cast<uint8_t>(i));
+        std::string path = (root / ("image_" + std::to_string(i) + (channels == 1 ? ".pgm" : ".ppm"))).string();
+        write_file(path, file);
+        batch.paths.push_back(path);
+        batch.loads.push_back(true);
+        batch.bytes_read += file.size();
+        batch.bytes_decoded += (8 + i) * (5 + i % 3) * 4;
+    }
+    batch.paths.push_back((root / "missing.ppm").string());
+    batch.loads.push_back(false);
+
+    std::vector<uint8_t> truncated = make_pnm(20, 20, 3, 1);
+    truncated.resize(truncated.size() / 2);
+    batch.paths.push_back((root / "truncated.ppm").string());
+    write_file(batch.paths.back(), truncated);
+    batch.loads.push_back(false);
+    batch.bytes_read += truncated.size();
+
+    std::vector<uint8_t> rejected = make_pnm(4, 4, 3, 2);
+    batch.rejected = (root / "rejected.ppm").string();
+    batch.paths.push_back(batch.rejected);
+    write_file(batch.rejected, rejected);
+    batch.loads.push_back(false);
+    batch.bytes_read += rejected.size();
+    batch.bytes_decoded += 4 * 4 * 4;
+    return batch;
+}
+
+static void run_batch(const Batch& batch, JobPool& job_pool, uint32_t io_thread_count, size_t max_read_ahead_bytes) {
+    ImageBatchLoader* loader_pointer = nullptr;
+    ImageBatchLoader loader(job_pool, io_thread_count, max_read_ahead_bytes, [&](ImageLoadHandle handle, DecodedImage& image) {
+        if (loader_pointer->get_path(handle) == batch.rejected) {
+            throw std::runtime_error("Rejected by stage.");
+        }
+        // Staging sees the decoded image before take() does.
+        image.pixels[3] = 7;
+    });
+    loader_pointer = &loader;
+
+    std::vector<ImageLoadHandle> handles = loader.load_batch(batch.paths);
+    loader.wait_all();
+    for (size_t i = 0; i < handles.size(); ++i) {
+        CHECK(loader.get_status(handles[i]) == (batch.loads[i] ? ImageLoadStatus::ready : ImageLoadStatus::failed));
+        CHECK(loader.get_error(handles[i]).empty() == batch.loads[i]);
+    }
+    CHECK(loader.get_error(handles.back()) == "Rejected by stage.");
+    CHECK_THROWS(loader.take(handles[16]));
+
+    // Grey is expanded to RGBA with opaque alpha.
+    DecodedImage grey = loader.take(handles[0]);
+    CHECK(grey.width == 8 && grey.height == 5 && grey.channels == 1 && grey.pixels.size() == 8 * 5 * 4);
+    CHECK(grey.pixels[4] == 1 * 3 && grey.pixels[5] == 1 * 3 && grey.pixels[6] == 1 * 3 && grey.pixels[7] == 255);
+    CHECK(grey.pixels[3] == 7);
+    DecodedImage colour = loader.take(handles[1]);
+    CHECK(colour.width == 9 && colour.height == 6 && colour.channels == 3);
+    CHECK(colour.pixels[4] == 1 + 3 * 3 && colour.pixels[5] == 1 + 4 * 3 && colour.pixels[6] == 1 + 5 * 3 && colour.pixels[7] == 255);
+
+    ImageBatchStats stats = loader.get_stats();
+    CHECK(stats.images_loaded == 16);
+    CHECK(stats.images_failed == 3);
+    CHECK(stats.bytes_read == batch.bytes_read);
+    CHECK(stats.bytes_decoded == batch.bytes_decoded);
+    CHECK(stats.read_seconds >= 0.0 && stats.decode_seconds > 0.0 && stats.stage_seconds > 0.0);
+
+    // A second batch adds to the same counters.
+    loader.load_batch({ batch.paths[2], batch.paths[16] });
+    loader.wait_all();
+    stats = loader.get_stats();
+    CHECK(stats.images_loaded == 17 && stats.images_failed == 4);
+}
+
+static void test_format() {
+    ImageBatchStats stats = { 3, 1, 2500000, 8000000, 0.5, 0.25, 0.125 };
+    CHECK(format_image_batch_stats(stats) == "3 images (1 failed), 2.5 MB read in 0.500 s, 8.0 MB decoded in 0.250 s, staged in 0.125 s");
+    CHECK(format_image_batch_stats({}) == "0 images (0 failed), 0.0 MB read in 0.000 s, 0.0 MB decoded in 0.000 s, staged in 0.000 s");
+}
+
+int main() {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "image_batch_loader_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    Batch batch = make_batch(root);
+    JobPool job_pool(4);
+    run_batch(batch, job_pool, 1, 64ull * 1024 * 1024);
+    run_batch(batch, job_pool, 3, 1);
+    test_format();
+    std::filesystem::remove_all(root);
+    return finish_checks("image_batch_loader_test");
+}
@@ -0,0 +1,149 @@
+// Records input events through InputRecorder and replays them tick by tick.
+// Checks that malformed recordings are rejected, and that writes which fail
+// (a full disk, simulated with /dev/full where it exists) throw instead of
+// leaving a truncated recording.
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "input.hpp"
+
+static InputEvent make_event(int64_t time, InputEventType type, uint8_t key, int32_t dx, int32_t dy) {
+    InputEvent event;
+    event.time = time;
+    event.type = type;
+    event.key = key;
+    event.dx = dx;
+    event.dy = dy;
+    return event;
+}
+
+static void test_round_trip(const std::filesystem::path& root) {
+    std::string path = (root / "round_trip.bnji").string();
+    {
+        InputRecorder recorder(path, 16666667);
+        recorder.write(0, make_event(1000, InputEventType::key_down, 'W', 0, 0));
+        recorder.write(0, make_event(1500, InputEventType::mouse_move, 0, 3, -4));
+        recorder.write(2, make_event(9000, InputEventType::key_up, 'W', 0, 0));
+        recorder.write(5, make_event(20000, InputEventType::focus_lost, 0, 0, 0));
+        recorder.close();
+        // Closing twice is harmless; writing after is not.
+        recorder.close();
+        CHECK_THROWS(recorder.write(6, make_event(21000, InputEventType::key_down, 'A', 0, 0)));
+    }
+
+    InputReplay replay(path);
+    CHECK(replay.get_step_ns() == 16666667);
+    InputEvent event;
+    // Events recorded at a tick apply before that tick's step.
+    CHECK(replay.next(0, event) && event.type == InputEventType::key_down && event.key == 'W' && event.time == 0);
+    CHECK(replay.next(0, event) && event.type == InputEventType::mouse_move && event.dx == 3 && event.dy == -4 && event.time == 500);
+    CHECK(!replay.next(0, event) && !replay.next(1, event));
+    CHECK(replay.next(2, event) && event.type == InputEventType::key_up);
+    CHECK(!replay.is_finished());
+    CHECK(replay.next(9, event) && event.type == InputEventType::focus_lost && event.time == 19000);
+    CHECK(replay.is_finished() && !replay.next(10, event));
+}
+
+static void write_bytes(const std::string& path, const std::vector<uint8_t>& bytes) {
+    FILE* file = fopen(path.c_str(), "wb");
+    CHECK(file != nullptr);
+    if (file) {
+        CHECK(fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        CHECK(fclose(file) == 0);
+    }
+}
+
+static std::vector<uint8_t> read_bytes(const std::string& path) {
+    std::vector<uint8_t> bytes(std::filesystem::file_size(path));
+    FILE* file = fopen(path.c_str(), "rb");
+    CHECK(file != nullptr);
+    if (file) {
+        CHECK(fread(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        fclose(file);
+    }
+    return bytes;
+}
+
+static void test_malformed(const std::filesystem::path& root) {
+    CHECK_THROWS(InputReplay((root / "missing.bnji").string()));
+    CHECK_THROWS(InputRecorder((root / "no_such_directory" / "recording.bnji").string(), 1));
+
+    std::string path = (root / "valid.bnji").string();
+    {
+        InputRecorder recorder(path, 1000);
+        recorder.write(3, make_event(0, InputEventType::key_down, 'A', 0, 0));
+        recorder.write(4, make_event(0, InputEventType::key_up, 'A', 0, 0));
+        recorder.close();
+    }
+    std::vector<uint8_t> valid = read_bytes(path);
+    // The 16 byte header and two 32 byte records.
+    CHECK(valid.size() == 16 + 2 * 32);
+
+    std::string bad = (root / "bad.bnji").string();
+    std::vector<uint8_t> bytes = valid;
+    bytes[0] = 'X';
+    write_bytes(bad, bytes);
+    CHECK_THROWS(InputReplay(bad));
+
+    bytes = valid;
+    bytes[4] = 2;
+    write_bytes(bad, bytes);
+    CHECK_THROWS(InputReplay(bad));
+
+    // An unknown event type.
+    bytes = valid;
+    bytes[16 + 32 + 16] = 200;
+    write_bytes(bad, bytes);
+    CHECK_THROWS(InputReplay(bad));
+
+    // Ticks going backwards.
+    bytes = valid;
+    bytes[16 + 32] = 1;
+    write_bytes(bad, bytes);
+    CHECK_THROWS(InputReplay(bad));
+
+    // A header alone is an empty recording.
+    bytes.assign(valid.begin(), valid.begin() + 16);
+    write_bytes(bad, bytes);
+    CHECK(InputReplay(bad).is_finished());
+}
+
+static void test_full_disk() {
+    if (!std::filesystem::exists("/dev/full")) {
+        return;
+    }
+    // Small recordings sit in the stdio buffer until close.
+    {
+        InputRecorder recorder("/dev/full", 1000);
+        recorder.write(0, make_event(0, InputEventType::key_down, 'A', 0, 0));
+        CHECK_THROWS(recorder.close());
+    }
+    // Larger ones fail as the buffer is flushed.
+    {
+        InputRecorder recorder("/dev/full", 1000);
+        bool threw = false;
+        for (uint64_t tick = 0; tick < 100000 && !threw; ++tick) {
+            try {
+                recorder.write(tick, make_event(0, InputEventType::mouse_move, 0, 1, 1));
+            } catch (const std::exception&) {
+                threw = true;
+            }
+        }
+        CHECK(threw);
+    }
+}
+
+int main() {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "input_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    test_round_trip(root);
+    test_malformed(root);
+    test_full_disk();
+    std::filesystem::remove_all(root);
+    return finish_checks("input_test");
+}
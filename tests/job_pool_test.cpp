@@ -0,0 +1,228 @@
+// Pushes and pops a ChaseLevDeque from its owner while other threads steal,
+// and checks every item comes out exactly once. Runs parallel_for over every
+// index, task graphs in dependency order, and nested jobs under wait_all.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "chase_lev_deque.hpp"
+#include "check.hpp"
+#include "job_pool.hpp"
+#include "task_graph.hpp"
+
+static void test_deque() {
+    // A small ring, so pushing past it grows while thieves read.
+    const uint32_t item_count = 200000;
+    const uint32_t thief_count = 3;
+    ChaseLevDeque<uint32_t> deque(2);
+    std::vector<std::atomic<uint32_t>> taken(item_count);
+    std::atomic<bool> owner_done{false};
+    std::atomic<uint32_t> stolen{0};
+
+    std::vector<std::thread> thieves;
+    for (uint32_t t = 0; t < thief_count; ++t) {
+        thieves.emplace_back([&] {
+            uint32_t item;
+            for (;;) {
+                if (deque.steal(item)) {
+                    taken[item].fetch_add(1, std::memory_order_relaxed);
+                    stolen.fetch_add(1, std::memory_order_relaxed);
+                } else if (owner_done.load(std::memory_order_acquire)) {
+                    return;
+                }
+            }
+        });
+    }
+
+    // Bursts of pushes with a few pops between, then drain.
+    uint32_t popped = 0;
+    uint32_t next = 0;
+    uint32_t item;
+    while (next < item_count) {
+        for (uint32_t i = 0; i < 64 && next < item_count; ++i) {
+            deque.push(next++);
+        }
+        for (uint32_t i = 0; i < 16 && deque.pop(item); ++i) {
+            taken[item].fetch_add(1, std::memory_order_relaxed);
+            popped++;
+        }
+    }
+    while (deque.pop(item)) {
+        taken[item].fetch_add(1, std::memory_order_relaxed);
+        popped++;
+    }
+    owner_done.store(true, std::memory_order_release);
+    for (std::thread& thief : thieves) {
+        thief.join();
+    }
+
+    uint32_t wrong = 0;
+    for (uint32_t i = 0; i < item_count; ++i) {
+        wrong += taken[i].load() != 1;
+    }
+    CHECK(wrong == 0);
+    CHECK(popped + stolen.load() == item_count);
+    CHECK(deque.empty());
+    CHECK(!deque.pop(item) && !deque.steal(item));
+}
+
+static void test_parallel_for(JobPool& job_pool) {
+    const uint32_t counts[] = { 1, 7, 1000, 100003 };
+    const uint32_t grains[] = { 0, 1, 3, 64, 200000 };
+    for (uint32_t count : counts) {
+        for (uint32_t grain : grains) {
+            std::vector<std::atomic<uint32_t>> visits(count);
+            std::atomic<uint32_t> misaligned{0};
+            job_pool.parallel_for(count, grain, [&](uint32_t begin, uint32_t end) {
+                if (grain != 0 && (begin % grain != 0 || end - begin > grain)) {
+                    misaligned.fetch_add(1, std::memory_order_relaxed);
+                }
+                for (uint32_t i = begin; i < end; ++i) {
+                    visits[i].fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+            uint32_t wrong = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                wrong += visits[i].load() != 1;
+            }
+            CHECK(wrong == 0);
+            CHECK(misaligned.load() == 0);
+        }
+    }
+    // Nothing to run is not a call.
+    bool called = false;
+    job_pool.parallel_for(0, 4, [&](uint32_t, uint32_t) { called = true; });
+    CHECK(!called);
+}
+
+// Appends each task's id to the order it ran in.
+struct Trace {
+    std::mutex mutex;
+    std::vector<uint32_t> order;
+
+    void record(uint32_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(id);
+    }
+
+    uint32_t position(uint32_t id) const {
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            if (order[i] == id) {
+                return i;
+            }
+        }
+        return UINT32_MAX;
+    }
+};
+
+static void test_task_graph(JobPool& job_pool) {
+    // Diamonds stacked in a chain: top -> middle fan -> bottom -> next top.
+    // The fans release several successors at once, which get pushed for
+    // other threads to steal.
+    const uint32_t diamond_count = 50;
+    const uint32_t fan = 8;
+    Trace trace;
+    TaskGraph graph;
+    std::vector<std::vector<TaskGraph::TaskId>> dependencies;
+    // Ids are handed out in order of adding, starting at 0.
+    auto add = [&](std::vector<TaskGraph::TaskId> task_dependencies) {
+        TaskGraph::TaskId id = graph.size();
+        CHECK(graph.add([&trace, id] { trace.record(id); }) == id);
+        for (TaskGraph::TaskId dependency : task_dependencies) {
+            graph.add_dependency(id, dependency);
+        }
+        dependencies.push_back(task_dependencies);
+        return id;
+    };
+    TaskGraph::TaskId top = add({});
+    for (uint32_t d = 0; d < diamond_count; ++d) {
+        std::vector<TaskGraph::TaskId> middle;
+        for (uint32_t i = 0; i < fan; ++i) {
+            middle.push_back(add({ top }));
+        }
+        top = add(middle);
+    }
+    uint32_t task_count = graph.size();
+    CHECK(task_count == 1 + diamond_count * (fan + 1));
+
+    for (uint32_t run = 0; run < 3; ++run) {
+        trace.order.clear();
+        job_pool.run(graph);
+        CHECK(trace.order.size() == task_count);
+        uint32_t out_of_order = 0;
+        for (uint32_t id = 0; id < task_count; ++id) {
+            uint32_t position = trace.position(id);
+            for (TaskGraph::TaskId dependency : dependencies[id]) {
+                out_of_order += trace.position(dependency) >= position;
+            }
+        }
+        CHECK(out_of_order == 0);
+    }
+
+    // Dependencies must already exist.
+    TaskGraph bad;
+    TaskGraph::TaskId first = bad.add([] {});
+    CHECK_THROWS(bad.add([] {}, { first + 1 }));
+    CHECK_THROWS(bad.add_dependency(first, first + 1));
+    TaskGraph empty;
+    job_pool.run(empty);
+}
+
+static void test_wait_all(JobPool& job_pool) {
+    // Jobs that submit jobs that submit jobs, and jobs that wait inside on
+    // parallel_for and task graphs; wait_all covers all of them.
+    std::atomic<uint32_t> leaves{0};
+    std::atomic<uint32_t> for_iterations{0};
+    std::atomic<uint32_t> graph_tasks{0};
+    for (uint32_t i = 0; i < 16; ++i) {
+        job_pool.submit([&] {
+            for (uint32_t j = 0; j < 8; ++j) {
+                job_pool.submit([&] {
+                    for (uint32_t k = 0; k < 4; ++k) {
+                        job_pool.submit([&] { leaves.fetch_add(1, std::memory_order_relaxed); });
+                    }
+                });
+            }
+            job_pool.parallel_for(256, 4, [&](uint32_t begin, uint32_t end) {
+                for_iterations.fetch_add(end - begin, std::memory_order_relaxed);
+            });
+            TaskGraph graph;
+            TaskGraph::TaskId a = graph.add([&] { graph_tasks.fetch_add(1, std::memory_order_relaxed); });
+            TaskGraph::TaskId b = graph.add([&] { graph_tasks.fetch_add(1, std::memory_order_relaxed); }, { a });
+            graph.add([&] { graph_tasks.fetch_add(1, std::memory_order_relaxed); }, { a, b });
+            job_pool.run(graph);
+        });
+    }
+    job_pool.wait_all();
+    CHECK(leaves.load() == 16 * 8 * 4);
+    CHECK(for_iterations.load() == 16 * 256);
+    CHECK(graph_tasks.load() == 16 * 3);
+
+    // From inside a job it would wait on itself.
+    std::atomic<bool> threw{false};
+    job_pool.submit([&] {
+        try {
+            job_pool.wait_all();
+        } catch (const std::exception&) {
+            threw = true;
+        }
+    });
+    job_pool.wait_all();
+    CHECK(threw.load());
+    // With nothing submitted it returns at once.
+    job_pool.wait_all();
+}
+
+int main() {
+    test_deque();
+    JobPool job_pool(4);
+    test_parallel_for(job_pool);
+    test_task_graph(job_pool);
+    test_wait_all(job_pool);
+    JobPoolStats stats = job_pool.get_stats();
+    CHECK(stats.jobs_run > 0 && stats.jobs_injected > 0);
+    return finish_checks("job_pool_test");
+}
@@ -0,0 +1,231 @@
+// Checks LightClusterer::bin against a brute-force sphere-vs-froxel test in
+// double precision, with and without the job pool.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "check.hpp"
+#include "job_pool.hpp"
+#include "light_clusters.hpp"
+
+struct Projection {
+    float fov;
+    float aspect_ratio;
+    float near_plane;
+    float far_plane;
+};
+
+static uint32_t next_random(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static float random_range(uint32_t& state, float low, float high) {
+    return low + (high - low) * (next_random(state) & 0xffff) / 65535.0f;
+}
+
+static ClusterLight make_light(float x, float y, float z, float range) {
+    ClusterLight light = {};
+    light.position[0] = x;
+    light.position[1] = y;
+    light.position[2] = z;
+    light.range = range;
+    light.spot_cos_outer = -1.0f;
+    return light;
+}
+
+// Row-major, row vectors: a camera at (cx, cy, cz) turned yaw radians about +y.
+static void make_view_matrix(float cx, float cy, float cz, float yaw, float* m) {
+    float c = std::cos(yaw);
+    float s = std::sin(yaw);
+    float rows[16] = {
+        c, 0.0f, s, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        -s, 0.0f, c, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+    std::copy(rows, rows + 16, m);
+    m[12] = -(cx * rows[0] + cy * rows[4] + cz * rows[8]);
+    m[13] = -(cx * rows[1] + cy * rows[5] + cz * rows[9]);
+    m[14] = -(cx * rows[2] + cy * rows[6] + cz * rows[10]);
+}
+
+// 1 if the light must be in the cluster, 0 if it must not, -1 if it is too
+// close to the boundary for float rounding to decide.
+static int reference_overlap(const ClusterGridDesc& desc, const Projection& projection, uint32_t cluster, const double* center, double range) {
+    uint32_t tiles_per_slice = desc.tiles_x * desc.tiles_y;
+    uint32_t k = cluster / tiles_per_slice;
+    uint32_t i = cluster % tiles_per_slice % desc.tiles_x;
+    uint32_t j = cluster % tiles_per_slice / desc.tiles_x;
+
+    double ratio = static_cast<double>(projection.far_plane) / projection.near_plane;
+    double z0 = projection.near_plane * std::pow(ratio, static_cast<double>(k) / desc.slices_z);
+    double z1 = projection.near_plane * std::pow(ratio, static_cast<double>(k + 1) / desc.slices_z);
+    double tan_y = std::tan(projection.fov * 0.5);
+    double tan_x = tan_y * projection.aspect_ratio;
+    double ndc_x0 = -1.0 + 2.0 * i / desc.tiles_x;
+    double ndc_x1 = -1.0 + 2.0 * (i + 1) / desc.tiles_x;
+    double ndc_y0 = 1.0 - 2.0 * (j + 1) / desc.tiles_y;
+    double ndc_y1 = 1.0 - 2.0 * j / desc.tiles_y;
+
+    double lo[3] = {
+        std::min({ ndc_x0 * tan_x * z0, ndc_x1 * tan_x * z0, ndc_x0 * tan_x * z1, ndc_x1 * tan_x * z1 }),
+        std::min({ ndc_y0 * tan_y * z0, ndc_y1 * tan_y * z0, ndc_y0 * tan_y * z1, ndc_y1 * tan_y * z1 }),
+        z0,
+    };
+    double hi[3] = {
+        std::max({ ndc_x0 * tan_x * z0, ndc_x1 * tan_x * z0, ndc_x0 * tan_x * z1, ndc_x1 * tan_x * z1 }),
+        std::max({ ndc_y0 * tan_y * z0, ndc_y1 * tan_y * z0, ndc_y0 * tan_y * z1, ndc_y1 * tan_y * z1 }),
+        z1,
+    };
+    double dist_sq = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        double d = std::max(std::max(lo[axis] - center[axis], center[axis] - hi[axis]), 0.0);
+        dist_sq += d * d;
+    }
+    double dist = std::sqrt(dist_sq);
+    double slack = 1e-3 * (1.0 + range + std::abs(center[2]));
+    if (dist < range - slack) {
+        return 1;
+    }
+    if (dist > range + slack) {
+        return 0;
+    }
+    return -1;
+}
+
+static void check_against_reference(const LightClusterer& clusterer, const Projection& projection, const float* view, const std::vector<ClusterLight>& lights) {
+    const ClusterGridDesc& desc = clusterer.get_desc();
+    const std::vector<ClusterRange>& ranges = clusterer.get_cluster_ranges();
+    const std::vector<uint32_t>& indices = clusterer.get_light_indices();
+    CHECK(!clusterer.was_truncated());
+    CHECK(ranges.size() == clusterer.get_cluster_count());
+
+    std::vector<double> centers(lights.size() * 3);
+    for (size_t l = 0; l < lights.size(); ++l) {
+        const float* p = lights[l].position;
+        for (int axis = 0; axis < 3; ++axis) {
+            centers[l * 3 + axis] = static_cast<double>(p[0]) * view[axis] + static_cast<double>(p[1]) * view[4 + axis] +
+                                    static_cast<double>(p[2]) * view[8 + axis] + view[12 + axis];
+        }
+    }
+
+    uint32_t expected_offset = 0;
+    uint32_t missing = 0;
+    uint32_t extra = 0;
+    std::vector<uint8_t> present(lights.size());
+    for (uint32_t cluster = 0; cluster < clusterer.get_cluster_count(); ++cluster) {
+        const ClusterRange& range = ranges[cluster];
+        CHECK(range.offset == expected_offset);
+        CHECK(range.count <= desc.max_lights_per_cluster);
+        expected_offset = range.offset + range.count;
+
+        std::fill(present.begin(), present.end(), 0);
+        for (uint32_t n = 0; n < range.count && range.offset + n < indices.size(); ++n) {
+            uint32_t l = indices[range.offset + n];
+            CHECK(l < lights.size() && !present[l]);
+            if (l < lights.size()) {
+                present[l] = 1;
+            }
+        }
+        for (size_t l = 0; l < lights.size(); ++l) {
+            int expected = reference_overlap(desc, projection, cluster, &centers[l * 3], lights[l].range);
+            missing += expected == 1 && !present[l];
+            extra += expected == 0 && present[l];
+        }
+    }
+    CHECK(expected_offset == indices.size());
+    CHECK(missing == 0);
+    CHECK(extra == 0);
+}
+
+static void test_random_scene(const ClusterGridDesc& desc, JobPool* job_pool) {
+    const Projection projection = { 1.0f, 16.0f / 9.0f, 0.1f, 100.0f };
+    LightClusterer clusterer(desc);
+    clusterer.set_projection(projection.fov, projection.aspect_ratio, projection.near_plane, projection.far_plane);
+
+    uint32_t state = 7;
+    std::vector<ClusterLight> lights;
+    for (uint32_t l = 0; l < 400; ++l) {
+        // Spread around and behind the camera, some crossing the near plane.
+        lights.push_back(make_light(random_range(state, -40.0f, 40.0f), random_range(state, -10.0f, 10.0f), random_range(state, -20.0f, 90.0f),
+                                    random_range(state, 0.2f, 6.0f)));
+    }
+    lights.push_back(make_light(0.0f, 0.0f, 0.05f, 0.5f));
+
+    float view[16];
+    make_view_matrix(1.5f, 2.0f, -3.0f, 0.3f, view);
+    clusterer.bin(view, lights.data(), static_cast<uint32_t>(lights.size()), job_pool);
+    check_against_reference(clusterer, projection, view, lights);
+}
+
+static void test_pool_matches_serial(JobPool& job_pool) {
+    LightClusterer serial;
+    LightClusterer parallel;
+    serial.set_projection(1.2f, 1.5f, 0.5f, 200.0f);
+    parallel.set_projection(1.2f, 1.5f, 0.5f, 200.0f);
+
+    uint32_t state = 99;
+    std::vector<ClusterLight> lights;
+    for (uint32_t l = 0; l < 1000; ++l) {
+        lights.push_back(make_light(random_range(state, -60.0f, 60.0f), random_range(state, -5.0f, 5.0f), random_range(state, 0.0f, 150.0f),
+                                    random_range(state, 0.5f, 4.0f)));
+    }
+    float view[16];
+    make_view_matrix(0.0f, 0.0f, 0.0f, 0.0f, view);
+    serial.bin(view, lights.data(), static_cast<uint32_t>(lights.size()), nullptr);
+    parallel.bin(view, lights.data(), static_cast<uint32_t>(lights.size()), &job_pool);
+
+    CHECK(serial.get_light_indices() == parallel.get_light_indices());
+    bool same_ranges = true;
+    for (uint32_t cluster = 0; cluster < serial.get_cluster_count(); ++cluster) {
+        same_ranges &= serial.get_cluster_ranges()[cluster].offset == parallel.get_cluster_ranges()[cluster].offset &&
+                       serial.get_cluster_ranges()[cluster].count == parallel.get_cluster_ranges()[cluster].count;
+    }
+    CHECK(same_ranges);
+}
+
+static void test_truncation() {
+    ClusterGridDesc desc;
+    desc.tiles_x = 4;
+    desc.tiles_y = 4;
+    desc.slices_z = 4;
+    desc.max_lights_per_cluster = 8;
+    desc.max_light_indices = 64;
+    LightClusterer clusterer(desc);
+    clusterer.set_projection(1.0f, 1.0f, 0.1f, 50.0f);
+
+    // Every light covers the whole frustum.
+    std::vector<ClusterLight> lights(20, make_light(0.0f, 0.0f, 10.0f, 100.0f));
+    float view[16];
+    make_view_matrix(0.0f, 0.0f, 0.0f, 0.0f, view);
+    clusterer.bin(view, lights.data(), static_cast<uint32_t>(lights.size()), nullptr);
+
+    CHECK(clusterer.was_truncated());
+    CHECK(clusterer.get_light_indices().size() == desc.max_light_indices);
+    uint32_t total = 0;
+    for (const ClusterRange& range : clusterer.get_cluster_ranges()) {
+        CHECK(range.count <= desc.max_lights_per_cluster);
+        total += range.count;
+    }
+    CHECK(total == desc.max_light_indices);
+}
+
+int main() {
+    JobPool job_pool(3);
+
+    test_random_scene(ClusterGridDesc(), nullptr);
+    test_random_scene(ClusterGridDesc(), &job_pool);
+
+    // Tile counts that are not a multiple of four exercise the SIMD padding.
+    ClusterGridDesc odd;
+    odd.tiles_x = 5;
+    odd.tiles_y = 3;
+    odd.slices_z = 7;
+    test_random_scene(odd, &job_pool);
+
+    test_pool_matches_serial(job_pool);
+    test_truncation();
+    return finish_checks("light_clusters_test");
+}
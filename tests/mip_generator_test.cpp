@@ -0,0 +1,237 @@
+// Checks generate_mip_chain against a double-precision reference of the same
+// separable filters, including non-power-of-two sizes whose ratios widen the
+// Kaiser support, and the row-streaming builder against the box filter.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "check.hpp"
+#include "job_pool.hpp"
+#include "mip_generator.hpp"
+
+static const double pi = 3.14159265358979323846;
+
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 30; ++k) {
+        term *= (x * 0.5 / k) * (x * 0.5 / k);
+        sum += term;
+    }
+    return sum;
+}
+
+static double evaluate_filter(MipFilter filter, double x) {
+    double ax = std::fabs(x);
+    if (filter == MipFilter::box) {
+        return ax <= 0.5 ? 1.0 : 0.0;
+    }
+    if (ax >= 1.5) {
+        return 0.0;
+    }
+    double sinc = ax < 1e-9 ? 1.0 : std::sin(pi * x) / (pi * x);
+    double t = x / 1.5;
+    return sinc * bessel_i0(4.0 * std::sqrt(1.0 - t * t)) / bessel_i0(4.0);
+}
+
+static double srgb_to_linear(double c) {
+    return c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double linear_to_srgb(double l) {
+    return l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+}
+
+// One axis of the filter: weights[d] holds (source index, weight) pairs.
+// Both filters are discontinuous at the edge of their support, so tap
+// positions are computed in float like the generator's; only the weights
+// are evaluated in double.
+static std::vector<std::vector<std::pair<uint32_t, double>>> get_weights(MipFilter filter, uint32_t src_size, uint32_t dst_size) {
+    std::vector<std::vector<std::pair<uint32_t, double>>> weights(dst_size);
+    float scale = static_cast<float>(src_size) / dst_size;
+    float support = (filter == MipFilter::box ? 0.5f : 1.5f) * scale;
+    for (uint32_t d = 0; d < dst_size; ++d) {
+        float center = (d + 0.5f) * scale;
+        double total = 0.0;
+        for (int64_t s = static_cast<int64_t>(std::floor(center - support)); s <= static_cast<int64_t>(std::ceil(center + support)); ++s) {
+            double w = evaluate_filter(filter, (static_cast<float>(s) + 0.5f - center) / scale);
+            uint32_t wrapped = static_cast<uint32_t>(((s % src_size) + src_size) % src_size);
+            weights[d].push_back({ wrapped, w });
+            total += w;
+        }
+        for (auto& weight : weights[d]) {
+            weight.second /= total;
+        }
+    }
+    return weights;
+}
+
+static std::vector<uint8_t> make_image(uint32_t width, uint32_t height, uint32_t seed) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4);
+    for (uint8_t& value : rgba) {
+        seed = seed * 1664525u + 1013904223u;
+        value = static_cast<uint8_t>(seed >> 24);
+    }
+    return rgba;
+}
+
+// Largest difference between the chain and the reference, over every level.
+static int get_max_error(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, MipFilter filter, bool srgb, const MipChain& chain) {
+    std::vector<double> level(rgba.size());
+    for (size_t i = 0; i < rgba.size(); ++i) {
+        double c = rgba[i] / 255.0;
+        level[i] = srgb && i % 4 != 3 ? srgb_to_linear(c) : c;
+    }
+    int max_error = 0;
+    for (size_t index = 1; index < chain.levels.size(); ++index) {
+        const MipLevel& dst = chain.levels[index];
+        auto weights_x = get_weights(filter, width, dst.width);
+        auto weights_y = get_weights(filter, height, dst.height);
+        std::vector<double> next(static_cast<size_t>(dst.width) * dst.height * 4);
+        for (uint32_t y = 0; y < dst.height; ++y) {
+            for (uint32_t x = 0; x < dst.width; ++x) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    double sum = 0.0;
+                    for (const auto& wy : weights_y[y]) {
+                        for (const auto& wx : weights_x[x]) {
+                            sum += wy.second * wx.second * level[(static_cast<size_t>(wy.first) * width + wx.first) * 4 + c];
+                        }
+                    }
+                    next[(static_cast<size_t>(y) * dst.width + x) * 4 + c] = sum;
+
+                    double clamped = std::clamp(sum, 0.0, 1.0);
+                    double encoded = (srgb && c != 3 ? linear_to_srgb(clamped) : clamped) * 255.0;
+                    int actual = chain.get_level_data(index)[(static_cast<size_t>(y) * dst.width + x) * 4 + c];
+                    max_error = std::max(max_error, static_cast<int>(std::ceil(std::fabs(actual - encoded) - 0.5)));
+                }
+            }
+        }
+        level.swap(next);
+        width = dst.width;
+        height = dst.height;
+    }
+    return max_error;
+}
+
+static void test_against_reference(JobPool& job_pool) {
+    const uint32_t sizes[][2] = { { 16, 16 }, { 64, 32 }, { 10, 6 }, { 5, 3 }, { 3, 7 }, { 37, 23 }, { 1, 9 } };
+    for (const auto& size : sizes) {
+        std::vector<uint8_t> rgba = make_image(size[0], size[1], size[0] * 31 + size[1]);
+        for (MipFilter filter : { MipFilter::box, MipFilter::kaiser }) {
+            for (bool srgb : { false, true }) {
+                MipChain chain;
+                generate_mip_chain(rgba.data(), size[0], size[1], filter, srgb, &job_pool, chain);
+                CHECK(chain.levels.size() == get_mip_level_count(size[0], size[1]));
+                int error = get_max_error(rgba, size[0], size[1], filter, srgb, chain);
+                if (error > 1) {
+                    fprintf(stderr, "%ux%u %s %s: max error %d\n", size[0], size[1], filter == MipFilter::box ? "box" : "kaiser",
+                            srgb ? "srgb" : "linear", error);
+                }
+                CHECK(error <= 1);
+            }
+        }
+    }
+}
+
+static void test_mirror_symmetry() {
+    // The filters are symmetric about each destination texel, so mirroring
+    // the source mirrors every level. A 3 to 1 step needs nine Kaiser taps,
+    // and dropping the last one skews the result toward the left edge.
+    const uint32_t sizes[][2] = { { 3, 1 }, { 3, 3 }, { 5, 3 }, { 37, 23 } };
+    for (const auto& size : sizes) {
+        uint32_t width = size[0];
+        uint32_t height = size[1];
+        std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4, 0);
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t c = 0; c < 4; ++c) {
+                rgba[static_cast<size_t>(y) * width * 4 + c] = 255;
+            }
+        }
+        std::vector<uint8_t> mirrored(rgba.size());
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                memcpy(&mirrored[(static_cast<size_t>(y) * width + width - 1 - x) * 4], &rgba[(static_cast<size_t>(y) * width + x) * 4], 4);
+            }
+        }
+        MipChain chain;
+        MipChain mirrored_chain;
+        generate_mip_chain(rgba.data(), width, height, MipFilter::kaiser, false, nullptr, chain);
+        generate_mip_chain(mirrored.data(), width, height, MipFilter::kaiser, false, nullptr, mirrored_chain);
+        int max_error = 0;
+        for (size_t level = 1; level < chain.levels.size(); ++level) {
+            const MipLevel& info = chain.levels[level];
+            for (uint32_t y = 0; y < info.height; ++y) {
+                for (uint32_t x = 0; x < info.width; ++x) {
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        int a = chain.get_level_data(level)[(static_cast<size_t>(y) * info.width + x) * 4 + c];
+                        int b = mirrored_chain.get_level_data(level)[(static_cast<size_t>(y) * info.width + info.width - 1 - x) * 4 + c];
+                        max_error = std::max(max_error, std::abs(a - b));
+                    }
+                }
+            }
+        }
+        CHECK(max_error <= 1);
+    }
+}
+
+static void test_constant_image() {
+    // Normalized weights keep a flat image flat at every level.
+    std::vector<uint8_t> rgba(static_cast<size_t>(23) * 11 * 4);
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        rgba[i + 0] = 200;
+        rgba[i + 1] = 100;
+        rgba[i + 2] = 50;
+        rgba[i + 3] = 255;
+    }
+    MipChain chain;
+    generate_mip_chain(rgba.data(), 23, 11, MipFilter::kaiser, true, nullptr, chain);
+    bool flat = true;
+    for (size_t level = 1; level < chain.levels.size(); ++level) {
+        const uint8_t* data = chain.get_level_data(level);
+        for (size_t i = 0; i < static_cast<size_t>(chain.levels[level].width) * chain.levels[level].height * 4; i += 4) {
+            flat &= std::abs(data[i] - 200) <= 1 && std::abs(data[i + 1] - 100) <= 1 && std::abs(data[i + 2] - 50) <= 1 && data[i + 3] == 255;
+        }
+    }
+    CHECK(flat);
+}
+
+static void test_row_builder_matches_box() {
+    // Even sizes, where dropping a trailing row or column never comes up.
+    const uint32_t width = 32;
+    const uint32_t height = 16;
+    std::vector<uint8_t> rgba = make_image(width, height, 5);
+    MipChain chain;
+    generate_mip_chain(rgba.data(), width, height, MipFilter::box, true, nullptr, chain);
+
+    int max_error = 0;
+    uint32_t rows = 0;
+    MipRowBuilder builder(width, height, true, [&](uint32_t level, uint32_t row, const uint8_t* data) {
+        const MipLevel& expected = chain.levels[level];
+        const uint8_t* expected_row = chain.get_level_data(level) + static_cast<size_t>(row) * expected.width * 4;
+        for (uint32_t i = 0; i < expected.width * 4; ++i) {
+            max_error = std::max(max_error, std::abs(data[i] - expected_row[i]));
+        }
+        ++rows;
+    });
+    for (uint32_t y = 0; y < height; ++y) {
+        builder.push_row(rgba.data() + static_cast<size_t>(y) * width * 4);
+    }
+    uint32_t expected_rows = 0;
+    for (const MipLevel& level : chain.levels) {
+        expected_rows += level.height;
+    }
+    CHECK(rows == expected_rows);
+    CHECK(max_error <= 1);
+}
+
+int main() {
+    JobPool job_pool(3);
+    test_against_reference(job_pool);
+    test_mirror_symmetry();
+    test_constant_image();
+    test_row_builder_matches_box();
+    return finish_checks("mip_generator_test");
+}
@@ -0,0 +1,198 @@
+// Checks that normalize_pipeline_desc makes descriptions the runtime treats
+// as the same pipeline hash the same — state ignored by disabled tests and
+// unused targets, semantic name case, appended offsets — and that changes
+// the runtime does see still give different hashes.
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "check.hpp"
+#include "pipeline_desc.hpp"
+
+// DXGI_FORMAT values used below.
+static const uint32_t format_r32g32b32a32_float = 2;
+static const uint32_t format_r32g32b32_float = 6;
+static const uint32_t format_r32g32_float = 16;
+static const uint32_t format_r8g8b8a8_unorm = 28;
+static const uint32_t format_d32_float = 40;
+static const uint32_t format_r16_float = 54;
+static const uint32_t format_r8_unorm = 61;
+static const uint32_t append_aligned_element = 0xffffffff;
+
+// An opaque single-target pipeline, as the renderer builds them.
+static PipelineDesc make_desc() {
+    PipelineDesc desc = {};
+    desc.root_signature_hash = 0x1234;
+    desc.shader_hashes[static_cast<size_t>(PipelineShaderStage::vertex)] = 0xAAAA;
+    desc.shader_hashes[static_cast<size_t>(PipelineShaderStage::pixel)] = 0xBBBB;
+    desc.input_layout = {
+        { "POSITION", 0, format_r32g32b32_float, 0, 0, 0, 0 },
+        { "TEXCOORD", 0, format_r32g32_float, 0, 12, 0, 0 },
+        { "COLOR", 0, format_r8g8b8a8_unorm, 0, 20, 0, 0 },
+    };
+    desc.primitive_topology_type = 3;
+    desc.fill_mode = 3;
+    desc.cull_mode = 3;
+    desc.depth_clip_enable = true;
+    for (PipelineRenderTargetBlend& blend : desc.render_target_blend) {
+        blend.src_blend = 2;
+        blend.dest_blend = 1;
+        blend.blend_op = 1;
+        blend.src_blend_alpha = 2;
+        blend.dest_blend_alpha = 1;
+        blend.blend_op_alpha = 1;
+        blend.logic_op = 4;
+        blend.render_target_write_mask = 0xF;
+    }
+    desc.sample_mask = 0xFFFFFFFF;
+    desc.depth_enable = true;
+    desc.depth_write_mask = 1;
+    desc.depth_func = 2;
+    desc.stencil_read_mask = 0xFF;
+    desc.stencil_write_mask = 0xFF;
+    desc.front_face = { 1, 1, 1, 8 };
+    desc.back_face = { 1, 1, 1, 8 };
+    desc.num_render_targets = 1;
+    desc.rtv_formats[0] = format_r8g8b8a8_unorm;
+    desc.dsv_format = format_d32_float;
+    desc.sample_count = 1;
+    desc.node_mask = 1;
+    return desc;
+}
+
+static bool hashes_equal(const std::function<void(PipelineDesc&)>& change) {
+    PipelineDesc desc = make_desc();
+    change(desc);
+    return hash_pipeline_desc(desc) == hash_pipeline_desc(make_desc());
+}
+
+static void test_equivalent() {
+    CHECK(hashes_equal([](PipelineDesc&) {}));
+    // Semantic names match case-insensitively.
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.input_layout[1].semantic_name = "TexCoord"; }));
+    // Appended offsets resolve to the explicit ones.
+    CHECK(hashes_equal([](PipelineDesc& desc) {
+        desc.input_layout[1].aligned_byte_offset = append_aligned_element;
+        desc.input_layout[2].aligned_byte_offset = append_aligned_element;
+    }));
+    // The step rate only applies to per-instance data.
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.input_layout[0].instance_data_step_rate = 5; }));
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.depth_bias_clamp = -0.0f; }));
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.slope_scaled_depth_bias = -0.0f; }));
+    // Blend factors of a target with blending off, and formats and blend
+    // state of targets past num_render_targets.
+    CHECK(hashes_equal([](PipelineDesc& desc) {
+        desc.render_target_blend[0].src_blend = 5;
+        desc.render_target_blend[0].blend_op_alpha = 3;
+        desc.render_target_blend[0].logic_op = 7;
+    }));
+    CHECK(hashes_equal([](PipelineDesc& desc) {
+        desc.render_target_blend[3].blend_enable = true;
+        desc.rtv_formats[3] = format_r16_float;
+    }));
+    // Independent blending with one target, or with unused differing targets.
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.independent_blend_enable = true; }));
+    CHECK(hashes_equal([](PipelineDesc& desc) {
+        desc.independent_blend_enable = true;
+        desc.render_target_blend[1].render_target_write_mask = 1;
+    }));
+    // Without independent blending only the first target's state counts.
+    PipelineDesc two_targets = make_desc();
+    two_targets.num_render_targets = 2;
+    two_targets.rtv_formats[1] = format_r16_float;
+    PipelineDesc two_targets_changed = two_targets;
+    two_targets_changed.render_target_blend[1].render_target_write_mask = 1;
+    CHECK(hash_pipeline_desc(two_targets) == hash_pipeline_desc(two_targets_changed));
+    // Depth and stencil state with the tests off.
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.stencil_read_mask = 0x0F; desc.back_face.stencil_func = 3; }));
+    PipelineDesc no_depth = make_desc();
+    no_depth.depth_enable = false;
+    PipelineDesc no_depth_changed = no_depth;
+    no_depth_changed.depth_func = 4;
+    no_depth_changed.depth_write_mask = 0;
+    CHECK(hash_pipeline_desc(no_depth) == hash_pipeline_desc(no_depth_changed));
+    // Sample mask bits past the sample count, and the default node mask.
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.sample_mask = 1; }));
+    CHECK(hashes_equal([](PipelineDesc& desc) { desc.node_mask = 0; }));
+}
+
+static void test_different() {
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.root_signature_hash = 0x1235; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.shader_hashes[static_cast<size_t>(PipelineShaderStage::pixel)] = 0; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.shader_hashes[static_cast<size_t>(PipelineShaderStage::geometry)] = 0xBBBB; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.input_layout[1].semantic_index = 1; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.input_layout[2].aligned_byte_offset = 24; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.input_layout.pop_back(); }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.input_layout[2].input_slot_class = 1; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.cull_mode = 1; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.depth_bias = 1; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.render_target_blend[0].blend_enable = true; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.render_target_blend[0].render_target_write_mask = 7; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.rtv_formats[0] = format_r16_float; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.num_render_targets = 2; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.depth_func = 4; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.depth_write_mask = 0; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.stencil_enable = true; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.sample_count = 4; }));
+    CHECK(!hashes_equal([](PipelineDesc& desc) { desc.node_mask = 2; }));
+
+    // Differing blend state of a used target with independent blending.
+    PipelineDesc two_targets = make_desc();
+    two_targets.num_render_targets = 2;
+    two_targets.independent_blend_enable = true;
+    PipelineDesc two_targets_changed = two_targets;
+    two_targets_changed.render_target_blend[1].render_target_write_mask = 1;
+    CHECK(hash_pipeline_desc(two_targets) != hash_pipeline_desc(two_targets_changed));
+
+    // With stencil on, its state counts; the mask bits within the sample count do too.
+    PipelineDesc stencil = make_desc();
+    stencil.stencil_enable = true;
+    PipelineDesc stencil_changed = stencil;
+    stencil_changed.back_face.stencil_func = 3;
+    CHECK(hash_pipeline_desc(stencil) != hash_pipeline_desc(stencil_changed));
+    PipelineDesc multisampled = make_desc();
+    multisampled.sample_count = 4;
+    PipelineDesc multisampled_changed = multisampled;
+    multisampled_changed.sample_mask = 0x7;
+    CHECK(hash_pipeline_desc(multisampled) != hash_pipeline_desc(multisampled_changed));
+}
+
+static void test_normalized_fields() {
+    PipelineDesc desc = make_desc();
+    desc.input_layout = {
+        { "position", 0, format_r32g32b32_float, 0, append_aligned_element, 0, 0 },
+        { "COLOR", 0, format_r8_unorm, 0, append_aligned_element, 0, 0 },
+        // Aligned to its own 2 bytes, not 4.
+        { "TEXCOORD", 0, format_r16_float, 0, append_aligned_element, 0, 0 },
+        // Offsets continue per slot.
+        { "TEXCOORD", 1, format_r32g32b32a32_float, 1, append_aligned_element, 1, 1 },
+        { "TEXCOORD", 2, format_r32g32_float, 1, append_aligned_element, 1, 1 },
+        // A format of unknown size stops resolution for the rest of its slot.
+        { "BLENDINDICES", 0, 0, 2, 4, 0, 0 },
+        { "BLENDWEIGHT", 0, format_r32g32_float, 2, append_aligned_element, 0, 0 },
+    };
+    desc.num_render_targets = 12;
+    normalize_pipeline_desc(desc);
+    CHECK(desc.input_layout[0].semantic_name == "POSITION");
+    CHECK(desc.input_layout[0].aligned_byte_offset == 0);
+    CHECK(desc.input_layout[1].aligned_byte_offset == 12);
+    CHECK(desc.input_layout[2].aligned_byte_offset == 14);
+    CHECK(desc.input_layout[3].aligned_byte_offset == 0);
+    CHECK(desc.input_layout[4].aligned_byte_offset == 16);
+    CHECK(desc.input_layout[3].instance_data_step_rate == 1);
+    CHECK(desc.input_layout[5].aligned_byte_offset == 4);
+    CHECK(desc.input_layout[6].aligned_byte_offset == append_aligned_element);
+    CHECK(desc.num_render_targets == 8);
+
+    // Normalizing is idempotent.
+    PipelineDesc again = desc;
+    normalize_pipeline_desc(again);
+    CHECK(hash_pipeline_desc(again) == hash_pipeline_desc(desc));
+}
+
+int main() {
+    test_equivalent();
+    test_different();
+    test_normalized_fields();
+    return finish_checks("pipeline_desc_test");
+}
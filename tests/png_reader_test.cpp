@@ -0,0 +1,791 @@
+// Checks InflateStream and PngRowReader against streams built here: stored,
+// fixed and dynamic deflate blocks, matches across blocks and at the window
+// edge, input fed a few bytes at a time, and PNGs of every colour type, bit
+// depth and filter with split IDATs, compared row for row with what
+// decode_image (stb_image) makes of the same file. Malformed streams and
+// files have to throw.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "image_decoder.hpp"
+#include "inflate_stream.hpp"
+#include "png_reader.hpp"
+
+static const uint16_t length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distance_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distance_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t code_length_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+static uint32_t next_random(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+// Deflate bits go in least significant first; Huffman codes most significant first.
+class BitWriter {
+public:
+    void put(uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            put_bit(value >> i & 1);
+        }
+    }
+
+    void put_code(uint32_t code, uint32_t length) {
+        for (uint32_t i = length; i-- > 0;) {
+            put_bit(code >> i & 1);
+        }
+    }
+
+    void align() {
+        while (bit_count != 0) {
+            put_bit(0);
+        }
+    }
+
+    std::vector<uint8_t> bytes;
+
+private:
+    void put_bit(uint32_t bit) {
+        if (bit_count == 0) {
+            bytes.push_back(0);
+        }
+        bytes.back() |= static_cast<uint8_t>(bit << bit_count);
+        bit_count = (bit_count + 1) % 8;
+    }
+
+    uint32_t bit_count = 0;
+};
+
+struct HuffmanCode {
+    std::vector<uint8_t> lengths;
+    std::vector<uint32_t> codes;
+};
+
+static HuffmanCode make_canonical_code(const std::vector<uint8_t>& lengths) {
+    HuffmanCode code = { lengths, std::vector<uint32_t>(lengths.size()) };
+    uint32_t counts[16] = {};
+    for (uint8_t length : lengths) {
+        counts[length]++;
+    }
+    counts[0] = 0;
+    uint32_t next[16] = {};
+    for (uint32_t length = 1, value = 0; length < 16; ++length) {
+        value = (value + counts[length - 1]) << 1;
+        next[length] = value;
+    }
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        if (lengths[i]) {
+            code.codes[i] = next[lengths[i]]++;
+        }
+    }
+    return code;
+}
+
+// Huffman code lengths for the frequencies, limited by halving the
+// frequencies until the tree is shallow enough. At least two symbols get a
+// code, so every code is complete.
+static std::vector<uint8_t> make_code_lengths(std::vector<uint32_t> frequencies, uint32_t limit) {
+    uint32_t used = 0;
+    for (uint32_t& frequency : frequencies) {
+        used += frequency != 0;
+    }
+    for (size_t i = 0; used < 2; ++i) {
+        if (frequencies[i] == 0) {
+            frequencies[i] = 1;
+            used++;
+        }
+    }
+    for (;;) {
+        struct Node {
+            uint64_t weight;
+            int index;
+        };
+        auto heavier = [](const Node& a, const Node& b) { return a.weight > b.weight; };
+        std::priority_queue<Node, std::vector<Node>, decltype(heavier)> queue(heavier);
+        std::vector<int> parents;
+        for (size_t i = 0; i < frequencies.size(); ++i) {
+            parents.push_back(-1);
+            if (frequencies[i]) {
+                queue.push({ frequencies[i], static_cast<int>(i) });
+            }
+        }
+        while (queue.size() > 1) {
+            Node a = queue.top();
+            queue.pop();
+            Node b = queue.top();
+            queue.pop();
+            int parent = static_cast<int>(parents.size());
+            parents.push_back(-1);
+            parents[a.index] = parent;
+            parents[b.index] = parent;
+            queue.push({ a.weight + b.weight, parent });
+        }
+        std::vector<uint8_t> lengths(frequencies.size(), 0);
+        uint32_t longest = 0;
+        for (size_t i = 0; i < frequencies.size(); ++i) {
+            if (frequencies[i]) {
+                uint32_t depth = 0;
+                for (int node = static_cast<int>(i); parents[node] >= 0; node = parents[node]) {
+                    depth++;
+                }
+                lengths[i] = static_cast<uint8_t>(depth);
+                longest = std::max(longest, depth);
+            }
+        }
+        if (longest <= limit) {
+            return lengths;
+        }
+        for (uint32_t& frequency : frequencies) {
+            frequency = frequency ? (frequency + 1) / 2 : 0;
+        }
+    }
+}
+
+// A literal when distance is 0, otherwise a match.
+struct Token {
+    uint32_t value;
+    uint32_t distance;
+};
+
+static uint32_t get_length_symbol(uint32_t length) {
+    uint32_t index = 28;
+    while (length_base[index] > length) {
+        index--;
+    }
+    return index;
+}
+
+static uint32_t get_distance_symbol(uint32_t distance) {
+    uint32_t index = 29;
+    while (distance_base[index] > distance) {
+        index--;
+    }
+    return index;
+}
+
+static void write_tokens(BitWriter& out, const std::vector<Token>& tokens, const HuffmanCode& literals, const HuffmanCode& distances) {
+    for (const Token& token : tokens) {
+        if (token.distance == 0) {
+            out.put_code(literals.codes[token.value], literals.lengths[token.value]);
+            continue;
+        }
+        uint32_t length = get_length_symbol(token.value);
+        out.put_code(literals.codes[257 + length], literals.lengths[257 + length]);
+        out.put(token.value - length_base[length], length_extra[length]);
+        uint32_t distance = get_distance_symbol(token.distance);
+        out.put_code(distances.codes[distance], distances.lengths[distance]);
+        out.put(token.distance - distance_base[distance], distance_extra[distance]);
+    }
+    out.put_code(literals.codes[256], literals.lengths[256]);
+}
+
+static HuffmanCode get_fixed_literal_code() {
+    std::vector<uint8_t> lengths(288);
+    for (uint32_t i = 0; i < 288; ++i) {
+        lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    }
+    return make_canonical_code(lengths);
+}
+
+static HuffmanCode get_fixed_distance_code() {
+    return make_canonical_code(std::vector<uint8_t>(32, 5));
+}
+
+static void write_fixed_block(BitWriter& out, const std::vector<Token>& tokens, bool final_block) {
+    out.put(final_block, 1);
+    out.put(1, 2);
+    write_tokens(out, tokens, get_fixed_literal_code(), get_fixed_distance_code());
+}
+
+// The code length header of a dynamic block, with runs as codes 16, 17 and 18.
+static void write_dynamic_header(BitWriter& out, const std::vector<uint8_t>& literal_lengths, const std::vector<uint8_t>& distance_lengths) {
+    std::vector<uint8_t> lengths = literal_lengths;
+    lengths.insert(lengths.end(), distance_lengths.begin(), distance_lengths.end());
+    std::vector<Token> runs;
+    for (size_t i = 0; i < lengths.size();) {
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == lengths[i]) {
+            run++;
+        }
+        if (lengths[i] == 0 && run >= 3) {
+            run = std::min<size_t>(run, 138);
+            runs.push_back({ run >= 11 ? 18u : 17u, static_cast<uint32_t>(run) });
+        } else if (i > 0 && lengths[i] == lengths[i - 1] && run >= 3) {
+            run = std::min<size_t>(run, 6);
+            runs.push_back({ 16, static_cast<uint32_t>(run) });
+        } else {
+            run = 1;
+            runs.push_back({ lengths[i], 0 });
+        }
+        i += run;
+    }
+    std::vector<uint32_t> frequencies(19, 0);
+    for (const Token& run : runs) {
+        frequencies[run.value]++;
+    }
+    HuffmanCode length_code = make_canonical_code(make_code_lengths(frequencies, 7));
+    uint32_t length_code_count = 19;
+    while (length_code_count > 4 && length_code.lengths[code_length_order[length_code_count - 1]] == 0) {
+        length_code_count--;
+    }
+
+    out.put(static_cast<uint32_t>(literal_lengths.size() - 257), 5);
+    out.put(static_cast<uint32_t>(distance_lengths.size() - 1), 5);
+    out.put(length_code_count - 4, 4);
+    for (uint32_t i = 0; i < length_code_count; ++i) {
+        out.put(length_code.lengths[code_length_order[i]], 3);
+    }
+    for (const Token& run : runs) {
+        out.put_code(length_code.codes[run.value], length_code.lengths[run.value]);
+        if (run.value == 16) {
+            out.put(run.distance - 3, 2);
+        } else if (run.value == 17) {
+            out.put(run.distance - 3, 3);
+        } else if (run.value == 18) {
+            out.put(run.distance - 11, 7);
+        }
+    }
+}
+
+static void write_dynamic_block(BitWriter& out, const std::vector<Token>& tokens, bool final_block) {
+    std::vector<uint32_t> literal_frequencies(286, 0);
+    std::vector<uint32_t> distance_frequencies(30, 0);
+    literal_frequencies[256] = 1;
+    for (const Token& token : tokens) {
+        if (token.distance == 0) {
+            literal_frequencies[token.value]++;
+        } else {
+            literal_frequencies[257 + get_length_symbol(token.value)]++;
+            distance_frequencies[get_distance_symbol(token.distance)]++;
+        }
+    }
+    std::vector<uint8_t> literal_lengths = make_code_lengths(literal_frequencies, 15);
+    std::vector<uint8_t> distance_lengths = make_code_lengths(distance_frequencies, 15);
+    while (literal_lengths.size() > 257 && literal_lengths.back() == 0) {
+        literal_lengths.pop_back();
+    }
+    while (distance_lengths.size() > 1 && distance_lengths.back() == 0) {
+        distance_lengths.pop_back();
+    }
+    out.put(final_block, 1);
+    out.put(2, 2);
+    write_dynamic_header(out, literal_lengths, distance_lengths);
+    write_tokens(out, tokens, make_canonical_code(literal_lengths), make_canonical_code(distance_lengths));
+}
+
+static void write_stored_block(BitWriter& out, const uint8_t* data, size_t size, bool final_block) {
+    out.put(final_block, 1);
+    out.put(0, 2);
+    out.align();
+    out.put(static_cast<uint32_t>(size), 16);
+    out.put(static_cast<uint32_t>(~size & 0xFFFF), 16);
+    out.bytes.insert(out.bytes.end(), data, data + size);
+}
+
+enum class BlockMode {
+    stored,
+    fixed,
+    dynamic,
+    // Cycles through the three, block by block.
+    mixed
+};
+
+// Greedy LZ77 over hash chains; matches reach back into earlier blocks.
+class Matcher {
+public:
+    explicit Matcher(const std::vector<uint8_t>& data) : data(data), head(1 << 15, -1), previous(data.size(), -1) {}
+
+    void insert(size_t position) {
+        if (position + 3 <= data.size()) {
+            uint32_t hash = get_hash(position);
+            previous[position] = head[hash];
+            head[hash] = static_cast<int64_t>(position);
+        }
+    }
+
+    std::vector<Token> tokenize(size_t start, size_t end) {
+        std::vector<Token> tokens;
+        size_t position = start;
+        while (position < end) {
+            uint32_t best_length = 0;
+            uint32_t best_distance = 0;
+            if (position + 3 <= end) {
+                int64_t candidate = head[get_hash(position)];
+                for (int chain = 0; candidate >= 0 && chain < 64; ++chain, candidate = previous[candidate]) {
+                    size_t distance = position - static_cast<size_t>(candidate);
+                    if (distance > 32768) {
+                        break;
+                    }
+                    uint32_t length = 0;
+                    while (length < 258 && position + length < end && data[candidate + length] == data[position + length]) {
+                        length++;
+                    }
+                    if (length > best_length) {
+                        best_length = length;
+                        best_distance = static_cast<uint32_t>(distance);
+                    }
+                }
+            }
+            if (best_length >= 3) {
+                tokens.push_back({ best_length, best_distance });
+            } else {
+                best_length = 1;
+                tokens.push_back({ data[position], 0 });
+            }
+            for (uint32_t i = 0; i < best_length; ++i) {
+                insert(position + i);
+            }
+            position += best_length;
+        }
+        return tokens;
+    }
+
+private:
+    uint32_t get_hash(size_t position) const {
+        return (data[position] * 506832829u ^ data[position + 1] * 2654435761u ^ data[position + 2] * 40503u) >> 17;
+    }
+
+    const std::vector<uint8_t>& data;
+    std::vector<int64_t> head;
+    std::vector<int64_t> previous;
+};
+
+static void put_u32_be(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t>& data, BlockMode mode, size_t block_size) {
+    BitWriter out;
+    out.bytes = { 0x78, 0x9C };
+    Matcher matcher(data);
+    size_t block = 0;
+    size_t start = 0;
+    do {
+        size_t end = std::min(start + block_size, data.size());
+        bool final_block = end == data.size();
+        BlockMode block_mode = mode == BlockMode::mixed ? static_cast<BlockMode>(block % 3) : mode;
+        if (block_mode == BlockMode::stored) {
+            for (size_t i = start; i < end; ++i) {
+                matcher.insert(i);
+            }
+            write_stored_block(out, data.data() + start, end - start, final_block);
+        } else if (block_mode == BlockMode::fixed) {
+            write_fixed_block(out, matcher.tokenize(start, end), final_block);
+        } else {
+            write_dynamic_block(out, matcher.tokenize(start, end), final_block);
+        }
+        start = end;
+        block++;
+    } while (start < data.size());
+    out.align();
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (uint8_t value : data) {
+        a = (a + value) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_u32_be(out.bytes, b << 16 | a);
+    return out.bytes;
+}
+
+// Inflates the whole stream, fed at most feed_size bytes per read call and
+// read back out in chunks of varying size.
+static std::vector<uint8_t> inflate(const std::vector<uint8_t>& compressed, size_t feed_size = 1 << 16) {
+    size_t position = 0;
+    InflateStream stream([&](uint8_t* dst, size_t size) {
+        size_t count = std::min({ size, feed_size, compressed.size() - position });
+        memcpy(dst, compressed.data() + position, count);
+        position += count;
+        return count;
+    });
+    std::vector<uint8_t> output;
+    uint8_t chunk[4099];
+    for (size_t chunk_size = 1;; chunk_size = chunk_size * 3 % sizeof(chunk) + 1) {
+        size_t count = stream.read(chunk, chunk_size);
+        output.insert(output.end(), chunk, chunk + count);
+        if (count < chunk_size) {
+            break;
+        }
+    }
+    CHECK(stream.at_end());
+    return output;
+}
+
+static std::vector<std::vector<uint8_t>> make_inflate_inputs() {
+    uint32_t state = 11;
+    std::vector<std::vector<uint8_t>> inputs(6);
+    // Empty, incompressible, text-like, one long run (overlapping
+    // distance-1 matches of 258), and a random block repeated exactly
+    // 32768 bytes later, the farthest a match can reach.
+    inputs[1].resize(70000);
+    for (uint8_t& value : inputs[1]) {
+        value = static_cast<uint8_t>(next_random(state));
+    }
+    const char* words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dogs ", "\n" };
+    while (inputs[2].size() < 200000) {
+        const char* word = words[next_random(state) % 9];
+        inputs[2].insert(inputs[2].end(), word, word + strlen(word));
+    }
+    inputs[3].assign(100000, 'a');
+    inputs[4].resize(32768 + 5000);
+    for (size_t i = 0; i < inputs[4].size(); ++i) {
+        inputs[4][i] = i < 32768 ? static_cast<uint8_t>(next_random(state)) : inputs[4][i - 32768];
+    }
+    // Short runs of all byte values, so every literal code gets used.
+    for (uint32_t i = 0; i < 30000; ++i) {
+        inputs[5].push_back(static_cast<uint8_t>(next_random(state) % 7 ? i / 5 : next_random(state)));
+    }
+    return inputs;
+}
+
+static void test_inflate_blocks() {
+    std::vector<std::vector<uint8_t>> inputs = make_inflate_inputs();
+    const BlockMode modes[] = { BlockMode::stored, BlockMode::fixed, BlockMode::dynamic, BlockMode::mixed };
+    for (const std::vector<uint8_t>& input : inputs) {
+        for (BlockMode mode : modes) {
+            for (size_t block_size : { static_cast<size_t>(1000), static_cast<size_t>(65535) }) {
+                std::vector<uint8_t> compressed = compress(input, mode, block_size);
+                CHECK(inflate(compressed) == input);
+                CHECK(inflate(compressed, 3) == input);
+            }
+        }
+    }
+}
+
+// A dynamic block whose code length header gives counts literal_count and
+// distance_count, with complete codes of those sizes, holding "A".
+static std::vector<uint8_t> make_dynamic_counts_stream(uint32_t literal_count, uint32_t distance_count) {
+    // Complete codes: the shorter length for as many symbols as fit.
+    auto complete_lengths = [](uint32_t count, uint32_t short_length) {
+        uint32_t short_count = (2u << short_length) - count;
+        std::vector<uint8_t> lengths(count, static_cast<uint8_t>(short_length + 1));
+        std::fill(lengths.begin(), lengths.begin() + short_count, static_cast<uint8_t>(short_length));
+        return lengths;
+    };
+    std::vector<uint8_t> literal_lengths = complete_lengths(literal_count, 8);
+    std::vector<uint8_t> distance_lengths = complete_lengths(distance_count, 4);
+    BitWriter out;
+    out.bytes = { 0x78, 0x9C };
+    out.put(1, 1);
+    out.put(2, 2);
+    write_dynamic_header(out, literal_lengths, distance_lengths);
+    write_tokens(out, { { 'A', 0 } }, make_canonical_code(literal_lengths), make_canonical_code(distance_lengths));
+    out.align();
+    put_u32_be(out.bytes, 0x00420042);
+    return out.bytes;
+}
+
+static void test_inflate_malformed() {
+    // HLIT and HDIST can say 288 and 32 codes; only 286 and 30 exist.
+    CHECK(inflate(make_dynamic_counts_stream(286, 30)) == std::vector<uint8_t>({ 'A' }));
+    CHECK_THROWS(inflate(make_dynamic_counts_stream(288, 30)));
+    CHECK_THROWS(inflate(make_dynamic_counts_stream(287, 30)));
+    CHECK_THROWS(inflate(make_dynamic_counts_stream(286, 32)));
+    CHECK_THROWS(inflate(make_dynamic_counts_stream(288, 32)));
+
+    // A match reaching before the first byte, and the distance and length
+    // codes fixed blocks define but deflate does not use.
+    auto fixed_stream = [](const std::vector<uint32_t>& codes) {
+        HuffmanCode literals = get_fixed_literal_code();
+        BitWriter out;
+        out.bytes = { 0x78, 0x9C };
+        out.put(1, 1);
+        out.put(1, 2);
+        for (uint32_t code : codes) {
+            out.put_code(literals.codes[code], literals.lengths[code]);
+        }
+        return out;
+    };
+    BitWriter too_far = fixed_stream({ 'x' });
+    write_tokens(too_far, { { 3, 2 } }, get_fixed_literal_code(), get_fixed_distance_code());
+    too_far.align();
+    CHECK_THROWS(inflate(too_far.bytes));
+    BitWriter distance_30 = fixed_stream({ 'x', 'y', 257 });
+    distance_30.put_code(30, 5);
+    distance_30.put_code(0, 32);
+    CHECK_THROWS(inflate(distance_30.bytes));
+    BitWriter length_286 = fixed_stream({ 'x', 286 });
+    length_286.put_code(0, 32);
+    CHECK_THROWS(inflate(length_286.bytes));
+
+    // Truncation anywhere before the end of the deflate data.
+    std::vector<uint8_t> input = make_inflate_inputs()[2];
+    input.resize(5000);
+    for (BlockMode mode : { BlockMode::stored, BlockMode::fixed, BlockMode::dynamic }) {
+        std::vector<uint8_t> compressed = compress(input, mode, 2000);
+        size_t deflate_end = compressed.size() - 4;
+        for (size_t cut = 0; cut < deflate_end; cut += cut < 300 ? 1 : 97) {
+            CHECK_THROWS(inflate(std::vector<uint8_t>(compressed.begin(), compressed.begin() + cut)));
+        }
+        CHECK_THROWS(inflate(std::vector<uint8_t>(compressed.begin(), compressed.begin() + deflate_end - 1)));
+    }
+
+    // Block type 3, a stored length that does not match its complement,
+    // over-subscribed code lengths, and bad zlib headers.
+    CHECK_THROWS(inflate({ 0x78, 0x9C, 0x07, 0, 0, 0, 0 }));
+    CHECK_THROWS(inflate({ 0x78, 0x9C, 0x01, 0x05, 0x00, 0xFA, 0xFE, 1, 2, 3, 4, 5 }));
+    BitWriter oversubscribed;
+    oversubscribed.bytes = { 0x78, 0x9C };
+    oversubscribed.put(1, 1);
+    oversubscribed.put(2, 2);
+    write_dynamic_header(oversubscribed, std::vector<uint8_t>(257, 1), std::vector<uint8_t>(1, 1));
+    oversubscribed.put(0, 32);
+    CHECK_THROWS(inflate(oversubscribed.bytes));
+    CHECK_THROWS(inflate({ 0x78, 0x9D, 0x03, 0x00 }));
+    CHECK_THROWS(inflate({ 0x79, 0x9C, 0x03, 0x00 }));
+    CHECK_THROWS(inflate({ 0x78, 0xBB, 0x03, 0x00 }));
+    CHECK_THROWS(inflate({}));
+}
+
+static uint32_t get_crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc >> 1 ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void put_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+    put_u32_be(out, static_cast<uint32_t>(size));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    put_u32_be(out, get_crc32(out.data() + start, out.size() - start));
+}
+
+static void put_chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+    put_chunk(out, type, data.data(), data.size());
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+struct PngDesc {
+    uint32_t width;
+    uint32_t height;
+    uint32_t color_type;
+    uint32_t bit_depth;
+    // Filter type per row is filter, or cycles through all five when it is 5.
+    uint32_t filter;
+    BlockMode mode;
+    bool transparency;
+};
+
+static uint32_t get_samples_per_pixel(uint32_t color_type) {
+    const uint32_t samples[] = { 1, 0, 3, 1, 2, 0, 4 };
+    return samples[color_type];
+}
+
+// Smooth gradients with noise on top, so filters and matches both have
+// something to work with, plus a tRNS key that does occur in the image.
+static std::vector<uint8_t> encode_png(const PngDesc& desc, uint32_t seed) {
+    uint32_t bits_per_pixel = get_samples_per_pixel(desc.color_type) * desc.bit_depth;
+    size_t row_bytes = (static_cast<size_t>(desc.width) * bits_per_pixel + 7) / 8;
+    size_t stride = std::max(bits_per_pixel / 8, 1u);
+    std::vector<uint8_t> rows(row_bytes * desc.height);
+    uint32_t state = seed;
+    for (uint32_t y = 0; y < desc.height; ++y) {
+        for (size_t i = 0; i < row_bytes; ++i) {
+            uint32_t noise = next_random(state);
+            rows[y * row_bytes + i] = static_cast<uint8_t>(noise % 5 == 0 ? noise >> 8 : (i / stride * 3 + y * 2 + i % stride * 50) & 0xFF);
+        }
+    }
+
+    std::vector<uint8_t> filtered;
+    std::vector<uint8_t> zero(row_bytes, 0);
+    for (uint32_t y = 0; y < desc.height; ++y) {
+        uint32_t filter = desc.filter == 5 ? (y + seed) % 5 : desc.filter;
+        const uint8_t* row = &rows[y * row_bytes];
+        const uint8_t* above = y > 0 ? &rows[(y - 1) * row_bytes] : zero.data();
+        filtered.push_back(static_cast<uint8_t>(filter));
+        for (size_t i = 0; i < row_bytes; ++i) {
+            uint8_t left = i >= stride ? row[i - stride] : 0;
+            uint8_t corner = i >= stride ? above[i - stride] : 0;
+            uint8_t predictor = filter == 1 ? left : filter == 2 ? above[i] : filter == 3 ? static_cast<uint8_t>((left + above[i]) / 2)
+                              : filter == 4 ? paeth(left, above[i], corner) : 0;
+            filtered.push_back(static_cast<uint8_t>(row[i] - predictor));
+        }
+    }
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> header;
+    put_u32_be(header, desc.width);
+    put_u32_be(header, desc.height);
+    header.insert(header.end(), { static_cast<uint8_t>(desc.bit_depth), static_cast<uint8_t>(desc.color_type), 0, 0, 0 });
+    put_chunk(png, "IHDR", header);
+    // Ancillary chunks are skipped.
+    put_chunk(png, "tEXt", std::vector<uint8_t>({ 'a', 0, 'b' }));
+    if (desc.color_type == 3) {
+        std::vector<uint8_t> palette;
+        for (uint32_t i = 0; i < 256; ++i) {
+            palette.insert(palette.end(), { static_cast<uint8_t>(i), static_cast<uint8_t>(255 - i), static_cast<uint8_t>(i * 7) });
+        }
+        put_chunk(png, "PLTE", palette);
+        if (desc.transparency) {
+            std::vector<uint8_t> alpha;
+            for (uint32_t i = 0; i < 100; ++i) {
+                alpha.push_back(static_cast<uint8_t>(i * 5));
+            }
+            put_chunk(png, "tRNS", alpha);
+        }
+    } else if (desc.transparency && (desc.color_type == 0 || desc.color_type == 2)) {
+        // The first pixel's value, as 16-bit samples.
+        std::vector<uint8_t> key;
+        for (uint32_t c = 0; c < get_samples_per_pixel(desc.color_type); ++c) {
+            uint32_t value = desc.bit_depth == 16 ? rows[c * 2] << 8 | rows[c * 2 + 1]
+                           : desc.bit_depth == 8  ? rows[c]
+                                                  : rows[0] >> (8 - desc.bit_depth);
+            key.push_back(static_cast<uint8_t>(value >> 8));
+            key.push_back(static_cast<uint8_t>(value));
+        }
+        put_chunk(png, "tRNS", key);
+    }
+
+    // IDATs of uneven sizes, one of them empty.
+    std::vector<uint8_t> zlib = compress(filtered, desc.mode, 4096);
+    size_t offset = 0;
+    for (size_t i = 0; offset < zlib.size(); ++i) {
+        size_t size = std::min<size_t>(i == 1 ? 0 : 1 + next_random(state) % 3000, zlib.size() - offset);
+        put_chunk(png, "IDAT", zlib.data() + offset, size);
+        offset += size;
+    }
+    put_chunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+// Rows through PngRowReader in bands of varying height.
+static std::vector<uint8_t> read_png_rows(const std::vector<uint8_t>& png, ImageInfo& info) {
+    MemoryImageSource source(png.data(), png.size());
+    PngRowReader reader(source);
+    info = reader.get_info();
+    std::vector<uint8_t> rgba(static_cast<size_t>(info.width) * info.height * 4);
+    for (uint32_t y = 0, band = 1; y < info.height; y += band, band = band % 7 + 1) {
+        band = std::min(band, info.height - y);
+        reader.read_rows(&rgba[static_cast<size_t>(y) * info.width * 4], static_cast<size_t>(info.width) * 4, band);
+    }
+    return rgba;
+}
+
+static void test_png_formats() {
+    const uint32_t formats[][2] = {
+        // colour type, bit depth
+        { 0, 1 }, { 0, 2 }, { 0, 4 }, { 0, 8 }, { 0, 16 }, { 2, 8 }, { 2, 16 }, { 3, 1 }, { 3, 2 }, { 3, 4 }, { 3, 8 }, { 4, 8 }, { 4, 16 }, { 6, 8 }, { 6, 16 },
+    };
+    const BlockMode modes[] = { BlockMode::stored, BlockMode::fixed, BlockMode::dynamic, BlockMode::mixed };
+    uint32_t seed = 1;
+    for (const auto& format : formats) {
+        for (uint32_t filter = 0; filter <= 5; ++filter) {
+            for (bool transparency : { false, true }) {
+                // Odd widths leave partial bytes at the end of packed rows.
+                PngDesc desc = { 37 + seed % 13, 29 + seed % 7, format[0], format[1], filter, modes[seed % 4], transparency };
+                std::vector<uint8_t> png = encode_png(desc, seed++);
+                ImageInfo info;
+                std::vector<uint8_t> rows = read_png_rows(png, info);
+
+                MemoryImageSource source(png.data(), png.size());
+                std::vector<uint8_t> expected(static_cast<size_t>(desc.width) * desc.height * 4);
+                ImageInfo expected_info = decode_image(source, expected.data(), static_cast<size_t>(desc.width) * 4);
+                CHECK(info.width == desc.width && info.height == desc.height && !info.hdr);
+                CHECK(info.width == expected_info.width && info.height == expected_info.height);
+                if (rows != expected) {
+                    fprintf(stderr, "colour type %u, depth %u, filter %u, transparency %d differs from stb_image\n", desc.color_type, desc.bit_depth,
+                            desc.filter, transparency);
+                    CHECK(rows == expected);
+                }
+            }
+        }
+    }
+}
+
+static void test_png_malformed() {
+    PngDesc desc = { 40, 30, 6, 8, 5, BlockMode::dynamic, false };
+    std::vector<uint8_t> png = encode_png(desc, 5);
+    ImageInfo info;
+    std::vector<uint8_t> rows = read_png_rows(png, info);
+    CHECK(info.channels == 4);
+
+    // Cut inside the image data, and a stream that ends a row early.
+    size_t first_idat = 8 + 25 + 15;
+    for (size_t cut : { first_idat + 20, png.size() / 2, png.size() - 40 }) {
+        CHECK_THROWS(read_png_rows(std::vector<uint8_t>(png.begin(), png.begin() + cut), info));
+    }
+    desc.height = 31;
+    std::vector<uint8_t> taller = encode_png(desc, 5);
+    std::vector<uint8_t> header(taller.begin() + 16, taller.begin() + 29);
+    header[7] = 32;
+    std::vector<uint8_t> claimed(taller.begin(), taller.begin() + 8);
+    put_chunk(claimed, "IHDR", header);
+    claimed.insert(claimed.end(), taller.begin() + 33, taller.end());
+    CHECK_THROWS(read_png_rows(claimed, info));
+
+    // Reading past the last row.
+    {
+        MemoryImageSource source(png.data(), png.size());
+        PngRowReader reader(source);
+        std::vector<uint8_t> all(40 * 31 * 4);
+        CHECK_THROWS(reader.read_rows(all.data(), 40 * 4, 31));
+    }
+
+    // A filter type past Paeth: rows are stored uncompressed, so byte
+    // offsets are known.
+    desc = { 8, 4, 0, 8, 0, BlockMode::stored, false };
+    std::vector<uint8_t> stored = encode_png(desc, 3);
+    std::vector<uint8_t> bad_filter = stored;
+    size_t idat_data = 8 + 25 + 15 + 8;
+    CHECK(memcmp(&bad_filter[idat_data - 4], "IDAT", 4) == 0);
+    // zlib header, stored block header, then the first row's filter byte.
+    bad_filter[idat_data + 2 + 5] = 5;
+    CHECK_THROWS(read_png_rows(bad_filter, info));
+
+    // Interlacing, an invalid depth, and an unknown critical chunk.
+    auto patch_header = [&](size_t index, uint8_t value) {
+        std::vector<uint8_t> patched(stored.begin(), stored.begin() + 8);
+        std::vector<uint8_t> fields(stored.begin() + 16, stored.begin() + 29);
+        fields[index] = value;
+        put_chunk(patched, "IHDR", fields);
+        patched.insert(patched.end(), stored.begin() + 33, stored.end());
+        return patched;
+    };
+    CHECK(read_png_rows(patch_header(12, 0), info).size() == 8 * 4 * 4);
+    CHECK_THROWS(read_png_rows(patch_header(12, 1), info));
+    CHECK_THROWS(read_png_rows(patch_header(8, 3), info));
+    CHECK_THROWS(read_png_rows(patch_header(9, 5), info));
+    std::vector<uint8_t> critical(stored.begin(), stored.begin() + 33);
+    put_chunk(critical, "ABCD", {});
+    critical.insert(critical.end(), stored.begin() + 33, stored.end());
+    CHECK_THROWS(read_png_rows(critical, info));
+    // A palette image without its palette.
+    desc = { 8, 4, 3, 8, 0, BlockMode::stored, false };
+    std::vector<uint8_t> paletted = encode_png(desc, 3);
+    std::vector<uint8_t> no_palette(paletted.begin(), paletted.begin() + 33 + 15);
+    no_palette.insert(no_palette.end(), paletted.begin() + 33 + 15 + 12 + 768, paletted.end());
+    CHECK_THROWS(read_png_rows(no_palette, info));
+    CHECK_THROWS(read_png_rows({ 0x89, 'P', 'N', 'G' }, info));
+}
+
+int main() {
+    test_inflate_blocks();
+    test_inflate_malformed();
+    test_png_formats();
+    test_png_malformed();
+    return finish_checks("png_reader_test");
+}
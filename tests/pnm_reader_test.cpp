@@ -0,0 +1,100 @@
+// Decodes binary and ASCII PNM files built in memory, serially and split
+// across a job pool, and checks that bad samples surface as exceptions on
+// the calling thread rather than inside pool jobs.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "job_pool.hpp"
+#include "pnm_reader.hpp"
+
+static std::vector<uint8_t> make_pnm(const std::string& header, const std::vector<uint8_t>& samples) {
+    std::vector<uint8_t> data(header.begin(), header.end());
+    data.insert(data.end(), samples.begin(), samples.end());
+    return data;
+}
+
+static std::vector<uint8_t> decode(const std::vector<uint8_t>& data, JobPool* job_pool) {
+    PnmHeader header = parse_pnm_header(data.data(), data.size());
+    std::vector<uint8_t> rgba(static_cast<size_t>(header.width) * header.height * 4);
+    decode_pnm(data.data(), data.size(), header, rgba.data(), static_cast<size_t>(header.width) * 4, job_pool);
+    return rgba;
+}
+
+static void test_binary(JobPool& job_pool) {
+    // Tall enough that parallel_for splits the rows.
+    const uint32_t width = 37;
+    const uint32_t height = 4000;
+    std::vector<uint8_t> samples(static_cast<size_t>(width) * height * 3);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = static_cast<uint8_t>(i * 7 + i / 3);
+    }
+    std::vector<uint8_t> data = make_pnm("P6\n37 4000\n255\n", samples);
+    std::vector<uint8_t> serial = decode(data, nullptr);
+    std::vector<uint8_t> parallel = decode(data, &job_pool);
+    CHECK(serial == parallel);
+    bool expanded = true;
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        expanded &= serial[i * 4] == samples[i * 3] && serial[i * 4 + 1] == samples[i * 3 + 1] && serial[i * 4 + 2] == samples[i * 3 + 2] &&
+                    serial[i * 4 + 3] == 255;
+    }
+    CHECK(expanded);
+
+    std::vector<uint8_t> grey = decode(make_pnm("P5 2 1 255\n", { 10, 200 }), &job_pool);
+    CHECK(grey == std::vector<uint8_t>({ 10, 10, 10, 255, 200, 200, 200, 255 }));
+
+    CHECK_THROWS(decode(make_pnm("P5 2 2 255\n", { 1, 2, 3 }), &job_pool));
+}
+
+static void test_scaled(JobPool& job_pool) {
+    // 16-bit big-endian samples rescale to 8 bits.
+    std::vector<uint8_t> rgba = decode(make_pnm("P5 3 1 65535\n", { 0x00, 0x00, 0x80, 0x00, 0xFF, 0xFF }), &job_pool);
+    CHECK(rgba[0] == 0 && rgba[4] == 128 && rgba[8] == 255);
+
+    rgba = decode(make_pnm("P5 2 1 15\n", { 0, 15 }), nullptr);
+    CHECK(rgba[0] == 0 && rgba[4] == 255);
+
+    // Samples above the maximum spread over the image, so that pool workers
+    // as well as the calling thread expand bad rows.
+    const uint32_t width = 64;
+    const uint32_t height = 3000;
+    std::vector<uint8_t> samples(static_cast<size_t>(width) * height * 2, 0);
+    for (uint32_t y = 1; y < height; y += 50) {
+        samples[static_cast<size_t>(y) * width * 2 + 2 * width - 2] = 0x10;
+    }
+    std::vector<uint8_t> data = make_pnm("P5\n64 3000\n4095\n", samples);
+    CHECK_THROWS(decode(data, &job_pool));
+    CHECK_THROWS(decode(data, nullptr));
+
+    PnmHeader header = parse_pnm_header(data.data(), data.size());
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 4);
+    CHECK_THROWS(expand_pnm_rows(data.data() + header.data_offset + get_pnm_row_size(header), header, 1, row.data(), row.size()));
+    expand_pnm_rows(data.data() + header.data_offset, header, 1, row.data(), row.size());
+    CHECK(row[0] == 0 && row[3] == 255);
+}
+
+static void test_ascii() {
+    std::vector<uint8_t> rgba = decode(make_pnm("P3\n# comment\n2 1\n255\n1 2 3\n  250 251\t252\n", {}), nullptr);
+    CHECK(rgba == std::vector<uint8_t>({ 1, 2, 3, 255, 250, 251, 252, 255 }));
+    CHECK_THROWS(decode(make_pnm("P2 2 1 100 5 101\n", {}), nullptr));
+    CHECK_THROWS(decode(make_pnm("P2 2 1 100 5\n", {}), nullptr));
+    CHECK_THROWS(decode(make_pnm("P2 2 1 100 5 x\n", {}), nullptr));
+}
+
+static void test_headers() {
+    CHECK_THROWS(decode(make_pnm("P7 1 1 255\n", { 0 }), nullptr));
+    CHECK_THROWS(decode(make_pnm("P5 0 1 255\n", {}), nullptr));
+    CHECK_THROWS(decode(make_pnm("P5 16385 1 255\n", {}), nullptr));
+    CHECK_THROWS(decode(make_pnm("P5 1 1 65536\n", { 0, 0 }), nullptr));
+    CHECK_THROWS(decode(make_pnm("P5 1 1 255", {}), nullptr));
+}
+
+int main() {
+    JobPool job_pool(3);
+    test_binary(job_pool);
+    test_scaled(job_pool);
+    test_ascii();
+    test_headers();
+    return finish_checks("pnm_reader_test");
+}
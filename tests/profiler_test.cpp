@@ -0,0 +1,335 @@
+// Records more scopes than a thread's ring holds on one thread and a few on
+// another, restarts a capture over stale events, and parses the Chrome trace
+// to check it is valid JSON holding the newest events of this capture only.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "profiler.hpp"
+
+struct JsonValue {
+    enum class Type { null, boolean, number, string, array, object } type = Type::null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* find(const std::string& key) const {
+        for (const auto& [name, value] : object) {
+            if (name == key) {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Strict enough for the trace: no trailing commas, no stray text, escapes
+// limited to what JSON allows. Sets ok to false on the first error.
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : text(text), position(0), ok(true) {}
+
+    bool parse(JsonValue& value) {
+        parse_value(value);
+        skip_space();
+        return ok && position == text.size();
+    }
+
+private:
+    void skip_space() {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\n' || text[position] == '\r' || text[position] == '\t')) {
+            position++;
+        }
+    }
+
+    bool take(char c) {
+        skip_space();
+        if (position < text.size() && text[position] == c) {
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!take(c)) {
+            ok = false;
+        }
+    }
+
+    void parse_string(std::string& out) {
+        expect('"');
+        while (ok && position < text.size() && text[position] != '"') {
+            char c = text[position++];
+            if (static_cast<unsigned char>(c) < 0x20) {
+                ok = false;
+            } else if (c != '\\') {
+                out += c;
+            } else if (position >= text.size()) {
+                ok = false;
+            } else {
+                char escape = text[position++];
+                const std::string simple = "\"\\/bfnrt";
+                const std::string replaced = "\"\\/\b\f\n\r\t";
+                if (simple.find(escape) != std::string::npos) {
+                    out += replaced[simple.find(escape)];
+                } else if (escape == 'u' && position + 4 <= text.size()) {
+                    // Only the control characters the writer escapes.
+                    out += static_cast<char>(strtol(text.substr(position, 4).c_str(), nullptr, 16));
+                    position += 4;
+                } else {
+                    ok = false;
+                }
+            }
+        }
+        if (position >= text.size()) {
+            ok = false;
+        }
+        position++;
+    }
+
+    void parse_value(JsonValue& value) {
+        skip_space();
+        if (!ok || position >= text.size()) {
+            ok = false;
+            return;
+        }
+        char c = text[position];
+        if (c == '{') {
+            value.type = JsonValue::Type::object;
+            position++;
+            if (take('}')) {
+                return;
+            }
+            do {
+                std::pair<std::string, JsonValue> member;
+                skip_space();
+                parse_string(member.first);
+                expect(':');
+                parse_value(member.second);
+                value.object.push_back(std::move(member));
+            } while (ok && take(','));
+            expect('}');
+        } else if (c == '[') {
+            value.type = JsonValue::Type::array;
+            position++;
+            if (take(']')) {
+                return;
+            }
+            do {
+                value.array.emplace_back();
+                parse_value(value.array.back());
+            } while (ok && take(','));
+            expect(']');
+        } else if (c == '"') {
+            value.type = JsonValue::Type::string;
+            parse_string(value.string);
+        } else if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0) {
+            value.type = JsonValue::Type::boolean;
+            value.boolean = c == 't';
+            position += value.boolean ? 4 : 5;
+        } else if (text.compare(position, 4, "null") == 0) {
+            position += 4;
+        } else {
+            value.type = JsonValue::Type::number;
+            const char* start = text.c_str() + position;
+            char* end = nullptr;
+            value.number = strtod(start, &end);
+            if (end == start) {
+                ok = false;
+            }
+            position += end - start;
+        }
+    }
+
+    const std::string& text;
+    size_t position;
+    bool ok;
+};
+
+struct TraceThread {
+    std::string name;
+    std::vector<std::string> events;
+    std::vector<double> timestamps;
+    bool durations_valid = true;
+};
+
+// Parses the trace at path into its threads by tid; false if it is not
+// valid JSON of the expected shape.
+static bool read_trace(const std::string& path, std::map<uint32_t, TraceThread>& threads) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream text;
+    text << file.rdbuf();
+    JsonValue root;
+    if (!JsonParser(text.str()).parse(root) || root.type != JsonValue::Type::object) {
+        return false;
+    }
+    const JsonValue* events = root.find("traceEvents");
+    if (!events || events->type != JsonValue::Type::array) {
+        return false;
+    }
+    for (const JsonValue& event : events->array) {
+        const JsonValue* name = event.find("name");
+        const JsonValue* phase = event.find("ph");
+        const JsonValue* tid = event.find("tid");
+        if (!name || !phase || name->type != JsonValue::Type::string || phase->type != JsonValue::Type::string) {
+            return false;
+        }
+        if (!tid) {
+            // The process name.
+            continue;
+        }
+        TraceThread& thread = threads[static_cast<uint32_t>(tid->number)];
+        if (phase->string == "M") {
+            const JsonValue* args = event.find("args");
+            const JsonValue* thread_name = args ? args->find("name") : nullptr;
+            if (!thread_name) {
+                return false;
+            }
+            thread.name = thread_name->string;
+        } else if (phase->string == "X") {
+            const JsonValue* ts = event.find("ts");
+            const JsonValue* dur = event.find("dur");
+            if (!ts || !dur || ts->type != JsonValue::Type::number || dur->type != JsonValue::Type::number) {
+                return false;
+            }
+            thread.events.push_back(name->string);
+            thread.timestamps.push_back(ts->number);
+            thread.durations_valid = thread.durations_valid && ts->number >= 0.0 && dur->number >= 0.0;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const TraceThread* find_thread(const std::map<uint32_t, TraceThread>& threads, const std::string& name) {
+    for (const auto& [tid, thread] : threads) {
+        if (thread.name == name) {
+            return &thread;
+        }
+    }
+    return nullptr;
+}
+
+static uint32_t count_events(const TraceThread& thread, const std::string& name) {
+    uint32_t count = 0;
+    for (const std::string& event : thread.events) {
+        count += event == name;
+    }
+    return count;
+}
+
+static void test_json_parser() {
+    JsonValue value;
+    CHECK(JsonParser("{\"a\":[1,-2.5e3,\"x\\\"\\u000a\"],\"b\":{},\"c\":true}").parse(value));
+    CHECK(value.find("a") && value.find("a")->array.size() == 3 && value.find("a")->array[2].string == "x\"\n");
+    CHECK(!JsonParser("{\"a\":[1,]}").parse(value));
+    CHECK(!JsonParser("{\"a\":1").parse(value));
+    CHECK(!JsonParser("{\"a\":\"\n\"}").parse(value));
+    CHECK(!JsonParser("[1] 2").parse(value));
+}
+
+static void test_capture(const std::filesystem::path& root) {
+    const uint32_t ring = Profiler::events_per_thread;
+
+    // A first capture, then a restart: what the first one recorded is gone.
+    Profiler::set_thread_name("main");
+    Profiler::start();
+    for (uint32_t i = 0; i < 100; ++i) {
+        PROFILE_SCOPE("stale");
+    }
+    Profiler::start();
+    CHECK(Profiler::is_enabled());
+    for (uint32_t i = 0; i < 10; ++i) {
+        PROFILE_SCOPE("outer");
+        PROFILE_SCOPE("inner");
+    }
+
+    // One thread wraps its ring: the first scopes are overwritten by the
+    // newest ring's worth. The name needs escaping.
+    const std::string busy_name = "busy \"worker\"\t\\";
+    std::thread busy([&] {
+        Profiler::set_thread_name(busy_name);
+        for (uint32_t i = 0; i < 1000; ++i) {
+            PROFILE_SCOPE("overwritten");
+        }
+        for (uint32_t i = 0; i < ring; ++i) {
+            PROFILE_SCOPE("kept");
+        }
+    });
+    std::thread quiet([] {
+        Profiler::set_thread_name("quiet");
+        for (uint32_t i = 0; i < 500; ++i) {
+            PROFILE_SCOPE("quiet scope");
+        }
+    });
+    busy.join();
+    quiet.join();
+
+    std::string path = (root / "trace.json").string();
+    Profiler::write_chrome_trace(path);
+    // Writing stops the capture.
+    CHECK(!Profiler::is_enabled());
+    {
+        PROFILE_SCOPE("after stop");
+    }
+
+    std::map<uint32_t, TraceThread> threads;
+    CHECK(read_trace(path, threads));
+    const TraceThread* main_thread = find_thread(threads, "main");
+    const TraceThread* busy_thread = find_thread(threads, busy_name);
+    const TraceThread* quiet_thread = find_thread(threads, "quiet");
+    CHECK(main_thread && busy_thread && quiet_thread);
+    if (!main_thread || !busy_thread || !quiet_thread) {
+        return;
+    }
+    CHECK(main_thread->events.size() == 20 && count_events(*main_thread, "outer") == 10 && count_events(*main_thread, "inner") == 10);
+    CHECK(busy_thread->events.size() == ring && count_events(*busy_thread, "kept") == ring);
+    CHECK(quiet_thread->events.size() == 500 && count_events(*quiet_thread, "quiet scope") == 500);
+    bool ordered = true;
+    for (size_t i = 1; i < busy_thread->timestamps.size(); ++i) {
+        ordered = ordered && busy_thread->timestamps[i] >= busy_thread->timestamps[i - 1];
+    }
+    CHECK(ordered);
+    CHECK(main_thread->durations_valid && busy_thread->durations_valid && quiet_thread->durations_valid);
+
+    // A new capture starts empty for every thread, including ones that
+    // have exited.
+    Profiler::start();
+    {
+        PROFILE_SCOPE("second capture");
+    }
+    std::string second_path = (root / "second.json").string();
+    Profiler::write_chrome_trace(second_path);
+    threads.clear();
+    CHECK(read_trace(second_path, threads));
+    uint32_t total = 0;
+    for (const auto& [tid, thread] : threads) {
+        total += static_cast<uint32_t>(thread.events.size());
+    }
+    main_thread = find_thread(threads, "main");
+    CHECK(total == 1 && main_thread && count_events(*main_thread, "second capture") == 1);
+
+    CHECK_THROWS(Profiler::write_chrome_trace((root / "missing" / "trace.json").string()));
+}
+
+int main() {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "profiler_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    test_json_parser();
+    test_capture(root);
+    std::filesystem::remove_all(root);
+    return finish_checks("profiler_test");
+}
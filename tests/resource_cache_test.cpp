@@ -0,0 +1,157 @@
+// Loads files through ResourceCache and checks its counters: path hits, copies
+// under other names shared as content hits, misses, bytes saved and
+// residency across purges. A hash match whose bytes no longer compare equal
+// has to load its own resource.
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "resource_cache.hpp"
+
+struct Blob {
+    std::vector<uint8_t> bytes;
+};
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+    FILE* file = fopen(path.c_str(), "wb");
+    CHECK(file != nullptr);
+    if (file) {
+        CHECK(fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        CHECK(fclose(file) == 0);
+    }
+}
+
+static std::vector<uint8_t> make_bytes(uint8_t seed, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+    return bytes;
+}
+
+struct Fixture {
+    uint32_t loads = 0;
+    // Resources cost twice their file size, as decoded data usually does.
+    ResourceCache<Blob> cache{
+        [this](const std::string& path, const uint8_t* data, size_t size) {
+            loads++;
+            if (path.find("unloadable") != std::string::npos) {
+                return std::unique_ptr<Blob>();
+            }
+            return std::make_unique<Blob>(Blob{ std::vector<uint8_t>(data, data + size) });
+        },
+        [](const Blob& blob) { return static_cast<uint64_t>(blob.bytes.size() * 2); }
+    };
+};
+
+static void test_hits(const std::filesystem::path& root) {
+    std::string a = (root / "a.bin").string();
+    std::string copy = (root / "copy_of_a.bin").string();
+    std::string same_size = (root / "same_size.bin").string();
+    std::string longer = (root / "longer.bin").string();
+    write_file(a, make_bytes(1, 1000));
+    write_file(copy, make_bytes(1, 1000));
+    write_file(same_size, make_bytes(2, 1000));
+    write_file(longer, make_bytes(1, 1001));
+
+    Fixture fixture;
+    ResourceCache<Blob>& cache = fixture.cache;
+    ResourceHandle<Blob> first = cache.acquire(a);
+    ResourceHandle<Blob> again = cache.acquire(a);
+    ResourceHandle<Blob> shared = cache.acquire(copy);
+    ResourceHandle<Blob> other = cache.acquire(same_size);
+    ResourceHandle<Blob> prefix = cache.acquire(longer);
+    CHECK(first.get() == again.get() && first.get() == shared.get());
+    CHECK(other.get() != first.get() && prefix.get() != first.get());
+    CHECK(first->bytes == make_bytes(1, 1000) && prefix->bytes == make_bytes(1, 1001));
+    CHECK(fixture.loads == 3);
+
+    ResourceCacheStats stats = cache.get_stats();
+    CHECK(stats.requests == 5);
+    CHECK(stats.path_hits == 1);
+    CHECK(stats.content_hits == 1);
+    CHECK(stats.misses == 3);
+    CHECK(stats.bytes_saved == 2000);
+    CHECK(stats.resident_count == 3);
+    CHECK(stats.resident_bytes == 2000 + 2000 + 2002);
+    CHECK(stats.get_hit_rate() == 0.4);
+    CHECK(format_resource_cache_stats(stats) == "5 requests, 40% hits (1 path, 1 content), 3 misses, 0.0 MB saved, 3 resident in 0.0 MB");
+    // The copy's path now hits without touching the file.
+    cache.acquire(copy);
+    CHECK(cache.get_stats().path_hits == 2 && fixture.loads == 3);
+
+    // Only resources without handles go, along with every path that led to them.
+    CHECK(cache.purge_unused() == 0);
+    other.reset();
+    prefix = ResourceHandle<Blob>();
+    CHECK(cache.purge_unused() == 2);
+    stats = cache.get_stats();
+    CHECK(stats.resident_count == 1 && stats.resident_bytes == 2000);
+    first.reset();
+    again.reset();
+    CHECK(cache.purge_unused() == 0);
+    shared.reset();
+    CHECK(cache.purge_unused() == 1);
+    CHECK(cache.get_stats().resident_count == 0 && cache.get_stats().resident_bytes == 0);
+    ResourceHandle<Blob> reloaded = cache.acquire(copy);
+    CHECK(fixture.loads == 4 && cache.get_stats().misses == 4);
+    CHECK(reloaded->bytes == make_bytes(1, 1000));
+
+    // Slots freed by the purge are reused; empty files are resources too.
+    std::string empty_a = (root / "nothing_a.bin").string();
+    std::string empty_b = (root / "nothing_b.bin").string();
+    write_file(empty_a, {});
+    write_file(empty_b, {});
+    CHECK(cache.acquire(empty_a).get() == cache.acquire(empty_b).get());
+    CHECK(cache.get_stats().content_hits == 2);
+}
+
+static void test_content_changed(const std::filesystem::path& root) {
+    // b holds what a held when it was loaded. a has changed since, so the
+    // hash of b matches a's entry but the bytes do not.
+    std::string a = (root / "changed_a.bin").string();
+    std::string b = (root / "changed_b.bin").string();
+    write_file(a, make_bytes(3, 4096));
+    Fixture fixture;
+    ResourceHandle<Blob> original = fixture.cache.acquire(a);
+    write_file(a, make_bytes(4, 4096));
+    write_file(b, make_bytes(3, 4096));
+    ResourceHandle<Blob> copy = fixture.cache.acquire(b);
+    CHECK(copy.get() != original.get());
+    CHECK(fixture.loads == 2);
+    CHECK(fixture.cache.get_stats().content_hits == 0 && fixture.cache.get_stats().misses == 2);
+    CHECK(copy->bytes == make_bytes(3, 4096));
+
+    // Likewise when the file the entry came from is gone.
+    std::string c = (root / "changed_c.bin").string();
+    write_file(c, make_bytes(3, 4096));
+    std::filesystem::remove(b);
+    fixture.cache.acquire(c);
+    CHECK(fixture.loads == 3 && fixture.cache.get_stats().content_hits == 0);
+}
+
+static void test_errors(const std::filesystem::path& root) {
+    Fixture fixture;
+    CHECK_THROWS(fixture.cache.acquire((root / "missing.bin").string()));
+    std::string unloadable = (root / "unloadable.bin").string();
+    write_file(unloadable, make_bytes(5, 10));
+    // The load function returning nothing.
+    CHECK_THROWS(fixture.cache.acquire(unloadable));
+    ResourceCacheStats stats = fixture.cache.get_stats();
+    CHECK(stats.requests == 2 && stats.misses == 0 && stats.resident_count == 0);
+}
+
+int main() {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "resource_cache_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    test_hits(root);
+    test_content_changed(root);
+    test_errors(root);
+    std::filesystem::remove_all(root);
+    return finish_checks("resource_cache_test");
+}
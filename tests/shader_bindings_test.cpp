@@ -0,0 +1,193 @@
+// Derives the root signature layout from binding lists recorded off the
+// shaders.hlsl permutations and checks the parameters it builds, that
+// covers() accepts every recorded list and rejects bindings the layout does
+// not provide, and that conflicting or oversized binding sets throw.
+
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "shader_bindings.hpp"
+
+static const PipelineShaderStage vs = PipelineShaderStage::vertex;
+static const PipelineShaderStage ps = PipelineShaderStage::pixel;
+static const uint32_t vs_bit = 1u << static_cast<uint32_t>(PipelineShaderStage::vertex);
+static const uint32_t ps_bit = 1u << static_cast<uint32_t>(PipelineShaderStage::pixel);
+
+// What reflection reports for shaders.hlsl, per stage and feature set.
+// Each stage only sees the part of DrawConstants it reads up to.
+static std::vector<ShaderBinding> record_vertex(bool instancing) {
+    std::vector<ShaderBinding> bindings = {
+        { "CameraBuffer", ShaderBindingType::constant_buffer, 0, 0, 128, vs },
+        { "DrawConstants", ShaderBindingType::constant_buffer, 2, 0, 4, vs },
+        { "objects", ShaderBindingType::structured_buffer, 5, 0, 0, vs },
+    };
+    if (instancing) {
+        bindings.push_back({ "instances", ShaderBindingType::structured_buffer, 4, 0, 0, vs });
+    }
+    return bindings;
+}
+
+static std::vector<ShaderBinding> record_pixel(bool clustered_lights) {
+    std::vector<ShaderBinding> bindings = {
+        { "LightBuffer", ShaderBindingType::constant_buffer, 1, 0, 80, ps },
+        { "DrawConstants", ShaderBindingType::constant_buffer, 2, 0, 8, ps },
+        { "diffuseTexture", ShaderBindingType::texture, 0, 0, 0, ps },
+        { "materials", ShaderBindingType::structured_buffer, 6, 0, 0, ps },
+        { "linearSampler", ShaderBindingType::sampler, 0, 0, 0, ps },
+    };
+    if (clustered_lights) {
+        bindings.push_back({ "lights", ShaderBindingType::structured_buffer, 1, 0, 0, ps });
+        bindings.push_back({ "clusterRanges", ShaderBindingType::structured_buffer, 2, 0, 0, ps });
+        bindings.push_back({ "lightIndices", ShaderBindingType::structured_buffer, 3, 0, 0, ps });
+    }
+    return bindings;
+}
+
+static std::vector<std::vector<ShaderBinding>> record_permutations() {
+    // lights=4096, instancing, lights=0; alpha test and packed vertices
+    // change no bindings.
+    return { record_vertex(false), record_pixel(true), record_vertex(true), record_pixel(false) };
+}
+
+static std::vector<ShaderBinding> join(const std::vector<std::vector<ShaderBinding>>& lists) {
+    std::vector<ShaderBinding> bindings;
+    for (const std::vector<ShaderBinding>& list : lists) {
+        bindings.insert(bindings.end(), list.begin(), list.end());
+    }
+    return bindings;
+}
+
+static void test_derive() {
+    BindingLayout layout = derive_binding_layout(join(record_permutations()));
+    struct Expected {
+        RootParameterKind kind;
+        const char* name;
+        uint32_t register_index;
+        uint32_t value_count;
+        uint32_t stages;
+    };
+    const Expected expected[] = {
+        { RootParameterKind::constants, "DrawConstants", 2, 2, vs_bit | ps_bit },
+        { RootParameterKind::constant_buffer, "CameraBuffer", 0, 0, vs_bit },
+        { RootParameterKind::constant_buffer, "LightBuffer", 1, 0, ps_bit },
+        { RootParameterKind::shader_resource, "lights", 1, 0, ps_bit },
+        { RootParameterKind::shader_resource, "clusterRanges", 2, 0, ps_bit },
+        { RootParameterKind::shader_resource, "lightIndices", 3, 0, ps_bit },
+        { RootParameterKind::shader_resource, "instances", 4, 0, vs_bit },
+        { RootParameterKind::shader_resource, "objects", 5, 0, vs_bit },
+        { RootParameterKind::shader_resource, "materials", 6, 0, ps_bit },
+        { RootParameterKind::descriptor_table, "diffuseTexture", 0, 0, ps_bit },
+    };
+    CHECK(layout.parameters.size() == sizeof(expected) / sizeof(expected[0]));
+    for (size_t i = 0; i < layout.parameters.size() && i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        const RootParameterLayout& parameter = layout.parameters[i];
+        CHECK(parameter.kind == expected[i].kind && parameter.name == expected[i].name);
+        CHECK(parameter.register_index == expected[i].register_index && parameter.space == 0);
+        CHECK(parameter.value_count == expected[i].value_count && parameter.stages == expected[i].stages);
+        CHECK(layout.find(expected[i].name) == static_cast<int>(i));
+    }
+    CHECK(layout.samplers.size() == 1 && layout.samplers[0].name == "linearSampler");
+    CHECK(layout.find("instanceData") == -1);
+    // 2 constants, 8 root descriptors of 2 and one table.
+    CHECK(layout.get_size_in_dwords() == 19);
+
+    // Merging in another order gives the same layout.
+    std::vector<std::vector<ShaderBinding>> permutations = record_permutations();
+    BindingLayout reversed = derive_binding_layout(join({ permutations[3], permutations[2], permutations[1], permutations[0] }));
+    CHECK(reversed.parameters.size() == layout.parameters.size());
+    for (size_t i = 0; i < reversed.parameters.size() && i < layout.parameters.size(); ++i) {
+        CHECK(reversed.parameters[i].name == layout.parameters[i].name && reversed.parameters[i].stages == layout.parameters[i].stages &&
+              reversed.parameters[i].value_count == layout.parameters[i].value_count);
+    }
+
+    // Constant buffer sizes round up to whole values, at least one.
+    BindingLayout small = derive_binding_layout({ { "A", ShaderBindingType::constant_buffer, 0, 0, 5, vs },
+                                                  { "B", ShaderBindingType::constant_buffer, 1, 0, 0, vs },
+                                                  { "C", ShaderBindingType::constant_buffer, 2, 0, 16, vs },
+                                                  { "D", ShaderBindingType::constant_buffer, 3, 0, 17, vs } });
+    CHECK(small.parameters[small.find("A")].value_count == 2);
+    CHECK(small.parameters[small.find("B")].value_count == 1);
+    CHECK(small.parameters[small.find("C")].value_count == 4);
+    CHECK(small.parameters[small.find("D")].kind == RootParameterKind::constant_buffer);
+}
+
+static void test_covers() {
+    std::vector<std::vector<ShaderBinding>> permutations = record_permutations();
+    BindingLayout layout = derive_binding_layout(join(permutations));
+    for (const std::vector<ShaderBinding>& bindings : permutations) {
+        CHECK(layout.covers(bindings));
+    }
+    CHECK(layout.covers({}));
+
+    // A layout derived without the instancing permutation misses instances.
+    BindingLayout without_instancing = derive_binding_layout(join({ permutations[0], permutations[1] }));
+    std::string missing;
+    CHECK(!without_instancing.covers(permutations[2], &missing) && missing == "instances");
+    CHECK(without_instancing.covers(permutations[3]));
+
+    struct Case {
+        ShaderBinding binding;
+        bool covered;
+    };
+    const Case cases[] = {
+        // Per-draw data that outgrew its two root constants.
+        { { "DrawConstants", ShaderBindingType::constant_buffer, 2, 0, 12, ps }, false },
+        { { "DrawConstants", ShaderBindingType::constant_buffer, 2, 0, 8, PipelineShaderStage::geometry }, false },
+        // A small constant buffer fits a root CBV.
+        { { "CameraBuffer", ShaderBindingType::constant_buffer, 0, 0, 16, vs }, true },
+        { { "CameraBuffer", ShaderBindingType::constant_buffer, 0, 0, 128, ps }, false },
+        { { "CameraBuffer", ShaderBindingType::constant_buffer, 0, 1, 128, vs }, false },
+        { { "Camera", ShaderBindingType::constant_buffer, 0, 0, 128, vs }, false },
+        { { "objects", ShaderBindingType::structured_buffer, 5, 0, 0, vs }, true },
+        { { "objects", ShaderBindingType::structured_buffer, 7, 0, 0, vs }, false },
+        { { "objects", ShaderBindingType::texture, 5, 0, 0, vs }, false },
+        { { "normalTexture", ShaderBindingType::texture, 7, 0, 0, ps }, false },
+        { { "linearSampler", ShaderBindingType::sampler, 0, 0, 0, vs }, true },
+        { { "pointSampler", ShaderBindingType::sampler, 0, 0, 0, ps }, false },
+        { { "linearSampler", ShaderBindingType::sampler, 1, 0, 0, ps }, false },
+    };
+    for (const Case& test : cases) {
+        std::vector<ShaderBinding> bindings = permutations[1];
+        bindings.push_back(test.binding);
+        missing.clear();
+        bool covered = layout.covers(bindings, &missing);
+        CHECK(covered == test.covered);
+        CHECK(covered || missing == test.binding.name);
+    }
+}
+
+static void test_conflicts() {
+    std::vector<ShaderBinding> bindings = join(record_permutations());
+    // Registers are numbered per class, so b1 and t1 do not clash.
+    CHECK(derive_binding_layout(bindings).find("LightBuffer") != -1);
+
+    std::vector<ShaderBinding> renamed = bindings;
+    renamed.push_back({ "lightList", ShaderBindingType::structured_buffer, 1, 0, 0, vs });
+    CHECK_THROWS(derive_binding_layout(renamed));
+    std::vector<ShaderBinding> retyped = bindings;
+    retyped.push_back({ "lights", ShaderBindingType::texture, 1, 0, 0, ps });
+    CHECK_THROWS(derive_binding_layout(retyped));
+    // The same name in another space is a separate binding.
+    std::vector<ShaderBinding> spaced = bindings;
+    spaced.push_back({ "lights", ShaderBindingType::structured_buffer, 1, 1, 0, ps });
+    CHECK(derive_binding_layout(spaced).parameters.size() == 11);
+
+    // 31 root descriptors and a table take 63 dwords, a root constant the
+    // last one, and nothing more fits.
+    std::vector<ShaderBinding> many = { { "diffuseTexture", ShaderBindingType::texture, 0, 0, 0, ps } };
+    for (uint32_t i = 1; i <= 31; ++i) {
+        many.push_back({ "buffer" + std::to_string(i), ShaderBindingType::structured_buffer, i, 0, 0, ps });
+    }
+    CHECK(derive_binding_layout(many).get_size_in_dwords() == 63);
+    many.push_back({ "tail", ShaderBindingType::constant_buffer, 0, 0, 4, ps });
+    CHECK(derive_binding_layout(many).get_size_in_dwords() == 64);
+    many.push_back({ "extra", ShaderBindingType::texture, 1, 0, 0, ps });
+    CHECK_THROWS(derive_binding_layout(many));
+}
+
+int main() {
+    test_derive();
+    test_covers();
+    test_conflicts();
+    return finish_checks("shader_bindings_test");
+}
@@ -0,0 +1,198 @@
+// Checks that every key input separates cache entries, that 400 stores from
+// concurrent threads (many to the same keys, with loads racing them) only
+// ever leave whole entries, and that damaged entries are rejected.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "shader_cache.hpp"
+
+static uint64_t make_key(const std::string& source, const std::string& entry_point, const std::string& target,
+                         const std::vector<ShaderDefine>& defines, uint32_t flags) {
+    return make_shader_cache_key(source.data(), source.size(), entry_point, target, defines, flags);
+}
+
+static void test_key_separation() {
+    const std::string source = "float4 main() : SV_Target { return 1; }";
+    std::vector<uint64_t> keys = {
+        make_key(source, "main", "ps_6_0", {}, 0),
+        make_key(source + " ", "main", "ps_6_0", {}, 0),
+        make_key(source, "main2", "ps_6_0", {}, 0),
+        make_key(source, "main", "ps_6_6", {}, 0),
+        make_key(source, "main", "ps_6_0", {}, 1),
+        make_key(source, "main", "ps_6_0", { { "A", "1" } }, 0),
+        make_key(source, "main", "ps_6_0", { { "A", "2" } }, 0),
+        make_key(source, "main", "ps_6_0", { { "A", "1" }, { "B", "1" } }, 0),
+        make_key(source, "main", "ps_6_0", { { "B", "1" }, { "A", "1" } }, 0),
+        // Neighbouring fields that concatenate to the same bytes.
+        make_key(source, "mainp", "s_6_0", {}, 0),
+        make_key(source, "main", "ps_6_0", { { "AB", "" } }, 0),
+        make_key(source, "main", "ps_6_0", { { "A", "B" } }, 0),
+        make_key(source, "main", "ps_6_0", { { "", "AB" } }, 0),
+        make_key(source, "main", "ps_6_0", { { "", "" } }, 0),
+        make_key(source + "main", "", "ps_6_0", {}, 0),
+    };
+    std::set<uint64_t> unique(keys.begin(), keys.end());
+    CHECK(unique.size() == keys.size());
+    CHECK(make_key(source, "main", "ps_6_0", { { "A", "1" } }, 0) == keys[5]);
+}
+
+static std::vector<uint8_t> make_bytecode(uint64_t seed, size_t size) {
+    std::vector<uint8_t> bytecode(size);
+    for (uint8_t& value : bytecode) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        value = static_cast<uint8_t>(seed >> 56);
+    }
+    return bytecode;
+}
+
+static void test_round_trip(const std::string& directory) {
+    ShaderCache cache(directory);
+    std::vector<uint8_t> loaded = { 1, 2, 3 };
+    CHECK(!cache.load(42, loaded));
+
+    std::vector<uint8_t> bytecode = make_bytecode(1, 1000);
+    CHECK(cache.store(42, bytecode.data(), bytecode.size()));
+    CHECK(cache.load(42, loaded) && loaded == bytecode);
+
+    // Empty bytecode is a valid entry.
+    CHECK(cache.store(43, nullptr, 0));
+    CHECK(cache.load(43, loaded) && loaded.empty());
+
+    ShaderCacheStats stats = cache.get_stats();
+    CHECK(stats.hits == 2 && stats.misses == 1 && stats.stores == 2 && stats.rejected == 0 && stats.bytes_loaded == 1000);
+}
+
+static void test_concurrent_stores(const std::string& directory) {
+    // 8 threads store 50 entries each over 20 keys, so every key is written
+    // by several threads at once, while the same threads load and verify.
+    // Each key's content depends only on the key, as with real bytecode.
+    ShaderCache cache(directory);
+    const uint32_t thread_count = 8;
+    const uint32_t stores_per_thread = 50;
+    const uint32_t key_count = 20;
+    std::atomic<uint32_t> failed_stores(0);
+    std::atomic<uint32_t> bad_loads(0);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+            for (uint32_t i = 0; i < stores_per_thread; ++i) {
+                uint64_t key = 1000 + (t * 7 + i) % key_count;
+                std::vector<uint8_t> bytecode = make_bytecode(key, 4096 + key * 13);
+                if (!cache.store(key, bytecode.data(), bytecode.size())) {
+                    ++failed_stores;
+                }
+                std::vector<uint8_t> loaded;
+                uint64_t other = 1000 + (t + i * 3) % key_count;
+                if (cache.load(other, loaded) && loaded != make_bytecode(other, 4096 + other * 13)) {
+                    ++bad_loads;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CHECK(failed_stores == 0);
+    CHECK(bad_loads == 0);
+    CHECK(cache.get_stats().stores == thread_count * stores_per_thread);
+    CHECK(cache.get_stats().rejected == 0);
+
+    for (uint64_t key = 1000; key < 1000 + key_count; ++key) {
+        std::vector<uint8_t> loaded;
+        CHECK(cache.load(key, loaded) && loaded == make_bytecode(key, 4096 + key * 13));
+    }
+    uint32_t leftovers = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        leftovers += entry.path().extension() == ".tmp";
+    }
+    CHECK(leftovers == 0);
+}
+
+static std::vector<uint8_t> read_file(const std::string& path) {
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file) {
+        int c;
+        while ((c = fgetc(file)) != EOF) {
+            data.push_back(static_cast<uint8_t>(c));
+        }
+        fclose(file);
+    }
+    return data;
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file) {
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+    }
+}
+
+static void test_corrupt_entries(const std::string& directory) {
+    ShaderCache cache(directory);
+    std::vector<uint8_t> bytecode = make_bytecode(9, 256);
+    CHECK(cache.store(7, bytecode.data(), bytecode.size()));
+    std::string path = cache.get_entry_path(7);
+    const std::vector<uint8_t> good = read_file(path);
+    // magic, version, key, payload size, payload hash
+    const size_t header_size = 32;
+    CHECK(good.size() == header_size + bytecode.size());
+
+    std::vector<std::vector<uint8_t>> corruptions;
+    std::vector<uint8_t> damaged = good;
+    damaged[header_size + 100] ^= 1;
+    corruptions.push_back(damaged);
+    corruptions.push_back(std::vector<uint8_t>(good.begin(), good.end() - 1));
+    corruptions.push_back(std::vector<uint8_t>(good.begin(), good.begin() + 10));
+    damaged = good;
+    damaged.push_back(0);
+    corruptions.push_back(damaged);
+    damaged = good;
+    damaged[0] ^= 0xFF;
+    corruptions.push_back(damaged);
+    damaged = good;
+    damaged[4] += 1;
+    corruptions.push_back(damaged);
+    // A payload size far past the file.
+    damaged = good;
+    damaged[16 + 7] = 0x40;
+    corruptions.push_back(damaged);
+    corruptions.push_back({});
+
+    uint64_t rejected = 0;
+    for (const std::vector<uint8_t>& corruption : corruptions) {
+        write_file(path, corruption);
+        std::vector<uint8_t> loaded = { 1 };
+        CHECK(!cache.load(7, loaded) && loaded.empty());
+        CHECK(cache.get_stats().rejected == ++rejected);
+    }
+
+    // A whole, valid entry under another key's name.
+    write_file(cache.get_entry_path(8), good);
+    std::vector<uint8_t> loaded;
+    CHECK(!cache.load(8, loaded));
+    CHECK(cache.get_stats().rejected == rejected + 1);
+
+    // Storing again replaces the damaged entry.
+    CHECK(cache.store(7, bytecode.data(), bytecode.size()));
+    CHECK(cache.load(7, loaded) && loaded == bytecode);
+}
+
+int main() {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "shader_cache_test";
+    std::filesystem::remove_all(root);
+    test_key_separation();
+    test_round_trip((root / "round_trip").string());
+    test_concurrent_stores((root / "concurrent").string());
+    test_corrupt_entries((root / "corrupt").string());
+    std::filesystem::remove_all(root);
+    return finish_checks("shader_cache_test");
+}
@@ -0,0 +1,90 @@
+// Parses permutation manifests, checks that plan_permutations shares stage
+// compiles between pipelines that differ only in what the other stage reads,
+// and checks the stats line ShaderPermutationSet reports for a plan.
+
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "shader_permutations.hpp"
+
+// The manifest the engine ships.
+static const char* engine_manifest =
+    "# Pipelines built from shaders.hlsl at startup.\n"
+    "lights=4096\n"
+    "alpha_test\n"
+    "instancing\n"
+    "instancing alpha_test\n"
+    "packed_vertices\n"
+    "packed_vertices alpha_test lights=16\n"
+    "lights=0\n";
+
+static void test_parse() {
+    std::vector<ShaderPermutation> manifest = parse_permutation_manifest(engine_manifest);
+    // The default comes first whether listed or not.
+    CHECK(manifest.size() == 8);
+    CHECK(manifest[0] == shader_default_permutation && manifest[1] == shader_default_permutation);
+    CHECK(manifest[4].features == (shader_feature_instancing | shader_feature_alpha_test) && manifest[4].light_tier == shader_default_light_tier);
+    CHECK(manifest[6].light_tier == 1 && manifest[7].light_tier == 0 && manifest[7].features == 0);
+
+    // Light counts round up to the next tier; past the last they clamp.
+    std::vector<ShaderPermutation> tiers = parse_permutation_manifest("lights=1\nlights=17 # comment\n  \nlights=64\nlights=9999\n");
+    CHECK(tiers.size() == 5);
+    CHECK(tiers[1].light_tier == 1 && tiers[2].light_tier == 2 && tiers[3].light_tier == 2 && tiers[4].light_tier == shader_default_light_tier);
+    CHECK(get_light_tier_limit(tiers[2].light_tier) == 64);
+    CHECK_THROWS(parse_permutation_manifest("instancing shadows\n"));
+    CHECK(parse_permutation_manifest("").size() == 1);
+}
+
+static void test_plan() {
+    ShaderPermutationPlan plan = plan_permutations(parse_permutation_manifest(engine_manifest));
+    // The listed default is the same pipeline as the implicit one.
+    CHECK(plan.pipelines.size() == 7);
+    CHECK(plan.vertex_compiles.size() == 7 && plan.pixel_compiles.size() == 7);
+    // Vertex shaders only see instancing and packed vertices: 3 variants.
+    // Pixel shaders see alpha test and the tier: 4 variants.
+    uint32_t vertex_count = 0;
+    uint32_t pixel_count = 0;
+    for (const ShaderStageCompile& compile : plan.compiles) {
+        vertex_count += compile.stage == PipelineShaderStage::vertex;
+        pixel_count += compile.stage == PipelineShaderStage::pixel;
+        CHECK(compile.permutation == mask_permutation(compile.permutation, compile.stage));
+    }
+    CHECK(vertex_count == 3 && pixel_count == 4);
+    for (size_t i = 0; i < plan.pipelines.size(); ++i) {
+        const ShaderStageCompile& vertex = plan.compiles[plan.vertex_compiles[i]];
+        const ShaderStageCompile& pixel = plan.compiles[plan.pixel_compiles[i]];
+        CHECK(vertex.stage == PipelineShaderStage::vertex && vertex.permutation == mask_permutation(plan.pipelines[i], PipelineShaderStage::vertex));
+        CHECK(pixel.stage == PipelineShaderStage::pixel && pixel.permutation == mask_permutation(plan.pipelines[i], PipelineShaderStage::pixel));
+    }
+
+    // Defines spell out every feature of the stage.
+    std::vector<ShaderDefine> defines = get_permutation_defines(plan.pipelines[5], PipelineShaderStage::pixel);
+    CHECK(defines.size() == 2 && defines[0].name == "ALPHA_TEST" && defines[0].value == "1");
+    CHECK(defines.size() == 2 && defines[1].name == "CLUSTER_LIGHT_LIMIT" && defines[1].value == "16");
+}
+
+static void test_stats() {
+    ShaderPermutationPlan plan = plan_permutations(parse_permutation_manifest(engine_manifest));
+    ShaderPermutationStats stats = {};
+    stats.permutation_space = get_permutation_space_size();
+    stats.pipeline_count = static_cast<uint32_t>(plan.pipelines.size());
+    stats.compile_count = static_cast<uint32_t>(plan.compiles.size());
+    CHECK(stats.permutation_space == 32);
+    CHECK(format_shader_permutation_stats(stats) ==
+          "0 of 7 pipelines ready (0 failed, 32 permutations possible), 0 of 7 compiles (14 unpruned), 0.000 s compiling, 0.000 s wall");
+
+    stats.compiles_done = 6;
+    stats.pipelines_ready = 5;
+    stats.failed = 1;
+    stats.compile_seconds = 1.25;
+    stats.wall_seconds = 0.5;
+    CHECK(format_shader_permutation_stats(stats) ==
+          "5 of 7 pipelines ready (1 failed, 32 permutations possible), 6 of 7 compiles (14 unpruned), 1.250 s compiling, 0.500 s wall");
+}
+
+int main() {
+    test_parse();
+    test_plan();
+    test_stats();
+    return finish_checks("shader_permutations_test");
+}
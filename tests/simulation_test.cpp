@@ -0,0 +1,165 @@
+// Feeds frame times to FixedTimestep and checks the steps taken, the
+// accumulator left over as alpha, and the clamp after a stall. Runs the
+// Simulation twice on the same jittery frame times and checks the two end
+// bit-identical, and that interpolate blends the short way round.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "check.hpp"
+#include "fixed_timestep.hpp"
+#include "simulation.hpp"
+
+static const float pi = 3.14159265f;
+
+static uint32_t run_steps(FixedTimestep& timestep) {
+    uint32_t steps = 0;
+    while (timestep.step()) {
+        steps++;
+    }
+    return steps;
+}
+
+static bool near(double a, double b) {
+    return std::fabs(a - b) < 1e-6;
+}
+
+static void test_steps() {
+    // 10 ms steps: every count below is exact in nanoseconds.
+    FixedTimestep timestep(0.01, 8);
+    CHECK(timestep.get_step_seconds() == 0.01);
+    CHECK(run_steps(timestep) == 0 && timestep.get_alpha() == 0.0f);
+
+    timestep.add_time(0.025);
+    CHECK(run_steps(timestep) == 2);
+    CHECK(near(timestep.get_alpha(), 0.5));
+    timestep.add_time(0.004);
+    CHECK(run_steps(timestep) == 0);
+    CHECK(near(timestep.get_alpha(), 0.9));
+    timestep.add_time(0.001);
+    CHECK(run_steps(timestep) == 1);
+    CHECK(timestep.get_alpha() == 0.0f);
+    CHECK(timestep.get_step_count() == 3);
+
+    // No time, or time running backwards, adds nothing.
+    timestep.add_time(0.0);
+    timestep.add_time(-1.0);
+    CHECK(run_steps(timestep) == 0 && timestep.get_alpha() == 0.0f);
+
+    // Sixty frames of a 60 Hz step do not drift.
+    FixedTimestep sixty;
+    uint32_t steps = 0;
+    for (uint32_t frame = 0; frame < 6000; ++frame) {
+        sixty.add_time(1.0 / 60.0);
+        steps += run_steps(sixty);
+    }
+    CHECK(steps == 6000 && sixty.get_alpha() == 0.0f && sixty.get_dropped_steps() == 0);
+
+    CHECK_THROWS(FixedTimestep(0.0, 8));
+    CHECK_THROWS(FixedTimestep(0.01, 0));
+}
+
+static void test_catch_up_clamp() {
+    // A one second stall at 10 ms steps is 100 steps; only 8 run, the rest
+    // are dropped, and the fraction of a step survives.
+    FixedTimestep timestep(0.01, 8);
+    timestep.add_time(1.003);
+    CHECK(timestep.get_dropped_steps() == 92);
+    CHECK(run_steps(timestep) == 8);
+    CHECK(near(timestep.get_alpha(), 0.3));
+
+    // A backlog of exactly the limit is kept whole.
+    timestep.add_time(0.077);
+    CHECK(timestep.get_dropped_steps() == 92);
+    CHECK(run_steps(timestep) == 8);
+    CHECK(near(timestep.get_alpha(), 0.0));
+
+    // Backlogs add up across frames that take no steps.
+    timestep.add_time(0.05);
+    timestep.add_time(0.05);
+    CHECK(timestep.get_dropped_steps() == 94);
+    CHECK(run_steps(timestep) == 8);
+    CHECK(timestep.get_step_count() == 24);
+}
+
+static Simulation make_scene() {
+    Simulation simulation;
+    for (uint32_t i = 0; i < 64; ++i) {
+        SimulationObject object = { { static_cast<float>(i % 8) * 2.0f, 0.0f, static_cast<float>(i / 8) * 2.0f }, 0.1f * i, 0.6f + 0.37f * (i % 16) };
+        CHECK(simulation.add_object(object) == i);
+    }
+    return simulation;
+}
+
+// Drives a simulation the way the engine does, on frame times with jitter
+// and an occasional stall, and returns every interpolated frame.
+static std::vector<ObjectTransform> run_frames(Simulation& simulation, FixedTimestep& timestep) {
+    std::vector<ObjectTransform> frames;
+    std::vector<ObjectTransform> transforms;
+    uint32_t state = 12345;
+    for (uint32_t frame = 0; frame < 2000; ++frame) {
+        state = state * 1664525u + 1013904223u;
+        double elapsed = 0.004 + (state >> 8) % 20000 * 1e-6;
+        if (frame % 500 == 499) {
+            elapsed = 0.5;
+        }
+        timestep.add_time(elapsed);
+        while (timestep.step()) {
+            simulation.step(timestep.get_step_seconds());
+        }
+        simulation.interpolate(timestep.get_alpha(), transforms);
+        frames.insert(frames.end(), transforms.begin(), transforms.end());
+    }
+    return frames;
+}
+
+static void test_determinism() {
+    Simulation first = make_scene();
+    Simulation second = make_scene();
+    FixedTimestep first_timestep;
+    FixedTimestep second_timestep;
+    std::vector<ObjectTransform> a = run_frames(first, first_timestep);
+    std::vector<ObjectTransform> b = run_frames(second, second_timestep);
+    CHECK(first.get_tick() == second.get_tick() && first.get_tick() == first_timestep.get_step_count());
+    CHECK(first_timestep.get_dropped_steps() > 0);
+    CHECK(a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(ObjectTransform)) == 0);
+
+    // Yaw stays wrapped however long it runs.
+    bool wrapped = true;
+    for (const ObjectTransform& transform : a) {
+        wrapped = wrapped && transform.yaw >= -pi && transform.yaw < pi;
+    }
+    CHECK(wrapped);
+}
+
+static void test_interpolate() {
+    Simulation simulation;
+    // Crosses the wrap on its first step: from just under pi to just over -pi.
+    simulation.add_object({ { 1.0f, 2.0f, 3.0f }, 3.1f, 10.0f });
+    simulation.add_object({ { 0.0f, 0.0f, 0.0f }, 0.0f, 1.0f });
+    std::vector<ObjectTransform> transforms;
+    simulation.interpolate(0.5f, transforms);
+    CHECK(transforms.size() == 2 && transforms[0].yaw == 3.1f && transforms[1].yaw == 0.0f);
+
+    simulation.step(0.01);
+    CHECK(simulation.get_tick() == 1 && simulation.get_object_count() == 2);
+    simulation.interpolate(0.0f, transforms);
+    CHECK(std::fabs(transforms[0].yaw - 3.1f) < 1e-5f);
+    simulation.interpolate(1.0f, transforms);
+    CHECK(std::fabs(transforms[0].yaw - (3.2f - 2.0f * pi)) < 1e-5f);
+    CHECK(std::fabs(transforms[1].yaw - 0.01f) < 1e-6f);
+    // Halfway is 3.15, past pi, so it wraps to the negative side rather than
+    // sweeping back through zero.
+    simulation.interpolate(0.5f, transforms);
+    CHECK(std::fabs(transforms[0].yaw - (3.15f - 2.0f * pi)) < 1e-5f);
+    CHECK(transforms[0].position[0] == 1.0f && transforms[0].position[1] == 2.0f && transforms[0].position[2] == 3.0f);
+}
+
+int main() {
+    test_steps();
+    test_catch_up_clamp();
+    test_determinism();
+    test_interpolate();
+    return finish_checks("simulation_test");
+}
@@ -0,0 +1,167 @@
+// Parses DDS and KTX2 files built in memory: well-formed layouts, and
+// headers crafted so that unchecked size arithmetic would wrap and point
+// subresources outside the file.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "check.hpp"
+#include "texture_container.hpp"
+
+static void write_u32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+    memcpy(data.data() + offset, &value, 4);
+}
+
+static void write_u64(std::vector<uint8_t>& data, size_t offset, uint64_t value) {
+    memcpy(data.data() + offset, &value, 8);
+}
+
+static const uint32_t dxt1 = 0x31545844;
+static const uint32_t dx10 = 0x30315844;
+
+// DDS with a FourCC pixel format and room for payload_size bytes.
+static std::vector<uint8_t> make_dds(uint32_t width, uint32_t height, uint32_t mip_levels, uint32_t fourcc, size_t payload_size) {
+    std::vector<uint8_t> data(4 + 124 + (fourcc == dx10 ? 20 : 0) + payload_size);
+    write_u32(data, 0, 0x20534444);
+    write_u32(data, 4, 124);
+    write_u32(data, 4 + 8, height);
+    write_u32(data, 4 + 12, width);
+    write_u32(data, 4 + 24, mip_levels);
+    write_u32(data, 4 + 72 + 4, 0x4);
+    write_u32(data, 4 + 72 + 8, fourcc);
+    return data;
+}
+
+static std::vector<uint8_t> make_dx10_dds(uint32_t width, uint32_t height, uint32_t dxgi_format, uint32_t array_size, bool cube, size_t payload_size) {
+    std::vector<uint8_t> data = make_dds(width, height, 1, dx10, payload_size);
+    write_u32(data, 128, dxgi_format);
+    write_u32(data, 128 + 4, 3);
+    write_u32(data, 128 + 8, cube ? 0x4 : 0);
+    write_u32(data, 128 + 12, array_size);
+    return data;
+}
+
+static std::vector<uint8_t> make_ktx2(uint32_t vk_format, uint32_t width, uint32_t height, uint32_t layers, uint32_t faces, uint32_t mip_levels,
+                                      size_t payload_size) {
+    static const uint8_t identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    std::vector<uint8_t> data(80 + static_cast<size_t>(mip_levels) * 24 + payload_size);
+    memcpy(data.data(), identifier, sizeof(identifier));
+    write_u32(data, 12, vk_format);
+    write_u32(data, 16, 1);
+    write_u32(data, 20, width);
+    write_u32(data, 24, height);
+    write_u32(data, 32, layers);
+    write_u32(data, 36, faces);
+    write_u32(data, 40, mip_levels);
+    return data;
+}
+
+static void test_dds_layout() {
+    // 8x8 BC1 with a full chain: 32 bytes, then 8 for each smaller level.
+    std::vector<uint8_t> data = make_dds(8, 8, 4, dxt1, 32 + 8 * 3);
+    TextureContainer container = parse_texture_container(data.data(), data.size());
+    CHECK(container.format == PixelFormat::bc1);
+    CHECK(container.mip_levels == 4 && container.array_size == 1);
+    CHECK(container.subresources.size() == 4);
+    CHECK(container.subresources[0].offset == 128 && container.subresources[0].row_size == 16 && container.subresources[0].row_count == 2);
+    CHECK(container.subresources[1].offset == 160 && container.subresources[1].row_count == 1);
+    CHECK(container.subresources[3].offset == 176 && container.subresources[3].width == 1);
+
+    CHECK_THROWS(parse_texture_container(data.data(), data.size() - 1));
+}
+
+static void test_dds_bad_extents() {
+    // (width + 3) / 4 in 32 bits wrapped to a zero-byte row.
+    std::vector<uint8_t> wide = make_dds(0xFFFFFFFFu, 4, 1, dxt1, 64);
+    CHECK_THROWS(parse_texture_container(wide.data(), wide.size()));
+
+    std::vector<uint8_t> large = make_dds(16385, 4, 1, dxt1, 64);
+    CHECK_THROWS(parse_texture_container(large.data(), large.size()));
+
+    // More levels than a 4x4 chain has.
+    std::vector<uint8_t> mips = make_dds(4, 4, 5, dxt1, 64);
+    CHECK_THROWS(parse_texture_container(mips.data(), mips.size()));
+
+    // A cube array of 0x2AAAAAAB times six faces wraps to 2 in 32 bits.
+    std::vector<uint8_t> cube = make_dx10_dds(4, 4, 28, 0x2AAAAAABu, true, 2 * 64);
+    CHECK_THROWS(parse_texture_container(cube.data(), cube.size()));
+
+    std::vector<uint8_t> array = make_dx10_dds(4, 4, 28, 2049, false, 64);
+    CHECK_THROWS(parse_texture_container(array.data(), array.size()));
+
+    // The largest legal extent parses only as far as its missing payload.
+    std::vector<uint8_t> truncated = make_dx10_dds(16384, 16384, 28, 2048, false, 64);
+    CHECK_THROWS(parse_texture_container(truncated.data(), truncated.size()));
+
+    std::vector<uint8_t> cube_map = make_dx10_dds(4, 4, 28, 1, true, 6 * 64);
+    TextureContainer container = parse_texture_container(cube_map.data(), cube_map.size());
+    CHECK(container.array_size == 6);
+    CHECK(container.subresources[5].offset == 148 + 5 * 64);
+}
+
+static void test_ktx2_layout() {
+    // RGBA8 4x4 with two levels, level 1 stored first as KTX2 does.
+    std::vector<uint8_t> data = make_ktx2(37, 4, 4, 0, 1, 2, 64 + 16);
+    write_u64(data, 80, 128 + 16);
+    write_u64(data, 88, 64);
+    write_u64(data, 104, 128);
+    write_u64(data, 112, 16);
+    TextureContainer container = parse_texture_container(data.data(), data.size());
+    CHECK(container.format == PixelFormat::rgba8);
+    CHECK(container.mip_levels == 2 && container.array_size == 1);
+    CHECK(container.subresources[0].offset == 144 && container.subresources[0].row_size == 16 && container.subresources[0].row_count == 4);
+    CHECK(container.subresources[1].offset == 128 && container.subresources[1].width == 2);
+
+    // A level shorter than its image.
+    write_u64(data, 88, 63);
+    CHECK_THROWS(parse_texture_container(data.data(), data.size()));
+}
+
+static void test_ktx2_wrapping_offsets() {
+    // 168 bytes whose level offset plus length wraps past zero: the sum
+    // passed the old bounds check and the offset pointed far outside the file.
+    std::vector<uint8_t> data = make_ktx2(37, 4, 4, 0, 1, 1, 64);
+    CHECK(data.size() == 168);
+    write_u64(data, 80, 0xFFFFFFFFFFFFFFF0ull);
+    write_u64(data, 88, 0x50);
+    CHECK_THROWS(parse_texture_container(data.data(), data.size()));
+
+    write_u64(data, 80, 104);
+    write_u64(data, 88, 0xFFFFFFFFFFFFFFF0ull);
+    CHECK_THROWS(parse_texture_container(data.data(), data.size()));
+
+    // Layers times faces wraps to 0 in 32 bits.
+    std::vector<uint8_t> layers = make_ktx2(37, 4, 4, 0x80000000u, 2, 1, 64);
+    write_u64(layers, 80, 104);
+    write_u64(layers, 88, 64);
+    CHECK_THROWS(parse_texture_container(layers.data(), layers.size()));
+
+    std::vector<uint8_t> wide = make_ktx2(131, 0xFFFFFFFDu, 4, 0, 1, 1, 64);
+    write_u64(wide, 80, 104);
+    write_u64(wide, 88, 64);
+    CHECK_THROWS(parse_texture_container(wide.data(), wide.size()));
+}
+
+static void test_copy_with_pitch() {
+    std::vector<uint8_t> data = make_ktx2(37, 2, 2, 0, 1, 1, 16);
+    for (uint8_t i = 0; i < 16; ++i) {
+        data[104 + i] = i;
+    }
+    write_u64(data, 80, 104);
+    write_u64(data, 88, 16);
+    TextureContainer container = parse_texture_container(data.data(), data.size());
+
+    uint8_t dst[2 * 32] = {};
+    copy_container_subresource(data.data(), container.subresources[0], dst, 32);
+    CHECK(dst[0] == 0 && dst[7] == 7 && dst[8] == 0);
+    CHECK(dst[32] == 8 && dst[39] == 15);
+}
+
+int main() {
+    test_dds_layout();
+    test_dds_bad_extents();
+    test_ktx2_layout();
+    test_ktx2_wrapping_offsets();
+    test_copy_with_pitch();
+    return finish_checks("texture_container_test");
+}
@@ -0,0 +1,258 @@
+// Drives TextureStreamer with an in-memory loader: mip-tail-first
+// residency, priority between textures, budget limits, LRU eviction, no
+// eviction in the update that loads a mip, and failed reads.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "texture_streamer.hpp"
+
+// 256x256 at 4 bytes a texel, with mips 4 and below as the resident tail.
+static StreamingTextureDesc make_desc() {
+    StreamingTextureDesc desc = {};
+    desc.width = 256;
+    desc.height = 256;
+    desc.mip_levels = 9;
+    desc.tail_mip = 4;
+    for (uint32_t mip = 0; mip < desc.mip_levels; ++mip) {
+        uint64_t extent = std::max(256u >> mip, 1u);
+        desc.mip_sizes.push_back(extent * extent * 4);
+    }
+    return desc;
+}
+
+static uint64_t get_tail_size(const StreamingTextureDesc& desc) {
+    uint64_t size = 0;
+    for (uint32_t mip = desc.tail_mip; mip < desc.mip_levels; ++mip) {
+        size += desc.mip_sizes[mip];
+    }
+    return size;
+}
+
+struct Loader {
+    std::mutex mutex;
+    std::vector<std::pair<StreamingTextureId, uint32_t>> reads;
+    // Reads left to fail before the loader starts succeeding.
+    std::atomic<int> failures{0};
+
+    TextureStreamer::LoadFunction get_function() {
+        return [this](StreamingTextureId texture, uint32_t mip, std::vector<uint8_t>& data) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reads.push_back({ texture, mip });
+            data.assign(16, static_cast<uint8_t>(mip));
+            return failures.fetch_sub(1) <= 0;
+        };
+    }
+};
+
+// Calls update() for one frame until nothing is in flight, re-issuing the
+// frame's requests each time the way a renderer would. Collects what loaded
+// and what was evicted, in order.
+template <typename Requests>
+static StreamingUpdate settle(TextureStreamer& streamer, uint64_t frame, Requests requests) {
+    StreamingUpdate all;
+    for (int attempt = 0; attempt < 10000; ++attempt) {
+        requests();
+        StreamingUpdate update = streamer.update(frame);
+        for (StreamedMip& mip : update.loaded) {
+            all.loaded.push_back(std::move(mip));
+        }
+        all.evicted.insert(all.evicted.end(), update.evicted.begin(), update.evicted.end());
+        StreamingCounters counters = streamer.get_counters();
+        // Loads are only issued into room the budget has; a lowered budget
+        // is met by evicting as later loads need the space.
+        CHECK(counters.pending_bytes == 0 || counters.resident_bytes + counters.pending_bytes <= counters.budget_bytes);
+        if (counters.pending_requests == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return all;
+}
+
+static void test_wanted_mip() {
+    StreamingTextureDesc desc = make_desc();
+    CHECK(TextureStreamer::compute_wanted_mip(desc, 0.0f) == desc.tail_mip);
+    CHECK(TextureStreamer::compute_wanted_mip(desc, 256.0f) == 0);
+    CHECK(TextureStreamer::compute_wanted_mip(desc, 1000.0f) == 0);
+    CHECK(TextureStreamer::compute_wanted_mip(desc, 64.0f) == 2);
+    CHECK(TextureStreamer::compute_wanted_mip(desc, 1.0f) == desc.tail_mip);
+    CHECK(TextureStreamer::compute_screen_size(1.0f, 0.5f, 1.0f, 720.0f) > 720.0f);
+    CHECK(TextureStreamer::compute_screen_size(1.0f, 100.0f, 1.0f, 720.0f) < TextureStreamer::compute_screen_size(1.0f, 10.0f, 1.0f, 720.0f));
+}
+
+static void test_tail_first_order() {
+    Loader loader;
+    TextureStreamer streamer(64ull << 20, 1, loader.get_function());
+    StreamingTextureDesc desc = make_desc();
+    StreamingTextureId id = streamer.register_texture(desc);
+    CHECK(streamer.get_resident_mip(id) == desc.tail_mip);
+    CHECK(streamer.get_counters().resident_bytes == get_tail_size(desc));
+
+    // Full detail is wanted at once, but arrives one mip at a time, coarsest first.
+    StreamingUpdate update = settle(streamer, 1, [&] { streamer.request(id, 512.0f, 1); });
+    CHECK(update.loaded.size() == desc.tail_mip);
+    for (size_t i = 0; i < update.loaded.size(); ++i) {
+        CHECK(update.loaded[i].texture == id);
+        CHECK(update.loaded[i].mip == desc.tail_mip - 1 - i);
+        CHECK(update.loaded[i].data.size() == 16 && update.loaded[i].data[0] == update.loaded[i].mip);
+    }
+    CHECK(streamer.get_resident_mip(id) == 0);
+    CHECK(update.evicted.empty());
+
+    StreamingCounters counters = streamer.get_counters();
+    uint64_t total = get_tail_size(desc);
+    for (uint32_t mip = 0; mip < desc.tail_mip; ++mip) {
+        total += desc.mip_sizes[mip];
+    }
+    CHECK(counters.resident_bytes == total);
+    CHECK(counters.loads_completed == desc.tail_mip);
+    CHECK(counters.pending_bytes == 0);
+}
+
+static void test_priority() {
+    Loader loader;
+    StreamingTextureDesc desc = make_desc();
+    // Both tails plus exactly one mip 3: the two textures compete for it.
+    uint64_t budget = get_tail_size(desc) * 2 + desc.mip_sizes[3];
+    TextureStreamer streamer(budget, 1, loader.get_function());
+    StreamingTextureId small = streamer.register_texture(desc);
+    StreamingTextureId large = streamer.register_texture(desc);
+
+    StreamingUpdate update = settle(streamer, 1, [&] {
+        streamer.request(small, 40.0f, 1);
+        streamer.request(large, 300.0f, 1);
+    });
+    CHECK(update.loaded.size() == 1);
+    CHECK(streamer.get_resident_mip(large) == 3);
+    CHECK(streamer.get_resident_mip(small) == desc.tail_mip);
+    // Both were used this frame, so neither is evicted for the other.
+    CHECK(update.evicted.empty());
+}
+
+static void test_budget_eviction() {
+    Loader loader;
+    StreamingTextureDesc desc = make_desc();
+    // Three tails plus mips 3 and 2 for one texture.
+    uint64_t budget = get_tail_size(desc) * 3 + desc.mip_sizes[3] + desc.mip_sizes[2];
+    TextureStreamer streamer(budget, 2, loader.get_function());
+    StreamingTextureId a = streamer.register_texture(desc);
+    StreamingTextureId b = streamer.register_texture(desc);
+    StreamingTextureId c = streamer.register_texture(desc);
+
+    settle(streamer, 1, [&] { streamer.request(a, 64.0f, 1); });
+    CHECK(streamer.get_resident_mip(a) == 2);
+
+    // b is seen later but also drops out of view before c needs the memory.
+    settle(streamer, 2, [&] { streamer.request(b, 8.0f, 2); });
+    CHECK(streamer.get_resident_mip(b) == desc.tail_mip);
+
+    // c wants mip 3; a, not used since frame 1, gives up its finest mip.
+    StreamingUpdate update = settle(streamer, 3, [&] { streamer.request(c, 32.0f, 3); });
+    CHECK(streamer.get_resident_mip(c) == 3);
+    CHECK(streamer.get_resident_mip(a) == 3);
+    CHECK(update.evicted.size() == 1 && update.evicted[0].texture == a && update.evicted[0].resident_mip == 3);
+
+    // c is seen this frame, but holding more detail than it wants leaves it
+    // evictable, and its mip 3 makes room for a to return to mip 2.
+    update = settle(streamer, 4, [&] {
+        streamer.request(a, 64.0f, 4);
+        streamer.request(c, 1.0f, 4);
+    });
+    CHECK(update.evicted.size() == 1 && update.evicted[0].texture == c);
+    CHECK(streamer.get_resident_mip(c) == desc.tail_mip);
+    CHECK(streamer.get_resident_mip(a) == 2);
+    CHECK(streamer.get_counters().evictions == 2);
+
+    // With no budget left everything else drops to its tail, which is never
+    // evicted, and the load that asked for the room is not issued.
+    streamer.set_budget(0);
+    update = settle(streamer, 5, [&] { streamer.request(b, 512.0f, 5); });
+    CHECK(update.loaded.empty());
+    CHECK(streamer.get_resident_mip(a) == desc.tail_mip);
+    CHECK(streamer.get_resident_mip(b) == desc.tail_mip);
+    CHECK(streamer.get_counters().resident_bytes == get_tail_size(desc) * 3);
+}
+
+static void test_evict_after_load() {
+    Loader loader;
+    StreamingTextureDesc desc = make_desc();
+    // Two tails and one mip 3.
+    TextureStreamer streamer(get_tail_size(desc) * 2 + desc.mip_sizes[3], 1, loader.get_function());
+    StreamingTextureId a = streamer.register_texture(desc);
+    StreamingTextureId c = streamer.register_texture(desc);
+
+    streamer.request(a, 32.0f, 1);
+    streamer.update(1);
+    CHECK(streamer.get_counters().pending_requests == 1);
+
+    // While a's load is in flight it stops wanting the detail and c wants
+    // it. c finds no room until a's mip arrives, and the update handing out
+    // a's mip must not also evict it: the caller maps the mip afterwards.
+    bool c_loaded = false;
+    uint32_t a_evicted = 0;
+    for (int attempt = 0; attempt < 10000 && !c_loaded; ++attempt) {
+        streamer.request(a, 1.0f, 2);
+        streamer.request(c, 32.0f, 2);
+        StreamingUpdate update = streamer.update(2);
+        for (const StreamedMip& mip : update.loaded) {
+            for (const MipEviction& eviction : update.evicted) {
+                CHECK(eviction.texture != mip.texture);
+            }
+            c_loaded |= mip.texture == c;
+        }
+        for (const MipEviction& eviction : update.evicted) {
+            CHECK(eviction.texture == a && eviction.resident_mip == desc.tail_mip);
+            a_evicted++;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    CHECK(c_loaded && a_evicted == 1);
+    CHECK(streamer.get_resident_mip(a) == desc.tail_mip);
+    CHECK(streamer.get_resident_mip(c) == 3);
+    CHECK(streamer.get_counters().resident_bytes == get_tail_size(desc) * 2 + desc.mip_sizes[3]);
+}
+
+static void test_failed_load() {
+    Loader loader;
+    loader.failures = 2;
+    TextureStreamer streamer(64ull << 20, 1, loader.get_function());
+    StreamingTextureDesc desc = make_desc();
+    StreamingTextureId id = streamer.register_texture(desc);
+
+    // A failed read releases its pending bytes and the mip is asked for again.
+    StreamingUpdate update = settle(streamer, 1, [&] { streamer.request(id, 512.0f, 1); });
+    CHECK(update.loaded.size() == desc.tail_mip);
+    CHECK(loader.reads.size() == desc.tail_mip + 2);
+    CHECK(loader.reads[0].second == 3 && loader.reads[1].second == 3 && loader.reads[2].second == 3);
+    CHECK(streamer.get_resident_mip(id) == 0);
+    CHECK(streamer.get_counters().loads_completed == desc.tail_mip);
+    CHECK(streamer.get_counters().pending_bytes == 0);
+}
+
+static void test_invalid_desc() {
+    Loader loader;
+    TextureStreamer streamer(1 << 20, 1, loader.get_function());
+    StreamingTextureDesc desc = make_desc();
+    desc.tail_mip = desc.mip_levels;
+    CHECK_THROWS(streamer.register_texture(desc));
+    desc = make_desc();
+    desc.mip_sizes.pop_back();
+    CHECK_THROWS(streamer.register_texture(desc));
+}
+
+int main() {
+    test_wanted_mip();
+    test_tail_first_order();
+    test_priority();
+    test_budget_eviction();
+    test_evict_after_load();
+    test_failed_load();
+    test_invalid_desc();
+    return finish_checks("texture_streamer_test");
+}
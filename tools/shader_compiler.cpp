@@ -0,0 +1,147 @@
+// Build step for the engine target: compiles every stage the permutation
+// manifest needs and writes the bytecode out as constexpr arrays for
+// engine/embedded_shaders.cpp to include.
+//
+// shader_compiler <shaders.hlsl> <shader_permutations.txt> <output.inl> [--optimize]
+
+#include <windows.h>
+#include <d3dcompiler.h>
+#include <wrl.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "shader_permutations.hpp"
+#include "shader_reflection.hpp"
+
+static std::string read_text(const std::string& path) {
+    std::string text;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return text;
+    }
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, read);
+    }
+    fclose(file);
+    return text;
+}
+
+static std::vector<uint8_t> compile_stage(const std::string& shader_path, const ShaderStageCompile& compile, UINT flags) {
+    bool vertex = compile.stage == PipelineShaderStage::vertex;
+    std::vector<ShaderDefine> defines = get_permutation_defines(compile.permutation, compile.stage);
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const ShaderDefine& define : defines) {
+        macros.push_back({ define.name.c_str(), define.value.c_str() });
+    }
+    macros.push_back({ nullptr, nullptr });
+
+    Microsoft::WRL::ComPtr<ID3DBlob> blob;
+    Microsoft::WRL::ComPtr<ID3DBlob> error;
+    std::wstring wide_path = std::filesystem::path(shader_path).wstring();
+    if (FAILED(D3DCompileFromFile(wide_path.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, vertex ? "VSMain" : "PSMain",
+                                  vertex ? "vs_5_0" : "ps_5_0", flags, 0, &blob, &error))) {
+        std::string message = error ? std::string(static_cast<const char*>(error->GetBufferPointer()), error->GetBufferSize()) : std::string();
+        throw std::runtime_error("Failed to compile " + shader_path + " (" + (vertex ? "VSMain" : "PSMain") + "): " + message);
+    }
+    const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+    return std::vector<uint8_t>(data, data + blob->GetBufferSize());
+}
+
+static const char* get_stage_name(PipelineShaderStage stage) {
+    return stage == PipelineShaderStage::vertex ? "PipelineShaderStage::vertex" : "PipelineShaderStage::pixel";
+}
+
+static const char* get_binding_type_name(ShaderBindingType type) {
+    switch (type) {
+    case ShaderBindingType::constant_buffer:
+        return "ShaderBindingType::constant_buffer";
+    case ShaderBindingType::structured_buffer:
+        return "ShaderBindingType::structured_buffer";
+    case ShaderBindingType::texture:
+        return "ShaderBindingType::texture";
+    default:
+        return "ShaderBindingType::sampler";
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: shader_compiler <shaders.hlsl> <shader_permutations.txt> <output.inl> [--optimize]\n");
+        return 1;
+    }
+    std::string shader_path = argv[1];
+    std::string manifest_path = argv[2];
+    std::string output_path = argv[3];
+    bool optimize = argc > 4 && strcmp(argv[4], "--optimize") == 0;
+    UINT flags = optimize ? D3DCOMPILE_OPTIMIZATION_LEVEL3 : D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+
+    try {
+        std::vector<ShaderPermutation> manifest = load_permutation_manifest(manifest_path);
+        ShaderPermutationPlan plan = plan_permutations(manifest);
+
+        std::string out = "// Generated by shader_compiler from shaders.hlsl and shader_permutations.txt; do not edit.\n\n";
+        char line[256];
+        std::vector<size_t> binding_counts;
+        for (size_t i = 0; i < plan.compiles.size(); ++i) {
+            std::vector<uint8_t> bytecode = compile_stage(shader_path, plan.compiles[i], flags);
+            snprintf(line, sizeof(line), "constexpr uint8_t embedded_shader_%zu[] = {", i);
+            out += line;
+            for (size_t b = 0; b < bytecode.size(); ++b) {
+                snprintf(line, sizeof(line), "%s0x%02x,", b % 16 == 0 ? "\n    " : " ", bytecode[b]);
+                out += line;
+            }
+            out += "\n};\n\n";
+
+            // Recorded so the engine derives its root signature without reflecting at startup.
+            std::vector<ShaderBinding> bindings = reflect_shader_bindings({ bytecode.data(), bytecode.size() }, plan.compiles[i].stage);
+            binding_counts.push_back(bindings.size());
+            if (!bindings.empty()) {
+                snprintf(line, sizeof(line), "constexpr EmbeddedShaderBinding embedded_bindings_%zu[] = {\n", i);
+                out += line;
+                for (const ShaderBinding& binding : bindings) {
+                    snprintf(line, sizeof(line), "    { \"%s\", %s, %uu, %uu, %uu },\n",
+                             binding.name.c_str(), get_binding_type_name(binding.type), binding.register_index, binding.space, binding.size);
+                    out += line;
+                }
+                out += "};\n\n";
+            }
+        }
+        out += "constexpr EmbeddedShader embedded_shaders[] = {\n";
+        for (size_t i = 0; i < plan.compiles.size(); ++i) {
+            char bindings[64] = "nullptr";
+            if (binding_counts[i] > 0) {
+                snprintf(bindings, sizeof(bindings), "embedded_bindings_%zu", i);
+            }
+            snprintf(line, sizeof(line), "    { %s, 0x%xu, embedded_shader_%zu, sizeof(embedded_shader_%zu), %s, %zu },\n",
+                     get_stage_name(plan.compiles[i].stage), plan.compiles[i].permutation.get_key(), i, i, bindings, binding_counts[i]);
+            out += line;
+        }
+        out += "};\n\nconstexpr ShaderPermutation embedded_manifest[] = {\n";
+        for (const ShaderPermutation& permutation : plan.pipelines) {
+            snprintf(line, sizeof(line), "    { 0x%xu, %uu },\n", permutation.features, permutation.light_tier);
+            out += line;
+        }
+        out += "};\n";
+
+        // Leave an unchanged file alone so the engine does not rebuild.
+        if (read_text(output_path) != out) {
+            std::filesystem::create_directories(std::filesystem::path(output_path).parent_path());
+            FILE* file = fopen(output_path.c_str(), "wb");
+            bool written = file && fwrite(out.data(), 1, out.size(), file) == out.size();
+            written = file && fclose(file) == 0 && written;
+            if (!written) {
+                throw std::runtime_error("Failed to write " + output_path);
+            }
+        }
+        printf("shader_compiler: %zu pipelines, %zu stage compiles (%s)\n", plan.pipelines.size(), plan.compiles.size(), optimize ? "optimized" : "debug");
+    } catch (const std::exception& e) {
+        fprintf(stderr, "shader_compiler: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+// Steps the simulation as fast as it will go, with no window or device, and
+// reports the tick rate. Portable: builds from core alone, so it runs on
+// build machines without D3D12.
+//
+// simulation_headless [ticks] [objects]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "fixed_timestep.hpp"
+#include "simulation.hpp"
+
+int main(int argc, char** argv) {
+    uint64_t ticks = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    uint32_t object_count = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 1;
+
+    // The engine's step, without the real-time accumulator.
+    const double step_seconds = FixedTimestep().get_step_seconds();
+    Simulation simulation;
+    for (uint32_t i = 0; i < object_count; ++i) {
+        SimulationObject object = {{static_cast<float>(i % 32) * 2.0f, 0.0f, static_cast<float>(i / 32) * 2.0f}, 0.0f, 0.6f + 0.01f * (i % 16)};
+        simulation.add_object(object);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t tick = 0; tick < ticks; ++tick) {
+        simulation.step(step_seconds);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%llu ticks of %u objects in %.3f s: %.0f ticks/s, %.1fx real time\n", static_cast<unsigned long long>(simulation.get_tick()),
+           object_count, seconds, ticks / seconds, ticks * step_seconds / seconds);
+    return 0;
+}
@@ -17,10 +17,107 @@ target("gameplay")
     add_deps("core_modules")
     add_files("gameplay/api.cpp")
 
+-- Job system (work-stealing pool and task graphs) and the fixed-step
+-- simulation, no platform dependencies.
+target("core")
+    set_kind("static")
+    set_policy("build.c++.modules", false)
+    add_files("core/job_pool.cpp", "core/profiler.cpp", "core/task_graph.cpp", "core/fixed_timestep.cpp", "core/simulation.cpp")
+    add_headerfiles("core/*.hpp")
+    add_includedirs("core", { public = true })
+    if is_plat("linux") then
+        add_syslinks("pthread")
+    end
+
+-- Spawn overhead, fork/join latency and scaling of the job system.
+target("job_pool_bench")
+    set_kind("binary")
+    set_default(false)
+    set_policy("build.c++.modules", false)
+    add_deps("core")
+    add_files("benchmarks/job_pool_bench.cpp")
+
+-- The simulation stepped flat out with no window or device.
+target("simulation_headless")
+    set_kind("binary")
+    set_default(false)
+    set_policy("build.c++.modules", false)
+    add_deps("core")
+    add_files("tools/simulation_headless.cpp")
+
+-- Headless tests and benchmarks of the portable engine modules. Each builds
+-- the sources it exercises, like shader_compiler does; none is built by
+-- default. Tests exit non-zero on a failed check and run with `xmake test`.
+function headless_target(name, files)
+    target(name)
+        set_kind("binary")
+        set_default(false)
+        set_policy("build.c++.modules", false)
+        add_deps("core")
+        add_files(files)
+        add_includedirs("engine", "libs", "tests")
+        if name:endswith("_test") then
+            set_group("tests")
+            add_tests("default")
+        else
+            set_group("benchmarks")
+        end
+    target_end()
+end
+
+headless_target("light_clusters_test", {"tests/light_clusters_test.cpp", "engine/light_clusters.cpp"})
+headless_target("light_clusters_bench", {"benchmarks/light_clusters_bench.cpp", "engine/light_clusters.cpp"})
+headless_target("mip_generator_test", {"tests/mip_generator_test.cpp", "engine/mip_generator.cpp"})
+headless_target("mip_generator_bench", {"benchmarks/mip_generator_bench.cpp", "engine/mip_generator.cpp"})
+headless_target("block_compress_bench", {"benchmarks/block_compress_bench.cpp", "engine/block_compress.cpp"})
+headless_target("texture_container_test", {"tests/texture_container_test.cpp", "engine/texture_container.cpp"})
+headless_target("texture_streamer_test", {"tests/texture_streamer_test.cpp", "engine/texture_streamer.cpp"})
+headless_target("image_batch_bench", {"benchmarks/image_batch_bench.cpp", "engine/image_batch_loader.cpp", "engine/image_decoder.cpp", "engine/pnm_reader.cpp", "engine/png_reader.cpp", "engine/inflate_stream.cpp"})
+headless_target("atlas_packer_test", {"tests/atlas_packer_test.cpp", "engine/atlas_packer.cpp"})
+headless_target("atlas_packer_bench", {"benchmarks/atlas_packer_bench.cpp", "engine/atlas_packer.cpp"})
+headless_target("pnm_reader_test", {"tests/pnm_reader_test.cpp", "engine/pnm_reader.cpp"})
+headless_target("float_pack_test", {"tests/float_pack_test.cpp", "engine/float_pack.cpp"})
+headless_target("float_pack_bench", {"benchmarks/float_pack_bench.cpp", "engine/float_pack.cpp"})
+headless_target("shader_cache_test", {"tests/shader_cache_test.cpp", "engine/shader_cache.cpp", "engine/content_hash.cpp"})
+headless_target("pipeline_desc_test", {"tests/pipeline_desc_test.cpp", "engine/pipeline_desc.cpp", "engine/content_hash.cpp"})
+headless_target("shader_bindings_test", {"tests/shader_bindings_test.cpp", "engine/shader_bindings.cpp"})
+headless_target("png_reader_test", {"tests/png_reader_test.cpp", "engine/png_reader.cpp", "engine/inflate_stream.cpp", "engine/image_decoder.cpp", "engine/pnm_reader.cpp"})
+headless_target("resource_cache_test", {"tests/resource_cache_test.cpp", "engine/mapped_file.cpp", "engine/content_hash.cpp"})
+headless_target("image_batch_loader_test", {"tests/image_batch_loader_test.cpp", "engine/image_batch_loader.cpp", "engine/image_decoder.cpp", "engine/pnm_reader.cpp", "engine/png_reader.cpp", "engine/inflate_stream.cpp"})
+headless_target("shader_permutations_test", {"tests/shader_permutations_test.cpp", "engine/shader_permutations.cpp"})
+headless_target("job_pool_test", {"tests/job_pool_test.cpp"})
+headless_target("simulation_test", {"tests/simulation_test.cpp"})
+headless_target("profiler_test", {"tests/profiler_test.cpp"})
+headless_target("input_test", {"tests/input_test.cpp", "engine/input.cpp"})
+
+-- Host tool the engine build runs to compile shaders.hlsl into embedded bytecode.
+target("shader_compiler")
+    set_kind("binary")
+    set_policy("build.c++.modules", false)
+    add_files("tools/shader_compiler.cpp", "engine/shader_permutations.cpp", "engine/shader_bindings.cpp", "engine/shader_reflection.cpp")
+    add_includedirs("engine", "libs")
+    add_syslinks("d3dcompiler")
+
 target("engine")
     set_kind("binary")
     set_policy("build.c++.modules", false)
-    add_files("engine/entry.cpp", "engine/window.cpp", "engine/renderer.cpp", "engine/pipeline.cpp", "engine/buffer.cpp", "engine/camera.cpp", "engine/texture.cpp")
+    add_deps("core", "shader_compiler")
+    add_files("engine/entry.cpp", "engine/window.cpp", "engine/renderer.cpp", "engine/pipeline.cpp", "engine/buffer.cpp", "engine/camera.cpp", "engine/texture.cpp", "engine/light_clusters.cpp", "engine/mip_generator.cpp", "engine/block_compress.cpp", "engine/mapped_file.cpp", "engine/texture_container.cpp", "engine/texture_streamer.cpp", "engine/streamed_texture.cpp", "engine/image_batch_loader.cpp", "engine/texture_loader.cpp", "engine/atlas_packer.cpp", "engine/texture_pack.cpp", "engine/pnm_reader.cpp", "engine/image_decoder.cpp", "engine/content_hash.cpp", "engine/pixel_convert.cpp", "engine/float_pack.cpp", "engine/inflate_stream.cpp", "engine/png_reader.cpp", "engine/shader_cache.cpp", "engine/pipeline_desc.cpp", "engine/pipeline_cache.cpp", "engine/shader_permutations.cpp", "engine/shader_permutation_set.cpp", "engine/file_watcher.cpp", "engine/embedded_shaders.cpp", "engine/shader_bindings.cpp", "engine/shader_reflection.cpp", "engine/frame_packet_queue.cpp", "engine/input.cpp")
     add_headerfiles("engine/*.hpp")
-    add_includedirs("libs")
+    add_includedirs("libs", "$(buildir)/generated")
     add_syslinks("d3d12", "dxgi", "d3dcompiler", "user32")
+    if is_mode("release") then
+        add_defines("OPTIMIZE_SHADERS")
+    end
+    on_load(function (target)
+        -- Hot reload watches the shader sources in the checkout.
+        target:add("defines", "SHADER_SOURCE_DIRECTORY=\"" .. (path.join(os.projectdir(), "engine"):gsub("\\", "/")) .. "\"")
+    end)
+    before_build(function (target)
+        import("core.project.config")
+        local args = {"engine/shaders.hlsl", "engine/shader_permutations.txt", path.join(config.buildir(), "generated", "embedded_shaders.inl")}
+        if is_mode("release") then
+            table.insert(args, "--optimize")
+        end
+        os.vrunv(target:dep("shader_compiler"):targetfile(), args, {curdir = os.projectdir()})
+    end)